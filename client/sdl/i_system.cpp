@@ -828,6 +828,47 @@ void I_PrintStr (int xp, const char *cp, int count, BOOL scroll)
 	// used in the DOS version
 }
 
+//
+// I_FlushLog
+//
+// The client writes to the log as it goes, so there's nothing queued.
+//
+void I_FlushLog(bool crashing)
+{
+	if (LOG.is_open())
+		LOG.flush();
+}
+
+//
+// I_ReopenLog
+//
+// Starts logging to path instead of the current log file, if any.  Returns
+// false if it can't be opened.
+//
+bool I_ReopenLog(const std::string& path)
+{
+	if (LOG.is_open())
+		LOG.close();
+
+	LOG_FILE = path;
+	LOG.open(LOG_FILE.c_str(), std::ios::app);
+
+	if (!LOG.is_open())
+		return false;
+
+	LOG << std::endl;
+	return true;
+}
+
+//
+// I_CloseLog
+//
+void I_CloseLog()
+{
+	if (LOG.is_open())
+		LOG.close();
+}
+
 #ifdef _WIN32 // denis - fixme - make this work on POSIX
 
 long I_FindFirst (char *filespec, findstate_t *fileinfo)
@@ -104,6 +104,14 @@ void I_PaintConsole (void);
 // Print a console string
 void I_PrintStr (int x, const char *str, int count, BOOL scroll);
 
+// Writes out anything printed but not yet in the log file.  Crash handlers
+// pass crashing.
+void I_FlushLog(bool crashing = false);
+
+// Switch log files or stop logging.
+bool I_ReopenLog(const std::string& path);
+void I_CloseLog();
+
 // Set the title string of the startup window
 void I_SetTitleString (const char *title);
 
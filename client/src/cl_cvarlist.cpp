@@ -293,6 +293,8 @@ CVAR (sv_maxplayers,		"0", "maximum players who can join the game, others are sp
 // Maximum number of players that can be on a team
 CVAR (sv_maxplayersperteam, "0", "Maximum number of players that can be on a team", CVARTYPE_BYTE, CVAR_SERVERINFO | CVAR_LATCH | CVAR_NOENABLEDISABLE)
 CVAR_RANGE (sv_teamsinplay, "2", "Teams that are enabled", CVARTYPE_BYTE, CVAR_SERVERINFO | CVAR_LATCH | CVAR_NOENABLEDISABLE, 2.0f, 3.0f)
+// Build a REJECT table for maps that lack one, in offline games
+CVAR (sv_buildreject,		"0", "Build a REJECT table for maps that lack one", CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
 
 
 // Netcode Settings
@@ -502,6 +504,12 @@ CVAR(hud_targethealth_debug, "0",
 CVAR(			hud_timer, "1", "Show the HUD timer:\n// 0: No Timer\n// 1: Count-down Timer\n// 2: Count-up timer",
 				CVARTYPE_INT, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE)
 
+CVAR(			hud_cachetext, "1", "Cache rendered HUD text between frames",
+				CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
+
+CVAR(			hud_profile, "0", "Display the time taken to draw each HUD element",
+				CVARTYPE_BOOL, CVAR_NULL)
+
 CVAR(hud_speedometer, "0", "Show the HUD speedometer", CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
 
 CVAR_RANGE(		hud_transparency, "1.0", "HUD transparency",
@@ -644,6 +652,12 @@ CVAR_RANGE(		r_drawplayersprites, "1", "Weapon Transparency",
 CVAR(			r_particles, "1", "Draw particles",
 				CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
 
+CVAR(			r_interpolate, "1", "Interpolate actors, moving floors/ceilings and scrolling textures at uncapped framerates",
+				CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
+
+CVAR_RANGE_FUNC_DECL(r_lightcachesize, "64", "Number of light/fade colormap tables kept cached between palette, gamma and sector color changes",
+				CVARTYPE_INT, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 1024.0f)
+
 CVAR_RANGE_FUNC_DECL(r_stretchsky, "2", "Stretch sky textures. (0 - always off, 1 - always on, 2 - auto)",
 				CVARTYPE_BYTE, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 2.0f)
 
@@ -117,12 +117,25 @@ BOOL      connected;
 netadr_t  serveraddr; // address of a server
 netadr_t  lastconaddr;
 
-const static size_t PACKET_SEQ_MASK = 0xFF;
-static int packetseq[256];
+const static size_t PACKET_SEQ_MASK = PACKET_SEQ_WINDOW - 1;
+static int packetseq[PACKET_SEQ_WINDOW];
+
+// Pieces of reliable data that was too big for one packet, keyed by the
+// sequence of the first piece.
+struct fragments_t
+{
+	std::vector<std::string> pieces;
+	size_t received;
+};
+typedef std::map<int, fragments_t> Fragments;
+static Fragments fragments;
 
 // denis - unique session key provided by the server
 std::string digest;
 
+// NETF_* the server agreed to, 0 until its ConsolePlayer arrives
+int netfeatures = 0;
+
 // denis - clientside compressor, used for decompression
 huffman_client compressor;
 
@@ -891,8 +904,7 @@ BEGIN_COMMAND (serverinfo)
     // Data
 	for (size_t i = 0; i < server_cvars.size(); i++)
 	{
-		cvar_t *dummy;
-		Cvar = cvar_t::FindCVar(server_cvars[i].c_str(), &dummy);
+		Cvar = cvar_t::FindCVar(server_cvars[i].c_str());
 
 		Printf( "%*s - %s\n",
 				MaxFieldLength,
@@ -1747,11 +1759,13 @@ bool CL_Connect()
 	players.clear();
 
 	memset(packetseq, -1, sizeof(packetseq));
+	fragments.clear();
+	netfeatures = 0;
 
 	// [AM] This needs to go out ASAP so the server can start sending us
 	//      messages.
-	MSG_WriteMarker(&net_buffer, clc_ack);
-	MSG_WriteLong(&net_buffer, 0);
+	packetseq[0] = 0;
+	CL_SendAck(0);
 	NET_SendPacket(::net_buffer, ::serveraddr);
 	Printf("Requesting server state...\n");
 
@@ -1872,6 +1886,10 @@ void CL_TryToConnect(DWORD server_token)
 
         MSG_WriteString(&net_buffer, (char *)connectpasshash.c_str());
 
+		// Ask for the network features we know about.  Older servers stop
+		// reading after the password.
+		MSG_WriteLong(&net_buffer, NETF_ALL);
+
 		NET_SendPacket(net_buffer, serveraddr);
 		SZ_Clear(&net_buffer);
 	}
@@ -1926,6 +1944,96 @@ void CL_Decompress()
 	MSG_DecompressMinilzo();
 }
 
+//
+// CL_SendAck
+//
+// Acks a packet.  If the server agreed to NETF_SELECTIVEACK, which of the 32
+// packets before it have arrived goes along too so that the server can tell
+// which ones went missing.
+//
+void CL_SendAck(int sequence)
+{
+	if (!(netfeatures & NETF_SELECTIVEACK))
+	{
+		MSG_WriteMarker(&net_buffer, clc_ack);
+		MSG_WriteLong(&net_buffer, sequence);
+		return;
+	}
+
+	unsigned int bits = 0;
+	for (int i = 0; i < 32; i++)
+	{
+		const int seq = sequence - 1 - i;
+		if (seq >= 0 && ::packetseq[seq & PACKET_SEQ_MASK] == seq)
+			bits |= 1u << i;
+	}
+
+	MSG_WriteMarker(&net_buffer, clc_ackbits);
+	MSG_WriteLong(&net_buffer, sequence);
+	MSG_WriteLong(&net_buffer, bits);
+}
+
+//
+// CL_ReadFragment
+//
+// Stores a piece of reliable data that the server had to split up.  Once
+// every piece is here, net_message is replaced with all of it put back
+// together and true is returned.
+//
+static bool CL_ReadFragment(int sequence)
+{
+	const int first = MSG_ReadLong();
+	const int index = MSG_ReadByte();
+	const int count = MSG_ReadByte();
+
+	if (index < 0 || count <= 0 || index >= count || first > sequence)
+	{
+		SZ_Clear(&::net_message);
+		return false;
+	}
+
+	// Forget about anything too old to ever be finished.
+	while (!fragments.empty() &&
+	       fragments.begin()->first <= sequence - PACKET_SEQ_WINDOW)
+	{
+		fragments.erase(fragments.begin());
+	}
+
+	fragments_t& frag = fragments[first];
+	if (frag.pieces.empty())
+	{
+		frag.pieces.resize(count);
+		frag.received = 0;
+	}
+
+	const size_t len = MSG_BytesLeft();
+	if (frag.pieces.size() != (size_t)count || !frag.pieces[index].empty() || len == 0)
+	{
+		SZ_Clear(&::net_message);
+		return false;
+	}
+
+	frag.pieces[index].assign((const char*)MSG_ReadChunk(len), len);
+	frag.received++;
+
+	if (frag.received < frag.pieces.size())
+		return false;
+
+	size_t total = 0;
+	for (size_t i = 0; i < frag.pieces.size(); i++)
+		total += frag.pieces[i].size();
+
+	::net_message.clear();
+	if (::net_message.maxsize() <= total)
+		::net_message.resize(total + 1, false);
+
+	for (size_t i = 0; i < frag.pieces.size(); i++)
+		::net_message.WriteChunk(frag.pieces[i].data(), frag.pieces[i].size());
+
+	fragments.erase(first);
+	return true;
+}
+
 /**
  * @brief Read the header of the packet and prepare the rest of it for reading.
  * 
@@ -1939,7 +2047,9 @@ bool CL_ReadPacketHeader()
 
 	if (sequence == oldsequence)
 	{
-		// Duplicate packet, burn it and return early.
+		// Duplicate packet, burn it and return early.  It's acked again in
+		// case our first ack was the thing that got lost.
+		CL_SendAck(sequence);
 		SZ_Clear(&::net_message);
 		return false;
 	}
@@ -1948,8 +2058,7 @@ bool CL_ReadPacketHeader()
 	::packetseq[sequence & PACKET_SEQ_MASK] = sequence;
 
 	// Send an ACK to the server.
-	MSG_WriteMarker(&net_buffer, clc_ack);
-	MSG_WriteLong(&net_buffer, sequence);
+	CL_SendAck(sequence);
 
 	// Flag bits.
 	byte flags = MSG_ReadByte();
@@ -1964,6 +2073,10 @@ bool CL_ReadPacketHeader()
 	}
 
 	netgraph.addPacketIn();
+
+	if (flags & SVF_FRAGMENT)
+		return CL_ReadFragment(sequence);
+
 	return true;
 }
 
@@ -61,6 +61,7 @@ void CL_InitNetwork (void);
 void CL_RequestConnectInfo(void);
 bool CL_PrepareConnect();
 void CL_ParseCommands(void);
+void CL_SendAck(int sequence);
 bool CL_ReadPacketHeader();
 void CL_SendCmd(void);
 void CL_SaveCmd(void);
@@ -82,6 +82,7 @@ EXTERN_CVAR(mute_spectators)
 EXTERN_CVAR(show_messages)
 
 extern std::string digest;
+extern int netfeatures;
 extern bool forcenetdemosplit;
 extern int last_svgametic;
 extern int last_player_update;
@@ -862,6 +863,7 @@ static void CL_ConsolePlayer(const odaproto::svc::ConsolePlayer* msg)
 {
 	::displayplayer_id = ::consoleplayer_id = msg->pid();
 	::digest = msg->digest();
+	::netfeatures = msg->netfeatures() & NETF_ALL;
 }
 
 //
@@ -1941,12 +1943,12 @@ static void CL_SecretEvent(const odaproto::svc::SecretEvent* msg)
 
 static void CL_ServerSettings(const odaproto::svc::ServerSettings* msg)
 {
-	cvar_t *var = NULL, *prev = NULL;
+	cvar_t *var = NULL;
 
 	std::string CvarKey = msg->key();
 	std::string CvarValue = msg->value();
 
-	var = cvar_t::FindCVar(CvarKey.c_str(), &prev);
+	var = cvar_t::FindCVar(CvarKey.c_str());
 
 	// GhostlyDeath <June 19, 2008> -- Read CVAR or dump it
 	if (var)
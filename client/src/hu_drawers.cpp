@@ -27,6 +27,13 @@
 #include "i_video.h"
 #include "v_video.h"
 #include "v_text.h"
+#include "c_cvars.h"
+#include "hashtable.h"
+
+#include <map>
+
+EXTERN_CVAR(hud_cachetext)
+EXTERN_CVAR(hud_transparency)
 
 namespace hud {
 
@@ -173,6 +180,390 @@ void Dim(int x, int y,
 }
 
 
+//
+// Text cache
+//
+// Most HUD strings are identical from one frame to the next, yet drawing them
+// means going glyph by glyph through the scaled patch drawers every frame.
+// Instead, DrawText rasterizes each string once into an 8-bit offscreen
+// surface and keeps the result as a list of horizontal spans of translated
+// palette indices.  Drawing a cached string copies (or blends) those spans
+// onto the screen.  Palette indices are kept instead of screen pixels so
+// that tiles stay valid through palette flashes and gamma changes in 32bpp.
+//
+// Tiles are looked up by a hash of the string so that a hit doesn't have to
+// copy it.  A string only gets a tile the second time it's drawn, so text
+// that changes every frame (timers, pings) goes straight to the regular
+// drawer without building a tile that is never used again.
+//
+
+struct TextSpan
+{
+	short x, y;
+	unsigned short length;
+	unsigned int offset;
+};
+
+struct TextTile
+{
+	// Bounding box of the drawn glyphs, relative to the text origin.
+	int minx, miny, maxx, maxy;
+	// Right-most column reached by TextSWrapper, relative to the origin.
+	int reach;
+	bool valid;
+	unsigned int lastused;
+	std::string str;	// tells apart strings with the same hash
+	std::vector<TextSpan> spans;
+	std::vector<palindex_t> pixels;
+};
+
+struct TextTileKey
+{
+	unsigned int hash;
+	const lumpHandle_t* font;
+	int color, x_scale, y_scale;
+
+	bool operator<(const TextTileKey& other) const
+	{
+		if (font != other.font)
+			return font < other.font;
+		if (color != other.color)
+			return color < other.color;
+		if (x_scale != other.x_scale)
+			return x_scale < other.x_scale;
+		if (y_scale != other.y_scale)
+			return y_scale < other.y_scale;
+		return hash < other.hash;
+	}
+};
+
+typedef std::map<TextTileKey, TextTile> TextTileCache;
+
+static TextTileCache text_cache;
+static unsigned int text_cache_clock = 0;
+static unsigned int text_cache_hits = 0;
+static unsigned int text_cache_misses = 0;
+
+static const size_t MAX_TEXT_TILES = 512;
+
+// Hashes of strings drawn recently that don't have a tile yet.
+static const size_t TEXT_SEEN_SIZE = 256;	// must be a power of two
+static unsigned int text_seen[TEXT_SEEN_SIZE];
+
+// Scratch surface tiles are rasterized on, kept between builds.
+static IWindowSurface* text_surface = NULL;
+
+void ClearTextCache()
+{
+	text_cache.clear();
+	memset(text_seen, 0, sizeof(text_seen));
+
+	if (text_surface)
+		I_FreeSurface(text_surface);
+}
+
+TextCacheStats GetTextCacheStats()
+{
+	TextCacheStats stats;
+	stats.tiles = text_cache.size();
+	stats.bytes = 0;
+	stats.hits = text_cache_hits;
+	stats.misses = text_cache_misses;
+
+	for (TextTileCache::const_iterator it = text_cache.begin(); it != text_cache.end(); ++it)
+	{
+		stats.bytes += it->second.pixels.size() * sizeof(palindex_t) +
+		               it->second.spans.size() * sizeof(TextSpan);
+	}
+
+	return stats;
+}
+
+// Drops the tiles that have gone unused the longest once the cache is full.
+static void ExpireTextCache()
+{
+	if (text_cache.size() < MAX_TEXT_TILES)
+		return;
+
+	const unsigned int cutoff = text_cache_clock - MAX_TEXT_TILES / 2;
+
+	TextTileCache::iterator it = text_cache.begin();
+	while (it != text_cache.end())
+	{
+		if (int(it->second.lastused - cutoff) < 0)
+			text_cache.erase(it++);
+		else
+			++it;
+	}
+}
+
+// Walk the string the same way DCanvas::TextSWrapper does and find the
+// bounding box of the glyphs it would draw.
+static void MeasureTextTile(TextTile& tile, const char* str, int scalex, int scaley)
+{
+	tile.minx = tile.miny = MAXINT;
+	tile.maxx = tile.maxy = MININT;
+	tile.reach = 0;
+
+	int cx = 0, cy = 0;
+
+	while (*str)
+	{
+		if (str[0] == TEXTCOLOR_ESCAPE && str[1] != '\0')
+		{
+			str += 2;
+			continue;
+		}
+
+		if (str[0] == '\n')
+		{
+			cx = 0;
+			cy += V_LineHeight() * scalex;
+			str++;
+			continue;
+		}
+
+		int c = toupper(str[0]) - HU_FONTSTART;
+		str++;
+
+		if (c < 0 || c >= HU_FONTSIZE)
+		{
+			cx += 4 * scaley;
+			continue;
+		}
+
+		const patch_t* ch = W_ResolvePatchHandle(hu_font[c]);
+		const int w = ch->width() * scalex;
+		const int h = ch->height() * scaley;
+
+		if (w > 0 && h > 0)
+		{
+			const int x0 = cx - ch->leftoffset() * scalex;
+			const int y0 = cy - ch->topoffset() * scaley;
+
+			tile.minx = MIN(tile.minx, x0);
+			tile.miny = MIN(tile.miny, y0);
+			tile.maxx = MAX(tile.maxx, x0 + w);
+			tile.maxy = MAX(tile.maxy, y0 + h);
+		}
+
+		tile.reach = MAX(tile.reach, cx + w);
+		cx += w;
+	}
+}
+
+// Rasterize the string into tile.  The string is drawn twice, once onto a
+// surface cleared to 0x00 and once onto one cleared to 0xFF; any pixel that
+// comes out the same in both was written by a glyph.
+static void BuildTextTile(TextTile& tile, const char* str, int color, int scalex, int scaley)
+{
+	tile.valid = false;
+
+	MeasureTextTile(tile, str, scalex, scaley);
+	if (tile.minx >= tile.maxx || tile.miny >= tile.maxy)
+		return;
+
+	const int width = tile.maxx - tile.minx;
+	const int height = tile.maxy - tile.miny;
+	if (width > I_GetSurfaceWidth() || height > I_GetSurfaceHeight())
+		return;
+
+	if (!text_surface || text_surface->getWidth() < width ||
+	    text_surface->getHeight() < height)
+	{
+		int surfacewidth = MAX(width, 256), surfaceheight = MAX(height, 32);
+		if (text_surface)
+		{
+			surfacewidth = MAX(surfacewidth, (int)text_surface->getWidth());
+			surfaceheight = MAX(surfaceheight, (int)text_surface->getHeight());
+			I_FreeSurface(text_surface);
+		}
+		text_surface = I_AllocateSurface(surfacewidth, surfaceheight, 8);
+	}
+
+	IWindowSurface* surface = text_surface;
+	DCanvas* canvas = surface->getDefaultCanvas();
+	const int pitch = surface->getPitchInPixels();
+
+	surface->lock();
+
+	for (int y = 0; y < height; y++)
+		memset(surface->getBuffer() + y * pitch, 0x00, width);
+	canvas->DrawTextStretched(color, -tile.minx, -tile.miny, str, scalex, scaley);
+
+	std::vector<palindex_t> first(width * height);
+	for (int y = 0; y < height; y++)
+		memcpy(&first[y * width], surface->getBuffer() + y * pitch, width);
+
+	for (int y = 0; y < height; y++)
+		memset(surface->getBuffer() + y * pitch, 0xFF, width);
+	canvas->DrawTextStretched(color, -tile.minx, -tile.miny, str, scalex, scaley);
+
+	for (int y = 0; y < height; y++)
+	{
+		const palindex_t* a = &first[y * width];
+		const palindex_t* b = surface->getBuffer() + y * pitch;
+
+		int x = 0;
+		while (x < width)
+		{
+			while (x < width && a[x] != b[x])
+				x++;
+			if (x >= width)
+				break;
+
+			TextSpan span;
+			span.x = tile.minx + x;
+			span.y = tile.miny + y;
+			span.offset = tile.pixels.size();
+
+			while (x < width && a[x] == b[x])
+				tile.pixels.push_back(b[x++]);
+
+			span.length = tile.pixels.size() - span.offset;
+			tile.spans.push_back(span);
+		}
+	}
+
+	surface->unlock();
+
+	tile.valid = true;
+}
+
+// Copy or blend a cached string onto the primary surface, using the same
+// arithmetic as the translated (lucent) patch drawers in v_draw.cpp.
+static void BlitTextTile(const TextTile& tile, int x, int y, bool opaque)
+{
+	if (!opaque && !hud_transparency)
+		return;
+	if (hud_transparency >= 1.0)
+		opaque = true;
+
+	IWindowSurface* surface = I_GetPrimarySurface();
+	const int pitch = surface->getPitchInPixels();
+
+	V_MarkRect(x + tile.minx, y + tile.miny, tile.maxx - tile.minx, tile.maxy - tile.miny);
+
+	if (surface->getBitsPerPixel() == 8)
+	{
+		argb_t *fg2rgb = NULL, *bg2rgb = NULL;
+		if (!opaque)
+		{
+			const fixed_t translevel = (fixed_t)(0xFFFF * hud_transparency);
+			const fixed_t fglevel = translevel & ~0x3ff;
+			const fixed_t bglevel = FRACUNIT - fglevel;
+			fg2rgb = Col2RGB8[fglevel >> 10];
+			bg2rgb = Col2RGB8[bglevel >> 10];
+		}
+
+		for (size_t i = 0; i < tile.spans.size(); i++)
+		{
+			const TextSpan& span = tile.spans[i];
+			const palindex_t* source = &tile.pixels[span.offset];
+			palindex_t* dest = surface->getBuffer() + (y + span.y) * pitch + x + span.x;
+
+			if (opaque)
+			{
+				memcpy(dest, source, span.length);
+				continue;
+			}
+
+			for (int n = 0; n < span.length; n++)
+			{
+				unsigned int fg = fg2rgb[source[n]];
+				unsigned int bg = bg2rgb[dest[n]];
+				fg = (fg + bg) | 0x1f07c1f;
+				dest[n] = RGB32k[0][0][fg & (fg >> 15)];
+			}
+		}
+	}
+	else
+	{
+		const int alpha = (int)(hud_transparency * 255);
+		const int invAlpha = 255 - alpha;
+
+		for (size_t i = 0; i < tile.spans.size(); i++)
+		{
+			const TextSpan& span = tile.spans[i];
+			const palindex_t* source = &tile.pixels[span.offset];
+			argb_t* dest = (argb_t*)surface->getBuffer() + (y + span.y) * pitch + x + span.x;
+
+			if (opaque)
+			{
+				for (int n = 0; n < span.length; n++)
+					dest[n] = V_Palette.shade(source[n]);
+				continue;
+			}
+
+			for (int n = 0; n < span.length; n++)
+				dest[n] = alphablend2a(dest[n], invAlpha, V_Palette.shade(source[n]), alpha);
+		}
+	}
+}
+
+// Draw a string through the text cache.  Returns false if the string can
+// not be drawn from the cache, in which case it should be drawn directly.
+static bool DrawCachedText(int x, int y, const char* str, const int color,
+                           const int x_scale, const int y_scale, const bool force_opaque)
+{
+	if (::hu_font[0].empty())
+		return false;
+
+	TextTileKey key;
+	key.hash = __hash_cstring(str);
+	key.font = ::hu_font.data();
+	key.color = color;
+	key.x_scale = x_scale;
+	key.y_scale = y_scale;
+
+	TextTileCache::iterator it = text_cache.find(key);
+	if (it == text_cache.end() || it->second.str != str)
+	{
+		text_cache_misses++;
+
+		// Leave strings we haven't seen before to the regular drawer.
+		unsigned int& seen = text_seen[key.hash & (TEXT_SEEN_SIZE - 1)];
+		if (seen != key.hash)
+		{
+			seen = key.hash;
+			return false;
+		}
+
+		if (it == text_cache.end())
+		{
+			ExpireTextCache();
+			it = text_cache.insert(std::make_pair(key, TextTile())).first;
+		}
+
+		TextTile& tile = it->second;
+		tile.str = str;
+		tile.spans.clear();
+		tile.pixels.clear();
+		BuildTextTile(tile, str, color, x_scale, y_scale);
+	}
+	else
+	{
+		text_cache_hits++;
+	}
+
+	TextTile& tile = it->second;
+	tile.lastused = ++text_cache_clock;
+
+	if (!tile.valid)
+		return false;
+
+	// The patch drawers do not clip, and TextSWrapper stops at the right
+	// edge of the screen, so leave anything that is not entirely on the
+	// screen to the regular drawer.
+	if (x + tile.minx < 0 || y + tile.miny < 0 ||
+	    x + tile.maxx > I_GetSurfaceWidth() || y + tile.maxy > I_GetSurfaceHeight() ||
+	    x + tile.reach > I_GetSurfaceWidth())
+		return false;
+
+	BlitTextTile(tile, x, y, force_opaque);
+	return true;
+}
+
 // Draw hu_font text.
 void DrawText(int x, int y, const float scale,
               const x_align_t x_align, const y_align_t y_align,
@@ -192,6 +583,9 @@ void DrawText(int x, int y, const float scale,
 	int x_scale, y_scale;
 	calculateOrigin(x, y, w, h, scale, x_scale, y_scale, x_align, y_align, x_origin, y_origin);
 
+	if (hud_cachetext && DrawCachedText(x, y, str, color, x_scale, y_scale, force_opaque))
+		return;
+
 	if (force_opaque)
 		screen->DrawTextStretched(color, x, y, str, x_scale, y_scale);
 	else
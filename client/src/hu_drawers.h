@@ -35,6 +35,17 @@ enum y_align_t {
 	Y_TOP, Y_MIDDLE, Y_BOTTOM, Y_ABSOLUTE
 };
 
+struct TextCacheStats
+{
+	size_t tiles;
+	size_t bytes;
+	unsigned int hits;
+	unsigned int misses;
+};
+
+void ClearTextCache();
+TextCacheStats GetTextCacheStats();
+
 int XSize(const float scale);
 int YSize(const float scale);
 void Clear(int x, int y,
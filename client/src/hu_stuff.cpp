@@ -41,6 +41,7 @@
 
 #include "cl_main.h"
 #include "p_ctf.h"
+#include "i_system.h"
 #include "i_video.h"
 #include "cl_netgraph.h"
 #include "hu_mousegraph.h"
@@ -82,6 +83,7 @@ EXTERN_CVAR(screenblocks)
 EXTERN_CVAR(idmypos)
 EXTERN_CVAR(sv_teamsinplay)
 EXTERN_CVAR(g_lives)
+EXTERN_CVAR(hud_profile)
 
 static int crosshair_lump;
 
@@ -479,6 +481,78 @@ static void HU_DrawChatPrompt()
 }
 
 
+//
+// HUD profiling
+//
+// With hud_profile enabled, HU_Drawer times each of the elements it draws
+// and lists the smoothed times in the top left corner of the screen, along
+// with the text cache statistics.
+//
+enum hudprofile_t
+{
+	HUDPROF_TOASTS,
+	HUDPROF_HUD,
+	HUDPROF_LEVELSTATE,
+	HUDPROF_NETGRAPH,
+	HUDPROF_NETDEMO,
+	HUDPROF_VOTE,
+	HUDPROF_SCORES,
+	HUDPROF_CROSSHAIR,
+	HUDPROF_CHAT,
+	NUMHUDPROF
+};
+
+static const char* hudprofile_names[NUMHUDPROF] = {
+	"toasts", "hud", "levelstate", "netgraph", "netdemo",
+	"vote", "scores", "crosshair", "chat"
+};
+
+static float hudprofile_usec[NUMHUDPROF];
+
+class HUDProfileScope
+{
+  public:
+	HUDProfileScope(hudprofile_t section)
+	    : m_section(section), m_start(hud_profile ? I_GetTime() : 0)
+	{
+	}
+
+	~HUDProfileScope()
+	{
+		if (m_start == 0)
+			return;
+
+		// exponential moving average, so the numbers are readable
+		const float usec = (I_GetTime() - m_start) / 1000.0f;
+		hudprofile_usec[m_section] += (usec - hudprofile_usec[m_section]) * 0.1f;
+	}
+
+  private:
+	hudprofile_t m_section;
+	dtime_t m_start;
+};
+
+static void HU_DrawProfile()
+{
+	char buffer[64];
+	int y = 8;
+
+	for (int i = 0; i < NUMHUDPROF; i++, y += 8)
+	{
+		snprintf(buffer, sizeof(buffer), "%-10s %8.1f us", hudprofile_names[i],
+		         hudprofile_usec[i]);
+		screen->PrintStr(0, y, buffer, CR_GREEN);
+	}
+
+	const hud::TextCacheStats stats = hud::GetTextCacheStats();
+	snprintf(buffer, sizeof(buffer), "text cache %u tiles %u KiB",
+	         (unsigned int)stats.tiles, (unsigned int)(stats.bytes / 1024));
+	screen->PrintStr(0, y, buffer, CR_GREEN);
+	y += 8;
+	snprintf(buffer, sizeof(buffer), "%u hits %u misses", stats.hits, stats.misses);
+	screen->PrintStr(0, y, buffer, CR_GREEN);
+}
+
 //
 // HU_Drawer
 //
@@ -491,24 +565,33 @@ void HU_Drawer()
 	{
 		bool spechud = consoleplayer().spectator && consoleplayer_id == displayplayer_id;
 
-		hud::DrawToasts();
+		{
+			HUDProfileScope prof(HUDPROF_TOASTS);
+			hud::DrawToasts();
+		}
 
-		if ((viewactive && !R_StatusBarVisible()) || spechud)
 		{
-			if (screenblocks < 12)
+			HUDProfileScope prof(HUDPROF_HUD);
+			if ((viewactive && !R_StatusBarVisible()) || spechud)
+			{
+				if (screenblocks < 12)
+				{
+					if (spechud)
+						hud::SpectatorHUD();
+					else
+						hud::OdamexHUD();
+				}
+			}
+			else
 			{
-				if (spechud)
-					hud::SpectatorHUD();
-				else
-					hud::OdamexHUD();
+				hud::DoomHUD();
 			}
 		}
-		else
+
 		{
-			hud::DoomHUD();
+			HUDProfileScope prof(HUDPROF_LEVELSTATE);
+			hud::LevelStateHUD();
 		}
-
-		hud::LevelStateHUD();
 	}
 
 	// [csDoom] draw disconnected wire [Toke] Made this 1337er
@@ -517,7 +600,10 @@ void HU_Drawer()
 		screen->DrawPatchCleanNoMove(W_CachePatch("NET"), 50 * CleanXfac, 1 * CleanYfac);
 
 	if (cl_netgraph)
+	{
+		HUDProfileScope prof(HUDPROF_NETGRAPH);
 		netgraph.draw();
+	}
 
 	if (hud_mousegraph)
 		mousegraph.draw(hud_mousegraph);
@@ -530,10 +616,16 @@ void HU_Drawer()
 				displayplayer().camera->z/FRACUNIT);
 
 	// Draw Netdemo info
-	hud::drawNetdemo();
+	{
+		HUDProfileScope prof(HUDPROF_NETDEMO);
+		hud::drawNetdemo();
+	}
 
 	// [AM] Voting HUD!
-	ST_voteDraw(11 * CleanYfac);
+	{
+		HUDProfileScope prof(HUDPROF_VOTE);
+		ST_voteDraw(11 * CleanYfac);
+	}
 
 	if (consoleplayer().camera && !(demoplayback))
 	{
@@ -541,15 +633,25 @@ void HU_Drawer()
 		    (::multiplayer && hud_show_scoreboard_ondeath &&
 		     displayplayer().health <= 0 && !displayplayer().spectator))
 		{
+			HUDProfileScope prof(HUDPROF_SCORES);
 			HU_DrawScores(&displayplayer());
 		}
 	}
 
 	if (gamestate == GS_LEVEL)
+	{
+		HUDProfileScope prof(HUDPROF_CROSSHAIR);
 		HU_DrawCrosshair();
+	}
 
 	if (HU_ChatMode() != CHAT_INACTIVE)
+	{
+		HUDProfileScope prof(HUDPROF_CHAT);
 		HU_DrawChatPrompt();
+	}
+
+	if (hud_profile)
+		HU_DrawProfile();
 }
 
 static void ShoveChatStr (std::string str, byte who)
@@ -29,17 +29,43 @@
 #include "r_state.h"
 #include "p_local.h"
 #include "cl_demo.h"
+#include "p_spec.h"
 
 
-typedef std::pair<fixed_t, unsigned int> fixed_uint_pair;
+EXTERN_CVAR(r_interpolate)
 
-static std::vector<fixed_uint_pair> prev_ceilingheight;
-static std::vector<fixed_uint_pair> saved_ceilingheight;
-static std::vector<fixed_uint_pair> prev_floorheight;
-static std::vector<fixed_uint_pair> saved_floorheight;
+//
+// Interpolated values are kept as parallel arrays (one entry per moving
+// plane or scrolling surface) instead of an array of structs.  The arrays
+// are cleared rather than freed each tic, so once they have grown to fit the
+// level, recording and interpolating them does not allocate.
+//
+
+// Moving ceilings and floors, set through P_SetCeilingHeight and
+// P_SetFloorHeight so that sloped planes are handled.
+static std::vector<unsigned int> ceiling_secnum;
+static std::vector<fixed_t> ceiling_prev;
+static std::vector<fixed_t> ceiling_saved;
+
+static std::vector<unsigned int> floor_secnum;
+static std::vector<fixed_t> floor_prev;
+static std::vector<fixed_t> floor_saved;
+
+// Scrolling wall texture and flat offsets, written directly.
+static std::vector<fixed_t*> offset_value;
+static std::vector<fixed_t> offset_prev;
+static std::vector<fixed_t> offset_saved;
+
+static bool interpolating = false;
 
 extern NetDemo netdemo;
 
+static void R_RecordOffset(fixed_t* value)
+{
+	offset_value.push_back(value);
+	offset_prev.push_back(*value);
+}
+
 //
 // R_InterpolationTicker
 //
@@ -49,17 +75,61 @@ extern NetDemo netdemo;
 //
 void R_InterpolationTicker()
 {
-	prev_ceilingheight.clear();
-	prev_floorheight.clear();
+	ceiling_secnum.clear();
+	ceiling_prev.clear();
+	floor_secnum.clear();
+	floor_prev.clear();
+	offset_value.clear();
+	offset_prev.clear();
 
 	if (gamestate == GS_LEVEL)
 	{
 		for (int i = 0; i < numsectors; i++)
 		{
 			if (sectors[i].ceilingdata)
-				prev_ceilingheight.push_back(std::make_pair(P_CeilingHeight(&sectors[i]), i));
+			{
+				ceiling_secnum.push_back(i);
+				ceiling_prev.push_back(P_CeilingHeight(&sectors[i]));
+			}
 			if (sectors[i].floordata)
-				prev_floorheight.push_back(std::make_pair(P_FloorHeight(&sectors[i]), i));
+			{
+				floor_secnum.push_back(i);
+				floor_prev.push_back(P_FloorHeight(&sectors[i]));
+			}
+		}
+
+		DScroller* scroller;
+		TThinkerIterator<DScroller> iterator;
+		while ((scroller = iterator.Next()))
+		{
+			const int affectee = scroller->GetAffectee();
+
+			switch (scroller->GetType())
+			{
+			case DScroller::sc_side:
+				if (affectee >= 0 && affectee < numsides)
+				{
+					R_RecordOffset(&sides[affectee].textureoffset);
+					R_RecordOffset(&sides[affectee].rowoffset);
+				}
+				break;
+			case DScroller::sc_floor:
+				if (affectee >= 0 && affectee < numsectors)
+				{
+					R_RecordOffset(&sectors[affectee].floor_xoffs);
+					R_RecordOffset(&sectors[affectee].floor_yoffs);
+				}
+				break;
+			case DScroller::sc_ceiling:
+				if (affectee >= 0 && affectee < numsectors)
+				{
+					R_RecordOffset(&sectors[affectee].ceiling_xoffs);
+					R_RecordOffset(&sectors[affectee].ceiling_yoffs);
+				}
+				break;
+			default:
+				break;
+			}
 		}
 	}
 }
@@ -73,10 +143,16 @@ void R_InterpolationTicker()
 //
 void R_ResetInterpolation()
 {
-	prev_ceilingheight.clear();
-	prev_floorheight.clear();
-	saved_ceilingheight.clear();
-	saved_floorheight.clear();
+	ceiling_secnum.clear();
+	ceiling_prev.clear();
+	ceiling_saved.clear();
+	floor_secnum.clear();
+	floor_prev.clear();
+	floor_saved.clear();
+	offset_value.clear();
+	offset_prev.clear();
+	offset_saved.clear();
+	interpolating = false;
 	::localview.angle = 0;
 	::localview.setangle = false;
 	::localview.skipangle = false;
@@ -96,40 +172,48 @@ void R_ResetInterpolation()
 //
 void R_BeginInterpolation(fixed_t amount)
 {
-	saved_ceilingheight.clear();
-	saved_floorheight.clear();
+	interpolating = gamestate == GS_LEVEL && r_interpolate && amount < FRACUNIT;
+	if (!interpolating)
+		return;
 
-	if (gamestate == GS_LEVEL)
+	const size_t numceilings = ceiling_secnum.size();
+	ceiling_saved.resize(numceilings);
+	for (size_t i = 0; i < numceilings; i++)
 	{
-		for (std::vector<fixed_uint_pair>::const_iterator ceiling_it = prev_ceilingheight.begin();
-			 ceiling_it != prev_ceilingheight.end(); ++ceiling_it)
-		{
-			unsigned int secnum = ceiling_it->second;
-			sector_t* sector = &sectors[secnum];
+		sector_t* sector = &sectors[ceiling_secnum[i]];
 
-			fixed_t old_value = ceiling_it->first;
-			fixed_t cur_value = P_CeilingHeight(sector);
+		const fixed_t old_value = ceiling_prev[i];
+		const fixed_t cur_value = P_CeilingHeight(sector);
+		ceiling_saved[i] = cur_value;
 
-			saved_ceilingheight.push_back(std::make_pair(cur_value, secnum));
-			
-			fixed_t new_value = old_value + FixedMul(cur_value - old_value, amount);
-			P_SetCeilingHeight(sector, new_value);
-		}
+		P_SetCeilingHeight(sector, old_value + FixedMul(cur_value - old_value, amount));
+	}
 
-		for (std::vector<fixed_uint_pair>::const_iterator floor_it = prev_floorheight.begin();
-			 floor_it != prev_floorheight.end(); ++floor_it)
-		{
-			unsigned int secnum = floor_it->second;
-			sector_t* sector = &sectors[secnum];
+	const size_t numfloors = floor_secnum.size();
+	floor_saved.resize(numfloors);
+	for (size_t i = 0; i < numfloors; i++)
+	{
+		sector_t* sector = &sectors[floor_secnum[i]];
 
-			fixed_t old_value = floor_it->first;
-			fixed_t cur_value = P_FloorHeight(sector);
+		const fixed_t old_value = floor_prev[i];
+		const fixed_t cur_value = P_FloorHeight(sector);
+		floor_saved[i] = cur_value;
 
-			saved_floorheight.push_back(std::make_pair(cur_value, secnum));
-			
-			fixed_t new_value = old_value + FixedMul(cur_value - old_value, amount);
-			P_SetFloorHeight(sector, new_value);
-		}
+		P_SetFloorHeight(sector, old_value + FixedMul(cur_value - old_value, amount));
+	}
+
+	// Save every offset before writing any of them, so a surface affected by
+	// more than one scroller is still interpolated from its real position.
+	const size_t numoffsets = offset_value.size();
+	offset_saved.resize(numoffsets);
+	for (size_t i = 0; i < numoffsets; i++)
+		offset_saved[i] = *offset_value[i];
+
+	for (size_t i = 0; i < numoffsets; i++)
+	{
+		const fixed_t old_value = offset_prev[i];
+		const fixed_t cur_value = offset_saved[i];
+		*offset_value[i] = old_value + FixedMul(cur_value - old_value, amount);
 	}
 }
 
@@ -141,22 +225,19 @@ void R_BeginInterpolation(fixed_t amount)
 //
 void R_EndInterpolation()
 {
-	if (gamestate == GS_LEVEL)
-	{
-		for (std::vector<fixed_uint_pair>::const_iterator ceiling_it = saved_ceilingheight.begin();
-			 ceiling_it != saved_ceilingheight.end(); ++ceiling_it)
-		{
-			sector_t* sector = &sectors[ceiling_it->second];
-			P_SetCeilingHeight(sector, ceiling_it->first);
-		}
+	if (!interpolating)
+		return;
 
-		for (std::vector<fixed_uint_pair>::const_iterator floor_it = saved_floorheight.begin();
-			 floor_it != saved_floorheight.end(); ++floor_it)
-		{
-			sector_t* sector = &sectors[floor_it->second];
-			P_SetFloorHeight(sector, floor_it->first);
-		}
-	}
+	interpolating = false;
+
+	for (size_t i = 0; i < ceiling_saved.size(); i++)
+		P_SetCeilingHeight(&sectors[ceiling_secnum[i]], ceiling_saved[i]);
+
+	for (size_t i = 0; i < floor_saved.size(); i++)
+		P_SetFloorHeight(&sectors[floor_secnum[i]], floor_saved[i]);
+
+	for (size_t i = 0; i < offset_saved.size(); i++)
+		*offset_value[i] = offset_saved[i];
 }
 
 //
@@ -24,6 +24,8 @@
 
 #include "odamex.h"
 
+#include <algorithm>
+
 #include "m_alloc.h"
 
 #include "m_argv.h"
@@ -66,6 +68,7 @@ int*			spritelights;
 
 EXTERN_CVAR (r_drawplayersprites)
 EXTERN_CVAR (r_particles)
+EXTERN_CVAR (r_interpolate)
 
 //
 // INITIALIZATION FUNCTIONS
@@ -499,7 +502,7 @@ void R_ProjectSprite(AActor *thing, int fakeside)
 	// [SL] interpolate the position of thing
 	fixed_t thingx, thingy, thingz;
 
-	if (P_AproxDistance2(thing, thing->prevx, thing->prevy) < 128*FRACUNIT)
+	if (r_interpolate && P_AproxDistance2(thing, thing->prevx, thing->prevy) < 128*FRACUNIT)
 	{
 		// the actor probably did not teleport
 		// interpolate between previous and current position
@@ -862,17 +865,101 @@ void R_DrawPlayerSprites()
 //		more vissprites that need to be sorted, the better the performance
 //		gain compared to the old function.
 //
+// The qsort() has since been replaced by an LSD radix sort on a 64-bit key
+// built from the sprite depth (ascending) and gzt (descending), which is
+// the same ordering sv_compare used to give.  Byte passes where every key
+// shares the same digit are skipped, so a typical frame only does a handful
+// of passes.  Small counts are insertion sorted instead.
+//
 
 static int				vsprcount;
 static vissprite_t**	spritesorter;
+static vissprite_t**	spritesorter_tmp;
+static uint64_t*		spritekeys;
+static uint64_t*		spritekeys_tmp;
 static int				spritesorter_size = 0;
 
-static int STACK_ARGS sv_compare(const void *arg1, const void *arg2)
+static const int SPRITE_INSERTION_SORT_MAX = 32;
+
+static inline uint64_t R_VisSpriteSortKey(const vissprite_t* vis)
 {
-	int diff = (*(vissprite_t **)arg1)->depth - (*(vissprite_t **)arg2)->depth;
-	if (diff == 0)
-		return (*(vissprite_t **)arg2)->gzt - (*(vissprite_t **)arg1)->gzt;
-	return diff;
+	const uint32_t depthkey = uint32_t(vis->depth) ^ 0x80000000u;
+	const uint32_t gztkey = ~(uint32_t(vis->gzt) ^ 0x80000000u);
+	return (uint64_t(depthkey) << 32) | gztkey;
+}
+
+static void R_InsertionSortVisSprites(int count)
+{
+	for (int i = 1; i < count; i++)
+	{
+		const uint64_t key = spritekeys[i];
+		vissprite_t* vis = spritesorter[i];
+
+		int j = i - 1;
+		while (j >= 0 && spritekeys[j] > key)
+		{
+			spritekeys[j + 1] = spritekeys[j];
+			spritesorter[j + 1] = spritesorter[j];
+			j--;
+		}
+
+		spritekeys[j + 1] = key;
+		spritesorter[j + 1] = vis;
+	}
+}
+
+static void R_RadixSortVisSprites(int count)
+{
+	unsigned int histogram[8][256];
+	memset(histogram, 0, sizeof(histogram));
+
+	// Build all eight byte histograms in a single pass over the keys.
+	for (int i = 0; i < count; i++)
+	{
+		const uint64_t key = spritekeys[i];
+		for (int pass = 0; pass < 8; pass++)
+			histogram[pass][(key >> (pass * 8)) & 0xFF]++;
+	}
+
+	uint64_t* keys = spritekeys;
+	uint64_t* keys_tmp = spritekeys_tmp;
+	vissprite_t** sprites = spritesorter;
+	vissprite_t** sprites_tmp = spritesorter_tmp;
+
+	for (int pass = 0; pass < 8; pass++)
+	{
+		unsigned int* counts = histogram[pass];
+		const int shift = pass * 8;
+
+		// Every key has the same digit in this position, nothing to do.
+		if (counts[(keys[0] >> shift) & 0xFF] == (unsigned int)count)
+			continue;
+
+		unsigned int offset = 0;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			const unsigned int n = counts[digit];
+			counts[digit] = offset;
+			offset += n;
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			const unsigned int dest = counts[(keys[i] >> shift) & 0xFF]++;
+			keys_tmp[dest] = keys[i];
+			sprites_tmp[dest] = sprites[i];
+		}
+
+		std::swap(keys, keys_tmp);
+		std::swap(sprites, sprites_tmp);
+	}
+
+	// Make sure the result ends up in spritesorter.
+	if (sprites != spritesorter)
+	{
+		memcpy(spritesorter, sprites, count * sizeof(*spritesorter));
+		memcpy(spritekeys, keys, count * sizeof(*spritekeys));
+	}
 }
 
 void R_SortVisSprites()
@@ -885,30 +972,153 @@ void R_SortVisSprites()
 	if (spritesorter_size < MaxVisSprites)
 	{
 		delete [] spritesorter;
+		delete [] spritesorter_tmp;
+		delete [] spritekeys;
+		delete [] spritekeys_tmp;
 		spritesorter = new vissprite_t*[MaxVisSprites];
+		spritesorter_tmp = new vissprite_t*[MaxVisSprites];
+		spritekeys = new uint64_t[MaxVisSprites];
+		spritekeys_tmp = new uint64_t[MaxVisSprites];
 		spritesorter_size = MaxVisSprites;
 	}
 
 	for (int i = 0; i < vsprcount; i++)
+	{
 		spritesorter[i] = vissprites + i;
+		spritekeys[i] = R_VisSpriteSortKey(vissprites + i);
+	}
 
-	qsort(spritesorter, vsprcount, sizeof(vissprite_t *), sv_compare);
+	if (vsprcount <= SPRITE_INSERTION_SORT_MAX)
+		R_InsertionSortVisSprites(vsprcount);
+	else
+		R_RadixSortVisSprites(vsprcount);
 }
 
 
 //
-// R_DrawSprite
+// Drawseg column index
 //
-void R_DrawSprite (vissprite_t *spr)
+// R_DrawSprite used to test every drawseg in the frame against every sprite.
+// Before the masked pass we bin the drawsegs that can obscure anything into
+// DRAWSEG_BIN_WIDTH-column buckets, stored CSR style (drawsegbin_start holds
+// the offset of each bucket inside drawsegbin_list).  Each bucket lists its
+// drawsegs from last to first, which is the order R_DrawSprite needs them in.
+//
+
+#define DRAWSEG_BIN_SHIFT	5
+#define DRAWSEG_BIN_WIDTH	(1 << DRAWSEG_BIN_SHIFT)
+#define MAX_DRAWSEG_BINS	((MAXWIDTH + DRAWSEG_BIN_WIDTH - 1) >> DRAWSEG_BIN_SHIFT)
+
+static unsigned int		drawsegbin_start[MAX_DRAWSEG_BINS + 1];
+static unsigned int*	drawsegbin_list;
+static unsigned int		drawsegbin_list_size = 0;
+
+static inline bool R_DrawSegCanObscure(const drawseg_t* ds)
 {
-	static int			cliptop[MAXWIDTH];
-	static int			clipbot[MAXWIDTH];
+	return (ds->silhouette & SIL_BOTH) || ds->midposts;
+}
 
-	drawseg_t*			ds;
-	int 				x;
-	int 				r1, r2;
-	fixed_t 			segscale1, segscale2;
+static void R_BuildDrawSegIndex()
+{
+	const int numbins = (viewwidth + DRAWSEG_BIN_WIDTH - 1) >> DRAWSEG_BIN_SHIFT;
+
+	memset(drawsegbin_start, 0, (numbins + 1) * sizeof(*drawsegbin_start));
+
+	// count the number of entries in each bin
+	unsigned int total = 0;
+	for (const drawseg_t* ds = drawsegs; ds < ds_p; ds++)
+	{
+		if (!R_DrawSegCanObscure(ds) || ds->x1 > ds->x2)
+			continue;
+
+		const int b1 = ds->x1 >> DRAWSEG_BIN_SHIFT;
+		const int b2 = MIN(ds->x2 >> DRAWSEG_BIN_SHIFT, numbins - 1);
+		for (int b = b1; b <= b2; b++)
+			drawsegbin_start[b + 1]++;
+		total += b2 - b1 + 1;
+	}
+
+	if (drawsegbin_list_size < total)
+	{
+		delete [] drawsegbin_list;
+		drawsegbin_list_size = MAX(total, drawsegbin_list_size * 2);
+		drawsegbin_list = new unsigned int[drawsegbin_list_size];
+	}
 
+	// prefix sum into start offsets
+	for (int b = 0; b < numbins; b++)
+		drawsegbin_start[b + 1] += drawsegbin_start[b];
+
+	static unsigned int fill[MAX_DRAWSEG_BINS];
+	memcpy(fill, drawsegbin_start, numbins * sizeof(*fill));
+
+	// fill each bin from the last drawseg to the first
+	for (const drawseg_t* ds = ds_p; ds-- > drawsegs; )
+	{
+		if (!R_DrawSegCanObscure(ds) || ds->x1 > ds->x2)
+			continue;
+
+		const int b1 = ds->x1 >> DRAWSEG_BIN_SHIFT;
+		const int b2 = MIN(ds->x2 >> DRAWSEG_BIN_SHIFT, numbins - 1);
+		for (int b = b1; b <= b2; b++)
+			drawsegbin_list[fill[b]++] = ds - drawsegs;
+	}
+}
+
+
+static int cliptop[MAXWIDTH];
+static int clipbot[MAXWIDTH];
+
+//
+// R_ClipSpriteToDrawSeg
+//
+// Clips the sprite's column range against a single drawseg, rendering
+// the drawseg's masked midtexture instead if the seg is behind the sprite.
+//
+static void R_ClipSpriteToDrawSeg(const vissprite_t* spr, drawseg_t* ds)
+{
+	// determine if the drawseg obscures the sprite
+	if (ds->x1 > spr->x2 || ds->x2 < spr->x1 || !R_DrawSegCanObscure(ds))
+	{
+		// does not cover sprite
+		return;
+	}
+
+	const int r1 = MAX<int>(ds->x1, spr->x1);
+	const int r2 = MIN<int>(ds->x2, spr->x2);
+
+	const fixed_t segscale1 = MAX<int>(ds->scale1, ds->scale2);
+	const fixed_t segscale2 = MIN<int>(ds->scale1, ds->scale2);
+
+	// check if the seg is in front of the sprite
+	if (segscale1 < spr->yscale ||
+		(segscale2 < spr->yscale && !R_PointOnSegSide(spr->gx, spr->gy, ds->curline)))
+	{
+		// masked mid texture?
+		if (ds->midposts)
+			R_RenderMaskedSegRange(ds, r1, r2);
+		// seg is behind sprite
+		return;
+	}
+
+	// clip this piece of the sprite
+	// killough 3/27/98: optimized and made much shorter
+
+	for (int x = r1; x <= r2; x++)
+	{
+		if (ds->silhouette & SIL_BOTTOM && clipbot[x] > ds->sprbottomclip[x])
+			clipbot[x] = ds->sprbottomclip[x];
+		if (ds->silhouette & SIL_TOP && cliptop[x] < ds->sprtopclip[x])
+			cliptop[x] = ds->sprtopclip[x];
+	}
+}
+
+
+//
+// R_DrawSprite
+//
+void R_DrawSprite (vissprite_t *spr)
+{
 	int					topclip = 0, botclip = viewheight;
 	int*				clip1;
 	int*				clip2;
@@ -969,47 +1179,45 @@ void R_DrawSprite (vissprite_t *spr)
 
 	// Scan drawsegs from end to start for obscuring segs.
 	// The first drawseg that has a greater scale is the clip seg.
+	// Only the drawsegs binned in the columns the sprite covers are visited.
 
-	// Modified by Lee Killough:
-	// (pointer check was originally nonportable
-	// and buggy, by going past LEFT end of array):
+	const int b1 = spr->x1 >> DRAWSEG_BIN_SHIFT;
+	const int b2 = spr->x2 >> DRAWSEG_BIN_SHIFT;
 
-	for (ds = ds_p ; ds-- > drawsegs ; )  // new -- killough
+	if (b1 == b2)
 	{
-		// determine if the drawseg obscures the sprite
-		if (ds->x1 > spr->x2 || ds->x2 < spr->x1 ||
-			(!(ds->silhouette & SIL_BOTH) && !ds->midposts) )
-		{
-			// does not cover sprite
-			continue;
-		}
-
-		r1 = MAX<int>(ds->x1, spr->x1);
-		r2 = MIN<int>(ds->x2, spr->x2);
-
-		segscale1 = MAX<int>(ds->scale1, ds->scale2);
-		segscale2 = MIN<int>(ds->scale1, ds->scale2);
+		for (unsigned int n = drawsegbin_start[b1]; n < drawsegbin_start[b1 + 1]; n++)
+			R_ClipSpriteToDrawSeg(spr, drawsegs + drawsegbin_list[n]);
+	}
+	else
+	{
+		// The sprite spans several bins: merge their (descending) lists,
+		// visiting each drawseg only once and in the original order.
+		static unsigned int cursor[MAX_DRAWSEG_BINS];
+		for (int b = b1; b <= b2; b++)
+			cursor[b] = drawsegbin_start[b];
 
-		// check if the seg is in front of the sprite
-		if (segscale1 < spr->yscale ||
-			(segscale2 < spr->yscale && !R_PointOnSegSide(spr->gx, spr->gy, ds->curline)))
+		for (;;)
 		{
-			// masked mid texture?
-			if (ds->midposts)
-				R_RenderMaskedSegRange(ds, r1, r2);
-			// seg is behind sprite
-			continue;
-		}
+			int next = -1;
+			for (int b = b1; b <= b2; b++)
+			{
+				if (cursor[b] < drawsegbin_start[b + 1] &&
+				    int(drawsegbin_list[cursor[b]]) > next)
+					next = drawsegbin_list[cursor[b]];
+			}
 
-		// clip this piece of the sprite
-		// killough 3/27/98: optimized and made much shorter
+			if (next < 0)
+				break;
 
-		for (x = r1; x <= r2; x++)
-		{
-			if (ds->silhouette & SIL_BOTTOM && clipbot[x] > ds->sprbottomclip[x])
-				clipbot[x] = ds->sprbottomclip[x];
-			if (ds->silhouette & SIL_TOP && cliptop[x] < ds->sprtopclip[x])
-				cliptop[x] = ds->sprtopclip[x];
+			for (int b = b1; b <= b2; b++)
+			{
+				if (cursor[b] < drawsegbin_start[b + 1] &&
+				    int(drawsegbin_list[cursor[b]]) == next)
+					cursor[b]++;
+			}
+
+			R_ClipSpriteToDrawSeg(spr, drawsegs + next);
 		}
 	}
 
@@ -1036,6 +1244,7 @@ void R_DrawMasked (void)
 	drawseg_t		 *ds;
 
 	R_SortVisSprites ();
+	R_BuildDrawSegIndex ();
 
 	while (vsprcount > 0)
 		R_DrawSprite(spritesorter[--vsprcount]);
@@ -26,6 +26,8 @@
 
 #include <math.h>
 #include <cassert>
+#include <list>
+#include <map>
 
 #include "i_system.h"
 #include "v_video.h"
@@ -83,6 +85,7 @@ EXTERN_CVAR(gammalevel)
 EXTERN_CVAR(vid_gammatype)
 EXTERN_CVAR(r_painintensity)
 EXTERN_CVAR(sv_allowredscreen)
+EXTERN_CVAR(r_lightcachesize)
 
 dyncolormap_t NormalLight;
 
@@ -703,89 +706,292 @@ void BuildLightRamp (shademap_t &maps)
 	}
 }
 
-void BuildDefaultColorAndShademap(const palette_t* pal, shademap_t& maps)
+// ----------------------------------------------------------------------------
+//
+// Light table cache
+//
+// ----------------------------------------------------------------------------
+
+//
+// The 8bpp colormaps for a light and fade color only depend on the base
+// palette, but each table takes (NUMCOLORMAPS + 1) * 256 calls to
+// V_BestColor to generate. Gamma changes, level changes and sector color
+// changes keep asking for the same handful of tables, so the most recently
+// used ones are kept here and only the 32bpp shademaps, which are a cheap
+// gamma lookup, are rebuilt.
+//
+
+static const size_t LIGHTTABLE_SIZE = (NUMCOLORMAPS + 1) * 256;
+
+struct LightTableKey
 {
-	BuildLightRamp(maps);
+	uint32_t	palette;	// checksum of the palette's base colors
+	uint32_t	light;
+	uint32_t	fade;
 
-	// [SL] Modified algorithm from RF_BuildLights in dcolors.c
-	// from Doom Utilities. Now accomodates fading to non-black colors.
+	bool operator<(const LightTableKey& other) const
+	{
+		if (palette != other.palette)
+			return palette < other.palette;
+		if (light != other.light)
+			return light < other.light;
+		return fade < other.fade;
+	}
+};
 
-	const argb_t* palette = pal->basecolors;
-	argb_t fadecolor(level.fadeto_color[0], level.fadeto_color[1], level.fadeto_color[2], level.fadeto_color[3]);
-	
-	palindex_t* colormap = maps.colormap;
-	argb_t* shademap = maps.shademap;
+struct LightTable
+{
+	LightTableKey	key;
+	palindex_t		colormap[LIGHTTABLE_SIZE];
+};
+
+typedef std::list<LightTable> LightTableList;
+typedef std::map<LightTableKey, LightTableList::iterator> LightTableMap;
+
+static LightTableList lighttables;		// most recently used first
+static LightTableMap lighttable_index;
 
-	for (int i = 0; i < NUMCOLORMAPS; i++, colormap += 256, shademap += 256)
+static struct
+{
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int evictions;
+	dtime_t build_time;
+} lighttable_stats;
+
+
+//
+// V_PaletteChecksum
+//
+static uint32_t V_PaletteChecksum(const argb_t* palette_colors)
+{
+	// FNV-1a over the 24-bit colors
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < 256; i++)
 	{
-		for (int c = 0; c < 256; c++)
+		hash = (hash ^ (palette_colors[i].getr())) * 16777619u;
+		hash = (hash ^ (palette_colors[i].getg())) * 16777619u;
+		hash = (hash ^ (palette_colors[i].getb())) * 16777619u;
+	}
+	return hash;
+}
+
+
+//
+// V_LightColor
+//
+// Returns the color of palette entry c at light level l when lit with the
+// light color lr, lg, lb and fading to the color fr, fg, fb.
+//
+// [SL] Modified algorithm from RF_BuildLights in dcolors.c
+// from Doom Utilities. Now accomodates fading to non-black colors.
+//
+static inline argb_t V_LightColor(const argb_t color, unsigned int l,
+			const int lr, const int lg, const int lb, const int fr, const int fg, const int fb)
+{
+	unsigned int r = (color.getr() * (NUMCOLORMAPS - l) + fr * l + NUMCOLORMAPS / 2) / NUMCOLORMAPS;
+	unsigned int g = (color.getg() * (NUMCOLORMAPS - l) + fg * l + NUMCOLORMAPS / 2) / NUMCOLORMAPS;
+	unsigned int b = (color.getb() * (NUMCOLORMAPS - l) + fb * l + NUMCOLORMAPS / 2) / NUMCOLORMAPS;
+
+	if (lr == 255 && lg == 255 && lb == 255)
+		return argb_t(255, r, g, b);
+	return argb_t(255, r * lr / 255, g * lg / 255, b * lb / 255);
+}
+
+
+//
+// V_GrayColor
+//
+// Returns the color of palette entry c in the special (invulnerability) map.
+//
+static inline argb_t V_GrayColor(const argb_t color)
+{
+	int grayint = (int)(255.0f * clamp(1.0f -
+					(color.getr() * 0.00116796875f +
+					 color.getg() * 0.00229296875f +
+					 color.getb() * 0.0005625f), 0.0f, 1.0f));
+
+	return argb_t(255, grayint, grayint, grayint);
+}
+
+
+//
+// V_BuildLightTable
+//
+// Fills colormap with NUMCOLORMAPS light levels of the palette lit with
+// the given light color and faded to the given fade color, followed by the
+// special (invulnerability) map.
+//
+// Light levels close to the fade color map a large part of the palette to
+// the same few colors, so V_BestColor results are memoized by RGB value
+// while the table is generated.
+//
+static void V_BuildLightTable(palindex_t* colormap, const argb_t* palette_colors,
+			const argb_t light, const argb_t fade)
+{
+	static const unsigned int MEMO_SIZE = 4096;
+	static uint32_t memo_color[MEMO_SIZE];
+	static palindex_t memo_index[MEMO_SIZE];
+
+	// the alpha channel is unused by V_BestColor so 0 marks an empty slot
+	memset(memo_color, 0, sizeof(memo_color));
+
+	const int lr = light.getr(), lg = light.getg(), lb = light.getb();
+	const int fr = fade.getr(), fg = fade.getg(), fb = fade.getb();
+
+	for (unsigned int l = 0; l <= NUMCOLORMAPS; l++, colormap += 256)
+	{
+		for (unsigned int c = 0; c < 256; c++)
 		{
-			unsigned int r = (palette[c].getr() * (NUMCOLORMAPS - i) + fadecolor.getr() * i
-					+ NUMCOLORMAPS/2) / NUMCOLORMAPS;
-			unsigned int g = (palette[c].getg() * (NUMCOLORMAPS - i) + fadecolor.getg() * i
-					+ NUMCOLORMAPS/2) / NUMCOLORMAPS;
-			unsigned int b = (palette[c].getb() * (NUMCOLORMAPS - i) + fadecolor.getb() * i
-					+ NUMCOLORMAPS/2) / NUMCOLORMAPS;
-
-			argb_t color(255, r, g, b);
-			colormap[c] = V_BestColor(palette, color);
-			shademap[c] = V_GammaCorrect(color);
+			argb_t color = (l < NUMCOLORMAPS) ?
+					V_LightColor(palette_colors[c], l, lr, lg, lb, fr, fg, fb) :
+					V_GrayColor(palette_colors[c]);
+
+			const uint32_t value = uint32_t(color);
+			const unsigned int slot = ((value >> 12) ^ value) & (MEMO_SIZE - 1);
+
+			if (memo_color[slot] != value)
+			{
+				memo_color[slot] = value;
+				memo_index[slot] = V_BestColor(palette_colors, color);
+			}
+
+			colormap[c] = memo_index[slot];
 		}
 	}
+}
 
-	// build special maps (e.g. invulnerability)
-	for (int c = 0; c < 256; c++)
+
+//
+// V_TrimLightTables
+//
+// Evicts the least recently used light tables until no more than
+// r_lightcachesize remain.
+//
+static void V_TrimLightTables()
+{
+	const size_t limit = MAX(r_lightcachesize.asInt(), 0);
+
+	while (lighttables.size() > limit)
+	{
+		lighttable_index.erase(lighttables.back().key);
+		lighttables.pop_back();
+		lighttable_stats.evictions++;
+	}
+}
+
+
+//
+// V_GetLightTable
+//
+// Returns the (NUMCOLORMAPS + 1) * 256 colormap entries for the palette lit
+// with the given light color and faded to the given fade color, generating
+// them if they are not already cached. The returned pointer is only valid
+// until the next call.
+//
+static const palindex_t* V_GetLightTable(const argb_t* palette_colors,
+			const argb_t light, const argb_t fade)
+{
+	LightTableKey key;
+	key.palette = V_PaletteChecksum(palette_colors);
+	key.light = uint32_t(light) & 0x00FFFFFF;
+	key.fade = uint32_t(fade) & 0x00FFFFFF;
+
+	LightTableMap::iterator it = lighttable_index.find(key);
+	if (it != lighttable_index.end())
+	{
+		lighttable_stats.hits++;
+		lighttables.splice(lighttables.begin(), lighttables, it->second);
+		return it->second->colormap;
+	}
+
+	lighttable_stats.misses++;
+	dtime_t start = I_GetTime();
+
+	palindex_t* colormap;
+	if (r_lightcachesize.asInt() > 0)
+	{
+		lighttables.push_front(LightTable());
+		lighttables.front().key = key;
+		lighttable_index[key] = lighttables.begin();
+		colormap = lighttables.front().colormap;
+	}
+	else
+	{
+		static palindex_t scratch[LIGHTTABLE_SIZE];
+		colormap = scratch;
+	}
+
+	V_BuildLightTable(colormap, palette_colors, light, fade);
+	lighttable_stats.build_time += I_GetTime() - start;
+
+	V_TrimLightTables();
+	return colormap;
+}
+
+
+//
+// V_ClearLightTables
+//
+static void V_ClearLightTables()
+{
+	lighttables.clear();
+	lighttable_index.clear();
+}
+
+
+CVAR_FUNC_IMPL(r_lightcachesize)
+{
+	V_TrimLightTables();
+}
+
+
+BEGIN_COMMAND(lightcachestats)
+{
+	Printf(PRINT_HIGH, "Light table cache: %u/%d tables, %u hits, %u misses, %u evictions\n",
+			(unsigned int)lighttables.size(), r_lightcachesize.asInt(),
+			lighttable_stats.hits, lighttable_stats.misses, lighttable_stats.evictions);
+	Printf(PRINT_HIGH, "Time spent generating tables: %u ms\n",
+			(unsigned int)I_ConvertTimeToMs(lighttable_stats.build_time));
+
+	if (argc > 1 && stricmp(argv[1], "clear") == 0)
 	{
-		int grayint = (int)(255.0f * clamp(1.0f -
-						(palette[c].getr() * 0.00116796875f +
-						 palette[c].getg() * 0.00229296875f +
-			 			 palette[c].getb() * 0.0005625f), 0.0f, 1.0f));
-
-		argb_t color(255, grayint, grayint, grayint); 
-		colormap[c] = V_BestColor(palette, color);
-		shademap[c] = V_GammaCorrect(color); 
+		V_ClearLightTables();
+		memset(&lighttable_stats, 0, sizeof(lighttable_stats));
 	}
 }
+END_COMMAND(lightcachestats)
+
+
+void BuildDefaultColorAndShademap(const palette_t* pal, shademap_t& maps)
+{
+	argb_t fadecolor(level.fadeto_color[0], level.fadeto_color[1], level.fadeto_color[2], level.fadeto_color[3]);
+
+	const palindex_t* colormap = V_GetLightTable(pal->basecolors, argb_t(255, 255, 255, 255), fadecolor);
+	memcpy(maps.colormap, colormap, LIGHTTABLE_SIZE * sizeof(*maps.colormap));
+
+	BuildDefaultShademap(pal, maps);
+}
 
 void BuildDefaultShademap(const palette_t* pal, shademap_t& maps)
 {
 	BuildLightRamp(maps);
 
-	// [SL] Modified algorithm from RF_BuildLights in dcolors.c
-	// from Doom Utilities. Now accomodates fading to non-black colors.
-
 	const argb_t* palette = pal->basecolors;
 	argb_t fadecolor(level.fadeto_color[0], level.fadeto_color[1], level.fadeto_color[2], level.fadeto_color[3]);
-	
+	const int fr = fadecolor.getr(), fg = fadecolor.getg(), fb = fadecolor.getb();
+
 	argb_t* shademap = maps.shademap;
 
 	for (int i = 0; i < NUMCOLORMAPS; i++, shademap += 256)
 	{
 		for (int c = 0; c < 256; c++)
-		{
-			unsigned int r = (palette[c].getr() * (NUMCOLORMAPS - i) + fadecolor.getr() * i
-					+ NUMCOLORMAPS/2) / NUMCOLORMAPS;
-			unsigned int g = (palette[c].getg() * (NUMCOLORMAPS - i) + fadecolor.getg() * i
-					+ NUMCOLORMAPS/2) / NUMCOLORMAPS;
-			unsigned int b = (palette[c].getb() * (NUMCOLORMAPS - i) + fadecolor.getb() * i
-					+ NUMCOLORMAPS/2) / NUMCOLORMAPS;
-
-			argb_t color(255, r, g, b);
-			shademap[c] = V_GammaCorrect(color);
-		}
+			shademap[c] = V_GammaCorrect(V_LightColor(palette[c], i, 255, 255, 255, fr, fg, fb));
 	}
 
 	// build special maps (e.g. invulnerability)
 	for (int c = 0; c < 256; c++)
-	{
-		int grayint = (int)(255.0f * clamp(1.0f -
-						(palette[c].getr() * 0.00116796875f +
-						 palette[c].getg() * 0.00229296875f +
-			 			 palette[c].getb() * 0.0005625f), 0.0f, 1.0f));
-
-		argb_t color(255, grayint, grayint, grayint); 
-		shademap[c] = V_GammaCorrect(color); 
-	}
+		shademap[c] = V_GammaCorrect(V_GrayColor(palette[c]));
 }
 
 
@@ -1013,28 +1219,16 @@ static void BuildColoredLights(shademap_t* maps, const int lr, const int lg, con
 
 	const argb_t* palette_colors = V_GetDefaultPalette()->basecolors;
 
+	const palindex_t* colormap = V_GetLightTable(palette_colors,
+			argb_t(255, lr, lg, lb), argb_t(255, fr, fg, fb));
+	memcpy(maps->colormap, colormap, NUMCOLORMAPS * 256 * sizeof(*maps->colormap));
+
 	// build normal (but colored) light mappings
 	for (unsigned int l = 0; l < NUMCOLORMAPS; l++)
 	{
-		// Build the colormap and shademap:
-		palindex_t* colormap = maps->colormap + 256 * l;
 		argb_t* shademap = maps->shademap + 256 * l;
 		for (unsigned int c = 0; c < 256; c++)
-		{
-			unsigned int r = (palette_colors[c].getr() * (NUMCOLORMAPS - l) + fr * l +
-			                  NUMCOLORMAPS / 2) /
-			                 NUMCOLORMAPS;
-			unsigned int g = (palette_colors[c].getg() * (NUMCOLORMAPS - l) + fg * l +
-			                  NUMCOLORMAPS / 2) /
-			                 NUMCOLORMAPS;
-			unsigned int b = (palette_colors[c].getb() * (NUMCOLORMAPS - l) + fb * l +
-			                  NUMCOLORMAPS / 2) /
-			                 NUMCOLORMAPS;
-			argb_t color(255, r * lr / 255, g * lg / 255, b * lb / 255);
-
-			shademap[c] = V_GammaCorrect(color);
-			colormap[c] = V_BestColor(palette_colors, color);
-		}
+			shademap[c] = V_GammaCorrect(V_LightColor(palette_colors[c], l, lr, lg, lb, fr, fg, fb));
 	}
 }
 
@@ -31,6 +31,7 @@
 #include "i_video.h"
 #include "v_video.h"
 #include "hu_stuff.h"
+#include "hu_drawers.h"
 #include "w_wad.h"
 
 #include "hashtable.h"
@@ -131,6 +132,9 @@ void V_TextInit()
 
 	// Default font is SMALLFONT.
 	V_SetFont("SMALLFONT");
+
+	// Any cached text was rendered with the old glyphs.
+	hud::ClearTextCache();
 }
 
 /**
@@ -138,6 +142,8 @@ void V_TextInit()
  */
 void V_TextShutdown()
 {
+	hud::ClearTextCache();
+
 	for (int i = 0; i < HU_FONTSIZE; i++)
 	{
 		::hu_bigfont[i].clear();
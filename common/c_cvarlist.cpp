@@ -395,6 +395,9 @@ CVAR_RANGE_FUNC_DECL(net_sndbuf, "131072", "Net send buffer size in bytes",
 					CVARTYPE_INT, CVAR_ARCHIVE | CVAR_NOENABLEDISABLE,
 					1500.0f, 256.0f * 1024.0f * 1024.0f)
 
+CVAR(				sv_parallelai, "0", "Trace monster sight checks on several threads",
+					CVARTYPE_BOOL, CVAR_ARCHIVE)
+
 // Experimental settings (all categories)
 // =======================================
 
@@ -24,6 +24,7 @@
 
 #include "odamex.h"
 
+#include <algorithm>
 #include <cmath>
 #include <exception>
 
@@ -40,10 +41,16 @@
 bool cvar_t::m_DoNoSet = false;
 bool cvar_t::m_UseCallback = false;
 
+// Number of chains in the cvar name hash.
+static const unsigned int CVAR_HASH_SIZE = 512;
+
 // denis - all this class does is delete the cvars during its static destruction
 class ad_t {
 public:
 	cvar_t *&GetCVars() { static cvar_t *CVars; return CVars; }
+	cvar_t **GetHash() { static cvar_t *Hash[CVAR_HASH_SIZE]; return Hash; }
+	// Leaked on purpose so ~cvar_t can still use it during static destruction.
+	std::vector<cvar_t *> &GetChanged() { static std::vector<cvar_t *> *Changed = new std::vector<cvar_t *>; return *Changed; }
 	ad_t() {}
 	~ad_t()
 	{
@@ -65,6 +72,21 @@ cvar_t* GetFirstCvar(void)
 
 int cvar_defflags;
 
+//
+// C_HashCVarName
+//
+// Case-folded, so it agrees with the stricmp in FindCVar.
+//
+static unsigned int C_HashCVarName(const char* name)
+{
+	unsigned int hash = 0;
+
+	while (*name)
+		hash = hash * 31 + tolower(*name++);
+
+	return hash % CVAR_HASH_SIZE;
+}
+
 cvar_t::cvar_t(const char* var_name, const char* def, const char* help, cvartype_t type,
 		DWORD flags, float minval, float maxval)
 {
@@ -80,10 +102,11 @@ cvar_t::cvar_t(const char* var_name, const char* def, const char* help, cvartype
 void cvar_t::InitSelf(const char* var_name, const char* def, const char* help, cvartype_t type,
 		DWORD var_flags, void (*callback)(cvar_t &), float minval, float maxval)
 {
-	cvar_t* dummy;
-	cvar_t* var = FindCVar(var_name, &dummy);
+	cvar_t* var = FindCVar(var_name);
 
 	m_Callback = callback;
+	m_HashNext = NULL;
+	m_ServerInfoChanged = false;
 	m_String = "";
 	m_Value = 0.0f;
 	m_Flags = 0;
@@ -113,6 +136,7 @@ void cvar_t::InitSelf(const char* var_name, const char* def, const char* help, c
 		m_Name = var_name;
 		m_Next = ad.GetCVars();
 		ad.GetCVars() = this;
+		AddToHash();
 	}
 	else
 		m_Name = "";
@@ -146,7 +170,51 @@ cvar_t::~cvar_t ()
 			else
 				ad.GetCVars() = m_Next;
 		}
+
+		RemoveFromHash();
 	}
+
+	RemoveFromChanged();
+}
+
+//
+// cvar_t::AddToHash
+//
+// Newer cvars go in front, so a lookup finds the same cvar that a walk of
+// the registration list would.
+//
+void cvar_t::AddToHash()
+{
+	cvar_t** chain = &ad.GetHash()[C_HashCVarName(m_Name.c_str())];
+	m_HashNext = *chain;
+	*chain = this;
+}
+
+void cvar_t::RemoveFromHash()
+{
+	cvar_t** link = &ad.GetHash()[C_HashCVarName(m_Name.c_str())];
+
+	while (*link)
+	{
+		if (*link == this)
+		{
+			*link = m_HashNext;
+			break;
+		}
+		link = &(*link)->m_HashNext;
+	}
+
+	m_HashNext = NULL;
+}
+
+void cvar_t::RemoveFromChanged()
+{
+	if (!m_ServerInfoChanged)
+		return;
+
+	std::vector<cvar_t*>& changed = ad.GetChanged();
+	changed.erase(std::remove(changed.begin(), changed.end(), this), changed.end());
+	m_ServerInfoChanged = false;
 }
 
 void cvar_t::ForceSet(const char* valstr)
@@ -203,7 +271,15 @@ void cvar_t::ForceSet(const char* valstr)
 		if (m_Flags & CVAR_USERINFO)
 			D_UserInfoChanged(this);
 		if (m_Flags & CVAR_SERVERINFO)
+		{
+			// Only the server drains this set, in SV_ServerSettingChange.
+			if (serverside && !m_ServerInfoChanged)
+			{
+				m_ServerInfoChanged = true;
+				ad.GetChanged().push_back(this);
+			}
 			D_SendServerInfoChange(this, m_String.c_str());
+		}
 	}
 
 	m_Flags &= ~CVAR_ISDEFAULT;
@@ -259,7 +335,7 @@ void cvar_t::Transfer(const char *fromname, const char *toname)
 	cvar_t *from, *to, *dummy;
 
 	from = FindCVar(fromname, &dummy);
-	to = FindCVar(toname, &dummy);
+	to = FindCVar(toname);
 
 	if (from && to)
 	{
@@ -267,19 +343,20 @@ void cvar_t::Transfer(const char *fromname, const char *toname)
 		to->ForceSet(from->m_String.c_str());
 
 		// remove the old cvar
-		cvar_t *cur = ad.GetCVars();
-		while (cur->m_Next != from)
-			cur = cur->m_Next;
+		if (dummy)
+			dummy->m_Next = from->m_Next;
+		else
+			ad.GetCVars() = from->m_Next;
 
-		cur->m_Next = from->m_Next;
+		from->RemoveFromHash();
 	}
 }
 
 cvar_t *cvar_t::cvar_set (const char *var_name, const char *val)
 {
-	cvar_t *var, *dummy;
+	cvar_t *var;
 
-	if ( (var = FindCVar (var_name, &dummy)) )
+	if ( (var = FindCVar (var_name)) )
 		var->Set (val);
 
 	return var;
@@ -287,9 +364,9 @@ cvar_t *cvar_t::cvar_set (const char *var_name, const char *val)
 
 cvar_t *cvar_t::cvar_forceset (const char *var_name, const char *val)
 {
-	cvar_t *var, *dummy;
+	cvar_t *var;
 
-	if ( (var = FindCVar (var_name, &dummy)) )
+	if ( (var = FindCVar (var_name)) )
 		var->ForceSet (val);
 
 	return var;
@@ -488,18 +565,30 @@ cvar_t *cvar_t::FindCVar (const char *var_name, cvar_t **prev)
 	if (var_name == NULL)
 		return NULL;
 
-	var = ad.GetCVars();
-	*prev = NULL;
-	while (var)
+	var = ad.GetHash()[C_HashCVarName(var_name)];
+	while (var && stricmp(var->m_Name.c_str(), var_name) != 0)
+		var = var->m_HashNext;
+
+	if (prev)
 	{
-		if (iequals(var->m_Name, var_name))
-			break;
-		*prev = var;
-		var = var->m_Next;
+		*prev = NULL;
+		for (cvar_t *cur = ad.GetCVars(); cur && cur != var; cur = cur->m_Next)
+			*prev = cur;
 	}
+
 	return var;
 }
 
+void cvar_t::GetChangedServerInfo (std::vector<cvar_t *> &out)
+{
+	std::vector<cvar_t*>& changed = ad.GetChanged();
+
+	out = changed;
+	for (size_t i = 0; i < changed.size(); i++)
+		changed[i]->m_ServerInfoChanged = false;
+	changed.clear();
+}
+
 void cvar_t::UnlatchCVars (void)
 {
 	cvar_t *var;
@@ -628,9 +717,9 @@ BEGIN_COMMAND (set)
 	}
 	else
 	{
-		cvar_t *var, *prev;
+		cvar_t *var;
 
-		var = cvar_t::FindCVar (argv[1], &prev);
+		var = cvar_t::FindCVar (argv[1]);
 		if (!var)
 			var = new cvar_t(argv[1], NULL, "", CVARTYPE_NONE,  CVAR_AUTO | CVAR_UNSETTABLE | cvar_defflags);
 
@@ -676,7 +765,6 @@ END_COMMAND (set)
 
 BEGIN_COMMAND (get)
 {
-    cvar_t *prev;
 	cvar_t *var;
 
     if (argc < 2)
@@ -685,7 +773,7 @@ BEGIN_COMMAND (get)
         return;
 	}
 
-    var = cvar_t::FindCVar (argv[1], &prev);
+    var = cvar_t::FindCVar (argv[1]);
 
 	if (var)
 	{
@@ -712,7 +800,6 @@ END_COMMAND (get)
 
 BEGIN_COMMAND (toggle)
 {
-    cvar_t *prev;
 	cvar_t *var;
 
     if (argc < 2)
@@ -721,7 +808,7 @@ BEGIN_COMMAND (toggle)
         return;
 	}
 
-    var = cvar_t::FindCVar (argv[1], &prev);
+    var = cvar_t::FindCVar (argv[1]);
 
 	if (!var)
 	{
@@ -758,7 +845,6 @@ END_COMMAND (cvarlist)
 
 BEGIN_COMMAND (help)
 {
-    cvar_t *prev;
     cvar_t *var;
 
     if (argc < 2)
@@ -767,7 +853,7 @@ BEGIN_COMMAND (help)
         return;
     }
 
-    var = cvar_t::FindCVar (argv[1], &prev);
+    var = cvar_t::FindCVar (argv[1]);
 
     if (!var)
     {
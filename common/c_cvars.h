@@ -30,6 +30,7 @@
 #include "tarray.h"
 
 #include <cfloat>
+#include <vector>
 
 /*
 ==========================================================
@@ -182,8 +183,13 @@ public:
 	// that might possibly have been changed during the course of demo playback.
 	static void C_RestoreCVars (void);
 
-	// Finds a named cvar
-	static cvar_t *FindCVar (const char *var_name, cvar_t **prev);
+	// Finds a named cvar.  Only pass prev if you need the cvar before it in
+	// the registration list, finding that means walking the list.
+	static cvar_t *FindCVar (const char *var_name, cvar_t **prev = NULL);
+
+	// Fills out with the CVAR_SERVERINFO cvars that have changed since the
+	// last call, in the order they first changed, and forgets them.
+	static void GetChangedServerInfo (std::vector<cvar_t *> &out);
 
 	// Called from G_InitNew()
 	static void UnlatchCVars (void);
@@ -222,6 +228,12 @@ private:
 
 	void (*m_Callback)(cvar_t &);
 	cvar_t *m_Next;
+	cvar_t *m_HashNext;
+	bool m_ServerInfoChanged;
+
+	void AddToHash ();
+	void RemoveFromHash ();
+	void RemoveFromChanged ();
 
     cvartype_t m_Type;
 
@@ -239,7 +251,8 @@ private:
  protected:
 
 	cvar_t () :
-			m_Flags(0), m_Callback(NULL), m_Next(NULL), m_Type(CVARTYPE_NONE), m_Value(0.f),
+			m_Flags(0), m_Callback(NULL), m_Next(NULL), m_HashNext(NULL),
+			m_ServerInfoChanged(false), m_Type(CVARTYPE_NONE), m_Value(0.f),
 			m_MinValue(-FLT_MAX), m_MaxValue(FLT_MAX)
 	 { }
 };
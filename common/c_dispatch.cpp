@@ -290,9 +290,9 @@ void C_DoCommand(const char *cmd, uint32_t key)
 		else
 		{
 			// Check for any CVars that match the command
-			cvar_t *var, *dummy;
+			cvar_t *var;
 
-			if ( (var = cvar_t::FindCVar (argv[0], &dummy)) )
+			if ( (var = cvar_t::FindCVar (argv[0])) )
 			{
 				if (argc >= 2)
 				{
@@ -520,8 +520,8 @@ BEGIN_COMMAND (if)
 	if (argc < 4)
 		return;
 
-	cvar_t *var, *dummy;
-	var = cvar_t::FindCVar (argv[1], &dummy);
+	cvar_t *var;
+	var = cvar_t::FindCVar (argv[1]);
 
 	if (!var)
 	{
@@ -660,13 +660,13 @@ const char *ParseString2(const char *data)
 // contents of <cvar>.
 const char *ParseString (const char *data)
 {
-	cvar_t *var, *dummy;
+	cvar_t *var;
 
 	if ( (data = ParseString2 (data)) )
 	{
 		if (com_token[0] == '$')
 		{
-			if ( (var = cvar_t::FindCVar (&com_token[1], &dummy)) )
+			if ( (var = cvar_t::FindCVar (&com_token[1])) )
 			{
 				strcpy (com_token, var->cstring());
 			}
@@ -985,13 +985,9 @@ BEGIN_COMMAND(logfile)
 		time(&rawtime);
 		timeinfo = localtime(&rawtime);
 		Printf("Log file %s closed on %s\n", ::LOG_FILE.c_str(), asctime(timeinfo));
-		::LOG.close();
 	}
 
-	::LOG_FILE = (argc > 1 ? argv[1] : default_logname);
-	::LOG.open(::LOG_FILE.c_str(), std::ios::app);
-
-	if (!::LOG.is_open())
+	if (!I_ReopenLog(argc > 1 ? argv[1] : default_logname))
 	{
 		Printf(PRINT_HIGH, "Unable to create logfile: %s\n", ::LOG_FILE.c_str());
 	}
@@ -999,8 +995,6 @@ BEGIN_COMMAND(logfile)
 	{
 		time(&rawtime);
 		timeinfo = localtime(&rawtime);
-		::LOG.flush();
-		::LOG << std::endl;
 		Printf(PRINT_HIGH, "Logging in file %s started %s\n", ::LOG_FILE.c_str(),
 		       asctime(timeinfo));
 	}
@@ -1016,7 +1010,7 @@ BEGIN_COMMAND (stoplog)
 		time (&rawtime);
     	timeinfo = localtime (&rawtime);
 		Printf (PRINT_HIGH, "Logging to file %s stopped %s\n", LOG_FILE.c_str(), asctime (timeinfo));
-		LOG.close();
+		I_CloseLog();
 	}
 }
 END_COMMAND (stoplog)
@@ -271,42 +271,73 @@ public:
 	// denis - client structure is here now for a 1:1
 	struct client_t
 	{
+		// A packet with reliable data in it, kept until the client acks it.
 		struct oldPacket_t
 		{
 			int		sequence;
-			buf_t	data;
+			byte	flags;		// SVF_* bits it was sent with
+			buf_t	data;		// everything after the flags, uncompressed
+			dtime_t	sent;		// when it last went out, in ms
+			int		retries;
 
-			oldPacket_t() : sequence(-1)
+			oldPacket_t() : sequence(-1), flags(0), sent(0), retries(0)
 			{
-				data.resize(0);
 			}
 
 			oldPacket_t(const oldPacket_t& other)
+			    : sequence(other.sequence), flags(other.flags), data(other.data),
+			      sent(other.sent), retries(other.retries)
+			{
+			}
+		};
+
+		// Congestion control for the unreliable part of each packet.  The
+		// server sends at rate, backing off when acks show packet loss and
+		// creeping back up towards the client's rate when they don't.
+		struct sendrate_t
+		{
+			int		rate;		// bytes per second, 0 until the first packet
+			int		tokens;		// bytes that can go out right now
+			int		tokentic;	// gametic tokens were last added
+			int		minrtt;		// lowest ping seen, in ms
+			dtime_t	lastchange;	// when rate was last changed, in ms
+			bool	limited;	// something was held back since then
+
+			sendrate_t()
+			    : rate(0), tokens(0), tokentic(0), minrtt(0), lastchange(0),
+			      limited(false)
 			{
-				sequence = other.sequence;
-				data = other.data;
 			}
 		};
 
 		netadr_t    address;
 
+		// Unreliable messages, in the order they are sent when there isn't
+		// room for everything: the player's own view, then updates about
+		// actors near them, then everything further away.
 		buf_t       netbuf;
+		buf_t       nearbuf;
+		buf_t       farbuf;
 		buf_t       reliablebuf;
 
 		// protocol version supported by the client
 		short		version;
 		int			packedversion;
+		int			netfeatures;	// NETF_* agreed on at connect
 
 		// for reliable protocol
-		oldPacket_t oldpackets[256];
+		std::list<oldPacket_t> oldpackets;	// not acked yet, oldest first
 
 		int         sequence;
-		int         last_sequence;
+		int         last_sequence;	// highest sequence acked
 		byte        packetnum;
+		int         srtt;			// smoothed round trip in ms, 0 until measured
+		int         rttvar;
 
 		int         rate;
 		int         reliable_bps;	// bytes per second
 		int         unreliable_bps;
+		sendrate_t  sendrate;
 
 		int			last_received;	// for timeouts
 
@@ -335,14 +366,12 @@ public:
 			memset(&address, 0, sizeof(netadr_t));
 			version = 0;
 			packedversion = 0;
-			for (size_t i = 0; i < ARRAY_LENGTH(oldpackets); i++)
-			{
-				oldpackets[i].sequence = -1;
-				oldpackets[i].data.resize(MAX_UDP_PACKET);
-			}
+			netfeatures = 0;
 			sequence = 0;
 			last_sequence = 0;
 			packetnum = 0;
+			srtt = 0;
+			rttvar = 0;
 			rate = 0;
 			reliable_bps = 0;
 			unreliable_bps = 0;
@@ -353,6 +382,8 @@ public:
 
 			// GhostlyDeath -- done with the {}
 			netbuf = MAX_UDP_PACKET;
+			nearbuf = MAX_UDP_PACKET;
+			farbuf = MAX_UDP_PACKET;
 			reliablebuf = MAX_UDP_PACKET;
 			digest = "";
 			allow_rcon = false;
@@ -363,15 +394,22 @@ public:
 		client_t(const client_t &other)
 			: address(other.address),
 			netbuf(other.netbuf),
+			nearbuf(other.nearbuf),
+			farbuf(other.farbuf),
 			reliablebuf(other.reliablebuf),
 			version(other.version),
 			packedversion(other.packedversion),
+			netfeatures(other.netfeatures),
+			oldpackets(other.oldpackets),
 			sequence(other.sequence),
 			last_sequence(other.last_sequence),
 			packetnum(other.packetnum),
+			srtt(other.srtt),
+			rttvar(other.rttvar),
 			rate(other.rate),
 			reliable_bps(other.reliable_bps),
 			unreliable_bps(other.unreliable_bps),
+			sendrate(other.sendrate),
 			last_received(other.last_received),
 			lastcmdtic(other.lastcmdtic),
 			lastclientcmdtic(other.lastclientcmdtic),
@@ -381,10 +419,6 @@ public:
 			compressor(other.compressor),
 			download(other.download)
 		{
-			for (size_t i = 0; i < ARRAY_LENGTH(oldpackets); i++)
-			{
-				oldpackets[i] = other.oldpackets[i];
-			}
 		}
 	} client;
 
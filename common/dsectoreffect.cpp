@@ -46,6 +46,8 @@ void DSectorEffect::Destroy ()
 {
 	if (m_Sector)
 	{
+		P_WakeWaitingScripts();
+
 		if (m_Sector->floordata == this)
 			m_Sector->floordata = NULL;
 		if (m_Sector->ceilingdata == this)
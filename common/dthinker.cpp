@@ -26,10 +26,12 @@
 
 #include "odamex.h"
 
+#include <map>
 
 #include "dthinker.h"
 #include "z_zone.h"
 #include "stats.h"
+#include "i_system.h"
 #include "p_local.h"
 
 IMPLEMENT_SERIAL (DThinker, DObject)
@@ -243,17 +245,62 @@ bool IndependentThinker(DThinker *thinker)
 }
 
 
+//
+// ThinkerStat
+//
+// Returns the stat for the time spent on one type of thinker each tic.
+//
+static FStat* ThinkerStat(const TypeInfo* type)
+{
+	typedef std::map<const TypeInfo*, FStat*> ThinkerStats;
+	static ThinkerStats stats;
+
+	ThinkerStats::iterator it = stats.find(type);
+	if (it != stats.end())
+		return it->second;
+
+	FStat* stat = new FStat((std::string("Think") + type->Name).c_str());
+	stats[type] = stat;
+	return stat;
+}
+
+typedef std::map<const TypeInfo*, dtime_t> ThinkerTimes;
+
 void DThinker::RunThinkers ()
 {
 	DThinker *currentthinker;
 
 	BEGIN_STAT (ThinkCycles);
 	currentthinker = FirstThinker;
-	while (currentthinker)
+	if (FStat::profiling)
 	{
-		if (!IndependentThinker(currentthinker))
-			currentthinker->RunThink();
-		currentthinker = currentthinker->m_Next;
+		// Same as below, but also time each type of thinker.
+		ThinkerTimes times;
+
+		while (currentthinker)
+		{
+			if (!IndependentThinker(currentthinker))
+			{
+				// The thinker might be gone once it's run.
+				const TypeInfo* type = RUNTIME_TYPE(currentthinker);
+				const dtime_t start = I_GetTime();
+				currentthinker->RunThink();
+				times[type] += I_GetTime() - start;
+			}
+			currentthinker = currentthinker->m_Next;
+		}
+
+		for (ThinkerTimes::const_iterator it = times.begin(); it != times.end(); ++it)
+			ThinkerStat(it->first)->addSample(it->second);
+	}
+	else
+	{
+		while (currentthinker)
+		{
+			if (!IndependentThinker(currentthinker))
+				currentthinker->RunThink();
+			currentthinker = currentthinker->m_Next;
+		}
 	}
 	END_STAT (ThinkCycles);
 }
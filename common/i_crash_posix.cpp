@@ -129,6 +129,9 @@ static void SigActionCallback(int sig, siginfo_t* si, void* ctx)
 	// Write out the backtrace
 	WriteBacktrace(sig, si);
 
+	// Get whatever was printed before the crash into the log.
+	I_FlushLog(true);
+
 	// Once we're done, re-raise the signal.
 	kill(getpid(), sig);
 }
@@ -63,6 +63,9 @@ typedef BOOL(WINAPI* MINIDUMPWRITEDUMP)(
 // Write the minidump to a file.
 void writeMinidump(EXCEPTION_POINTERS* exceptionPtrs)
 {
+	// Get whatever was printed before the crash into the log.
+	I_FlushLog(true);
+
 	// Grab the debugging library.
 	HMODULE dbghelp = LoadLibrary("dbghelp.dll");
 	if (dbghelp == NULL)
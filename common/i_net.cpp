@@ -79,6 +79,7 @@ typedef int SOCKET;
 
 #include "i_system.h"
 #include "i_net.h"
+#include "i_thread.h"
 #include "svc_map.h"
 #include "d_player.h"
 
@@ -101,6 +102,7 @@ typedef int SOCKET;
 unsigned int	inet_socket;
 int         	localport;
 netadr_t    	net_from;   // address of who sent the packet
+dtime_t     	net_arrival; // when the packet came off the socket
 
 buf_t       net_message(MAX_UDP_PACKET);
 extern bool	simulated_connection;
@@ -356,6 +358,8 @@ void BindToLocalPort (SOCKET s, u_short wanted)
 
 void CloseNetwork (void)
 {
+	NET_StopReceiveThread();
+
 #ifdef ODA_HAVE_MINIUPNP
     upnp_rem_redir (port);
 #endif
@@ -439,53 +443,287 @@ bool NET_CompareAdr (netadr_t a, netadr_t b)
 typedef int socklen_t;
 #endif
 
+//
+// Receive thread
+//
+// While the receive thread is running, it pulls packets off the socket as
+// soon as they arrive and NET_GetPacket hands them out of a queue instead of
+// reading the socket itself.  The queue has a single producer and a single
+// consumer, so the two ends only have to agree on the head and tail.
+//
+static const int NET_QUEUE_SIZE = 512;	// must be a power of two
+
+struct netpacket_t
+{
+	buf_t data;
+	netadr_t from;
+	dtime_t arrival;
+};
+
+static netpacket_t* recvqueue = NULL;
+static volatile int recvhead = 0;	// next slot the thread fills
+static volatile int recvtail = 0;	// next slot NET_GetPacket reads
+static volatile int recvquit = 0;
+static OThread recvthread;
+
+static volatile int recvcount = 0;
+static volatile int recvdropped = 0;
+static int recvpeak = 0;
+
+// Errors the thread ran into, waiting for NET_GetPacket to print them.
+// Only the first few between reads are kept so a broken socket can't flood
+// the console.
+static const size_t NET_MAX_RECV_ERRORS = 16;
+
+struct netrecverror_t
+{
+	int error;
+	netadr_t from;
+};
+
+static std::vector<netrecverror_t> recverrors;
+static OMutex recverrorlock;
+
+//
+// NET_RecvError
+//
+// Returns the error from a failed recvfrom, or 0 if it's one that's expected
+// and can be ignored.
+//
+static int NET_RecvError()
+{
+#ifdef _WIN32
+	const int error = WSAGetLastError();
+
+	if (error == WSAEWOULDBLOCK || error == WSAECONNRESET)
+		return 0;
+#else
+	const int error = errno;
+
+	if (error == EWOULDBLOCK || error == ECONNREFUSED)
+		return 0;
+#endif
+
+	return error;
+}
+
+//
+// NET_PrintRecvError
+//
+static void NET_PrintRecvError(int error, const netadr_t& from)
+{
+#ifdef _WIN32
+	if (error == WSAEMSGSIZE)
+	{
+		Printf(PRINT_HIGH, "Warning:  Oversize packet from %s\n", NET_AdrToString(from));
+		return;
+	}
+#endif
+
+	Printf(PRINT_HIGH, "NET_GetPacket: %s\n", strerror(error));
+}
+
+static void NET_ReceiveThread(void* data)
+{
+	buf_t scratch(MAX_UDP_PACKET);
+
+	while (!I_AtomicLoad(&recvquit))
+	{
+		// Wake up now and then even if nothing arrives, to check if we
+		// should stop.
+		struct timeval timeout = {0, 100 * 1000};
+		fd_set fds;
+
+		FD_ZERO(&fds);
+		FD_SET(inet_socket, &fds);
+
+		if (select(inet_socket + 1, &fds, NULL, NULL, &timeout) < 1)
+			continue;
+
+		// Drain everything that's waiting before going back to select.
+		for (;;)
+		{
+			const int head = recvhead;
+			const int next = (head + 1) & (NET_QUEUE_SIZE - 1);
+			const bool full = (next == I_AtomicLoad(&recvtail));
+
+			// When the queue is full the packet still has to come off the
+			// socket, otherwise select would keep waking us up for it.
+			buf_t& buf = full ? scratch : recvqueue[head].data;
+
+			struct sockaddr_in from;
+			socklen_t fromlen = sizeof(from);
+
+			buf.clear();
+			int ret = recvfrom(inet_socket, (char *)buf.ptr(), buf.maxsize(), 0,
+			                   (struct sockaddr *)&from, &fromlen);
+			if (ret == -1)
+			{
+				const int error = NET_RecvError();
+				if (error != 0)
+				{
+					OMutexLock lock(recverrorlock);
+					if (recverrors.size() < NET_MAX_RECV_ERRORS)
+					{
+						netrecverror_t err;
+						err.error = error;
+						SockadrToNetadr(&from, &err.from);
+						recverrors.push_back(err);
+					}
+				}
+				break;
+			}
+
+			if (full)
+			{
+				I_AtomicIncrement(&recvdropped);
+				continue;
+			}
+
+			netpacket_t& packet = recvqueue[head];
+			packet.data.setcursize(ret);
+			SockadrToNetadr(&from, &packet.from);
+#ifdef _WIN32
+			// The Windows timer keeps unguarded state, so the packet is
+			// stamped when it's taken off the queue instead.
+			packet.arrival = 0;
+#else
+			packet.arrival = I_GetTime();
+#endif
+
+			I_AtomicIncrement(&recvcount);
+			I_AtomicStore(&recvhead, next);
+		}
+	}
+}
+
+//
+// NET_StartReceiveThread
+//
+void NET_StartReceiveThread()
+{
+	if (recvthread.joinable())
+		return;
+
+	if (recvqueue == NULL)
+	{
+		recvqueue = new netpacket_t[NET_QUEUE_SIZE];
+		for (int i = 0; i < NET_QUEUE_SIZE; i++)
+			recvqueue[i].data.resize(MAX_UDP_PACKET);
+	}
+
+	recvhead = recvtail = 0;
+	recvquit = 0;
+
+	if (!recvthread.start(NET_ReceiveThread, NULL))
+		Printf(PRINT_WARNING, "Could not start the network receive thread.\n");
+}
+
+//
+// NET_StopReceiveThread
+//
+// Packets still in the queue are dropped, the same as if they were still
+// sitting in the socket when it was closed.
+//
+void NET_StopReceiveThread()
+{
+	if (!recvthread.joinable())
+		return;
+
+	I_AtomicStore(&recvquit, 1);
+	recvthread.join();
+}
+
+//
+// NET_GetReceiveStats
+//
+void NET_GetReceiveStats(netrecvstats_t& stats, bool reset)
+{
+	stats.running = recvthread.joinable();
+	stats.received = I_AtomicLoad(&recvcount);
+	stats.dropped = I_AtomicLoad(&recvdropped);
+	stats.depth = (I_AtomicLoad(&recvhead) - recvtail) & (NET_QUEUE_SIZE - 1);
+	stats.peakdepth = recvpeak;
+	stats.capacity = NET_QUEUE_SIZE - 1;
+
+	if (reset)
+	{
+		I_AtomicStore(&recvcount, 0);
+		I_AtomicStore(&recvdropped, 0);
+		recvpeak = 0;
+	}
+}
+
+//
+// NET_GetQueuedPacket
+//
+static int NET_GetQueuedPacket()
+{
+	const int tail = recvtail;
+	const int depth = (I_AtomicLoad(&recvhead) - tail) & (NET_QUEUE_SIZE - 1);
+	if (depth == 0)
+		return 0;
+
+	if (depth > recvpeak)
+		recvpeak = depth;
+
+	netpacket_t& packet = recvqueue[tail];
+
+	net_message.clear();
+	memcpy(net_message.ptr(), packet.data.ptr(), packet.data.size());
+	net_message.setcursize(packet.data.size());
+	net_from = packet.from;
+	net_arrival = packet.arrival ? packet.arrival : I_GetTime();
+
+	const int ret = packet.data.size();
+	I_AtomicStore(&recvtail, (tail + 1) & (NET_QUEUE_SIZE - 1));
+
+	return ret;
+}
+
 int NET_GetPacket (void)
 {
 	int				  ret;
 	struct sockaddr_in   from;
 	socklen_t			fromlen;
 
+	if (recvthread.joinable())
+	{
+		std::vector<netrecverror_t> errors;
+		{
+			OMutexLock lock(recverrorlock);
+			errors.swap(recverrors);
+		}
+
+		for (size_t i = 0; i < errors.size(); i++)
+			NET_PrintRecvError(errors[i].error, errors[i].from);
+
+		return NET_GetQueuedPacket();
+	}
+
 	fromlen = sizeof(from);
 	net_message.clear();
 	ret = recvfrom (inet_socket, (char *)net_message.ptr(), net_message.maxsize(), 0, (struct sockaddr *)&from, &fromlen);
 
 	if (ret == -1)
 	{
-#ifdef _WIN32
-		errno = WSAGetLastError();
-
-		if (errno == WSAEWOULDBLOCK)
-			return false;
-
-		if (errno == WSAECONNRESET)
-			return false;
-
-		if (errno == WSAEMSGSIZE)
+		const int error = NET_RecvError();
+		if (error != 0)
 		{
-			 Printf (PRINT_HIGH, "Warning:  Oversize packet from %s\n",
-							 NET_AdrToString (net_from));
-			 return false;
+			netadr_t errfrom;
+			SockadrToNetadr(&from, &errfrom);
+			NET_PrintRecvError(error, errfrom);
 		}
-
-		Printf (PRINT_HIGH, "NET_GetPacket: %s\n", strerror(errno));
 		return false;
-#else
-		if (errno == EWOULDBLOCK)
-			return false;
-		if (errno == ECONNREFUSED)
-			return false;
-
-		Printf (PRINT_HIGH, "NET_GetPacket: %s\n", strerror(errno));
-		return false;
-#endif
 	}
 	net_message.setcursize(ret);
 	SockadrToNetadr (&from, &net_from);
+	net_arrival = I_GetTime();
 
 	return ret;
 }
 
-int NET_SendPacket (buf_t &buf, netadr_t &to)
+int NET_SendPacket (buf_t &buf, netadr_t &to, std::string* error)
 {
 	int				   ret;
 	struct sockaddr_in	addr;
@@ -521,7 +759,10 @@ int NET_SendPacket (buf_t &buf, netadr_t &to)
 			  return 0;
 		  if (errno == ECONNREFUSED)
 			  return 0;
-		  Printf (PRINT_HIGH, "NET_SendPacket: %s\n", strerror(errno));
+		  if (error)
+			  StrFormat(*error, "NET_SendPacket: %s\n", strerror(errno));
+		  else
+			  Printf (PRINT_HIGH, "NET_SendPacket: %s\n", strerror(errno));
 #endif
 	}
 
@@ -883,10 +1124,33 @@ bool MSG_DecompressMinilzo ()
 	return true;
 }
 
+//
+// MSG_MinilzoWorkSize
+//
+// Bytes of work memory MSG_CompressMinilzo needs.
+//
+size_t MSG_MinilzoWorkSize()
+{
+	return LZO1X_1_MEM_COMPRESS;
+}
+
 //
 // MSG_CompressMinilzo
 //
 bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
+{
+	return MSG_CompressMinilzo(buf, start_offset, write_gap, compressed, wrkmem);
+}
+
+//
+// MSG_CompressMinilzo
+//
+// Compresses using the given scratch buffer and work memory, so threads
+// with their own can compress at the same time.  workmem must hold
+// MSG_MinilzoWorkSize() bytes and be aligned for a pointer.
+//
+bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap,
+                          buf_t &scratch, void *workmem)
 {
 	if(buf.size() < MINILZO_COMPRESS_MINPACKETSIZE)
 		return false;
@@ -894,23 +1158,23 @@ bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
 	lzo_uint outlen = OUT_LEN(buf.maxsize() - start_offset - write_gap);
 	size_t total_len = outlen + start_offset + write_gap;
 
-	if(compressed.maxsize() < total_len)
-		compressed.resize(total_len);
+	if(scratch.maxsize() < total_len)
+		scratch.resize(total_len);
 
 	int r = lzo1x_1_compress (buf.ptr() + start_offset,
 							  buf.size() - start_offset,
-							  compressed.ptr() + start_offset + write_gap,
+							  scratch.ptr() + start_offset + write_gap,
 							  &outlen,
-							  wrkmem);
+							  workmem);
 
 	// worth the effort?
 	if(r != LZO_E_OK || outlen >= (buf.size() - start_offset - write_gap))
 		return false;
 
-	memcpy(compressed.ptr(), buf.ptr(), start_offset);
+	memcpy(scratch.ptr(), buf.ptr(), start_offset);
 
 	SZ_Clear(&buf);
-	MSG_WriteChunk(&buf, compressed.ptr(), outlen + start_offset + write_gap);
+	MSG_WriteChunk(&buf, scratch.ptr(), outlen + start_offset + write_gap);
 
 	return true;
 }
@@ -1157,6 +1421,7 @@ static void InitNetMessageFormats()
 	CLC_INFO(clc_netcmd);
 	CLC_INFO(clc_spy);
 	CLC_INFO(clc_privmsg);
+	CLC_INFO(clc_ackbits);
 	CLC_INFO(clc_max);
 }
 
@@ -61,10 +61,51 @@ enum clientBuf_e
  */
 #define SVF_COMPRESSED BIT(0)
 
+/**
+ * @brief The packet holds one piece of reliable data that was too big for a
+ *        single packet.  After decompression it starts with the sequence of
+ *        the first piece (long), this piece's index (byte) and the number of
+ *        pieces (byte).
+ */
+#define SVF_FRAGMENT BIT(1)
+
 /**
  * @brief Unused flags - if any of these are set, we have a problem.
  */
-#define SVF_UNUSED_MASK BIT_MASK(1, 7)
+#define SVF_UNUSED_MASK BIT_MASK(2, 7)
+
+/**
+ * @brief Number of sequences the client remembers receiving.  Reliable
+ *        packets that are still unacked this many sequences later can't be
+ *        told apart from new ones.
+ */
+#define PACKET_SEQ_WINDOW 4096
+
+/**
+ * @brief The same window for clients that didn't ask for
+ *        NETF_SELECTIVEACK.
+ */
+#define LEGACY_PACKET_SEQ_WINDOW 256
+
+// Network features a client asks for at the end of its connect packet (long)
+// and the server echoes back in ConsolePlayer.  Only what both sides have is
+// used, so older clients and servers keep the wire format they know.
+
+/**
+ * @brief The client acks with clc_ackbits and remembers PACKET_SEQ_WINDOW
+ *        sequences.
+ */
+#define NETF_SELECTIVEACK BIT(0)
+
+/**
+ * @brief The client understands packets with SVF_FRAGMENT set.
+ */
+#define NETF_FRAGMENT BIT(1)
+
+/**
+ * @brief Every network feature this build knows about.
+ */
+#define NETF_ALL (NETF_SELECTIVEACK | NETF_FRAGMENT)
 
 /**
  * @brief svc_*: Transmit all possible data.
@@ -282,7 +323,7 @@ enum clc_t
 	clc_userinfo,  // send userinfo
 	clc_pingreply, // [SL] 2011-05-11 - timestamp
 	clc_rate,
-	clc_ack,
+	clc_ack,       // sequence (long)
 	clc_rcon,
 	clc_rcon_password,
 	clc_changeteam, // [NightFang] - Change your team
@@ -299,6 +340,7 @@ enum clc_t
 	clc_netcmd,  // [AM] Send a string command to the server.
 	clc_spy,     // [SL] Tell server to send info about this player
 	clc_privmsg, // [AM] Targeted chat to a specific player.
+	clc_ackbits, // sequence (long), then which of the 32 before it arrived (long)
 };
 
 static const size_t clc_max = 255;
@@ -322,6 +364,7 @@ typedef struct
 } netadr_t;
 
 extern  netadr_t  net_from;  // address of who sent the packet
+extern  dtime_t   net_arrival; // when the packet came off the socket
 
 
 class buf_t
@@ -741,7 +784,26 @@ char *NET_AdrToString (netadr_t a);
 bool NET_StringToAdr (const char *s, netadr_t *a);
 bool NET_CompareAdr (netadr_t a, netadr_t b);
 int  NET_GetPacket (void);
-int NET_SendPacket (buf_t &buf, netadr_t &to);
+
+// Counters for the network receive thread.
+struct netrecvstats_t
+{
+	bool running;
+	int received;	// packets queued
+	int dropped;	// packets thrown away because the queue was full
+	int depth;		// packets waiting right now
+	int peakdepth;	// most packets waiting at once
+	int capacity;
+};
+
+// Starts or stops a thread that reads packets off the socket as they arrive.
+// While it's running, NET_GetPacket takes packets from its queue.
+void NET_StartReceiveThread();
+void NET_StopReceiveThread();
+void NET_GetReceiveStats(netrecvstats_t& stats, bool reset = false);
+// If error is given, a failure is described there instead of printed, so
+// that threads other than the main one can send.
+int NET_SendPacket (buf_t &buf, netadr_t &to, std::string* error = NULL);
 std::string NET_GetLocalAddress (void);
 
 void SZ_Clear (buf_t *buf);
@@ -793,6 +855,9 @@ size_t MSG_SetOffset (const size_t &offset, const buf_t::seek_loc_t &loc);
 
 bool MSG_DecompressMinilzo ();
 bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap);
+bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap,
+                          buf_t &scratch, void *workmem);
+size_t MSG_MinilzoWorkSize();
 
 bool MSG_DecompressAdaptive (huffman &huff);
 bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_t write_gap);
@@ -0,0 +1,147 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Shared worker pool for data-parallel loops.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include "i_thread.h"
+
+// There's rarely much to gain from more threads than this for the loops we
+// hand out, and each one is kept around for the life of the process.
+static const unsigned int MAX_POOL_THREADS = 8;
+
+struct ParallelJob
+{
+	ParallelFunc func;
+	void* data;
+	int count;
+	int grain;
+	int numchunks;
+	volatile int nextchunk;
+};
+
+static OThread* poolthreads = NULL;
+static unsigned int numpoolthreads = 0;
+static bool poolstarted = false;
+
+static OSemaphore* jobstart = NULL;
+static OSemaphore* jobdone = NULL;
+static ParallelJob* volatile currentjob = NULL;
+
+//
+// I_RunParallelJob
+//
+// Takes chunks off the job until there are none left.
+//
+static void I_RunParallelJob(ParallelJob* job)
+{
+	for (;;)
+	{
+		const int chunk = I_AtomicIncrement(&job->nextchunk) - 1;
+		if (chunk >= job->numchunks)
+			break;
+
+		const int begin = chunk * job->grain;
+		const int end = MIN(begin + job->grain, job->count);
+		job->func(begin, end, job->data);
+	}
+}
+
+static void I_PoolThread(void* data)
+{
+	for (;;)
+	{
+		jobstart->wait();
+		I_RunParallelJob(currentjob);
+		jobdone->post();
+	}
+}
+
+//
+// I_StartPool
+//
+// The pool is started the first time it's needed.  The threads are never
+// joined, they just sit waiting for work until the process exits.
+//
+static void I_StartPool()
+{
+	poolstarted = true;
+
+	const unsigned int cpus = MIN(I_GetNumCPUs(), MAX_POOL_THREADS);
+	if (cpus <= 1)
+		return;
+
+	jobstart = new OSemaphore(0);
+	jobdone = new OSemaphore(0);
+	poolthreads = new OThread[cpus - 1];
+
+	for (unsigned int i = 0; i < cpus - 1; i++)
+	{
+		if (!poolthreads[i].start(I_PoolThread, NULL))
+			break;
+		numpoolthreads++;
+	}
+}
+
+//
+// I_ParallelFor
+//
+void I_ParallelFor(int count, int grain, ParallelFunc func, void* data)
+{
+	if (count <= 0)
+		return;
+
+	if (grain < 1)
+		grain = 1;
+
+	if (!poolstarted)
+		I_StartPool();
+
+	ParallelJob job;
+	job.func = func;
+	job.data = data;
+	job.count = count;
+	job.grain = grain;
+	job.numchunks = (count + grain - 1) / grain;
+	job.nextchunk = 0;
+
+	const unsigned int helpers = MIN(numpoolthreads, (unsigned int)job.numchunks - 1);
+	if (helpers == 0)
+	{
+		I_RunParallelJob(&job);
+		return;
+	}
+
+	currentjob = &job;
+	jobstart->post(helpers);
+
+	I_RunParallelJob(&job);
+
+	// Every helper that was woken has to check in before the job goes out
+	// of scope, even if it found nothing left to do.
+	for (unsigned int i = 0; i < helpers; i++)
+		jobdone->wait();
+
+	currentjob = NULL;
+}
+
+VERSION_CONTROL (i_thread_cpp, "$Id$")
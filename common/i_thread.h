@@ -0,0 +1,167 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Minimal threading primitives.
+//
+//   None of the zone memory, WAD cache or console functions are thread safe.
+//   Code running on a worker thread should only touch data that has been
+//   handed to it, and hand its results back to the main thread.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __I_THREAD_H__
+#define __I_THREAD_H__
+
+/**
+ * @brief A joinable worker thread.
+ */
+class OThread
+{
+  public:
+	typedef void (*Func)(void* data);
+
+	OThread();
+	~OThread();
+
+	/**
+	 * @brief Start running func(data) on a new thread.
+	 *
+	 * @return true if the thread was started.
+	 */
+	bool start(Func func, void* data);
+
+	/**
+	 * @brief Wait for the thread to finish.  Does nothing if the thread was
+	 *        never started or has already been joined.
+	 */
+	void join();
+
+	bool joinable() const
+	{
+		return m_impl != NULL;
+	}
+
+  private:
+	struct Impl;
+	Impl* m_impl;
+
+	OThread(const OThread&);
+	OThread& operator=(const OThread&);
+};
+
+/**
+ * @brief A non-recursive mutex.
+ */
+class OMutex
+{
+  public:
+	OMutex();
+	~OMutex();
+
+	void lock();
+	void unlock();
+
+	/**
+	 * @brief Lock the mutex only if no one else holds it.
+	 *
+	 * @return true if the mutex was locked.
+	 */
+	bool trylock();
+
+  private:
+	struct Impl;
+	Impl* m_impl;
+
+	OMutex(const OMutex&);
+	OMutex& operator=(const OMutex&);
+};
+
+/**
+ * @brief Locks a mutex for the lifetime of the object.
+ */
+class OMutexLock
+{
+  public:
+	explicit OMutexLock(OMutex& mutex) : m_mutex(mutex)
+	{
+		m_mutex.lock();
+	}
+
+	~OMutexLock()
+	{
+		m_mutex.unlock();
+	}
+
+  private:
+	OMutex& m_mutex;
+
+	OMutexLock(const OMutexLock&);
+	OMutexLock& operator=(const OMutexLock&);
+};
+
+/**
+ * @brief A counting semaphore.
+ */
+class OSemaphore
+{
+  public:
+	explicit OSemaphore(unsigned int count = 0);
+	~OSemaphore();
+
+	void post(unsigned int count = 1);
+	void wait();
+
+	/**
+	 * @brief Wait until the semaphore can be decremented or the timeout
+	 *        expires.
+	 *
+	 * @return true if the semaphore was decremented.
+	 */
+	bool wait(unsigned int timeout_ms);
+
+  private:
+	struct Impl;
+	Impl* m_impl;
+
+	OSemaphore(const OSemaphore&);
+	OSemaphore& operator=(const OSemaphore&);
+};
+
+// Atomic operations on an int shared between threads.  Increment and
+// decrement return the new value.  Loads have acquire and stores have
+// release semantics.
+int I_AtomicIncrement(volatile int* value);
+int I_AtomicDecrement(volatile int* value);
+int I_AtomicLoad(const volatile int* value);
+void I_AtomicStore(volatile int* value, int newvalue);
+
+// Returns the number of logical processors, or 1 if it can't be determined.
+unsigned int I_GetNumCPUs();
+
+// Called with a half-open range [begin, end) of the items to process.
+typedef void (*ParallelFunc)(int begin, int end, void* data);
+
+// Splits [0, count) into chunks of at most grain items and runs func on
+// each of them, spread over a shared pool of worker threads and the calling
+// thread.  Returns once every chunk is done.  Chunks may run in any order and
+// at the same time, so func must only write to the items it was given.
+//
+// Only the main thread may call this, and func must not call it again.
+void I_ParallelFor(int count, int grain, ParallelFunc func, void* data);
+
+#endif // __I_THREAD_H__
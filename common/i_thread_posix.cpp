@@ -0,0 +1,373 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   POSIX threading primitives.
+//
+//-----------------------------------------------------------------------------
+
+
+#if defined(UNIX) && !defined(GCONSOLE)
+
+#if defined(_WIN32)
+#error "UNIX is mutually exclusive with _WIN32"
+#endif
+
+#include "odamex.h"
+
+#include "i_thread.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------
+// OThread
+// ----------------------------------------------------------------------------
+
+struct OThread::Impl
+{
+	pthread_t thread;
+};
+
+struct ThreadArgs
+{
+	OThread::Func func;
+	void* data;
+};
+
+static void* ThreadEntry(void* arg)
+{
+	ThreadArgs args = *static_cast<ThreadArgs*>(arg);
+	delete static_cast<ThreadArgs*>(arg);
+
+	args.func(args.data);
+	return NULL;
+}
+
+OThread::OThread() : m_impl(NULL)
+{
+}
+
+OThread::~OThread()
+{
+	join();
+}
+
+bool OThread::start(Func func, void* data)
+{
+	if (m_impl != NULL)
+		return false;
+
+	ThreadArgs* args = new ThreadArgs;
+	args->func = func;
+	args->data = data;
+
+	m_impl = new Impl;
+
+	if (pthread_create(&m_impl->thread, NULL, ThreadEntry, args) != 0)
+	{
+		delete args;
+		delete m_impl;
+		m_impl = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void OThread::join()
+{
+	if (m_impl == NULL)
+		return;
+
+	pthread_join(m_impl->thread, NULL);
+	delete m_impl;
+	m_impl = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// OMutex
+// ----------------------------------------------------------------------------
+
+struct OMutex::Impl
+{
+	pthread_mutex_t mutex;
+};
+
+OMutex::OMutex() : m_impl(new Impl)
+{
+	pthread_mutex_init(&m_impl->mutex, NULL);
+}
+
+OMutex::~OMutex()
+{
+	pthread_mutex_destroy(&m_impl->mutex);
+	delete m_impl;
+}
+
+void OMutex::lock()
+{
+	pthread_mutex_lock(&m_impl->mutex);
+}
+
+void OMutex::unlock()
+{
+	pthread_mutex_unlock(&m_impl->mutex);
+}
+
+bool OMutex::trylock()
+{
+	return pthread_mutex_trylock(&m_impl->mutex) == 0;
+}
+
+// ----------------------------------------------------------------------------
+// OSemaphore
+//
+// Unnamed POSIX semaphores aren't available everywhere (OS X), so this is
+// built on a mutex and condition variable instead.
+// ----------------------------------------------------------------------------
+
+struct OSemaphore::Impl
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	unsigned int count;
+};
+
+OSemaphore::OSemaphore(unsigned int count) : m_impl(new Impl)
+{
+	pthread_mutex_init(&m_impl->mutex, NULL);
+	pthread_cond_init(&m_impl->cond, NULL);
+	m_impl->count = count;
+}
+
+OSemaphore::~OSemaphore()
+{
+	pthread_cond_destroy(&m_impl->cond);
+	pthread_mutex_destroy(&m_impl->mutex);
+	delete m_impl;
+}
+
+void OSemaphore::post(unsigned int count)
+{
+	pthread_mutex_lock(&m_impl->mutex);
+	m_impl->count += count;
+	if (count == 1)
+		pthread_cond_signal(&m_impl->cond);
+	else
+		pthread_cond_broadcast(&m_impl->cond);
+	pthread_mutex_unlock(&m_impl->mutex);
+}
+
+void OSemaphore::wait()
+{
+	pthread_mutex_lock(&m_impl->mutex);
+	while (m_impl->count == 0)
+		pthread_cond_wait(&m_impl->cond, &m_impl->mutex);
+	m_impl->count--;
+	pthread_mutex_unlock(&m_impl->mutex);
+}
+
+bool OSemaphore::wait(unsigned int timeout_ms)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	struct timespec deadline;
+	deadline.tv_sec = now.tv_sec + timeout_ms / 1000;
+	deadline.tv_nsec = now.tv_usec * 1000 + (timeout_ms % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&m_impl->mutex);
+	while (m_impl->count == 0)
+	{
+		if (pthread_cond_timedwait(&m_impl->cond, &m_impl->mutex, &deadline) == ETIMEDOUT)
+			break;
+	}
+
+	bool acquired = false;
+	if (m_impl->count > 0)
+	{
+		m_impl->count--;
+		acquired = true;
+	}
+	pthread_mutex_unlock(&m_impl->mutex);
+
+	return acquired;
+}
+
+// ----------------------------------------------------------------------------
+// Atomics
+// ----------------------------------------------------------------------------
+
+int I_AtomicIncrement(volatile int* value)
+{
+	return __sync_add_and_fetch(value, 1);
+}
+
+int I_AtomicDecrement(volatile int* value)
+{
+	return __sync_sub_and_fetch(value, 1);
+}
+
+int I_AtomicLoad(const volatile int* value)
+{
+	int result = *value;
+	__sync_synchronize();
+	return result;
+}
+
+void I_AtomicStore(volatile int* value, int newvalue)
+{
+	__sync_synchronize();
+	*value = newvalue;
+}
+
+unsigned int I_GetNumCPUs()
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (unsigned int)count : 1;
+}
+
+#endif
+
+#if defined(GCONSOLE)
+
+//
+// Consoles don't get threads.  OThread never starts, so the log is written
+// as it's printed and I_ParallelFor runs everything on the calling thread.
+//
+
+#include "odamex.h"
+
+#include "i_thread.h"
+
+struct OThread::Impl
+{
+};
+
+OThread::OThread() : m_impl(NULL)
+{
+}
+
+OThread::~OThread()
+{
+}
+
+bool OThread::start(Func func, void* data)
+{
+	return false;
+}
+
+void OThread::join()
+{
+}
+
+struct OMutex::Impl
+{
+};
+
+OMutex::OMutex() : m_impl(NULL)
+{
+}
+
+OMutex::~OMutex()
+{
+}
+
+void OMutex::lock()
+{
+}
+
+void OMutex::unlock()
+{
+}
+
+bool OMutex::trylock()
+{
+	return true;
+}
+
+// With only one thread, nothing could post a semaphore that's being waited
+// on, so waits never block.
+struct OSemaphore::Impl
+{
+	unsigned int count;
+};
+
+OSemaphore::OSemaphore(unsigned int count) : m_impl(new Impl)
+{
+	m_impl->count = count;
+}
+
+OSemaphore::~OSemaphore()
+{
+	delete m_impl;
+}
+
+void OSemaphore::post(unsigned int count)
+{
+	m_impl->count += count;
+}
+
+void OSemaphore::wait()
+{
+	if (m_impl->count > 0)
+		m_impl->count--;
+}
+
+bool OSemaphore::wait(unsigned int timeout_ms)
+{
+	if (m_impl->count == 0)
+		return false;
+
+	m_impl->count--;
+	return true;
+}
+
+int I_AtomicIncrement(volatile int* value)
+{
+	return ++*value;
+}
+
+int I_AtomicDecrement(volatile int* value)
+{
+	return --*value;
+}
+
+int I_AtomicLoad(const volatile int* value)
+{
+	return *value;
+}
+
+void I_AtomicStore(volatile int* value, int newvalue)
+{
+	*value = newvalue;
+}
+
+unsigned int I_GetNumCPUs()
+{
+	return 1;
+}
+
+#endif
@@ -0,0 +1,210 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Windows threading primitives.
+//
+//-----------------------------------------------------------------------------
+
+
+#if defined(_WIN32)
+
+#if defined(UNIX)
+#error "_WIN32 is mutually exclusive with UNIX"
+#endif
+
+#include "odamex.h"
+
+#include "win32inc.h"
+#include <process.h>
+
+#include "i_thread.h"
+
+// ----------------------------------------------------------------------------
+// OThread
+// ----------------------------------------------------------------------------
+
+struct OThread::Impl
+{
+	HANDLE thread;
+};
+
+struct ThreadArgs
+{
+	OThread::Func func;
+	void* data;
+};
+
+static unsigned int __stdcall ThreadEntry(void* arg)
+{
+	ThreadArgs args = *static_cast<ThreadArgs*>(arg);
+	delete static_cast<ThreadArgs*>(arg);
+
+	args.func(args.data);
+	return 0;
+}
+
+OThread::OThread() : m_impl(NULL)
+{
+}
+
+OThread::~OThread()
+{
+	join();
+}
+
+bool OThread::start(Func func, void* data)
+{
+	if (m_impl != NULL)
+		return false;
+
+	ThreadArgs* args = new ThreadArgs;
+	args->func = func;
+	args->data = data;
+
+	m_impl = new Impl;
+
+	// _beginthreadex rather than CreateThread so the CRT is set up for the
+	// new thread.
+	m_impl->thread = (HANDLE)_beginthreadex(NULL, 0, ThreadEntry, args, 0, NULL);
+	if (m_impl->thread == NULL)
+	{
+		delete args;
+		delete m_impl;
+		m_impl = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void OThread::join()
+{
+	if (m_impl == NULL)
+		return;
+
+	WaitForSingleObject(m_impl->thread, INFINITE);
+	CloseHandle(m_impl->thread);
+	delete m_impl;
+	m_impl = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// OMutex
+// ----------------------------------------------------------------------------
+
+struct OMutex::Impl
+{
+	CRITICAL_SECTION section;
+};
+
+OMutex::OMutex() : m_impl(new Impl)
+{
+	InitializeCriticalSection(&m_impl->section);
+}
+
+OMutex::~OMutex()
+{
+	DeleteCriticalSection(&m_impl->section);
+	delete m_impl;
+}
+
+void OMutex::lock()
+{
+	EnterCriticalSection(&m_impl->section);
+}
+
+void OMutex::unlock()
+{
+	LeaveCriticalSection(&m_impl->section);
+}
+
+bool OMutex::trylock()
+{
+	return TryEnterCriticalSection(&m_impl->section) != 0;
+}
+
+// ----------------------------------------------------------------------------
+// OSemaphore
+// ----------------------------------------------------------------------------
+
+struct OSemaphore::Impl
+{
+	HANDLE semaphore;
+};
+
+OSemaphore::OSemaphore(unsigned int count) : m_impl(new Impl)
+{
+	m_impl->semaphore = CreateSemaphore(NULL, count, MAXLONG, NULL);
+}
+
+OSemaphore::~OSemaphore()
+{
+	CloseHandle(m_impl->semaphore);
+	delete m_impl;
+}
+
+void OSemaphore::post(unsigned int count)
+{
+	ReleaseSemaphore(m_impl->semaphore, count, NULL);
+}
+
+void OSemaphore::wait()
+{
+	WaitForSingleObject(m_impl->semaphore, INFINITE);
+}
+
+bool OSemaphore::wait(unsigned int timeout_ms)
+{
+	return WaitForSingleObject(m_impl->semaphore, timeout_ms) == WAIT_OBJECT_0;
+}
+
+// ----------------------------------------------------------------------------
+// Atomics
+// ----------------------------------------------------------------------------
+
+int I_AtomicIncrement(volatile int* value)
+{
+	return InterlockedIncrement(reinterpret_cast<volatile LONG*>(value));
+}
+
+int I_AtomicDecrement(volatile int* value)
+{
+	return InterlockedDecrement(reinterpret_cast<volatile LONG*>(value));
+}
+
+int I_AtomicLoad(const volatile int* value)
+{
+	int result = *value;
+	MemoryBarrier();
+	return result;
+}
+
+void I_AtomicStore(volatile int* value, int newvalue)
+{
+	MemoryBarrier();
+	*value = newvalue;
+}
+
+unsigned int I_GetNumCPUs()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (unsigned int)info.dwNumberOfProcessors : 1;
+}
+
+#endif
@@ -22,6 +22,7 @@
 //-----------------------------------------------------------------------------
 
 #include <ctime>
+#include <list>
 
 #include "odamex.h"
 
@@ -29,10 +30,16 @@
 #include "m_wdlstats.h"
 
 #include "c_dispatch.h"
+#include "cmdlib.h"
+#include "i_system.h"
+#include "i_thread.h"
 #include "p_local.h"
 
 #define WDLSTATS_VERSION 6
 
+// Version of the binary container around the log, see FinishStream.
+#define WDLSTATS_BINARY_VERSION 1
+
 extern Players players;
 
 EXTERN_CVAR(sv_gametype)
@@ -75,6 +82,9 @@ static struct WDLState
 
 	// [Blair] Toggle for whether that recording has playerbeacons enabled.
 	bool enablebeacons;
+
+	// True if logs are saved in the binary format instead of text.
+	bool binary;
 } wdlstate;
 
 // A single tracked player
@@ -152,9 +162,77 @@ struct WDLEvent
 	int arg3;
 };
 
-// Events that we're keeping track of.
 typedef std::vector<WDLEvent> WDLEventLog;
-static WDLEventLog wdlevents;
+
+// Events from the current gametic.  Damage and accuracy events can still be
+// merged into these, anything older has already been handed to the writer.
+static WDLEventLog wdlstaging;
+static int wdlstagingtic = 0;
+
+// How many events have been logged since the log was started, and how many
+// of those have left the staging area.
+static int wdleventcount = 0;
+static int wdlflushedcount = 0;
+
+// The last few events handed to the writer, for wdlinfo.
+static const int WDL_RECENT_EVENTS = 64;
+static WDLEvent wdlrecent[WDL_RECENT_EVENTS];
+
+// Target used to find the latest staged event of a type by an activator,
+// whatever it was aimed at.
+static const int WDL_ANYTARGET = -1;
+
+// A slot in the lookup of staged events by (event, activator, target).  Only
+// slots from the current generation are in use, so the whole table is emptied
+// every tic just by bumping wdlslotgen.
+struct WDLEventSlot
+{
+	unsigned int gen;
+	int ev;
+	int activator;
+	int target;
+	int index;
+};
+
+typedef std::vector<WDLEventSlot> WDLEventSlots;
+static WDLEventSlots wdlslots;
+static unsigned int wdlslotgen = 1;
+static size_t wdlslotsused = 0;
+
+// Work for the writer thread, in the order it has to be done.
+enum WDLWriteJobType
+{
+	WDL_JOB_OPEN,   // Start streaming events to a new file.
+	WDL_JOB_EVENTS, // Add events to that file.
+	WDL_JOB_FINISH, // Write out the finished log.
+};
+
+struct WDLWriteJob
+{
+	WDLWriteJobType type;
+	std::string filename;
+	std::string header;
+	bool binary;
+	WDLEventLog events;
+};
+
+typedef std::list<WDLWriteJob> WDLWriteJobs;
+
+// How often the writer wakes up to write out new events.
+static const unsigned int WDL_WRITE_MS = 100;
+
+static OMutex wdljoblock;
+static WDLWriteJobs wdljobs;       // Guarded by wdljoblock.
+static std::string wdlwriteerrors; // Guarded by wdljoblock.
+static OSemaphore wdlwake;
+static OThread* wdlthread = NULL;
+static volatile int wdlquit = 0;
+
+// Only touched by whoever runs the jobs.
+static FILE* wdlstream = NULL;
+static std::string wdlstreamname;
+static bool wdlstreambinary = false;
+static int wdlstreamtic = 0;
 
 // Turn an event enum into a string.
 static const char* WDLEventString(WDLEvents i)
@@ -164,6 +242,406 @@ static const char* WDLEventString(WDLEvents i)
 	return ::wdlevstrings[i];
 }
 
+// Format an event the way it appears in the text format.
+static int FormatWDLEvent(char* buf, size_t size, const WDLEvent& evt)
+{
+	//                          "ev,ac,tg,gt,ax,ay,az,tx,ty,tz,a0,a1,a2,a3"
+	return snprintf(buf, size, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", evt.ev,
+	                evt.activator, evt.target, evt.gametic, evt.apos[0], evt.apos[1],
+	                evt.apos[2], evt.tpos[0], evt.tpos[1], evt.tpos[2], evt.arg0,
+	                evt.arg1, evt.arg2, evt.arg3);
+}
+
+// Append a zig-zag encoded varint to a binary log.
+static void WriteWDLVarint(std::string& out, int v)
+{
+	unsigned int uv = ((unsigned int)v << 1) ^ (unsigned int)(v >> 31);
+	while (uv >= 0x80)
+	{
+		out += (char)((uv & 0x7F) | 0x80);
+		uv >>= 7;
+	}
+	out += (char)uv;
+}
+
+static void STACK_ARGS WDLWriteError(const char* fmt, ...)
+{
+	std::string error;
+	va_list va;
+	va_start(va, fmt);
+	VStrFormat(error, fmt, va);
+	va_end(va);
+
+	OMutexLock lock(::wdljoblock);
+	::wdlwriteerrors += error;
+}
+
+// Print anything that went wrong on the writer thread since we last looked.
+static void ReportWriteErrors()
+{
+	std::string errors;
+	{
+		OMutexLock lock(::wdljoblock);
+		errors.swap(::wdlwriteerrors);
+	}
+
+	if (!errors.empty())
+		Printf(PRINT_HIGH, "%s", errors.c_str());
+}
+
+static void CloseStream()
+{
+	if (::wdlstream == NULL)
+		return;
+
+	fclose(::wdlstream);
+	::wdlstream = NULL;
+	remove(::wdlstreamname.c_str());
+}
+
+static void OpenStream(const std::string& filename, bool binary)
+{
+	CloseStream();
+
+	::wdlstream = fopen(filename.c_str(), "w+b");
+	::wdlstreamname = filename;
+	::wdlstreambinary = binary;
+	::wdlstreamtic = 0;
+
+	if (::wdlstream == NULL)
+		WDLWriteError("wdlstats: Could not open \"%s\" for writing.\n", filename.c_str());
+}
+
+static void WriteStreamEvents(const WDLEventLog& events)
+{
+	if (::wdlstream == NULL)
+		return;
+
+	std::string out;
+	out.reserve(events.size() * 48);
+
+	WDLEventLog::const_iterator it = events.begin();
+	for (; it != events.end(); ++it)
+	{
+		if (::wdlstreambinary)
+		{
+			WriteWDLVarint(out, it->ev);
+			WriteWDLVarint(out, it->activator);
+			WriteWDLVarint(out, it->target);
+			WriteWDLVarint(out, it->gametic - ::wdlstreamtic);
+			for (int i = 0; i < 3; i++)
+				WriteWDLVarint(out, it->apos[i]);
+			for (int i = 0; i < 3; i++)
+				WriteWDLVarint(out, it->tpos[i]);
+			WriteWDLVarint(out, it->arg0);
+			WriteWDLVarint(out, it->arg1);
+			WriteWDLVarint(out, it->arg2);
+			WriteWDLVarint(out, it->arg3);
+			::wdlstreamtic = it->gametic;
+		}
+		else
+		{
+			char buf[256];
+			int len = FormatWDLEvent(buf, sizeof(buf), *it);
+			out.append(buf, MIN(len, (int)sizeof(buf) - 1));
+		}
+	}
+
+	fwrite(out.data(), 1, out.size(), ::wdlstream);
+}
+
+//
+// FinishStream
+//
+// Writes the header of the log, then copies in the events that were streamed
+// to disk while the map was running.
+//
+// The binary format starts with "WDLB", then a varint version number and
+// the size of the header followed by the header itself, exactly as it is in
+// the text format up to the "events" line.  After that come the events, each
+// as fourteen zig-zag varints in the same order as the text format, except
+// that the gametic is the difference from the previous event.
+//
+static void FinishStream(const std::string& filename, const std::string& header)
+{
+	if (::wdlstream == NULL)
+	{
+		WDLWriteError("wdlstats: Could not save \"%s\", no events were written.\n",
+		              filename.c_str());
+		return;
+	}
+
+	FILE* fh = fopen(filename.c_str(), ::wdlstreambinary ? "wb" : "w");
+	if (fh == NULL)
+	{
+		WDLWriteError("wdlstats: Could not save \"%s\" for writing.\n", filename.c_str());
+		CloseStream();
+		return;
+	}
+
+	if (::wdlstreambinary)
+	{
+		std::string prefix = "WDLB";
+		WriteWDLVarint(prefix, WDLSTATS_BINARY_VERSION);
+		WriteWDLVarint(prefix, header.size());
+		fwrite(prefix.data(), 1, prefix.size(), fh);
+		fwrite(header.data(), 1, header.size(), fh);
+	}
+	else
+	{
+		fwrite(header.data(), 1, header.size(), fh);
+		fputs("events\n", fh);
+	}
+
+	fflush(::wdlstream);
+	rewind(::wdlstream);
+
+	char buf[8192];
+	size_t len;
+	while ((len = fread(buf, 1, sizeof(buf), ::wdlstream)) > 0)
+		fwrite(buf, 1, len, fh);
+
+	if (ferror(fh) || ferror(::wdlstream))
+		WDLWriteError("wdlstats: Error while saving \"%s\".\n", filename.c_str());
+
+	fclose(fh);
+	CloseStream();
+}
+
+static void RunWriteJob(const WDLWriteJob& job)
+{
+	switch (job.type)
+	{
+	case WDL_JOB_OPEN:
+		OpenStream(job.filename, job.binary);
+		break;
+	case WDL_JOB_EVENTS:
+		WriteStreamEvents(job.events);
+		break;
+	case WDL_JOB_FINISH:
+		FinishStream(job.filename, job.header);
+		break;
+	}
+}
+
+static void WDLWriterThread(void* data)
+{
+	for (;;)
+	{
+		::wdlwake.wait(WDL_WRITE_MS);
+
+		// Everything is queued before wdlquit is set, so looking at it before
+		// taking the jobs means the last of them still get written.
+		const bool quit = I_AtomicLoad(&::wdlquit) != 0;
+
+		WDLWriteJobs jobs;
+		{
+			OMutexLock lock(::wdljoblock);
+			jobs.splice(jobs.end(), ::wdljobs);
+		}
+
+		WDLWriteJobs::const_iterator it = jobs.begin();
+		for (; it != jobs.end(); ++it)
+			RunWriteJob(*it);
+
+		if (::wdlstream != NULL)
+			fflush(::wdlstream);
+
+		if (quit)
+			break;
+	}
+}
+
+static void QueueWriteJobs(WDLWriteJobs& jobs)
+{
+	if (::wdlthread == NULL || !::wdlthread->joinable())
+	{
+		// No writer thread, so do the work here.
+		WDLWriteJobs::const_iterator it = jobs.begin();
+		for (; it != jobs.end(); ++it)
+			RunWriteJob(*it);
+		jobs.clear();
+		return;
+	}
+
+	OMutexLock lock(::wdljoblock);
+	::wdljobs.splice(::wdljobs.end(), jobs);
+}
+
+//
+// StartWriter
+//
+// The thread object is never deleted, so an exit that skips
+// M_ShutdownWDLLog doesn't wait forever on it.
+//
+static void StartWriter()
+{
+	if (::wdlthread == NULL)
+	{
+		::wdlthread = new OThread;
+		atterm(M_ShutdownWDLLog);
+	}
+
+	if (::wdlthread->joinable())
+		return;
+
+	I_AtomicStore(&::wdlquit, 0);
+	::wdlthread->start(WDLWriterThread, NULL);
+}
+
+static void GrowEventSlots();
+
+//
+// FindEventSlot
+//
+// Looks up the slot for a key.  If create is set and there isn't one, an
+// empty slot is set aside for it.
+//
+static WDLEventSlot* FindEventSlot(WDLEvents ev, int activator, int target, bool create)
+{
+	if (create && (::wdlslotsused + 1) * 2 > ::wdlslots.size())
+		GrowEventSlots();
+
+	if (::wdlslots.empty())
+		return NULL;
+
+	unsigned int hash = (unsigned int)ev * 0x9E3779B1u;
+	hash ^= (unsigned int)activator * 0x85EBCA77u;
+	hash ^= (unsigned int)target * 0xC2B2AE3Du;
+	hash ^= hash >> 15;
+
+	const size_t mask = ::wdlslots.size() - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask)
+	{
+		WDLEventSlot& slot = ::wdlslots[i];
+		if (slot.gen != ::wdlslotgen)
+		{
+			if (!create)
+				return NULL;
+
+			slot.gen = ::wdlslotgen;
+			slot.ev = ev;
+			slot.activator = activator;
+			slot.target = target;
+			slot.index = -1;
+			::wdlslotsused++;
+			return &slot;
+		}
+
+		if (slot.ev == ev && slot.activator == activator && slot.target == target)
+			return &slot;
+	}
+}
+
+static void GrowEventSlots()
+{
+	WDLEventSlots old;
+	old.swap(::wdlslots);
+
+	const WDLEventSlot empty = {0, 0, 0, 0, -1};
+	::wdlslots.resize(old.empty() ? 64 : old.size() * 2, empty);
+	::wdlslotsused = 0;
+
+	WDLEventSlots::const_iterator it = old.begin();
+	for (; it != old.end(); ++it)
+	{
+		if (it->gen == ::wdlslotgen)
+			FindEventSlot((WDLEvents)it->ev, it->activator, it->target, true)->index =
+			    it->index;
+	}
+}
+
+/**
+ * Hand everything in the staging area to the writer.
+ */
+static void FlushStagedEvents()
+{
+	if (!::wdlstaging.empty())
+	{
+		for (size_t i = 0; i < ::wdlstaging.size(); i++)
+			::wdlrecent[(::wdlflushedcount + i) % WDL_RECENT_EVENTS] = ::wdlstaging[i];
+		::wdlflushedcount += ::wdlstaging.size();
+
+		WDLWriteJobs jobs(1);
+		jobs.back().type = WDL_JOB_EVENTS;
+		jobs.back().events.swap(::wdlstaging);
+		QueueWriteJobs(jobs);
+	}
+
+	::wdlstaging.clear();
+	::wdlslotgen++;
+	::wdlslotsused = 0;
+}
+
+/**
+ * Events can only be merged with others from the same gametic, so anything
+ * staged on an earlier tic is sent on its way first.
+ */
+static void SyncStagedEvents()
+{
+	if (::wdlstagingtic == ::gametic)
+		return;
+
+	FlushStagedEvents();
+	::wdlstagingtic = ::gametic;
+}
+
+static void StageEvent(const WDLEvent& evt)
+{
+	SyncStagedEvents();
+
+	const int index = ::wdlstaging.size();
+	::wdlstaging.push_back(evt);
+	::wdleventcount++;
+
+	FindEventSlot(evt.ev, evt.activator, evt.target, true)->index = index;
+	FindEventSlot(evt.ev, evt.activator, WDL_ANYTARGET, true)->index = index;
+}
+
+/**
+ * Find the latest event this tic with the given type, activator and target,
+ * or NULL if there isn't one.
+ */
+static WDLEvent* FindStagedEvent(WDLEvents ev, int activator, int target)
+{
+	SyncStagedEvents();
+
+	const WDLEventSlot* slot = FindEventSlot(ev, activator, target, false);
+	if (slot == NULL)
+		return NULL;
+
+	if (target == WDL_ANYTARGET || ::wdlstaging[slot->index].target == target)
+		return &::wdlstaging[slot->index];
+
+	// The event has since been given a target by a hit.  That's rare, so
+	// look for an older one the slow way.
+	for (int i = slot->index - 1; i >= 0; i--)
+	{
+		const WDLEvent& evt = ::wdlstaging[i];
+		if (evt.ev == ev && evt.activator == activator && evt.target == target)
+			return &::wdlstaging[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * Return an event logged since the log was started, if it's still in memory.
+ */
+static const WDLEvent* GetLoggedEvent(int id)
+{
+	if (id < 0 || id >= ::wdleventcount)
+		return NULL;
+
+	if (id >= ::wdlflushedcount)
+		return &::wdlstaging[id - ::wdlflushedcount];
+
+	if (id >= ::wdlflushedcount - WDL_RECENT_EVENTS)
+		return &::wdlrecent[id % WDL_RECENT_EVENTS];
+
+	return NULL;
+}
+
 static void AddWDLPlayer(player_t* player)
 {
 	// Don't add player if their name is already in the vector.
@@ -411,8 +889,9 @@ static void WDLStatsHelp()
 	       "wdlstats - Starts logging WDL statistics to the given directory.  Unless "
 	       "you are running a WDL server, you probably are not interested in this.\n\n"
 	       "Usage:\n"
-	       "  ] wdlstats <DIRNAME>\n"
-	       "  Starts logging WDL statistics in the directory DIRNAME.\n");
+	       "  ] wdlstats <DIRNAME> [text|binary]\n"
+	       "  Starts logging WDL statistics in the directory DIRNAME, in the text\n"
+	       "  format unless binary is given.\n");
 }
 
 BEGIN_COMMAND(wdlstats)
@@ -430,6 +909,16 @@ BEGIN_COMMAND(wdlstats)
 	if (*(::wdlstate.logdir.end() - 1) != PATHSEPCHAR)
 		::wdlstate.logdir += PATHSEPCHAR;
 
+	if (argc >= 3 && stricmp(argv[2], "binary") == 0)
+		::wdlstate.binary = true;
+	else if (argc >= 3 && stricmp(argv[2], "text") != 0)
+	{
+		WDLStatsHelp();
+		return;
+	}
+	else
+		::wdlstate.binary = false;
+
 	Printf(PRINT_HIGH,
 	       "wdlstats: Enabled, will log to directory \"%s\" on next map change.\n",
 	       wdlstate.logdir.c_str());
@@ -469,8 +958,15 @@ void M_StartWDLLog(bool newmap)
 	}
 	*/
 
-	// Start with a fresh slate of events.
-	::wdlevents.clear();
+	ReportWriteErrors();
+
+	// Start with a fresh slate of events.  Anything streamed from a log that
+	// was never committed is thrown away when the new stream is opened.
+	::wdlstaging.clear();
+	::wdlslotgen++;
+	::wdlslotsused = 0;
+	::wdleventcount = 0;
+	::wdlflushedcount = 0;
 
 	// And a fresh set of players.
 	::wdlplayers.clear();
@@ -494,6 +990,16 @@ void M_StartWDLLog(bool newmap)
 	// Set our starting tic.
 	::wdlstate.begintic = ::gametic;
 
+	// Events are streamed to disk as the game goes on, and the finished log
+	// is put together from them when it's committed.
+	StartWriter();
+
+	WDLWriteJobs jobs(1);
+	jobs.back().type = WDL_JOB_OPEN;
+	jobs.back().filename = ::wdlstate.logdir + "wdl_" + GenerateTimestamp() + ".events";
+	jobs.back().binary = ::wdlstate.binary;
+	QueueWriteJobs(jobs);
+
 	Printf(PRINT_HIGH, "wdlstats: Started, will log to directory \"%s\".\n",
 	       wdlstate.logdir.c_str());
 }
@@ -510,36 +1016,14 @@ void M_StartWDLLog(bool newmap)
 static bool LogDamageEvent(WDLEvents event, player_t* activator, player_t* target,
                            int arg0, int arg1, int arg2)
 {
-	WDLEventLog::reverse_iterator it = ::wdlevents.rbegin();
-	for (; it != ::wdlevents.rend(); ++it)
-	{
-		if ((*it).gametic != ::gametic)
-		{
-			// We're too late for events from last tic, so we must have a
-			// new event.
-			return false;
-		}
-
-		// Event type is the same?
-		if ((*it).ev != event)
-			continue;
-
-		// Activator is the same?
-		if ((*it).activator != activator->id)
-			continue;
-
-		// Target is the same?
-		if ((*it).target != target->id)
-			continue;
-
-		// Update our existing event.
-		(*it).arg0 += arg0;
-		(*it).arg1 += arg1;
-		return true;
-	}
-
-	// We ran through all our events, must be a new event.
-	return false;
+	WDLEvent* evt = FindStagedEvent(event, activator->id, target->id);
+	if (evt == NULL)
+		return false;
+
+	// Update our existing event.
+	evt->arg0 += arg0;
+	evt->arg1 += arg1;
+	return true;
 }
 
 /**
@@ -554,30 +1038,7 @@ bool LogAccuracyShot(WDLEvents event, player_t* activator, int mod, angle_t angl
 	// If not, we need to create a new one
 	// If there is an existing accuracy event for this tic and it has a target,
 	// then there were more than 1 hits, create a new event.
-	WDLEventLog::reverse_iterator it = ::wdlevents.rbegin();
-	for (; it != ::wdlevents.rend(); ++it)
-	{
-		if ((*it).gametic != ::gametic)
-		{
-			// Whoops, we went a whole gametic without seeing an accuracy
-			// to our name.
-			break;
-		}
-
-		// Event type is the same?
-		if ((*it).ev != event)
-			continue;
-
-		// Activator is the same?
-		if ((*it).activator != activator->id)
-			continue;
-
-		// We found an existing accuracy event for this tic.
-		// Do nothing.
-		return true;
-	}
-
-	return false;
+	return FindStagedEvent(event, activator->id, WDL_ANYTARGET) != NULL;
 }
 
 /**
@@ -589,56 +1050,36 @@ bool LogAccuracyShot(WDLEvents event, player_t* activator, int mod, angle_t angl
 bool LogAccuracyHit(WDLEvents event, player_t* activator, player_t* target, int mod,
                     int hits)
 {
-	// See if we have an existing accuracy event for this tic.
-	WDLEventLog::reverse_iterator it = ::wdlevents.rbegin();
-	for (; it != ::wdlevents.rend(); ++it)
-	{
-		if ((*it).gametic != ::gametic)
-		{
-			// Whoops, we went a whole gametic without seeing an accuracy
-			// to our name.
-			break;
-		}
-
-		// Event type is the same?
-		if ((*it).ev != event)
-			continue;
-
-		// Activator is the same?
-		if ((*it).activator != activator->id)
-			continue;
+	// Can't log a hit if it didn't hit anybody...
+	if (target == NULL)
+		return true;
 
-		// Target is the same?
-		if ((*it).target != target->id && (*it).target != 0)
-			continue;
+	// See if we have an existing accuracy event for this tic, either one
+	// that already hit this target or one that hasn't hit anybody yet.
+	WDLEvent* evt = FindStagedEvent(event, activator->id, target->id);
+	WDLEvent* open = FindStagedEvent(event, activator->id, 0);
+	if (evt == NULL || (open != NULL && open > evt))
+		evt = open;
 
-		// Target
-		int tx = 0;
-		int ty = 0;
-		int tz = 0;
-		if (target != NULL)
-		{
-			tx = target->mo->x;
-			ty = target->mo->y;
-			tz = target->mo->z;
-		}
-		else
-		{
-			// Can't log a hit if it didn't hit anybody...
-			return true;
-		}
+	if (evt == NULL)
+	{
+		// Not sure what happened but it can't find the event. Create one.
+		return false;
+	}
 
-		// We found an existing accuracy event for this tic - increment the number of
-		// shots hit if its a spread type
-		(*it).target = target->id;
-		(*it).arg2 += hits;
-		(*it).tpos[0] = tx;
-		(*it).tpos[1] = ty;
-		(*it).tpos[2] = tz;
-		return true;
+	// We found an existing accuracy event for this tic - increment the number of
+	// shots hit if its a spread type
+	if (evt->target != target->id)
+	{
+		evt->target = target->id;
+		FindEventSlot(event, activator->id, target->id, true)->index =
+		    evt - &::wdlstaging[0];
 	}
-	// Not sure what happened but it can't find the event. Create one.
-	return false;
+	evt->arg2 += hits;
+	evt->tpos[0] = target->mo->x;
+	evt->tpos[1] = target->mo->y;
+	evt->tpos[2] = target->mo->z;
+	return true;
 }
 
 // [Blair] Helper function to determine max amount of shots that a mod shoots at a time.
@@ -711,7 +1152,7 @@ void M_LogWDLItemRespawnEvent(AActor* activator)
 	// Add the event to the log.
 	WDLEvent evt = {WDL_EVENT_SPAWNITEM, NULL,     NULL,        ::gametic, {ax, ay, az},
 	                {0, 0, 0},           itemtype, itemspawnid, 0,         0};
-	::wdlevents.push_back(evt);
+	StageEvent(evt);
 }
 
 /**
@@ -776,7 +1217,7 @@ void M_LogWDLPickupEvent(player_t* activator, AActor* target, WDLPowerups pickup
 	WDLEvent evt = {
 	    WDL_EVENT_PICKUPITEM, aid,        tid,         ::gametic, {ax, ay, az},
 	    {tx, ty, tz},         pickuptype, itemspawnid, dropitem,  0};
-	::wdlevents.push_back(evt);
+	StageEvent(evt);
 }
 
 /**
@@ -862,7 +1303,7 @@ void M_LogWDLEvent(WDLEvents event, player_t* activator, player_t* target, int a
 	// Add the event to the log.
 	WDLEvent evt = {event,        aid,  tid,  ::gametic, {ax, ay, az},
 	                {tx, ty, tz}, arg0, arg1, arg2,      arg3};
-	::wdlevents.push_back(evt);
+	StageEvent(evt);
 }
 
 /**
@@ -945,15 +1386,28 @@ int M_GetPlayerId(player_t* player, team_t team)
 	return 0;
 }
 
+// Format a line of the log header.
+static void STACK_ARGS AddHeaderLine(std::string& header, const char* fmt, ...)
+{
+	std::string line;
+	va_list va;
+	va_start(va, fmt);
+	VStrFormat(line, fmt, va);
+	va_end(va);
+
+	header += line;
+}
+
 void M_CommitWDLLog()
 {
-	if (!::wdlstate.recording || wdlevents.empty() ||
+	if (!::wdlstate.recording || ::wdleventcount == 0 ||
 	    ::levelstate.getState() != LevelState::INGAME)
 		return;
 
 	// See if we can write a file.
 	std::string timestamp = GenerateTimestamp();
-	std::string filename = ::wdlstate.logdir + "wdl_" + timestamp + ".log";
+	std::string filename = ::wdlstate.logdir + "wdl_" + timestamp +
+	                       (::wdlstate.binary ? ".bin" : ".log");
 
 	// [Blair] Serialize the hashes before reading.
 	uint64_t reconsthash1 =
@@ -984,90 +1438,104 @@ void M_CommitWDLLog()
 	char iso8601buf[sizeof "2011-10-08T07:07:09Z"];
 	strftime(iso8601buf, sizeof iso8601buf, "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
 
-	FILE* fh = fopen(filename.c_str(), "w+");
-	if (fh == NULL)
-	{
-		::wdlstate.recording = false;
-		Printf(PRINT_HIGH, "wdlstats: Could not save\"%s\" for writing.\n",
-		       filename.c_str());
-		return;
-	}
+	std::string header;
 
 	// Header (metadata)
-	fprintf(fh, "version=%d\n", WDLSTATS_VERSION);
-	fprintf(fh, "time=%s\n", iso8601buf);
-	fprintf(fh, "levelnum=%d\n", ::level.levelnum);
-	fprintf(fh, "levelname=%s\n", ::level.level_name);
-	fprintf(fh, "levelhash=%.16llx%.16llx\n", reconsthash1, reconsthash2);
-	fprintf(fh, "gametype=%s\n", ::sv_gametype.cstring());
-	fprintf(fh, "lives=%s\n", ::g_lives.cstring());
-	fprintf(fh, "attackdefend=%s\n", ::g_sides.cstring());
-	fprintf(fh, "duration=%d\n", ::gametic - ::wdlstate.begintic);
-	fprintf(fh, "endgametic=%d\n", ::gametic);
-	fprintf(fh, "round=%d\n", ::levelstate.getRound());
-	fprintf(fh, "winresult=%d\n", ::levelstate.getWinInfo().type);
-	fprintf(fh, "winid=%d\n", ::levelstate.getWinInfo().id);
-	fprintf(fh, "hostname=%s\n", ::sv_hostname.cstring());
+	AddHeaderLine(header, "version=%d\n", WDLSTATS_VERSION);
+	AddHeaderLine(header, "time=%s\n", iso8601buf);
+	AddHeaderLine(header, "levelnum=%d\n", ::level.levelnum);
+	AddHeaderLine(header, "levelname=%s\n", ::level.level_name);
+	AddHeaderLine(header, "levelhash=%.16llx%.16llx\n", reconsthash1, reconsthash2);
+	AddHeaderLine(header, "gametype=%s\n", ::sv_gametype.cstring());
+	AddHeaderLine(header, "lives=%s\n", ::g_lives.cstring());
+	AddHeaderLine(header, "attackdefend=%s\n", ::g_sides.cstring());
+	AddHeaderLine(header, "duration=%d\n", ::gametic - ::wdlstate.begintic);
+	AddHeaderLine(header, "endgametic=%d\n", ::gametic);
+	AddHeaderLine(header, "round=%d\n", ::levelstate.getRound());
+	AddHeaderLine(header, "winresult=%d\n", ::levelstate.getWinInfo().type);
+	AddHeaderLine(header, "winid=%d\n", ::levelstate.getWinInfo().id);
+	AddHeaderLine(header, "hostname=%s\n", ::sv_hostname.cstring());
 
 	// Players
-	fprintf(fh, "players\n");
+	AddHeaderLine(header, "players\n");
 	WDLPlayers::const_iterator pit = ::wdlplayers.begin();
 	for (; pit != ::wdlplayers.end(); ++pit)
-		fprintf(fh, "%d,%d,%d,%s\n", pit->id, pit->pid, pit->team, pit->netname.c_str());
+		AddHeaderLine(header, "%d,%d,%d,%s\n", pit->id, pit->pid, pit->team,
+		              pit->netname.c_str());
 
 	// ItemSpawns
-	fprintf(fh, "itemspawns\n");
+	AddHeaderLine(header, "itemspawns\n");
 	WDLItemSpawns::const_iterator isit = ::wdlitemspawns.begin();
 	for (; isit != ::wdlitemspawns.end(); ++isit)
-		fprintf(fh, "%d,%d,%d,%d,%d\n", isit->id, isit->x, isit->y, isit->z, isit->item);
+		AddHeaderLine(header, "%d,%d,%d,%d,%d\n", isit->id, isit->x, isit->y, isit->z,
+		              isit->item);
 
 	// PlayerSpawns
-	fprintf(fh, "playerspawns\n");
+	AddHeaderLine(header, "playerspawns\n");
 	WDLPlayerSpawns::const_iterator psit = ::wdlplayerspawns.begin();
 	for (; psit != ::wdlplayerspawns.end(); ++psit)
-		fprintf(fh, "%d,%d,%d,%d,%d\n", psit->id, psit->team, psit->x, psit->y, psit->z);
+		AddHeaderLine(header, "%d,%d,%d,%d,%d\n", psit->id, psit->team, psit->x, psit->y,
+		              psit->z);
 
 	if (sv_gametype == GM_CTF)
 	{
 		// FlagLocation
-		fprintf(fh, "flaglocations\n");
+		AddHeaderLine(header, "flaglocations\n");
 		WDLFlagLocations::const_iterator flit = ::wdlflaglocations.begin();
 		for (; flit != ::wdlflaglocations.end(); ++flit)
-			fprintf(fh, "%d,%d,%d,%d\n", flit->team, flit->x, flit->y, flit->z);
+			AddHeaderLine(header, "%d,%d,%d,%d\n", flit->team, flit->x, flit->y,
+			              flit->z);
 	}
 
 	// Wads
-	fprintf(fh, "wads\n");
-	fprintf(fh, "%s", M_GetCurrentWadHashes().c_str());
+	AddHeaderLine(header, "wads\n");
+	AddHeaderLine(header, "%s", M_GetCurrentWadHashes().c_str());
 
-	// Events
-	fprintf(fh, "events\n");
-	WDLEventLog::const_iterator eit = ::wdlevents.begin();
-	for (; eit != ::wdlevents.end(); ++eit)
-	{
-		//          "ev,ac,tg,gt,ax,ay,az,tx,ty,tz,a0,a1,a2,a3"
-		fprintf(fh, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", eit->ev,
-		        eit->activator, eit->target, eit->gametic, eit->apos[0], eit->apos[1],
-		        eit->apos[2], eit->tpos[0], eit->tpos[1], eit->tpos[2], eit->arg0,
-		        eit->arg1, eit->arg2, eit->arg3);
-	}
+	// Events were streamed to disk as they came in, so the writer only has
+	// to put the header in front of them.
+	FlushStagedEvents();
 
-	fclose(fh);
+	WDLWriteJobs jobs(1);
+	jobs.back().type = WDL_JOB_FINISH;
+	jobs.back().filename = filename;
+	jobs.back().header.swap(header);
+	QueueWriteJobs(jobs);
+	::wdlwake.post();
 
 	// Turn off stat recording global - it must be turned on again by the
 	// log starter next go-around.
 	::wdlstate.recording = false;
 
-	Printf(PRINT_HIGH, "wdlstats: Log saved as \"%s\".\n", filename.c_str());
+	ReportWriteErrors();
+	Printf(PRINT_HIGH, "wdlstats: Saving log as \"%s\".\n", filename.c_str());
+}
+
+//
+// M_ShutdownWDLLog
+//
+// Writes out any logs the writer still has queued and stops it.  Events from
+// a log that was never committed are thrown away.
+//
+void STACK_ARGS M_ShutdownWDLLog()
+{
+	if (::wdlthread == NULL || !::wdlthread->joinable())
+		return;
+
+	I_AtomicStore(&::wdlquit, 1);
+	::wdlwake.post();
+	::wdlthread->join();
+
+	::wdlstate.recording = false;
+	CloseStream();
+
+	ReportWriteErrors();
 }
 
 static void PrintWDLEvent(const WDLEvent& evt)
 {
-	// FIXME: Once we have access to StrFormat, dedupe this format string.
-	//                 "ev,ac,tg,gt,ax,ay,az,tx,ty,tz,a0,a1,a2,a3"
-	Printf(PRINT_HIGH, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", evt.ev,
-	       evt.activator, evt.target, evt.gametic, evt.apos[0], evt.apos[1], evt.apos[2],
-	       evt.tpos[0], evt.tpos[1], evt.tpos[2], evt.arg0, evt.arg1, evt.arg2, evt.arg3);
+	char buf[256];
+	FormatWDLEvent(buf, sizeof(buf), evt);
+	Printf(PRINT_HIGH, "%s", buf);
 }
 
 static void WDLInfoHelp()
@@ -1076,9 +1544,9 @@ static void WDLInfoHelp()
 	       "wdlinfo - Looks up internal information about logged WDL events\n\n"
 	       "Usage:\n"
 	       "  ] wdlinfo event <ID>\n"
-	       "  Print the event by ID.\n\n"
+	       "  Print the event by ID, if it is one of the last few logged.\n\n"
 	       "  ] wdlinfo size\n"
-	       "  Return the size of the internal event array.\n\n"
+	       "  Return the number of events logged so far.\n\n"
 	       "  ] wdlinfo state\n"
 	       "  Return relevant WDL stats state.\n\n"
 	       "  ] wdlinfo tail\n"
@@ -1096,7 +1564,7 @@ BEGIN_COMMAND(wdlinfo)
 	if (stricmp(argv[1], "size") == 0)
 	{
 		// Count total events.
-		Printf(PRINT_HIGH, "%" PRIuSIZE " events found\n", ::wdlevents.size());
+		Printf(PRINT_HIGH, "%d events found\n", ::wdleventcount);
 		return;
 	}
 	else if (stricmp(argv[1], "state") == 0)
@@ -1107,25 +1575,23 @@ BEGIN_COMMAND(wdlinfo)
 		Printf(PRINT_HIGH, "Directory to write logs to: \"%s\"\n",
 		       ::wdlstate.logdir.c_str());
 		Printf(PRINT_HIGH, "Log starting gametic: %d\n", ::wdlstate.begintic);
+		Printf(PRINT_HIGH, "Log format: %s\n", ::wdlstate.binary ? "binary" : "text");
+		ReportWriteErrors();
 		return;
 	}
 	else if (stricmp(argv[1], "tail") == 0)
 	{
-		// [Blair] C++ doesn't like when you access an iterator on an empty vector.
-		if (::wdlevents.empty())
+		if (::wdleventcount == 0)
 		{
 			Printf(PRINT_HIGH, "No events to show.\n");
 			return;
 		}
 		// Show last 10 events.
-		WDLEventLog::const_iterator it = ::wdlevents.end() - 10;
-		if (it < ::wdlevents.begin())
-			it = wdlevents.begin();
-
-		Printf(PRINT_HIGH, "Showing last %" PRIdSIZE " events:\n",
-		       ::wdlevents.end() - it);
-		for (; it != ::wdlevents.end(); ++it)
-			PrintWDLEvent(*it);
+		int id = MAX(::wdleventcount - 10, 0);
+
+		Printf(PRINT_HIGH, "Showing last %d events:\n", ::wdleventcount - id);
+		for (; id < ::wdleventcount; id++)
+			PrintWDLEvent(*GetLoggedEvent(id));
 		return;
 	}
 
@@ -1138,13 +1604,13 @@ BEGIN_COMMAND(wdlinfo)
 	if (stricmp(argv[1], "event") == 0)
 	{
 		int id = atoi(argv[2]);
-		if (id >= ::wdlevents.size())
+		const WDLEvent* evt = GetLoggedEvent(id);
+		if (evt == NULL)
 		{
 			Printf(PRINT_HIGH, "Event number %d not found\n", id);
 			return;
 		}
-		WDLEvent evt = ::wdlevents.at(id);
-		PrintWDLEvent(evt);
+		PrintWDLEvent(*evt);
 		return;
 	}
 
@@ -131,6 +131,7 @@ int M_GetPlayerSpawn(int x, int y);
 void M_HandleWDLNameChange(team_t team, std::string oldname, std::string newname, int netid);
 int GetMaxShotsForMod(int mod);
 void M_CommitWDLLog();
+void STACK_ARGS M_ShutdownWDLLog();
 WDLPowerups M_GetWDLItemByMobjType(const mobjtype_t type);
 
 #endif
@@ -39,6 +39,7 @@
 #include "m_vectors.h"
 #include "p_inter.h"
 #include "gi.h"
+#include "stats.h"
 
 #if defined(SERVER_APP)
 #include "sv_main.h"
@@ -1021,6 +1022,42 @@ void FBehavior::StartTypedScripts (WORD type, AActor *activator, int arg0, int a
 #define STACK(a)	(Stack[sp - (a)])
 #define PushToStack(a)	(Stack[sp++] = (a))
 
+// With GCC and Clang each p-code's handler jumps straight to the next one's
+// through a table of label addresses instead of going back around the loop
+// to the switch, which gives the branch predictor one indirect jump per
+// handler to learn rather than a single shared one.  Other compilers just
+// use the switch.
+#if defined(__GNUC__) && !defined(ACS_NO_THREADED_DISPATCH)
+#define ACS_THREADED_DISPATCH
+#define PCODE(x)	case x: pcode_##x
+#define NEXTPCODE \
+	if (state != SCRIPT_Running || runaway >= 500000) \
+		break; \
+	runaway++; \
+	pcd = NEXTBYTE; \
+	goto dispatch
+#else
+#define PCODE(x)	case x
+#define NEXTPCODE	break
+#endif
+
+// Bumped whenever a sector or polyobject mover stops, so scripts waiting on
+// one only have to look again when something could have changed.
+static unsigned int waitwakecount = 0;
+
+// Totals for the acsstats command.
+static unsigned int acs_scriptruns = 0;
+static unsigned int acs_pcodes = 0;
+static dtime_t acs_runtime = 0;
+
+//
+// P_WakeWaitingScripts
+//
+void P_WakeWaitingScripts (void)
+{
+	waitwakecount++;
+}
+
 void strbin (char *str);
 
 IMPLEMENT_SERIAL (DACSThinker, DThinker)
@@ -1086,7 +1123,10 @@ void DACSThinker::Serialize (FArchive &arc)
 
 void DACSThinker::RunThink ()
 {
+	SCOPED_STAT(ACS);
+
 	DLevelScript *script = Scripts;
+	const dtime_t start = I_GetTime();
 
 	while (script)
 	{
@@ -1094,6 +1134,8 @@ void DACSThinker::RunThink ()
 		script->RunScript ();
 		script = next;
 	}
+
+	acs_runtime += I_GetTime() - start;
 }
 
 // FlashFader class - not sure where to put this so it goes here for now...
@@ -1383,12 +1425,16 @@ void DLevelScript::Serialize (FArchive &arc)
 	
 		arc >> i;
 		pc = level.behavior->Ofs2PC (i);
+
+		// Not archived, so have any wait check again straight away.
+		wakecount = waitwakecount - 1;
 	}
 }
 
 DLevelScript::DLevelScript ()
 {
 	next = prev = NULL;
+	wakecount = 0;
 	if (DACSThinker::ActiveThinker == NULL)
 		new DACSThinker;
 }
@@ -2133,8 +2179,13 @@ void DLevelScript::RunScript ()
 
 	case SCRIPT_TagWait:
 		// Wait for tagged sector(s) to go inactive, then enter
-		// state running
+		// state running.  Nothing can have gone inactive since the
+		// last look unless a mover has stopped.
 	{
+		if (wakecount == waitwakecount)
+			return;
+		wakecount = waitwakecount;
+
 		int secnum = -1;
 
 		while ((secnum = P_FindSectorFromTag (statedata, secnum)) >= 0)
@@ -2148,6 +2199,10 @@ void DLevelScript::RunScript ()
 
 	case SCRIPT_PolyWait:
 		// Wait for polyobj(s) to stop moving, then enter state running
+		if (wakecount == waitwakecount)
+			return;
+		wakecount = waitwakecount;
+
 		if (!PO_Busy (statedata))
 		{
 			state = SCRIPT_Running;
@@ -2183,6 +2238,209 @@ void DLevelScript::RunScript ()
 //	int optstart = -1;
 	int temp;
 
+#ifdef ACS_THREADED_DISPATCH
+	// Every p-code the switch below handles.  Anything missing from here
+	// still works, it just goes through the switch.
+	static const void *pcodelabels[PCODE_COMMAND_COUNT];
+	static bool pcodelabelsready = false;
+
+	if (!pcodelabelsready)
+	{
+		pcodelabels[PCD_TERMINATE] = &&pcode_PCD_TERMINATE;
+		pcodelabels[PCD_NOP] = &&pcode_PCD_NOP;
+		pcodelabels[PCD_SUSPEND] = &&pcode_PCD_SUSPEND;
+		pcodelabels[PCD_PUSHNUMBER] = &&pcode_PCD_PUSHNUMBER;
+		pcodelabels[PCD_PUSHBYTE] = &&pcode_PCD_PUSHBYTE;
+		pcodelabels[PCD_PUSH2BYTES] = &&pcode_PCD_PUSH2BYTES;
+		pcodelabels[PCD_PUSH3BYTES] = &&pcode_PCD_PUSH3BYTES;
+		pcodelabels[PCD_PUSH4BYTES] = &&pcode_PCD_PUSH4BYTES;
+		pcodelabels[PCD_PUSH5BYTES] = &&pcode_PCD_PUSH5BYTES;
+		pcodelabels[PCD_PUSHBYTES] = &&pcode_PCD_PUSHBYTES;
+		pcodelabels[PCD_DUP] = &&pcode_PCD_DUP;
+		pcodelabels[PCD_SWAP] = &&pcode_PCD_SWAP;
+		pcodelabels[PCD_LSPEC1] = &&pcode_PCD_LSPEC1;
+		pcodelabels[PCD_LSPEC2] = &&pcode_PCD_LSPEC2;
+		pcodelabels[PCD_LSPEC3] = &&pcode_PCD_LSPEC3;
+		pcodelabels[PCD_LSPEC4] = &&pcode_PCD_LSPEC4;
+		pcodelabels[PCD_LSPEC5] = &&pcode_PCD_LSPEC5;
+		pcodelabels[PCD_LSPEC1DIRECT] = &&pcode_PCD_LSPEC1DIRECT;
+		pcodelabels[PCD_LSPEC2DIRECT] = &&pcode_PCD_LSPEC2DIRECT;
+		pcodelabels[PCD_LSPEC3DIRECT] = &&pcode_PCD_LSPEC3DIRECT;
+		pcodelabels[PCD_LSPEC4DIRECT] = &&pcode_PCD_LSPEC4DIRECT;
+		pcodelabels[PCD_LSPEC5DIRECT] = &&pcode_PCD_LSPEC5DIRECT;
+		pcodelabels[PCD_LSPEC1DIRECTB] = &&pcode_PCD_LSPEC1DIRECTB;
+		pcodelabels[PCD_LSPEC2DIRECTB] = &&pcode_PCD_LSPEC2DIRECTB;
+		pcodelabels[PCD_LSPEC3DIRECTB] = &&pcode_PCD_LSPEC3DIRECTB;
+		pcodelabels[PCD_LSPEC4DIRECTB] = &&pcode_PCD_LSPEC4DIRECTB;
+		pcodelabels[PCD_LSPEC5DIRECTB] = &&pcode_PCD_LSPEC5DIRECTB;
+		pcodelabels[PCD_CALL] = &&pcode_PCD_CALL;
+		pcodelabels[PCD_CALLDISCARD] = &&pcode_PCD_CALLDISCARD;
+		pcodelabels[PCD_RETURNVOID] = &&pcode_PCD_RETURNVOID;
+		pcodelabels[PCD_RETURNVAL] = &&pcode_PCD_RETURNVAL;
+		pcodelabels[PCD_ADD] = &&pcode_PCD_ADD;
+		pcodelabels[PCD_SUBTRACT] = &&pcode_PCD_SUBTRACT;
+		pcodelabels[PCD_MULTIPLY] = &&pcode_PCD_MULTIPLY;
+		pcodelabels[PCD_DIVIDE] = &&pcode_PCD_DIVIDE;
+		pcodelabels[PCD_MODULUS] = &&pcode_PCD_MODULUS;
+		pcodelabels[PCD_EQ] = &&pcode_PCD_EQ;
+		pcodelabels[PCD_NE] = &&pcode_PCD_NE;
+		pcodelabels[PCD_LT] = &&pcode_PCD_LT;
+		pcodelabels[PCD_GT] = &&pcode_PCD_GT;
+		pcodelabels[PCD_LE] = &&pcode_PCD_LE;
+		pcodelabels[PCD_GE] = &&pcode_PCD_GE;
+		pcodelabels[PCD_ASSIGNSCRIPTVAR] = &&pcode_PCD_ASSIGNSCRIPTVAR;
+		pcodelabels[PCD_ASSIGNMAPVAR] = &&pcode_PCD_ASSIGNMAPVAR;
+		pcodelabels[PCD_ASSIGNWORLDVAR] = &&pcode_PCD_ASSIGNWORLDVAR;
+		pcodelabels[PCD_ASSIGNGLOBALVAR] = &&pcode_PCD_ASSIGNGLOBALVAR;
+		pcodelabels[PCD_ASSIGNMAPARRAY] = &&pcode_PCD_ASSIGNMAPARRAY;
+		pcodelabels[PCD_PUSHSCRIPTVAR] = &&pcode_PCD_PUSHSCRIPTVAR;
+		pcodelabels[PCD_PUSHMAPVAR] = &&pcode_PCD_PUSHMAPVAR;
+		pcodelabels[PCD_PUSHWORLDVAR] = &&pcode_PCD_PUSHWORLDVAR;
+		pcodelabels[PCD_PUSHGLOBALVAR] = &&pcode_PCD_PUSHGLOBALVAR;
+		pcodelabels[PCD_PUSHMAPARRAY] = &&pcode_PCD_PUSHMAPARRAY;
+		pcodelabels[PCD_ADDSCRIPTVAR] = &&pcode_PCD_ADDSCRIPTVAR;
+		pcodelabels[PCD_ADDMAPVAR] = &&pcode_PCD_ADDMAPVAR;
+		pcodelabels[PCD_ADDWORLDVAR] = &&pcode_PCD_ADDWORLDVAR;
+		pcodelabels[PCD_ADDGLOBALVAR] = &&pcode_PCD_ADDGLOBALVAR;
+		pcodelabels[PCD_ADDMAPARRAY] = &&pcode_PCD_ADDMAPARRAY;
+		pcodelabels[PCD_SUBSCRIPTVAR] = &&pcode_PCD_SUBSCRIPTVAR;
+		pcodelabels[PCD_SUBMAPVAR] = &&pcode_PCD_SUBMAPVAR;
+		pcodelabels[PCD_SUBWORLDVAR] = &&pcode_PCD_SUBWORLDVAR;
+		pcodelabels[PCD_SUBGLOBALVAR] = &&pcode_PCD_SUBGLOBALVAR;
+		pcodelabels[PCD_SUBMAPARRAY] = &&pcode_PCD_SUBMAPARRAY;
+		pcodelabels[PCD_MULSCRIPTVAR] = &&pcode_PCD_MULSCRIPTVAR;
+		pcodelabels[PCD_MULMAPVAR] = &&pcode_PCD_MULMAPVAR;
+		pcodelabels[PCD_MULWORLDVAR] = &&pcode_PCD_MULWORLDVAR;
+		pcodelabels[PCD_MULGLOBALVAR] = &&pcode_PCD_MULGLOBALVAR;
+		pcodelabels[PCD_MULMAPARRAY] = &&pcode_PCD_MULMAPARRAY;
+		pcodelabels[PCD_DIVSCRIPTVAR] = &&pcode_PCD_DIVSCRIPTVAR;
+		pcodelabels[PCD_DIVMAPVAR] = &&pcode_PCD_DIVMAPVAR;
+		pcodelabels[PCD_DIVWORLDVAR] = &&pcode_PCD_DIVWORLDVAR;
+		pcodelabels[PCD_DIVGLOBALVAR] = &&pcode_PCD_DIVGLOBALVAR;
+		pcodelabels[PCD_DIVMAPARRAY] = &&pcode_PCD_DIVMAPARRAY;
+		pcodelabels[PCD_MODSCRIPTVAR] = &&pcode_PCD_MODSCRIPTVAR;
+		pcodelabels[PCD_MODMAPVAR] = &&pcode_PCD_MODMAPVAR;
+		pcodelabels[PCD_MODWORLDVAR] = &&pcode_PCD_MODWORLDVAR;
+		pcodelabels[PCD_MODGLOBALVAR] = &&pcode_PCD_MODGLOBALVAR;
+		pcodelabels[PCD_MODMAPARRAY] = &&pcode_PCD_MODMAPARRAY;
+		pcodelabels[PCD_INCSCRIPTVAR] = &&pcode_PCD_INCSCRIPTVAR;
+		pcodelabels[PCD_INCMAPVAR] = &&pcode_PCD_INCMAPVAR;
+		pcodelabels[PCD_INCWORLDVAR] = &&pcode_PCD_INCWORLDVAR;
+		pcodelabels[PCD_INCGLOBALVAR] = &&pcode_PCD_INCGLOBALVAR;
+		pcodelabels[PCD_INCMAPARRAY] = &&pcode_PCD_INCMAPARRAY;
+		pcodelabels[PCD_DECSCRIPTVAR] = &&pcode_PCD_DECSCRIPTVAR;
+		pcodelabels[PCD_DECMAPVAR] = &&pcode_PCD_DECMAPVAR;
+		pcodelabels[PCD_DECWORLDVAR] = &&pcode_PCD_DECWORLDVAR;
+		pcodelabels[PCD_DECGLOBALVAR] = &&pcode_PCD_DECGLOBALVAR;
+		pcodelabels[PCD_DECMAPARRAY] = &&pcode_PCD_DECMAPARRAY;
+		pcodelabels[PCD_GOTO] = &&pcode_PCD_GOTO;
+		pcodelabels[PCD_IFGOTO] = &&pcode_PCD_IFGOTO;
+		pcodelabels[PCD_DROP] = &&pcode_PCD_DROP;
+		pcodelabels[PCD_DELAY] = &&pcode_PCD_DELAY;
+		pcodelabels[PCD_DELAYDIRECT] = &&pcode_PCD_DELAYDIRECT;
+		pcodelabels[PCD_DELAYDIRECTB] = &&pcode_PCD_DELAYDIRECTB;
+		pcodelabels[PCD_RANDOM] = &&pcode_PCD_RANDOM;
+		pcodelabels[PCD_RANDOMDIRECT] = &&pcode_PCD_RANDOMDIRECT;
+		pcodelabels[PCD_RANDOMDIRECTB] = &&pcode_PCD_RANDOMDIRECTB;
+		pcodelabels[PCD_THINGCOUNT] = &&pcode_PCD_THINGCOUNT;
+		pcodelabels[PCD_THINGCOUNTDIRECT] = &&pcode_PCD_THINGCOUNTDIRECT;
+		pcodelabels[PCD_TAGWAIT] = &&pcode_PCD_TAGWAIT;
+		pcodelabels[PCD_TAGWAITDIRECT] = &&pcode_PCD_TAGWAITDIRECT;
+		pcodelabels[PCD_POLYWAIT] = &&pcode_PCD_POLYWAIT;
+		pcodelabels[PCD_POLYWAITDIRECT] = &&pcode_PCD_POLYWAITDIRECT;
+		pcodelabels[PCD_CHANGEFLOOR] = &&pcode_PCD_CHANGEFLOOR;
+		pcodelabels[PCD_CHANGEFLOORDIRECT] = &&pcode_PCD_CHANGEFLOORDIRECT;
+		pcodelabels[PCD_CHANGECEILING] = &&pcode_PCD_CHANGECEILING;
+		pcodelabels[PCD_CHANGECEILINGDIRECT] = &&pcode_PCD_CHANGECEILINGDIRECT;
+		pcodelabels[PCD_RESTART] = &&pcode_PCD_RESTART;
+		pcodelabels[PCD_ANDLOGICAL] = &&pcode_PCD_ANDLOGICAL;
+		pcodelabels[PCD_ORLOGICAL] = &&pcode_PCD_ORLOGICAL;
+		pcodelabels[PCD_ANDBITWISE] = &&pcode_PCD_ANDBITWISE;
+		pcodelabels[PCD_ORBITWISE] = &&pcode_PCD_ORBITWISE;
+		pcodelabels[PCD_EORBITWISE] = &&pcode_PCD_EORBITWISE;
+		pcodelabels[PCD_NEGATELOGICAL] = &&pcode_PCD_NEGATELOGICAL;
+		pcodelabels[PCD_LSHIFT] = &&pcode_PCD_LSHIFT;
+		pcodelabels[PCD_RSHIFT] = &&pcode_PCD_RSHIFT;
+		pcodelabels[PCD_UNARYMINUS] = &&pcode_PCD_UNARYMINUS;
+		pcodelabels[PCD_IFNOTGOTO] = &&pcode_PCD_IFNOTGOTO;
+		pcodelabels[PCD_LINESIDE] = &&pcode_PCD_LINESIDE;
+		pcodelabels[PCD_SCRIPTWAIT] = &&pcode_PCD_SCRIPTWAIT;
+		pcodelabels[PCD_SCRIPTWAITDIRECT] = &&pcode_PCD_SCRIPTWAITDIRECT;
+		pcodelabels[PCD_CLEARLINESPECIAL] = &&pcode_PCD_CLEARLINESPECIAL;
+		pcodelabels[PCD_CASEGOTO] = &&pcode_PCD_CASEGOTO;
+		pcodelabels[PCD_BEGINPRINT] = &&pcode_PCD_BEGINPRINT;
+		pcodelabels[PCD_PRINTSTRING] = &&pcode_PCD_PRINTSTRING;
+		pcodelabels[PCD_PRINTLOCALIZED] = &&pcode_PCD_PRINTLOCALIZED;
+		pcodelabels[PCD_PRINTNUMBER] = &&pcode_PCD_PRINTNUMBER;
+		pcodelabels[PCD_PRINTCHARACTER] = &&pcode_PCD_PRINTCHARACTER;
+		pcodelabels[PCD_PRINTFIXED] = &&pcode_PCD_PRINTFIXED;
+		pcodelabels[PCD_PRINTNAME] = &&pcode_PCD_PRINTNAME;
+		pcodelabels[PCD_ENDPRINT] = &&pcode_PCD_ENDPRINT;
+		pcodelabels[PCD_ENDPRINTBOLD] = &&pcode_PCD_ENDPRINTBOLD;
+		pcodelabels[PCD_PLAYERCOUNT] = &&pcode_PCD_PLAYERCOUNT;
+		pcodelabels[PCD_GAMETYPE] = &&pcode_PCD_GAMETYPE;
+		pcodelabels[PCD_GAMESKILL] = &&pcode_PCD_GAMESKILL;
+		pcodelabels[PCD_PLAYERHEALTH] = &&pcode_PCD_PLAYERHEALTH;
+		pcodelabels[PCD_PLAYERARMORPOINTS] = &&pcode_PCD_PLAYERARMORPOINTS;
+		pcodelabels[PCD_PLAYERFRAGS] = &&pcode_PCD_PLAYERFRAGS;
+		pcodelabels[PCD_MUSICCHANGE] = &&pcode_PCD_MUSICCHANGE;
+		pcodelabels[PCD_SINGLEPLAYER] = &&pcode_PCD_SINGLEPLAYER;
+		pcodelabels[PCD_TIMER] = &&pcode_PCD_TIMER;
+		pcodelabels[PCD_SECTORSOUND] = &&pcode_PCD_SECTORSOUND;
+		pcodelabels[PCD_AMBIENTSOUND] = &&pcode_PCD_AMBIENTSOUND;
+		pcodelabels[PCD_LOCALAMBIENTSOUND] = &&pcode_PCD_LOCALAMBIENTSOUND;
+		pcodelabels[PCD_ACTIVATORSOUND] = &&pcode_PCD_ACTIVATORSOUND;
+		pcodelabels[PCD_SOUNDSEQUENCE] = &&pcode_PCD_SOUNDSEQUENCE;
+		pcodelabels[PCD_SETLINETEXTURE] = &&pcode_PCD_SETLINETEXTURE;
+		pcodelabels[PCD_SETLINEBLOCKING] = &&pcode_PCD_SETLINEBLOCKING;
+		pcodelabels[PCD_SETLINEMONSTERBLOCKING] = &&pcode_PCD_SETLINEMONSTERBLOCKING;
+		pcodelabels[PCD_SETLINESPECIAL] = &&pcode_PCD_SETLINESPECIAL;
+		pcodelabels[PCD_SETTHINGSPECIAL] = &&pcode_PCD_SETTHINGSPECIAL;
+		pcodelabels[PCD_THINGSOUND] = &&pcode_PCD_THINGSOUND;
+		pcodelabels[PCD_FIXEDMUL] = &&pcode_PCD_FIXEDMUL;
+		pcodelabels[PCD_FIXEDDIV] = &&pcode_PCD_FIXEDDIV;
+		pcodelabels[PCD_SETGRAVITY] = &&pcode_PCD_SETGRAVITY;
+		pcodelabels[PCD_SETGRAVITYDIRECT] = &&pcode_PCD_SETGRAVITYDIRECT;
+		pcodelabels[PCD_SETAIRCONTROL] = &&pcode_PCD_SETAIRCONTROL;
+		pcodelabels[PCD_SETAIRCONTROLDIRECT] = &&pcode_PCD_SETAIRCONTROLDIRECT;
+		pcodelabels[PCD_SPAWN] = &&pcode_PCD_SPAWN;
+		pcodelabels[PCD_SPAWNDIRECT] = &&pcode_PCD_SPAWNDIRECT;
+		pcodelabels[PCD_SPAWNSPOT] = &&pcode_PCD_SPAWNSPOT;
+		pcodelabels[PCD_SPAWNSPOTDIRECT] = &&pcode_PCD_SPAWNSPOTDIRECT;
+		pcodelabels[PCD_CLEARINVENTORY] = &&pcode_PCD_CLEARINVENTORY;
+		pcodelabels[PCD_GIVEINVENTORY] = &&pcode_PCD_GIVEINVENTORY;
+		pcodelabels[PCD_GIVEINVENTORYDIRECT] = &&pcode_PCD_GIVEINVENTORYDIRECT;
+		pcodelabels[PCD_TAKEINVENTORY] = &&pcode_PCD_TAKEINVENTORY;
+		pcodelabels[PCD_TAKEINVENTORYDIRECT] = &&pcode_PCD_TAKEINVENTORYDIRECT;
+		pcodelabels[PCD_CHECKINVENTORY] = &&pcode_PCD_CHECKINVENTORY;
+		pcodelabels[PCD_CHECKINVENTORYDIRECT] = &&pcode_PCD_CHECKINVENTORYDIRECT;
+		pcodelabels[PCD_SETMUSIC] = &&pcode_PCD_SETMUSIC;
+		pcodelabels[PCD_SETMUSICDIRECT] = &&pcode_PCD_SETMUSICDIRECT;
+		pcodelabels[PCD_LOCALSETMUSIC] = &&pcode_PCD_LOCALSETMUSIC;
+		pcodelabels[PCD_LOCALSETMUSICDIRECT] = &&pcode_PCD_LOCALSETMUSICDIRECT;
+		pcodelabels[PCD_FADETO] = &&pcode_PCD_FADETO;
+		pcodelabels[PCD_FADERANGE] = &&pcode_PCD_FADERANGE;
+		pcodelabels[PCD_CANCELFADE] = &&pcode_PCD_CANCELFADE;
+		pcodelabels[PCD_GETACTORX] = &&pcode_PCD_GETACTORX;
+		pcodelabels[PCD_GETACTORY] = &&pcode_PCD_GETACTORY;
+		pcodelabels[PCD_GETACTORZ] = &&pcode_PCD_GETACTORZ;
+		pcodelabels[PCD_GETACTORANGLE] = &&pcode_PCD_GETACTORANGLE;
+		pcodelabels[PCD_SETFLOORTRIGGER] = &&pcode_PCD_SETFLOORTRIGGER;
+		pcodelabels[PCD_SETCEILINGTRIGGER] = &&pcode_PCD_SETCEILINGTRIGGER;
+		pcodelabels[PCD_SIN] = &&pcode_PCD_SIN;
+		pcodelabels[PCD_COS] = &&pcode_PCD_COS;
+		pcodelabels[PCD_VECTORANGLE] = &&pcode_PCD_VECTORANGLE;
+		pcodelabels[PCD_PLAYERNUMBER] = &&pcode_PCD_PLAYERNUMBER;
+		pcodelabels[PCD_ACTIVATORTID] = &&pcode_PCD_ACTIVATORTID;
+		pcodelabels[PCD_GETCVAR] = &&pcode_PCD_GETCVAR;
+		pcodelabels[PCD_GETLEVELINFO] = &&pcode_PCD_GETLEVELINFO;
+		pcodelabelsready = true;
+	}
+#endif
+
+	if (state == SCRIPT_Running)
+		acs_scriptruns++;
+
 	while (state == SCRIPT_Running)
 	{
 		if (++runaway > 500000)
@@ -2193,57 +2451,62 @@ void DLevelScript::RunScript ()
 		}
 
 		pcd = NEXTBYTE;
+#ifdef ACS_THREADED_DISPATCH
+	dispatch:
+		if ((unsigned int)pcd < PCODE_COMMAND_COUNT && pcodelabels[pcd])
+			goto *pcodelabels[pcd];
+#endif
 		switch (pcd)
 		{
 		default:
 			DPrintf("Unknown P-Code %d in script %d\n", pcd, script);
 			continue;
 			// fall through
-		case PCD_TERMINATE:
+		PCODE(PCD_TERMINATE):
 			state = SCRIPT_PleaseRemove;
-			break;
+			NEXTPCODE;
 
-		case PCD_NOP:
-			break;
+		PCODE(PCD_NOP):
+			NEXTPCODE;
 
-		case PCD_SUSPEND:
+		PCODE(PCD_SUSPEND):
 			state = SCRIPT_Suspended;
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSHNUMBER:
+		PCODE(PCD_PUSHNUMBER):
 			PushToStack(NEXTWORD);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSHBYTE:
+		PCODE(PCD_PUSHBYTE):
 			PushToStack(*(BYTE*)pc);
 			pc = (int*)((BYTE*)pc + 1);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSH2BYTES:
+		PCODE(PCD_PUSH2BYTES):
 			Stack[sp] = ((BYTE*)pc)[0];
 			Stack[sp + 1] = ((BYTE*)pc)[1];
 			sp += 2;
 			pc = (int*)((BYTE*)pc + 2);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSH3BYTES:
+		PCODE(PCD_PUSH3BYTES):
 			Stack[sp] = ((BYTE*)pc)[0];
 			Stack[sp + 1] = ((BYTE*)pc)[1];
 			Stack[sp + 2] = ((BYTE*)pc)[2];
 			sp += 3;
 			pc = (int*)((BYTE*)pc + 3);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSH4BYTES:
+		PCODE(PCD_PUSH4BYTES):
 			Stack[sp] = ((BYTE*)pc)[0];
 			Stack[sp + 1] = ((BYTE*)pc)[1];
 			Stack[sp + 2] = ((BYTE*)pc)[2];
 			Stack[sp + 3] = ((BYTE*)pc)[3];
 			sp += 4;
 			pc = (int*)((BYTE*)pc + 4);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSH5BYTES:
+		PCODE(PCD_PUSH5BYTES):
 			Stack[sp] = ((BYTE*)pc)[0];
 			Stack[sp + 1] = ((BYTE*)pc)[1];
 			Stack[sp + 2] = ((BYTE*)pc)[2];
@@ -2251,127 +2514,127 @@ void DLevelScript::RunScript ()
 			Stack[sp + 4] = ((BYTE*)pc)[4];
 			sp += 5;
 			pc = (int*)((BYTE*)pc + 5);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSHBYTES:
+		PCODE(PCD_PUSHBYTES):
 			temp = *(BYTE*)pc;
 			pc = (int*)((BYTE*)pc + temp + 1);
 			for (temp = -temp; temp; temp++)
 			{
 				PushToStack(*((BYTE*)pc + temp));
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_DUP:
+		PCODE(PCD_DUP):
 			Stack[sp] = Stack[sp - 1];
 			sp++;
-			break;
+			NEXTPCODE;
 
-		case PCD_SWAP:
+		PCODE(PCD_SWAP):
 			std::swap(Stack[sp - 2], Stack[sp - 1]);
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC1:
+		PCODE(PCD_LSPEC1):
 			ActivateLineSpecial(NEXTBYTE, activationline, activator,
 						STACK(1), 0, 0, 0, 0);
 			sp -= 1;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC2:
+		PCODE(PCD_LSPEC2):
 			ActivateLineSpecial(NEXTBYTE, activationline, activator,
 						STACK(2), STACK(1), 0, 0, 0);
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC3:
+		PCODE(PCD_LSPEC3):
 			ActivateLineSpecial(NEXTBYTE, activationline, activator,
 						STACK(3), STACK(2), STACK(1), 0, 0);
 			sp -= 3;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC4:
+		PCODE(PCD_LSPEC4):
 			ActivateLineSpecial(NEXTBYTE, activationline, activator,
 						STACK(4), STACK(3), STACK(2),
 						STACK(1), 0);
 			sp -= 4;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC5:
+		PCODE(PCD_LSPEC5):
 			ActivateLineSpecial(NEXTBYTE, activationline, activator,
 						STACK(5), STACK(4), STACK(3),
 						STACK(2), STACK(1));
 			sp -= 5;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC1DIRECT:
+		PCODE(PCD_LSPEC1DIRECT):
 			temp = NEXTBYTE;
 			ActivateLineSpecial(temp, activationline, activator,
 						pc[0], 0, 0, 0, 0);
 			pc += 1;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC2DIRECT:
+		PCODE(PCD_LSPEC2DIRECT):
 			temp = NEXTBYTE;
 			ActivateLineSpecial(temp, activationline, activator,
 						pc[0], pc[1], 0, 0, 0);
 			pc += 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC3DIRECT:
+		PCODE(PCD_LSPEC3DIRECT):
 			temp = NEXTBYTE;
 			ActivateLineSpecial(temp, activationline, activator,
 						pc[0], pc[1], pc[2], 0, 0);
 			pc += 3;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC4DIRECT:
+		PCODE(PCD_LSPEC4DIRECT):
 			temp = NEXTBYTE;
 			ActivateLineSpecial(temp, activationline, activator,
 						pc[0], pc[1], pc[2], pc[3], 0);
 			pc += 4;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC5DIRECT:
+		PCODE(PCD_LSPEC5DIRECT):
 			temp = NEXTBYTE;
 			ActivateLineSpecial(temp, activationline, activator,
 						pc[0], pc[1], pc[2], pc[3], pc[4]);
 			pc += 5;
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC1DIRECTB:
+		PCODE(PCD_LSPEC1DIRECTB):
 			ActivateLineSpecial(((BYTE *)pc)[0], activationline, activator,
 				((BYTE *)pc)[1], 0, 0, 0, 0);
 			pc = (int *)((BYTE *)pc + 2);
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC2DIRECTB:
+		PCODE(PCD_LSPEC2DIRECTB):
 			ActivateLineSpecial(((BYTE *)pc)[0], activationline, activator,
 				((BYTE *)pc)[1], ((BYTE *)pc)[2], 0, 0, 0);
 			pc = (int *)((BYTE *)pc + 3);
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC3DIRECTB:
+		PCODE(PCD_LSPEC3DIRECTB):
 			ActivateLineSpecial(((BYTE *)pc)[0], activationline, activator,
 				((BYTE *)pc)[1], ((BYTE *)pc)[2], ((BYTE *)pc)[3], 0, 0);
 			pc = (int *)((BYTE *)pc + 4);
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC4DIRECTB:
+		PCODE(PCD_LSPEC4DIRECTB):
 			ActivateLineSpecial(((BYTE *)pc)[0], activationline, activator,
 				((BYTE *)pc)[1], ((BYTE *)pc)[2], ((BYTE *)pc)[3],
 				((BYTE *)pc)[4], 0);
 			pc = (int *)((BYTE *)pc + 5);
-			break;
+			NEXTPCODE;
 
-		case PCD_LSPEC5DIRECTB:
+		PCODE(PCD_LSPEC5DIRECTB):
 			ActivateLineSpecial(((BYTE *)pc)[0], activationline, activator,
 				((BYTE *)pc)[1], ((BYTE *)pc)[2], ((BYTE *)pc)[3],
 				((BYTE *)pc)[4], ((BYTE *)pc)[5]);
 			pc = (int *)((BYTE *)pc + 6);
-			break;
+			NEXTPCODE;
 
-		case PCD_CALL:
-		case PCD_CALLDISCARD: {
+		PCODE(PCD_CALL):
+		PCODE(PCD_CALLDISCARD): {
 			int funcnum;
 			int i;
 			ScriptFunction* func;
@@ -2383,13 +2646,13 @@ void DLevelScript::RunScript ()
 				Printf(PRINT_HIGH, "Function %d in script %d out of range\n", funcnum,
 				       script);
 				state = SCRIPT_PleaseRemove;
-				break;
+				NEXTPCODE;
 			}
 			if (sp + func->LocalCount + 32 > STACK_SIZE)
 			{ // 32 is the margin for the function's working space
 				Printf(PRINT_HIGH, "Out of stack space in script %d\n", script);
 				state = SCRIPT_PleaseRemove;
-				break;
+				NEXTPCODE;
 			}
 			// The function's first argument is also its first local variable.
 			locals = &Stack[sp - func->ArgCount];
@@ -2406,10 +2669,10 @@ void DLevelScript::RunScript ()
 			pc = level.behavior->Ofs2PC(func->Address);
 			activeFunction = func;
 		}
-		break;
+		NEXTPCODE;
 
-		case PCD_RETURNVOID:
-		case PCD_RETURNVAL: {
+		PCODE(PCD_RETURNVOID):
+		PCODE(PCD_RETURNVAL): {
 			int value;
 			CallReturn* retState;
 
@@ -2440,24 +2703,24 @@ void DLevelScript::RunScript ()
 				Stack[sp++] = value;
 			}
 		}
-		break;
+		NEXTPCODE;
 
-		case PCD_ADD:
+		PCODE(PCD_ADD):
 			STACK(2) = STACK(2) + STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_SUBTRACT:
+		PCODE(PCD_SUBTRACT):
 			STACK(2) = STACK(2) - STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_MULTIPLY:
+		PCODE(PCD_MULTIPLY):
 			STACK(2) = STACK(2) * STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_DIVIDE:
+		PCODE(PCD_DIVIDE):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_DivideBy0;
@@ -2467,9 +2730,9 @@ void DLevelScript::RunScript ()
 				STACK(2) = STACK(2) / STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_MODULUS:
+		PCODE(PCD_MODULUS):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_ModulusBy0;
@@ -2479,171 +2742,171 @@ void DLevelScript::RunScript ()
 				STACK(2) = STACK(2) % STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_EQ:
+		PCODE(PCD_EQ):
 			STACK(2) = (STACK(2) == STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_NE:
+		PCODE(PCD_NE):
 			STACK(2) = (STACK(2) != STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_LT:
+		PCODE(PCD_LT):
 			STACK(2) = (STACK(2) < STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_GT:
+		PCODE(PCD_GT):
 			STACK(2) = (STACK(2) > STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_LE:
+		PCODE(PCD_LE):
 			STACK(2) = (STACK(2) <= STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_GE:
+		PCODE(PCD_GE):
 			STACK(2) = (STACK(2) >= STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ASSIGNSCRIPTVAR:
+		PCODE(PCD_ASSIGNSCRIPTVAR):
 			locals[NEXTBYTE] = STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ASSIGNMAPVAR:
+		PCODE(PCD_ASSIGNMAPVAR):
 			level.vars[NEXTBYTE] = STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ASSIGNWORLDVAR:
+		PCODE(PCD_ASSIGNWORLDVAR):
 			ACS_WorldVars[NEXTBYTE] = STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ASSIGNGLOBALVAR:
+		PCODE(PCD_ASSIGNGLOBALVAR):
 			ACS_GlobalVars[NEXTBYTE] = STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ASSIGNMAPARRAY:
+		PCODE(PCD_ASSIGNMAPARRAY):
 			level.behavior->SetArrayVal(ACS_WorldVars[NEXTBYTE], STACK(2), STACK(1));
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSHSCRIPTVAR:
+		PCODE(PCD_PUSHSCRIPTVAR):
 			PushToStack(locals[NEXTBYTE]);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSHMAPVAR:
+		PCODE(PCD_PUSHMAPVAR):
 			PushToStack(level.vars[NEXTBYTE]);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSHWORLDVAR:
+		PCODE(PCD_PUSHWORLDVAR):
 			PushToStack(ACS_WorldVars[NEXTBYTE]);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSHGLOBALVAR:
+		PCODE(PCD_PUSHGLOBALVAR):
 			PushToStack(ACS_GlobalVars[NEXTBYTE]);
-			break;
+			NEXTPCODE;
 
-		case PCD_PUSHMAPARRAY:
+		PCODE(PCD_PUSHMAPARRAY):
 			STACK(1) = level.behavior->GetArrayVal(level.vars[NEXTBYTE], STACK(1));
-			break;
+			NEXTPCODE;
 
-		case PCD_ADDSCRIPTVAR:
+		PCODE(PCD_ADDSCRIPTVAR):
 			locals[NEXTBYTE] += STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ADDMAPVAR:
+		PCODE(PCD_ADDMAPVAR):
 			level.vars[NEXTBYTE] += STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ADDWORLDVAR:
+		PCODE(PCD_ADDWORLDVAR):
 			ACS_WorldVars[NEXTBYTE] += STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ADDGLOBALVAR:
+		PCODE(PCD_ADDGLOBALVAR):
 			ACS_GlobalVars[NEXTBYTE] += STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ADDMAPARRAY: {
+		PCODE(PCD_ADDMAPARRAY): {
 			int a = ACS_WorldVars[NEXTBYTE];
 			int i = STACK(2);
 			level.behavior->SetArrayVal(a, i,
 			                            level.behavior->GetArrayVal(a, i) + STACK(1));
 			sp -= 2;
 		}
-		break;
+		NEXTPCODE;
 
-		case PCD_SUBSCRIPTVAR:
+		PCODE(PCD_SUBSCRIPTVAR):
 			locals[NEXTBYTE] -= STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_SUBMAPVAR:
+		PCODE(PCD_SUBMAPVAR):
 			level.vars[NEXTBYTE] -= STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_SUBWORLDVAR:
+		PCODE(PCD_SUBWORLDVAR):
 			ACS_WorldVars[NEXTBYTE] -= STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_SUBGLOBALVAR:
+		PCODE(PCD_SUBGLOBALVAR):
 			ACS_GlobalVars[NEXTBYTE] -= STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_SUBMAPARRAY: {
+		PCODE(PCD_SUBMAPARRAY): {
 			int a = ACS_WorldVars[NEXTBYTE];
 			int i = STACK(2);
 			level.behavior->SetArrayVal(a, i,
 			                            level.behavior->GetArrayVal(a, i) - STACK(1));
 			sp -= 2;
 		}
-		break;
+		NEXTPCODE;
 
-		case PCD_MULSCRIPTVAR:
+		PCODE(PCD_MULSCRIPTVAR):
 			locals[NEXTBYTE] *= STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_MULMAPVAR:
+		PCODE(PCD_MULMAPVAR):
 			level.vars[NEXTBYTE] *= STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_MULWORLDVAR:
+		PCODE(PCD_MULWORLDVAR):
 			ACS_WorldVars[NEXTBYTE] *= STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_MULGLOBALVAR:
+		PCODE(PCD_MULGLOBALVAR):
 			ACS_GlobalVars[NEXTBYTE] *= STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_MULMAPARRAY: {
+		PCODE(PCD_MULMAPARRAY): {
 			int a = ACS_WorldVars[NEXTBYTE];
 			int i = STACK(2);
 			level.behavior->SetArrayVal(a, i,
 			                            level.behavior->GetArrayVal(a, i) * STACK(1));
 			sp -= 2;
 		}
-		break;
+		NEXTPCODE;
 
-		case PCD_DIVSCRIPTVAR:
+		PCODE(PCD_DIVSCRIPTVAR):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_DivideBy0;
@@ -2653,9 +2916,9 @@ void DLevelScript::RunScript ()
 				locals[NEXTBYTE] /= STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_DIVMAPVAR:
+		PCODE(PCD_DIVMAPVAR):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_DivideBy0;
@@ -2665,9 +2928,9 @@ void DLevelScript::RunScript ()
 				level.vars[NEXTBYTE] /= STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_DIVWORLDVAR:
+		PCODE(PCD_DIVWORLDVAR):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_DivideBy0;
@@ -2677,9 +2940,9 @@ void DLevelScript::RunScript ()
 				ACS_WorldVars[NEXTBYTE] /= STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_DIVGLOBALVAR:
+		PCODE(PCD_DIVGLOBALVAR):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_DivideBy0;
@@ -2689,9 +2952,9 @@ void DLevelScript::RunScript ()
 				ACS_GlobalVars[NEXTBYTE] /= STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_DIVMAPARRAY:
+		PCODE(PCD_DIVMAPARRAY):
 			{
 				if (STACK(1) == 0)
 				{
@@ -2706,9 +2969,9 @@ void DLevelScript::RunScript ()
 				    sp -= 2;
 			    }
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_MODSCRIPTVAR:
+		PCODE(PCD_MODSCRIPTVAR):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_ModulusBy0;
@@ -2718,9 +2981,9 @@ void DLevelScript::RunScript ()
 				locals[NEXTBYTE] %= STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_MODMAPVAR:
+		PCODE(PCD_MODMAPVAR):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_ModulusBy0;
@@ -2730,9 +2993,9 @@ void DLevelScript::RunScript ()
 				level.vars[NEXTBYTE] %= STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_MODWORLDVAR:
+		PCODE(PCD_MODWORLDVAR):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_ModulusBy0;
@@ -2742,9 +3005,9 @@ void DLevelScript::RunScript ()
 				ACS_WorldVars[NEXTBYTE] %= STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_MODGLOBALVAR:
+		PCODE(PCD_MODGLOBALVAR):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_ModulusBy0;
@@ -2754,9 +3017,9 @@ void DLevelScript::RunScript ()
 				ACS_GlobalVars[NEXTBYTE] %= STACK(1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_MODMAPARRAY:
+		PCODE(PCD_MODMAPARRAY):
 			if (STACK(1) == 0)
 			{
 				state = SCRIPT_ModulusBy0;
@@ -2769,25 +3032,25 @@ void DLevelScript::RunScript ()
 											level.behavior->GetArrayVal(a, i) % STACK(1));
 				sp -= 2;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_INCSCRIPTVAR:
+		PCODE(PCD_INCSCRIPTVAR):
 			++locals[NEXTBYTE];
-			break;
+			NEXTPCODE;
 
-		case PCD_INCMAPVAR:
+		PCODE(PCD_INCMAPVAR):
 			++level.vars[NEXTBYTE];
-			break;
+			NEXTPCODE;
 
-		case PCD_INCWORLDVAR:
+		PCODE(PCD_INCWORLDVAR):
 			++ACS_WorldVars[NEXTBYTE];
-			break;
+			NEXTPCODE;
 
-		case PCD_INCGLOBALVAR:
+		PCODE(PCD_INCGLOBALVAR):
 			++ACS_GlobalVars[NEXTBYTE];
-			break;
+			NEXTPCODE;
 
-		case PCD_INCMAPARRAY:
+		PCODE(PCD_INCMAPARRAY):
 			{
 				int a = ACS_WorldVars[NEXTBYTE];
 				int i = STACK(2);
@@ -2795,25 +3058,25 @@ void DLevelScript::RunScript ()
 					level.behavior->GetArrayVal (a, i) + 1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_DECSCRIPTVAR:
+		PCODE(PCD_DECSCRIPTVAR):
 			--locals[NEXTBYTE];
-			break;
+			NEXTPCODE;
 
-		case PCD_DECMAPVAR:
+		PCODE(PCD_DECMAPVAR):
 			--level.vars[NEXTBYTE];
-			break;
+			NEXTPCODE;
 
-		case PCD_DECWORLDVAR:
+		PCODE(PCD_DECWORLDVAR):
 			--ACS_WorldVars[NEXTBYTE];
-			break;
+			NEXTPCODE;
 
-		case PCD_DECGLOBALVAR:
+		PCODE(PCD_DECGLOBALVAR):
 			--ACS_GlobalVars[NEXTBYTE];
-			break;
+			NEXTPCODE;
 
-		case PCD_DECMAPARRAY:
+		PCODE(PCD_DECMAPARRAY):
 			{
 				int a = ACS_WorldVars[NEXTBYTE];
 				int i = STACK(2);
@@ -2821,168 +3084,172 @@ void DLevelScript::RunScript ()
 					level.behavior->GetArrayVal (a, i) - 1);
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_GOTO:
+		PCODE(PCD_GOTO):
 			pc = level.behavior->Ofs2PC (*pc);
-			break;
+			NEXTPCODE;
 
-		case PCD_IFGOTO:
+		PCODE(PCD_IFGOTO):
 			if (STACK(1))
 				pc = level.behavior->Ofs2PC (*pc);
 			else
 				pc++;
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_DROP:
+		PCODE(PCD_DROP):
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_DELAY:
+		PCODE(PCD_DELAY):
 			state = SCRIPT_Delayed;
 			statedata = STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_DELAYDIRECT:
+		PCODE(PCD_DELAYDIRECT):
 			state = SCRIPT_Delayed;
 			statedata = NEXTWORD;
-			break;
+			NEXTPCODE;
 
-		case PCD_DELAYDIRECTB:
+		PCODE(PCD_DELAYDIRECTB):
 			state = SCRIPT_Delayed;
 			statedata = *(BYTE *)pc;
 			pc = (int *)((BYTE *)pc + 1);
-			break;
+			NEXTPCODE;
 
-		case PCD_RANDOM:
+		PCODE(PCD_RANDOM):
 			STACK(2) = Random (STACK(2), STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_RANDOMDIRECT:
+		PCODE(PCD_RANDOMDIRECT):
 			PushToStack (Random (pc[0], pc[1]));
 			pc += 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_RANDOMDIRECTB:
+		PCODE(PCD_RANDOMDIRECTB):
 			PushToStack (Random (((BYTE *)pc)[0], ((BYTE *)pc)[1]));
 			pc = (int *)((BYTE *)pc + 2);
-			break;
+			NEXTPCODE;
 
-		case PCD_THINGCOUNT:
+		PCODE(PCD_THINGCOUNT):
 			STACK(2) = ThingCount (STACK(2), STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_THINGCOUNTDIRECT:
+		PCODE(PCD_THINGCOUNTDIRECT):
 			PushToStack (ThingCount (pc[0], pc[1]));
 			pc += 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_TAGWAIT:
+		PCODE(PCD_TAGWAIT):
 			state = SCRIPT_TagWait;
+			wakecount = waitwakecount - 1;
 			statedata = STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_TAGWAITDIRECT:
+		PCODE(PCD_TAGWAITDIRECT):
 			state = SCRIPT_TagWait;
+			wakecount = waitwakecount - 1;
 			statedata = NEXTWORD;
-			break;
+			NEXTPCODE;
 
-		case PCD_POLYWAIT:
+		PCODE(PCD_POLYWAIT):
 			state = SCRIPT_PolyWait;
+			wakecount = waitwakecount - 1;
 			statedata = STACK(1);
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_POLYWAITDIRECT:
+		PCODE(PCD_POLYWAITDIRECT):
 			state = SCRIPT_PolyWait;
+			wakecount = waitwakecount - 1;
 			statedata = NEXTWORD;
-			break;
+			NEXTPCODE;
 
-		case PCD_CHANGEFLOOR:
+		PCODE(PCD_CHANGEFLOOR):
 			ChangeFlat (STACK(2), STACK(1), 0);
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_CHANGEFLOORDIRECT:
+		PCODE(PCD_CHANGEFLOORDIRECT):
 			ChangeFlat (pc[0], pc[1], 0);
 			pc += 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_CHANGECEILING:
+		PCODE(PCD_CHANGECEILING):
 			ChangeFlat (STACK(2), STACK(1), 1);
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_CHANGECEILINGDIRECT:
+		PCODE(PCD_CHANGECEILINGDIRECT):
 			ChangeFlat (pc[0], pc[1], 1);
 			pc += 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_RESTART:
+		PCODE(PCD_RESTART):
 			pc = level.behavior->FindScript (script);
-			break;
+			NEXTPCODE;
 
-		case PCD_ANDLOGICAL:
+		PCODE(PCD_ANDLOGICAL):
 			STACK(2) = (STACK(2) && STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ORLOGICAL:
+		PCODE(PCD_ORLOGICAL):
 			STACK(2) = (STACK(2) || STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ANDBITWISE:
+		PCODE(PCD_ANDBITWISE):
 			STACK(2) = (STACK(2) & STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_ORBITWISE:
+		PCODE(PCD_ORBITWISE):
 			STACK(2) = (STACK(2) | STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_EORBITWISE:
+		PCODE(PCD_EORBITWISE):
 			STACK(2) = (STACK(2) ^ STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_NEGATELOGICAL:
+		PCODE(PCD_NEGATELOGICAL):
 			STACK(1) = !STACK(1);
-			break;
+			NEXTPCODE;
 
-		case PCD_LSHIFT:
+		PCODE(PCD_LSHIFT):
 			STACK(2) = (STACK(2) << STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_RSHIFT:
+		PCODE(PCD_RSHIFT):
 			STACK(2) = (STACK(2) >> STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_UNARYMINUS:
+		PCODE(PCD_UNARYMINUS):
 			STACK(1) = -STACK(1);
-			break;
+			NEXTPCODE;
 
-		case PCD_IFNOTGOTO:
+		PCODE(PCD_IFNOTGOTO):
 			if (!STACK(1))
 				pc = level.behavior->Ofs2PC (*pc);
 			else
 				pc++;
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_LINESIDE:
+		PCODE(PCD_LINESIDE):
 			PushToStack (lineSide);
-			break;
+			NEXTPCODE;
 
-		case PCD_SCRIPTWAIT:
+		PCODE(PCD_SCRIPTWAIT):
 			statedata = STACK(1);
 			if (controller->RunningScripts[statedata])
 				state = SCRIPT_ScriptWait;
@@ -2990,20 +3257,20 @@ void DLevelScript::RunScript ()
 				state = SCRIPT_ScriptWaitPre;
 			sp--;
 			PutLast ();
-			break;
+			NEXTPCODE;
 
-		case PCD_SCRIPTWAITDIRECT:
+		PCODE(PCD_SCRIPTWAITDIRECT):
 			state = SCRIPT_ScriptWait;
 			statedata = NEXTWORD;
 			PutLast ();
-			break;
+			NEXTPCODE;
 
-		case PCD_CLEARLINESPECIAL:
+		PCODE(PCD_CLEARLINESPECIAL):
 			if (activationline)
 				activationline->special = 0;
-			break;
+			NEXTPCODE;
 
-		case PCD_CASEGOTO:
+		PCODE(PCD_CASEGOTO):
 			if (STACK(1) == NEXTWORD)
 			{
 				pc = level.behavior->Ofs2PC (*pc);
@@ -3013,15 +3280,15 @@ void DLevelScript::RunScript ()
 			{
 				pc++;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_BEGINPRINT:
+		PCODE(PCD_BEGINPRINT):
 			workwhere = work;
 			work[0] = 0;
-			break;
+			NEXTPCODE;
 
-		case PCD_PRINTSTRING:
-		case PCD_PRINTLOCALIZED:
+		PCODE(PCD_PRINTSTRING):
+		PCODE(PCD_PRINTLOCALIZED):
 			lookup = (pcd == PCD_PRINTSTRING ?
 				level.behavior->LookupString (STACK(1)) :
 				level.behavior->LocalizeString (STACK(1)));
@@ -3030,28 +3297,28 @@ void DLevelScript::RunScript ()
 				workwhere += sprintf (workwhere, "%s", lookup);
 			}
 			--sp;
-			break;
+			NEXTPCODE;
 
-		case PCD_PRINTNUMBER:
+		PCODE(PCD_PRINTNUMBER):
 			workwhere += sprintf (workwhere, "%d", STACK(1));
 			--sp;
-			break;
+			NEXTPCODE;
 
-		case PCD_PRINTCHARACTER:
+		PCODE(PCD_PRINTCHARACTER):
 			workwhere[0] = STACK(1);
 			workwhere[1] = 0;
 			workwhere++;
 			--sp;
-			break;
+			NEXTPCODE;
 
-		case PCD_PRINTFIXED:
+		PCODE(PCD_PRINTFIXED):
 			workwhere += sprintf (workwhere, "%g", FIXED2FLOAT(STACK(1)));
 			--sp;
-			break;
+			NEXTPCODE;
 
 		// [BC] Print activator's name
 		// [RH] Fancied up a bit
-		case PCD_PRINTNAME:
+		PCODE(PCD_PRINTNAME):
 			{
 				player_t *player = NULL;
 
@@ -3071,7 +3338,7 @@ void DLevelScript::RunScript ()
 					workwhere += sprintf (workwhere, "Player %d\n",
 						STACK(1));
 					sp--;
-					break;
+					NEXTPCODE;
 				}
 				if (player)
 				{
@@ -3089,10 +3356,10 @@ void DLevelScript::RunScript ()
 				}
 				sp--;
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_ENDPRINT:
-		case PCD_ENDPRINTBOLD:
+		PCODE(PCD_ENDPRINT):
+		PCODE(PCD_ENDPRINTBOLD):
 		//case PCD_MOREHUDMESSAGE:
 			strbin (work);
 			if (pcd != PCD_MOREHUDMESSAGE)
@@ -3103,7 +3370,7 @@ void DLevelScript::RunScript ()
 			{
 //				optstart = -1;
 			}
-			break;
+			NEXTPCODE;
 
 		/*case PCD_OPTHUDMESSAGE:
 			optstart = sp;
@@ -3163,11 +3430,11 @@ void DLevelScript::RunScript ()
 			pc++;
 			break;
         */
-		case PCD_PLAYERCOUNT:
+		PCODE(PCD_PLAYERCOUNT):
 			PushToStack (CountPlayers ());
-			break;
+			NEXTPCODE;
 
-		case PCD_GAMETYPE:
+		PCODE(PCD_GAMETYPE):
 		    if (sv_gametype == 3)
                 PushToStack (GAME_NET_CTF);
             else if (sv_gametype == 2)
@@ -3178,97 +3445,97 @@ void DLevelScript::RunScript ()
 				PushToStack (GAME_NET_COOPERATIVE);
 			else
 				PushToStack (GAME_SINGLE_PLAYER);
-			break;
+			NEXTPCODE;
 
-		case PCD_GAMESKILL:
+		PCODE(PCD_GAMESKILL):
 			PushToStack (sv_skill);
-			break;
+			NEXTPCODE;
 
 // [BC] Start ST PCD's
-		case PCD_PLAYERHEALTH:
+		PCODE(PCD_PLAYERHEALTH):
 			if (activator)
 				PushToStack (activator->health);
 			else
 				PushToStack (0);
-			break;
+			NEXTPCODE;
 
-		case PCD_PLAYERARMORPOINTS:
+		PCODE(PCD_PLAYERARMORPOINTS):
 			if (activator && activator->player)
 				PushToStack (activator->player->armorpoints);
 			else
 				PushToStack (0);
-			break;
+			NEXTPCODE;
 
-		case PCD_PLAYERFRAGS:
+		PCODE(PCD_PLAYERFRAGS):
 			if (activator && activator->player)
 				PushToStack (activator->player->fragcount);
 			else
 				PushToStack (0);
-			break;
+			NEXTPCODE;
 
-		case PCD_MUSICCHANGE:
+		PCODE(PCD_MUSICCHANGE):
 			ChangeMusic(pcd, activator, STACK(2), STACK(1));
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_SINGLEPLAYER:
+		PCODE(PCD_SINGLEPLAYER):
 			PushToStack (!multiplayer);
-			break;
+			NEXTPCODE;
 // [BC] End ST PCD's
 
-		case PCD_TIMER:
+		PCODE(PCD_TIMER):
 			PushToStack (level.time);
-			break;
+			NEXTPCODE;
 
-		case PCD_SECTORSOUND:
+		PCODE(PCD_SECTORSOUND):
 			if (activationline)
 				StartSectorSound(pcd, activationline->frontsector, CHAN_BODY, STACK(2), STACK(1), ATTN_NORM);
 			else
 				StartSound(pcd, NULL, CHAN_BODY, STACK(2), STACK(1), ATTN_NORM);
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_AMBIENTSOUND:
+		PCODE(PCD_AMBIENTSOUND):
 			StartSound(pcd, activator, CHAN_AUTO, STACK(2), STACK(1), ATTN_NONE);
-			break;
+			NEXTPCODE;
 
-		case PCD_LOCALAMBIENTSOUND:
+		PCODE(PCD_LOCALAMBIENTSOUND):
 			StartSound(pcd, activator, CHAN_AUTO, STACK(2), STACK(1), ATTN_NONE);
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_ACTIVATORSOUND:
+		PCODE(PCD_ACTIVATORSOUND):
 			StartThingSound(pcd, activator, CHAN_AUTO, STACK(2), STACK(1), ATTN_NORM);
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_SOUNDSEQUENCE:
+		PCODE(PCD_SOUNDSEQUENCE):
 			if (activationline)
 				StartSoundSequence(activationline->frontsector, STACK(1));			
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETLINETEXTURE:
+		PCODE(PCD_SETLINETEXTURE):
 			SetLineTexture (STACK(4), STACK(3), STACK(2), STACK(1));
 			sp -= 4;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETLINEBLOCKING:
+		PCODE(PCD_SETLINEBLOCKING):
 			SetLineBlocking(STACK(2), STACK(1));
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETLINEMONSTERBLOCKING:
+		PCODE(PCD_SETLINEMONSTERBLOCKING):
 			SetLineMonsterBlocking(STACK(2), STACK(1));
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETLINESPECIAL:
+		PCODE(PCD_SETLINESPECIAL):
 			SetLineSpecial(STACK(7), STACK(6), STACK(5), STACK(4), STACK(3), STACK(2), STACK(1));
 			sp -= 7;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETTHINGSPECIAL:
+		PCODE(PCD_SETTHINGSPECIAL):
 		{				
 			FActorIterator iterator (STACK(7));
 			AActor *actor;
@@ -3277,9 +3544,9 @@ void DLevelScript::RunScript ()
 				SetThingSpecial(actor, STACK(6), STACK(5), STACK(4), STACK(3), STACK(2), STACK(1));
 			sp -= 7;
 		}
-			break;
+			NEXTPCODE;
 
-		case PCD_THINGSOUND:
+		PCODE(PCD_THINGSOUND):
 		{
 			FActorIterator iterator(STACK(3));
 			AActor *spot;
@@ -3287,135 +3554,135 @@ void DLevelScript::RunScript ()
 				StartThingSound(pcd, spot, CHAN_BODY, STACK(2), STACK(1), ATTN_NORM);
 			sp -= 3;
 		}
-			break;
+			NEXTPCODE;
 
-		case PCD_FIXEDMUL:
+		PCODE(PCD_FIXEDMUL):
 			STACK(2) = FixedMul (STACK(2), STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_FIXEDDIV:
+		PCODE(PCD_FIXEDDIV):
 			STACK(2) = FixedDiv (STACK(2), STACK(1));
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETGRAVITY:
+		PCODE(PCD_SETGRAVITY):
 			level.gravity = (float)STACK(1) / 65536.f;
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETGRAVITYDIRECT:
+		PCODE(PCD_SETGRAVITYDIRECT):
 			level.gravity = (float)pc[0] / 65536.f;
 			pc++;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETAIRCONTROL:
+		PCODE(PCD_SETAIRCONTROL):
 			level.aircontrol = STACK(1);
 			sp--;
 			G_AirControlChanged ();
-			break;
+			NEXTPCODE;
 
-		case PCD_SETAIRCONTROLDIRECT:
+		PCODE(PCD_SETAIRCONTROLDIRECT):
 			level.aircontrol = pc[0];
 			pc++;
 			G_AirControlChanged ();
-			break;
+			NEXTPCODE;
 
-		case PCD_SPAWN:
+		PCODE(PCD_SPAWN):
 			STACK(6) = DoSpawn (STACK(6), STACK(5), STACK(4), STACK(3), STACK(2), STACK(1));
 			sp -= 5;
-			break;
+			NEXTPCODE;
 
-		case PCD_SPAWNDIRECT:
+		PCODE(PCD_SPAWNDIRECT):
 			PushToStack (DoSpawn (pc[0], pc[1], pc[2], pc[3], pc[4], pc[5]));
 			pc += 6;
-			break;
+			NEXTPCODE;
 
-		case PCD_SPAWNSPOT:
+		PCODE(PCD_SPAWNSPOT):
 			STACK(4) = DoSpawnSpot (STACK(4), STACK(3), STACK(2), STACK(1));
 			sp -= 3;
-			break;
+			NEXTPCODE;
 
-		case PCD_SPAWNSPOTDIRECT:
+		PCODE(PCD_SPAWNSPOTDIRECT):
 			PushToStack (DoSpawnSpot (pc[0], pc[1], pc[2], pc[3]));
 			pc += 4;
-			break;
+			NEXTPCODE;
 
-		case PCD_CLEARINVENTORY:
+		PCODE(PCD_CLEARINVENTORY):
 			ClearInventory (activator);
-			break;
+			NEXTPCODE;
 
-		case PCD_GIVEINVENTORY:
+		PCODE(PCD_GIVEINVENTORY):
 			GiveInventory (activator, level.behavior->LookupString (STACK(2)), STACK(1));
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_GIVEINVENTORYDIRECT:
+		PCODE(PCD_GIVEINVENTORYDIRECT):
 			GiveInventory (activator, level.behavior->LookupString (pc[0]), pc[1]);
 			pc += 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_TAKEINVENTORY:
+		PCODE(PCD_TAKEINVENTORY):
 			TakeInventory (activator, level.behavior->LookupString (STACK(2)), STACK(1));
 			sp -= 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_TAKEINVENTORYDIRECT:
+		PCODE(PCD_TAKEINVENTORYDIRECT):
 			TakeInventory (activator, level.behavior->LookupString (pc[0]), pc[1]);
 			pc += 2;
-			break;
+			NEXTPCODE;
 
-		case PCD_CHECKINVENTORY:
+		PCODE(PCD_CHECKINVENTORY):
 			STACK(1) = CheckInventory (activator, level.behavior->LookupString (STACK(1)));
-			break;
+			NEXTPCODE;
 
-		case PCD_CHECKINVENTORYDIRECT:
+		PCODE(PCD_CHECKINVENTORYDIRECT):
 			PushToStack (CheckInventory (activator, level.behavior->LookupString (pc[0])));
 			pc += 1;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETMUSIC:
+		PCODE(PCD_SETMUSIC):
 			ChangeMusic(pcd, NULL, STACK(3), STACK(2));
 			sp -= 3;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETMUSICDIRECT:
+		PCODE(PCD_SETMUSICDIRECT):
 			ChangeMusic(pcd, NULL, pc[0], pc[1]);
 			pc += 3;
-			break;
+			NEXTPCODE;
 
-		case PCD_LOCALSETMUSIC:
+		PCODE(PCD_LOCALSETMUSIC):
 			ChangeMusic(pcd, activator, STACK(3), STACK(2));
 			sp -= 3;
-			break;
+			NEXTPCODE;
 
-		case PCD_LOCALSETMUSICDIRECT:
+		PCODE(PCD_LOCALSETMUSICDIRECT):
 			ChangeMusic(pcd, activator, pc[0], pc[1]);
 			pc += 3;
-			break;
+			NEXTPCODE;
 
-		case PCD_FADETO:
+		PCODE(PCD_FADETO):
 			DoFadeTo (activator, STACK(5), STACK(4), STACK(3), STACK(2), STACK(1));
 			sp -= 5;
-			break;
+			NEXTPCODE;
 
-		case PCD_FADERANGE:
+		PCODE(PCD_FADERANGE):
 			DoFadeRange (activator, STACK(9), STACK(8), STACK(7), STACK(6),
 						 STACK(5), STACK(4), STACK(3), STACK(2), STACK(1));
 			sp -= 9;
-			break;
+			NEXTPCODE;
 
-		case PCD_CANCELFADE:
+		PCODE(PCD_CANCELFADE):
 			CancelFade(activator);
-			break;
+			NEXTPCODE;
 
 		/*case PCD_PLAYMOVIE:
 			STACK(1) = I_PlayMovie (level.behavior->LookupString (STACK(1)));
 			break;
         */
-		case PCD_GETACTORX:
-		case PCD_GETACTORY:
-		case PCD_GETACTORZ:
+		PCODE(PCD_GETACTORX):
+		PCODE(PCD_GETACTORY):
+		PCODE(PCD_GETACTORZ):
 			{
 			    AActor *actor = SingleActorFromTID(STACK(1), activator);
 
@@ -3428,9 +3695,9 @@ void DLevelScript::RunScript ()
 					STACK(1) = (&actor->x)[pcd - PCD_GETACTORX];
 				}
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_GETACTORANGLE:
+		PCODE(PCD_GETACTORANGLE):
 			{
 				AActor *actor = SingleActorFromTID (STACK(1), activator);
 
@@ -3443,19 +3710,19 @@ void DLevelScript::RunScript ()
 					STACK(1) = actor->angle >> FRACBITS;
 				}
 			}
-			break;
+			NEXTPCODE;
 
-		case PCD_SETFLOORTRIGGER:
+		PCODE(PCD_SETFLOORTRIGGER):
 			new DPlaneWatcher (activator, activationline, lineSide, false, STACK(8),
 				STACK(7), STACK(6), STACK(5), STACK(4), STACK(3), STACK(2), STACK(1));
 			sp -= 8;
-			break;
+			NEXTPCODE;
 
-		case PCD_SETCEILINGTRIGGER:
+		PCODE(PCD_SETCEILINGTRIGGER):
 			new DPlaneWatcher (activator, activationline, lineSide, true, STACK(8),
 				STACK(7), STACK(6), STACK(5), STACK(4), STACK(3), STACK(2), STACK(1));
 			sp -= 8;
-			break;
+			NEXTPCODE;
 
 		/*case PCD_STARTTRANSLATION:
 			{
@@ -3569,36 +3836,36 @@ void DLevelScript::RunScript ()
 			break;
         */
 
-		case PCD_SIN:
+		PCODE(PCD_SIN):
 			STACK(1) = finesine[(STACK(1)<<16)>>ANGLETOFINESHIFT];
-			break;
+			NEXTPCODE;
 
-		case PCD_COS:
+		PCODE(PCD_COS):
 			STACK(1) = finecosine[(STACK(1)<<16)>>ANGLETOFINESHIFT];
-			break;
+			NEXTPCODE;
 
-		case PCD_VECTORANGLE:
+		PCODE(PCD_VECTORANGLE):
 			STACK(2) = R_PointToAngle2 (0, 0, STACK(2), STACK(1)) >> 16;
 			sp--;
-			break;
+			NEXTPCODE;
 
-		case PCD_PLAYERNUMBER:
+		PCODE(PCD_PLAYERNUMBER):
 			if (activator == NULL || activator->player == NULL)
 				PushToStack(-1);
 			else
 				PushToStack(activator->player->GetPlayerNumber());
-			break;
+			NEXTPCODE;
 
-		case PCD_ACTIVATORTID:
+		PCODE(PCD_ACTIVATORTID):
 			if (activator == NULL)
 				PushToStack(0);
 			else
 				PushToStack(activator->tid);
-			break;
+			NEXTPCODE;
 
-		case PCD_GETCVAR: {
-			cvar_t *var, *prev;
-			var = cvar_t::FindCVar(level.behavior->LookupString(STACK(1)), &prev);
+		PCODE(PCD_GETCVAR): {
+			cvar_t *var;
+			var = cvar_t::FindCVar(level.behavior->LookupString(STACK(1)));
 			if (var == NULL)
 			{
 				STACK(1) = 0;
@@ -3608,9 +3875,9 @@ void DLevelScript::RunScript ()
 				STACK(1) = (int)var->value();
 			}
 		}
-		break;
+		NEXTPCODE;
 
-		case PCD_GETLEVELINFO:
+		PCODE(PCD_GETLEVELINFO):
 			switch (STACK(1))
 			{
 			case LEVELINFO_PAR_TIME:
@@ -3647,7 +3914,7 @@ void DLevelScript::RunScript ()
 				STACK(1) = 0;
 				break;
 			}
-			break;
+			NEXTPCODE;
 
 		/*case PCD_CHECKWEAPON:
 			if (activator == NULL || activator->player == NULL)
@@ -3698,6 +3965,7 @@ void DLevelScript::RunScript ()
 
 	this->pc = pc;
 	this->sp = sp;
+	acs_pcodes += runaway;
 
 	if (state == SCRIPT_DivideBy0)
 	{
@@ -3755,6 +4023,7 @@ DLevelScript::DLevelScript (AActor *who, line_t *where, int num, int *code, int
 	localvars[2] = arg2;
 	memset (localvars+3, 0, sizeof(localvars)-3*sizeof(int));
 	pc = code;
+	wakecount = 0;
 	activator = who;
 	activationline = where;
 	lineSide = lineside;
@@ -4029,6 +4298,19 @@ BEGIN_COMMAND (scriptstat)
 }
 END_COMMAND (scriptstat)
 
+BEGIN_COMMAND (acsstats)
+{
+	Printf (PRINT_HIGH, "ACS: %u script runs, %u p-codes, %.3f ms\n",
+		acs_scriptruns, acs_pcodes, double(acs_runtime) / 1000000.0);
+
+	if (argc > 1 && stricmp(argv[1], "reset") == 0)
+	{
+		acs_scriptruns = acs_pcodes = 0;
+		acs_runtime = 0;
+	}
+}
+END_COMMAND (acsstats)
+
 void DACSThinker::DumpScriptStatus ()
 {
 	static const char *stateNames[] =
@@ -471,6 +471,7 @@ protected:
 	int				*pc;
 	EScriptState	state;
 	int				statedata;
+	unsigned int	wakecount;		// waitwakecount at the last TagWait/PolyWait check
 	AActor			*activator;
 	line_t			*activationline;
 	int				lineSide;
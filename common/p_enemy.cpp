@@ -27,6 +27,7 @@
 #include "odamex.h"
 
 #include <math.h>
+#include <vector>
 #include "m_random.h"
 #include "m_alloc.h"
 #include "i_system.h"
@@ -48,6 +49,7 @@ EXTERN_CVAR (sv_fastmonsters)
 EXTERN_CVAR (co_zdoomphys)
 EXTERN_CVAR (co_novileghosts)
 EXTERN_CVAR(co_zdoomsound)
+EXTERN_CVAR(sv_parallelai)
 
 enum dirtype_t
 {
@@ -781,6 +783,93 @@ bool P_LookForPlayers(AActor *actor, bool allaround)
 }
 
 
+//
+// P_SenseMonsters
+//
+// The first half of a monster's tic with sv_parallelai on.  Monsters spend
+// most of their time in A_Look and A_Chase checking whether they can see
+// their target, or a player to wake up for.  Those checks are traced here,
+// for every monster whose state is about to change, on the worker pool.
+// The act half is the usual serial thinker run, where P_CheckSight finds
+// the results in its cache.
+//
+// A cached result is only used if neither actor has moved and no floor,
+// ceiling or polyobject has changed since it was traced, so monsters act
+// exactly as they would otherwise and random numbers are drawn in the same
+// order.
+//
+void P_SenseMonsters()
+{
+	if (!sv_parallelai || !serverside)
+		return;
+
+	static std::vector<const AActor*> observers;
+	static std::vector<const AActor*> targets;
+	observers.clear();
+	targets.clear();
+
+	// Players a monster might wake up for, in the order P_LookForPlayers
+	// looks at them.
+	AActor* lookplayers[MAXPLAYERS];
+	unsigned int lookids[MAXPLAYERS];
+	int numlook = 0;
+
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (it->ingame() && !it->spectator && it->health > 0 && it->mo &&
+		    !(it->cheats & CF_NOTARGET) && numlook < MAXPLAYERS)
+		{
+			lookplayers[numlook] = it->mo;
+			lookids[numlook] = it->id - 1;
+			numlook++;
+		}
+	}
+
+	AActor* actor;
+	TThinkerIterator<AActor> iterator;
+	while ((actor = iterator.Next()))
+	{
+		// Only monsters about to run a state action will look around.
+		if (actor->player || actor->health <= 0 || actor->tics != 1 ||
+		    !actor->subsector || actor->info->seestate == S_NULL)
+			continue;
+
+		if (actor->target)
+		{
+			observers.push_back(actor);
+			targets.push_back(actor->target);
+			continue;
+		}
+
+		AActor* soundtarget = actor->subsector->sector->soundtarget;
+		if (soundtarget && (actor->flags & MF_AMBUSH))
+		{
+			observers.push_back(actor);
+			targets.push_back(soundtarget);
+		}
+
+		// P_LookForPlayers makes at most two sight checks, starting from
+		// lastlook.
+		int looked = 0;
+		for (int pass = 0; pass < 2 && looked < 2; pass++)
+		{
+			for (int i = 0; i < numlook && looked < 2; i++)
+			{
+				if ((pass == 0) != (lookids[i] >= actor->lastlook))
+					continue;
+
+				observers.push_back(actor);
+				targets.push_back(lookplayers[i]);
+				looked++;
+			}
+		}
+	}
+
+	if (!observers.empty())
+		P_PrefetchSight(&observers[0], &targets[0], observers.size());
+}
+
+
 //
 // A_KeenDie
 // DOOM II special, map 32.
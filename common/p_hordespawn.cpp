@@ -29,6 +29,7 @@
 
 #include "actor.h"
 #include "c_effect.h"
+#include "m_bbox.h"
 #include "m_random.h"
 #include "p_hordedefine.h"
 #include "p_local.h"
@@ -40,7 +41,6 @@ void SV_SpawnMobj(AActor* mobj);
 struct SpawnPointWeight
 {
 	hordeSpawn_t* spawn;
-	float score;
 	int dist;
 	bool visible;
 };
@@ -48,18 +48,119 @@ typedef std::vector<SpawnPointWeight> SpawnPointWeights;
 
 static hordeSpawns_t itemSpawns;
 static hordeSpawns_t powerupSpawns;
-static hordeSpawns_t monsterSpawns;
 
-static bool CmpWeights(const SpawnPointWeight& a, const SpawnPointWeight& b)
-{
-	return a.score > b.score;
-}
+// Monster spawns are bucketed by spawn type, so picking a spawn for a recipe
+// only has to look at the buckets that can take it.  The last bucket catches
+// any spawn type we don't know about.
+static const int NUM_SPAWN_BUCKETS = TTYPE_HORDE_SMALLBOSS - TTYPE_HORDE_SMALLMONSTER + 2;
+static hordeSpawns_t monsterSpawns[NUM_SPAWN_BUCKETS];
+static size_t numMonsterSpawns = 0;
+
+// Buckets in order of descending weight, which is the order spawn points
+// are considered in when rolling for one.  Zero stands in for the catch-all.
+static const int bucketOrder[] = {
+    TTYPE_HORDE_FLYING, TTYPE_HORDE_SMALLMONSTER, TTYPE_HORDE_MONSTER,
+    TTYPE_HORDE_BOSS,   TTYPE_HORDE_SMALLBOSS,    0,
+    TTYPE_HORDE_SMALLSNIPER, TTYPE_HORDE_SNIPER};
 
 static bool CmpDist(const SpawnPointWeight& a, const SpawnPointWeight& b)
 {
 	return a.dist < b.dist;
 }
 
+/**
+ * @brief Get the index of the bucket that holds spawns of the passed type.
+ */
+static int SpawnBucket(const int type)
+{
+	if (type < TTYPE_HORDE_SMALLMONSTER || type > TTYPE_HORDE_SMALLBOSS)
+		return NUM_SPAWN_BUCKETS - 1;
+
+	return type - TTYPE_HORDE_SMALLMONSTER;
+}
+
+/**
+ * @brief Get the selection weight of a single spawn of the passed type.
+ */
+static float SpawnScore(const int type)
+{
+	// [AM] During development we used to have a complicated spawn system
+	//      that spawned near players, but this resulted in it being
+	//      easy to exploit.
+
+	if (type == TTYPE_HORDE_FLYING)
+	{
+		// Preferring flying spawns frees up ground-level spawns for
+		// ground-level monsters.
+		return 1.25f;
+	}
+	else if (type == TTYPE_HORDE_SMALLSNIPER || type == TTYPE_HORDE_SNIPER)
+	{
+		// Sniper spawns can be annoying to clear, allow a breather.
+		return 0.75f;
+	}
+
+	return 1.0f;
+}
+
+static fixed_t occupiedBox[4];
+static fixed_t occupiedZ, occupiedTop;
+
+static BOOL PIT_CheckOccupied(AActor* thing)
+{
+	if (!(thing->flags & MF_SOLID))
+		return true;
+
+	if (thing->player && thing->player->spectator)
+		return true;
+
+	if (thing->x + thing->radius <= occupiedBox[BOXLEFT] ||
+	    thing->x - thing->radius >= occupiedBox[BOXRIGHT] ||
+	    thing->y + thing->radius <= occupiedBox[BOXBOTTOM] ||
+	    thing->y - thing->radius >= occupiedBox[BOXTOP])
+		return true;
+
+	if (thing->z >= occupiedTop || thing->z + thing->height <= occupiedZ)
+		return true;
+
+	return false;
+}
+
+/**
+ * @brief Quick check for a solid thing already standing where a monster
+ *        would be spawned, using the blockmap's thing links.
+ *
+ * @detail A spot that passes still needs a full P_TestMobjLocation, but a
+ *         spot that fails would never pass it, so we can skip creating and
+ *         destroying an actor just to find that out.
+ */
+static bool SpotOccupied(const fixed_t x, const fixed_t y, const fixed_t z,
+                         const mobjinfo_t& info)
+{
+	occupiedBox[BOXLEFT] = x - info.radius;
+	occupiedBox[BOXRIGHT] = x + info.radius;
+	occupiedBox[BOXBOTTOM] = y - info.radius;
+	occupiedBox[BOXTOP] = y + info.radius;
+	occupiedZ = z;
+	occupiedTop = z + info.height;
+
+	const int xl = (occupiedBox[BOXLEFT] - bmaporgx - MAXRADIUS) >> MAPBLOCKSHIFT;
+	const int xh = (occupiedBox[BOXRIGHT] - bmaporgx + MAXRADIUS) >> MAPBLOCKSHIFT;
+	const int yl = (occupiedBox[BOXBOTTOM] - bmaporgy - MAXRADIUS) >> MAPBLOCKSHIFT;
+	const int yh = (occupiedBox[BOXTOP] - bmaporgy + MAXRADIUS) >> MAPBLOCKSHIFT;
+
+	for (int bx = xl; bx <= xh; bx++)
+	{
+		for (int by = yl; by <= yh; by++)
+		{
+			if (!P_BlockThingsIterator(bx, by, PIT_CheckOccupied))
+				return true;
+		}
+	}
+
+	return false;
+}
+
 /**
  * @brief Spawn a monster.
  *
@@ -72,6 +173,13 @@ static bool CmpDist(const SpawnPointWeight& a, const SpawnPointWeight& b)
 static AActor::AActorPtr SpawnMonster(hordeSpawn_t& spawn, const hordeRecipe_t& recipe,
                                       const v2fixed_t offset)
 {
+	if (SpotOccupied(spawn.mo->x + offset.x, spawn.mo->y + offset.y, spawn.mo->z,
+	                 ::mobjinfo[recipe.type]))
+	{
+		// Spawn blocked.
+		return AActor::AActorPtr();
+	}
+
 	AActor* mo = new AActor(spawn.mo->x + offset.x, spawn.mo->y + offset.y, spawn.mo->z,
 	                        recipe.type);
 	if (mo)
@@ -207,7 +315,8 @@ void P_HordeAddSpawns()
 			::powerupSpawns.push_back(sp);
 			break;
 		default:
-			::monsterSpawns.push_back(sp);
+			::monsterSpawns[SpawnBucket(sp.type)].push_back(sp);
+			::numMonsterSpawns++;
 			break;
 		}
 	}
@@ -218,7 +327,7 @@ void P_HordeAddSpawns()
  */
 bool P_HordeHasSpawns()
 {
-	return !::itemSpawns.empty() && !::powerupSpawns.empty() && !::monsterSpawns.empty();
+	return !::itemSpawns.empty() && !::powerupSpawns.empty() && ::numMonsterSpawns > 0;
 }
 
 /**
@@ -228,7 +337,9 @@ void P_HordeClearSpawns()
 {
 	::itemSpawns.clear();
 	::powerupSpawns.clear();
-	::monsterSpawns.clear();
+	for (int i = 0; i < NUM_SPAWN_BUCKETS; i++)
+		::monsterSpawns[i].clear();
+	::numMonsterSpawns = 0;
 }
 
 /**
@@ -244,137 +355,123 @@ static bool FitRadHeight(const mobjinfo_t& info, const int rad, const int height
 }
 
 /**
- * @brief Get a spawn point to place a monster at.
+ * @brief True if a monster from the passed recipe can spawn at a spawn of
+ *        the passed type.
  */
-hordeSpawn_t* P_HordeSpawnPoint(const hordeRecipe_t& recipe)
+static bool SpawnTypeFits(const int type, const hordeRecipe_t& recipe)
 {
-	float totalScore = 0.0f;
+	const mobjinfo_t& info = ::mobjinfo[recipe.type];
+	const bool isFlying = info.flags & (MF_NOGRAVITY | MF_FLOAT);
 
-	SpawnPointWeights weights;
-	for (hordeSpawns_t::iterator sit = monsterSpawns.begin(); sit != monsterSpawns.end();
-	     ++sit)
+	if (recipe.isBoss && type != TTYPE_HORDE_BOSS && type != TTYPE_HORDE_SMALLBOSS)
 	{
-		mobjinfo_t& info = ::mobjinfo[recipe.type];
-		const bool isFlying = info.flags & (MF_NOGRAVITY | MF_FLOAT);
+		// Bosses cannot spawn at non-boss spawns.
+		return false;
+	}
 
-		if (recipe.isBoss && sit->type != TTYPE_HORDE_BOSS &&
-		    sit->type != TTYPE_HORDE_SMALLBOSS)
-		{
-			// Bosses cannot spawn at non-boss spawns.
-			continue;
-		}
+	// [AM] Radius reference for the big bodies, so you can get an idea
+	//      of what monsters are excluded from which radius comparisons.
+	//      - Spider Mastermind: 128 units
+	//      - Arachnotron: 64 units
+	//      - Mancubus: 48 units
+	//      - Cyberdemon: 40 units
+	//      - Cacodemon/Pain Elemental: 31 units
+	//      - Demon: 30 units
 
-		// [AM] Radius reference for the big bodies, so you can get an idea
-		//      of what monsters are excluded from which radius comparisons.
-		//      - Spider Mastermind: 128 units
-		//      - Arachnotron: 64 units
-		//      - Mancubus: 48 units
-		//      - Cyberdemon: 40 units
-		//      - Cacodemon/Pain Elemental: 31 units
-		//      - Demon: 30 units
+	const bool fitsNormal = FitRadHeight(info, 64, 128);
+	const bool fitsSmall = FitRadHeight(info, 32, 64);
 
-		const bool fitsNormal = FitRadHeight(info, 64, 128);
-		const bool fitsSmall = FitRadHeight(info, 32, 64);
+	switch (type)
+	{
+	case TTYPE_HORDE_MONSTER:
+		// Normal spawns can't spawn monsters that are too big.
+		return fitsNormal;
+	case TTYPE_HORDE_BOSS:
+		// Boss spawns can spawn non-boss monsters, but only if they're
+		// too big to spawn anywhere else.
+		return recipe.isBoss || !fitsNormal;
+	case TTYPE_HORDE_SMALLMONSTER:
+		// Small monster spawns have to spawn small monsters.
+		return fitsSmall;
+	case TTYPE_HORDE_SMALLBOSS:
+		// Small boss spawns can't spawn non-bosses, period.
+		return recipe.isBoss && fitsNormal;
+	case TTYPE_HORDE_FLYING:
+		// Flying spawns have to spawn flying monsters.
+		return isFlying && fitsNormal;
+	case TTYPE_HORDE_SNIPER:
+		// Snipers have to:
+		// - Have a ranged attack.
+		// - Not be flying.
+		// - Not be a boss monster for this wave.
+		// - Be skinny enough to fit in a 128x128 square.
+		return info.missilestate != S_NULL && !isFlying && !recipe.isBoss && fitsNormal;
+	case TTYPE_HORDE_SMALLSNIPER:
+		// Small snipers are similar, but they get to fit
+		// into a 64x64 square.
+		return info.missilestate != S_NULL && !isFlying && !recipe.isBoss && fitsSmall;
+	}
 
-		switch (sit->type)
-		{
-		case TTYPE_HORDE_MONSTER:
-			// Normal spawns can't spawn monsters that are too big.
-			if (!fitsNormal)
-				continue;
-			break;
-		case TTYPE_HORDE_BOSS:
-			// Boss spawns can spawn non-boss monsters, but only if they're
-			// too big to spawn anywhere else.
-			if (!recipe.isBoss && fitsNormal)
-				continue;
-			break;
-		case TTYPE_HORDE_SMALLMONSTER:
-			// Small monster spawns have to spawn small monsters.
-			if (!fitsSmall)
-				continue;
-			break;
-		case TTYPE_HORDE_SMALLBOSS:
-			// Small boss spawns can't spawn non-bosses, period.
-			if (!recipe.isBoss || !fitsNormal)
-				continue;
-			break;
-		case TTYPE_HORDE_FLYING:
-			// Flying spawns have to spawn flying monsters.
-			if (!isFlying || !fitsNormal)
-				continue;
-			break;
-		case TTYPE_HORDE_SNIPER:
-			// Snipers have to:
-			// - Have a ranged attack.
-			// - Not be flying.
-			// - Not be a boss monster for this wave.
-			// - Be skinny enough to fit in a 128x128 square.
-			if (info.missilestate == S_NULL || isFlying || recipe.isBoss || !fitsNormal)
-				continue;
-			break;
-		case TTYPE_HORDE_SMALLSNIPER:
-			// Small snipers are similar, but they get to fit
-			// into a 64x64 square.
-			if (info.missilestate == S_NULL || isFlying || recipe.isBoss || !fitsSmall)
-				continue;
-			break;
-		}
+	return true;
+}
 
-		SpawnPointWeight weight;
-		weight.spawn = &*sit;
+/**
+ * @brief Get a spawn point to place a monster at.
+ */
+hordeSpawn_t* P_HordeSpawnPoint(const hordeRecipe_t& recipe)
+{
+	// Every spawn in a bucket has the same type, so whether the recipe fits
+	// and what each spawn is worth only has to be worked out per bucket.
+	float bucketScore[ARRAY_LENGTH(bucketOrder)];
+	float totalScore = 0.0f;
 
-		// [AM] During development we used to have a complicated spawn system
-		//      that spawned near players, but this resulted in it being
-		//      easy to exploit.
+	for (size_t i = 0; i < ARRAY_LENGTH(bucketOrder); i++)
+	{
+		bucketScore[i] = 0.0f;
 
-		float score = 1.0f;
-		if (sit->type == TTYPE_HORDE_FLYING)
-		{
-			// Preferring flying spawns frees up ground-level spawns for
-			// ground-level monsters.
-			score = 1.25f;
-		}
-		else if (sit->type == TTYPE_HORDE_SMALLSNIPER || sit->type == TTYPE_HORDE_SNIPER)
-		{
-			// Sniper spawns can be annoying to clear, allow a breather.
-			score = 0.75f;
-		}
+		const hordeSpawns_t& bucket = ::monsterSpawns[SpawnBucket(bucketOrder[i])];
+		if (bucket.empty())
+			continue;
 
-		weight.score = score;
-		totalScore += score;
+		// The catch-all bucket can hold spawns of more than one type, but
+		// none of them are types that SpawnTypeFits knows about.
+		if (!SpawnTypeFits(bucket.front().type, recipe))
+			continue;
 
-		weights.push_back(weight);
+		bucketScore[i] = SpawnScore(bucket.front().type) * bucket.size();
+		totalScore += bucketScore[i];
 	}
 
 	// Did we find any spawns?
-	if (weights.empty())
+	if (totalScore <= 0.0f)
 	{
 		// Error is printed in parent.
 		return NULL;
 	}
 
-	// Sort by weights.
-	std::sort(weights.begin(), weights.end(), CmpWeights);
 	float choice = P_RandomFloat() * totalScore;
 
-	SpawnPointWeights::const_iterator it = weights.begin();
-	for (; it != weights.end(); ++it)
+	for (size_t i = 0; i < ARRAY_LENGTH(bucketOrder); i++)
 	{
-		// If our choice number is less than the score, we found our spawn.
-		if (choice < it->score)
-			break;
+		// If our choice number is less than the bucket's score, our spawn
+		// is in this bucket.
+		if (choice < bucketScore[i])
+		{
+			hordeSpawns_t& bucket = ::monsterSpawns[SpawnBucket(bucketOrder[i])];
+			size_t idx = choice / SpawnScore(bucket.front().type);
+			if (idx >= bucket.size())
+				idx = bucket.size() - 1;
+
+			return &bucket[idx];
+		}
 
 		// Since scores origin at 0.0 we subtract the current score from our
 		// choice so the next comparison lines up.
-		choice -= it->score;
+		choice -= bucketScore[i];
 	}
 
 	// This should not happen unless we were careless with our math.
-	if (it == weights.end())
-		return NULL;
-
-	return it->spawn;
+	return NULL;
 }
 
 /**
@@ -388,9 +485,10 @@ AActors P_HordeSpawn(hordeSpawn_t& spawn, const hordeRecipe_t& recipe)
 {
 	AActors ok;
 
+	hordeSpawns_t& bucket = ::monsterSpawns[SpawnBucket(spawn.type)];
+
 	SpawnPointWeights weights;
-	for (hordeSpawns_t::iterator it = ::monsterSpawns.begin();
-	     it != ::monsterSpawns.end(); ++it)
+	for (hordeSpawns_t::iterator it = bucket.begin(); it != bucket.end(); ++it)
 	{
 		if (it->type != spawn.type)
 			continue;
@@ -133,6 +133,7 @@ BOOL	P_DeactivateMobj (AActor *mobj);
 //
 void	P_NoiseAlert (AActor* target, AActor* emmiter);
 void	P_SpawnBrainTargets(void);	// killough 3/26/98: spawn icon landings
+void	P_SenseMonsters();
 
 extern struct brain_s {				// killough 3/26/98: global state of boss brain
 	int easy, targeton;
@@ -165,6 +166,8 @@ typedef struct
 
 extern TArray<intercept_t> intercepts;
 
+void P_SortIntercepts();
+
 typedef BOOL (*traverser_t) (intercept_t *in);
 
 subsector_t* P_PointInSubsector(fixed_t x, fixed_t y);
@@ -190,6 +193,9 @@ extern fixed_t			lowfloor;
 void P_LineOpening (const line_t *linedef, fixed_t x, fixed_t y, fixed_t refx=MINFIXED, fixed_t refy=0);
 
 BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*) );
+BOOL P_BlockLinesIteratorBox (int x, int y, const fixed_t *box, BOOL(*func)(line_t*) );
+void P_InitBlockLines();
+void P_FlagPolyobjBlockLines();
 BOOL P_BlockThingsIterator (int x, int y, BOOL(*func)(AActor*), AActor *start=NULL);
 
 #define PT_ADDLINES 	1
@@ -241,6 +247,9 @@ BOOL	P_TryMove (AActor* thing, fixed_t x, fixed_t y, bool dropoff, bool onfloor
 BOOL	P_TeleportMove (AActor* thing, fixed_t x, fixed_t y, fixed_t z, BOOL telefrag);	// [RH] Added z and telefrag parameters
 void	P_SlideMove (AActor* mo);
 bool	P_CheckSight (const AActor* t1, const AActor* t2);
+void	P_InvalidateSightCache ();
+void	P_PrefetchSight (const AActor* const* observers, const AActor* const* targets,
+                         size_t count);
 void	P_UseLines (player_t* player);
 void	P_ApplyTorque(AActor *mo);
 void	P_CopySector(sector_t *dest, sector_t *src);
@@ -385,6 +394,7 @@ class DPolyAction : public DThinker
 	DECLARE_SERIAL (DPolyAction, DThinker)
 public:
 	DPolyAction (int polyNum);
+	virtual void Destroy ();
 protected:
 	DPolyAction ();
 	int m_PolyObj;
@@ -985,7 +985,7 @@ bool P_CheckPosition (AActor *thing, fixed_t x, fixed_t y)
 
 	for (int bx=xl ; bx<=xh ; bx++)
 		for (int by=yl ; by<=yh ; by++)
-			if (!P_BlockLinesIterator (bx,by,PIT_CheckLine))
+			if (!P_BlockLinesIteratorBox (bx,by,tmbbox,PIT_CheckLine))
 				return false;
 
 	if (P_AllowPassover())
@@ -1390,7 +1390,7 @@ void P_ApplyTorque (AActor *mo)
 
 	for (bx = xl ; bx <= xh ; bx++)
 		for (by = yl ; by <= yh ; by++)
-			P_BlockLinesIterator(bx, by, PIT_ApplyTorque);
+			P_BlockLinesIteratorBox(bx, by, tmbbox, PIT_ApplyTorque);
 
 	// If any momentum, mark object as 'falling' using engine-internal flags
 	if (mo->momx | mo->momy)
@@ -3483,7 +3483,7 @@ void P_CreateSecNodeList (AActor *thing, fixed_t x, fixed_t y)
 
 	for (bx=xl ; bx<=xh ; bx++)
 		for (by=yl ; by<=yh ; by++)
-			P_BlockLinesIterator (bx,by,PIT_GetSectors);
+			P_BlockLinesIteratorBox (bx,by,tmbbox,PIT_GetSectors);
 
 	// Add the sector of the (x,y) point to sector_list.
 
@@ -3734,6 +3734,7 @@ void P_ChangeCeilingHeight(sector_t *sector, fixed_t amount)
 
 	plane_t *plane = &sector->ceilingplane;
 	plane->d -= FixedMul(amount, plane->c);
+	P_InvalidateSightCache();
 
 	// The sector's ceilingheight variable is still used for (among other things)
 	// calculating wall texture offsets
@@ -3747,6 +3748,7 @@ void P_ChangeFloorHeight(sector_t *sector, fixed_t amount)
 
 	plane_t *plane = &sector->floorplane;
 	plane->d -= FixedMul(amount, plane->c);
+	P_InvalidateSightCache();
 
 	// The sector's floorheight variable is still used for (among other things)
 	// calculating wall texture offsets
@@ -3890,6 +3892,8 @@ void P_CopySector(sector_t *dest, sector_t *src)
 	if (!dest || !src)
 		return;
 
+	P_InvalidateSightCache();
+
 	dest->floorheight			= src->floorheight;
 	dest->ceilingheight			= src->ceilingheight;
 	dest->floorpic				= src->floorpic;
@@ -27,10 +27,16 @@
 
 #include "odamex.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "m_bbox.h"
 
 #include "p_local.h"
 #include "r_data.h"
+#include "c_dispatch.h"
+#include "i_system.h"
+#include "z_zone.h"
 
 // State.
 #include "r_state.h"
@@ -269,32 +275,41 @@ fixed_t P_AproxDistance2 (AActor *a, AActor *b)
 // P_PointOnLineSide
 // Returns 0 (front) or 1 (back)
 //
-int P_PointOnLineSide (fixed_t x, fixed_t y, const line_t *line)
+// Works on the raw line geometry so that the flat blockmap records can share
+// it with line_t.
+//
+static inline int P_PointOnLineSide(fixed_t x, fixed_t y, fixed_t lx, fixed_t ly,
+                                    fixed_t ldx, fixed_t ldy)
 {
 	if (co_zdoomphys)
 	{
 		// Make use of vector cross product
-		return	int64_t(y - line->v1->y) * int64_t(line->dx) +
-				int64_t(line->v1->x - x) * int64_t(line->dy) >= 0;
+		return	int64_t(y - ly) * int64_t(ldx) +
+				int64_t(lx - x) * int64_t(ldy) >= 0;
 	}
 	else
 	{
-		if (!line->dx)
+		if (!ldx)
 		{
-			return (x <= line->v1->x) ? (line->dy > 0) : (line->dy < 0);
+			return (x <= lx) ? (ldy > 0) : (ldy < 0);
 		}
-		else if (!line->dy)
+		else if (!ldy)
 		{
-			return (y <= line->v1->y) ? (line->dx < 0) : (line->dx > 0);
+			return (y <= ly) ? (ldx < 0) : (ldx > 0);
 		}
 		else
 		{
-			return FixedMul (line->dy >> FRACBITS, x - line->v1->x)
-				   <= FixedMul (y - line->v1->y , line->dx >> FRACBITS);
+			return FixedMul (ldy >> FRACBITS, x - lx)
+				   <= FixedMul (y - ly , ldx >> FRACBITS);
 		}
 	}
 }
 
+int P_PointOnLineSide (fixed_t x, fixed_t y, const line_t *line)
+{
+	return P_PointOnLineSide(x, y, line->v1->x, line->v1->y, line->dx, line->dy);
+}
+
 
 
 //
@@ -302,17 +317,18 @@ int P_PointOnLineSide (fixed_t x, fixed_t y, const line_t *line)
 // Considers the line to be infinite
 // Returns side 0 or 1, -1 if box crosses the line.
 //
-int P_BoxOnLineSide (const fixed_t *tmbox, const line_t *ld)
+static inline int P_BoxOnLineSide(const fixed_t *tmbox, int slopetype, fixed_t lx, fixed_t ly,
+                                  fixed_t ldx, fixed_t ldy)
 {
 	int p1 = 0;
 	int p2 = 0;
 
-	switch (ld->slopetype)
+	switch (slopetype)
 	{
 	  case ST_HORIZONTAL:
-		p1 = tmbox[BOXTOP] > ld->v1->y;
-		p2 = tmbox[BOXBOTTOM] > ld->v1->y;
-		if (ld->dx < 0)
+		p1 = tmbox[BOXTOP] > ly;
+		p2 = tmbox[BOXBOTTOM] > ly;
+		if (ldx < 0)
 		{
 			p1 ^= 1;
 			p2 ^= 1;
@@ -320,9 +336,9 @@ int P_BoxOnLineSide (const fixed_t *tmbox, const line_t *ld)
 		break;
 
 	  case ST_VERTICAL:
-		p1 = tmbox[BOXRIGHT] < ld->v1->x;
-		p2 = tmbox[BOXLEFT] < ld->v1->x;
-		if (ld->dy < 0)
+		p1 = tmbox[BOXRIGHT] < lx;
+		p2 = tmbox[BOXLEFT] < lx;
+		if (ldy < 0)
 		{
 			p1 ^= 1;
 			p2 ^= 1;
@@ -330,19 +346,24 @@ int P_BoxOnLineSide (const fixed_t *tmbox, const line_t *ld)
 		break;
 
 	  case ST_POSITIVE:
-		p1 = P_PointOnLineSide (tmbox[BOXLEFT], tmbox[BOXTOP], ld);
-		p2 = P_PointOnLineSide (tmbox[BOXRIGHT], tmbox[BOXBOTTOM], ld);
+		p1 = P_PointOnLineSide (tmbox[BOXLEFT], tmbox[BOXTOP], lx, ly, ldx, ldy);
+		p2 = P_PointOnLineSide (tmbox[BOXRIGHT], tmbox[BOXBOTTOM], lx, ly, ldx, ldy);
 		break;
 
 	  case ST_NEGATIVE:
-		p1 = P_PointOnLineSide (tmbox[BOXRIGHT], tmbox[BOXTOP], ld);
-		p2 = P_PointOnLineSide (tmbox[BOXLEFT], tmbox[BOXBOTTOM], ld);
+		p1 = P_PointOnLineSide (tmbox[BOXRIGHT], tmbox[BOXTOP], lx, ly, ldx, ldy);
+		p2 = P_PointOnLineSide (tmbox[BOXLEFT], tmbox[BOXBOTTOM], lx, ly, ldx, ldy);
 		break;
 	}
 
 	return (p1 == p2) ? p1 : -1;
 }
 
+int P_BoxOnLineSide (const fixed_t *tmbox, const line_t *ld)
+{
+	return P_BoxOnLineSide(tmbox, ld->slopetype, ld->v1->x, ld->v1->y, ld->dx, ld->dy);
+}
+
 
 //
 // P_PointOnDivlineSide
@@ -634,27 +655,165 @@ void AActor::SetOrigin (fixed_t ix, fixed_t iy, fixed_t iz)
 
 
 //
-// P_BlockLinesIterator
+// Flat blockmap
+//
+// The blockmap lump stores each block as a list of line numbers, so checking
+// a block means chasing every number into lines[] only to find that most of
+// those lines are nowhere near the box being checked.  At level load the lists
+// are copied into one contiguous run of blockline_t records per block, each
+// holding what is needed to tell whether the line crosses a box, so
+// P_BlockLinesIteratorBox can skip those lines without touching line_t.
+//
+// Lines already visited are remembered in blocklinestamps rather than in
+// line_t::validcount, which keeps the check to a small array of ints.
+//
+struct blockline_t
+{
+	fixed_t bbox[4];
+	fixed_t x, y;
+	fixed_t dx, dy;
+	line_t* line;
+	int slopetype;
+	int flags;
+};
+
+// The line belongs to a polyobject and may have moved since the record was
+// made, so look at the line itself.
+static const int BLF_POLYOBJ = 1;
+
+static blockline_t* blocklinerecs;
+static int* blocklinestart;		// first record of each block, plus one past the end
+static int* blocklinestamps;	// validcount each line was last visited at
+
+//
+// P_InitBlockLines
+//
+// Builds the flat blockmap from blockmaplump.  Called once the lines and the
+// blockmap are loaded.
+//
+void P_InitBlockLines()
+{
+	const int numblocks = bmapwidth * bmapheight;
+
+	blocklinestart = (int*)Z_Malloc((numblocks + 1) * sizeof(*blocklinestart), PU_LEVEL, 0);
+
+	int total = 0;
+	for (int i = 0; i < numblocks; i++)
+	{
+		blocklinestart[i] = total;
+		for (const int* list = blockmaplump + blockmap[i]; *list != -1; list++)
+			total++;
+	}
+	blocklinestart[numblocks] = total;
+
+	blocklinerecs = (blockline_t*)Z_Malloc(MAX(total, 1) * sizeof(*blocklinerecs), PU_LEVEL, 0);
+
+	blockline_t* rec = blocklinerecs;
+	for (int i = 0; i < numblocks; i++)
+	{
+		for (const int* list = blockmaplump + blockmap[i]; *list != -1; list++, rec++)
+		{
+			// A bad line number gets an empty record rather than being
+			// dropped, so that co_blockmapfix still skips the right entry.
+			if (*list < 0 || *list >= numlines)
+			{
+				memset(rec, 0, sizeof(*rec));
+				rec->bbox[BOXLEFT] = rec->bbox[BOXBOTTOM] = MAXINT;
+				rec->bbox[BOXRIGHT] = rec->bbox[BOXTOP] = MININT;
+				continue;
+			}
+
+			const line_t* ld = &lines[*list];
+			memcpy(rec->bbox, ld->bbox, sizeof(rec->bbox));
+			rec->x = ld->v1->x;
+			rec->y = ld->v1->y;
+			rec->dx = ld->dx;
+			rec->dy = ld->dy;
+			rec->line = &lines[*list];
+			rec->slopetype = ld->slopetype;
+			rec->flags = 0;
+		}
+	}
+
+	blocklinestamps = (int*)Z_Malloc(MAX(numlines, 1) * sizeof(*blocklinestamps), PU_LEVEL, 0);
+	memset(blocklinestamps, 0, MAX(numlines, 1) * sizeof(*blocklinestamps));
+}
+
+//
+// P_FlagPolyobjBlockLines
+//
+// Marks the records of polyobject lines so the iterators look at the live
+// line instead.  Called once the polyobjects have been spawned.
+//
+void P_FlagPolyobjBlockLines()
+{
+	if (po_NumPolyobjs == 0 || blocklinerecs == NULL)
+		return;
+
+	std::vector<bool> polyline(numlines, false);
+	for (int i = 0; i < po_NumPolyobjs; i++)
+		for (int j = 0; j < polyobjs[i].numsegs; j++)
+			polyline[polyobjs[i].segs[j]->linedef - lines] = true;
+
+	const int total = blocklinestart[bmapwidth * bmapheight];
+	for (int i = 0; i < total; i++)
+	{
+		if (blocklinerecs[i].line && polyline[blocklinerecs[i].line - lines])
+			blocklinerecs[i].flags |= BLF_POLYOBJ;
+	}
+}
+
+//
+// P_LineCrossesBox
+//
+// True if the line passes through the inside of the box, which is the test
+// PIT_CheckLine and friends start with.
+//
+static inline bool P_LineCrossesBox(const fixed_t* box, const fixed_t* bbox, int slopetype,
+                                    fixed_t x, fixed_t y, fixed_t dx, fixed_t dy)
+{
+	if (box[BOXRIGHT] <= bbox[BOXLEFT] || box[BOXLEFT] >= bbox[BOXRIGHT] ||
+	    box[BOXTOP] <= bbox[BOXBOTTOM] || box[BOXBOTTOM] >= bbox[BOXTOP])
+		return false;
+
+	return P_BoxOnLineSide(box, slopetype, x, y, dx, dy) == -1;
+}
+
+static inline bool P_LineCrossesBox(const fixed_t* box, const line_t* ld)
+{
+	return P_LineCrossesBox(box, ld->bbox, ld->slopetype, ld->v1->x, ld->v1->y, ld->dx, ld->dy);
+}
+
+static inline bool P_LineCrossesBox(const fixed_t* box, const blockline_t* rec)
+{
+	if (rec->flags & BLF_POLYOBJ)
+		return P_LineCrossesBox(box, rec->line);
+
+	return P_LineCrossesBox(box, rec->bbox, rec->slopetype, rec->x, rec->y, rec->dx, rec->dy);
+}
+
+//
+// P_BlockLinesIteratorBox
 // The validcount flags are used to avoid checking lines
 // that are marked in multiple mapblocks,
 // so increment validcount before the first call
 // to P_BlockLinesIterator, then make one or more calls
 // to it.
 //
+// If box is not NULL, only lines that cross it are passed to func.
+//
 extern polyblock_t **PolyBlockMap;
 
-BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*))
+BOOL P_BlockLinesIteratorBox (int x, int y, const fixed_t *box, BOOL(*func)(line_t*))
 {
 	if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
 		return true;
 
-	int offset = *(blockmap + (bmapwidth*y + x));
-	int *list = blockmaplump + offset;
-	
+	int offset = y*bmapwidth + x;
+
 	/* [RH] Polyobj stuff from Hexen --> */
 	polyblock_t *polyLink;
 
-	offset = y*bmapwidth + x;
 	if (PolyBlockMap)
 	{
 		polyLink = PolyBlockMap[offset];
@@ -669,10 +828,14 @@ BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*))
 
 				for (i = polyLink->polyobj->numsegs; i; i--, tempSeg++)
 				{
-					if ((*tempSeg)->linedef->validcount != validcount)
+					line_t *ld = (*tempSeg)->linedef;
+					if (box && !P_LineCrossesBox(box, ld))
+						continue;
+
+					if (blocklinestamps[ld - lines] != validcount)
 					{
-						(*tempSeg)->linedef->validcount = validcount;
-						if (!func ((*tempSeg)->linedef))
+						blocklinestamps[ld - lines] = validcount;
+						if (!func (ld))
 							return false;
 					}
 				}
@@ -682,6 +845,9 @@ BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*))
 	}
 	/* <-- Polyobj stuff from Hexen */	
 
+	const blockline_t *rec = blocklinerecs + blocklinestart[offset];
+	const blockline_t *end = blocklinerecs + blocklinestart[offset + 1];
+
 	// [RH] Get past starting 0 (from BOOM)
 	// denis - not so fast, this breaks doom1.wad 1.9 demo1
 	// [SL] The first entry in each block list appears to have been intended to
@@ -690,16 +856,19 @@ BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*))
 	// cause hitscan weapons to erroneously hit the first linedef entry regardless
 	// of where that linedef is located in relation to the block.
 	if (co_blockmapfix)
-		++list;
+		++rec;
 
-	for (; *list != -1; list++)
+	for (; rec < end; rec++)
 	{
-		line_t *ld = &lines[*list];
+		if (box ? !P_LineCrossesBox(box, rec) : rec->line == NULL)
+			continue;
 
-		if (ld->validcount != validcount) {
-			ld->validcount = validcount;
+		int *stamp = &blocklinestamps[rec->line - lines];
+		if (*stamp != validcount)
+		{
+			*stamp = validcount;
 
-			if ( !func(ld) )
+			if ( !func(rec->line) )
 				return false;
 		}
 	}
@@ -707,6 +876,14 @@ BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*))
 	return true;		// everything was checked
 }
 
+//
+// P_BlockLinesIterator
+//
+BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*))
+{
+	return P_BlockLinesIteratorBox(x, y, NULL, func);
+}
+
 
 //
 // P_BlockThingsIterator
@@ -868,6 +1045,89 @@ BOOL PIT_AddThingIntercepts (AActor* thing)
 }
 
 
+//
+// P_SortIntercepts
+//
+// Sorts the intercepts list by ascending frac. The traversal used to pick
+// the closest remaining intercept with a full scan for every step, which is
+// quadratic in the number of intercepts. The sort is stable, so intercepts
+// with the same frac are still visited in the order they were added, exactly
+// like the old selection loop did.
+//
+static TArray<intercept_t> intercepts_tmp;
+
+void P_SortIntercepts()
+{
+	const size_t count = intercepts.Size();
+	if (count < 2)
+		return;
+
+	intercept_t* in = &intercepts[0];
+
+	// Traces rarely cross more than a handful of lines and things.
+	if (count <= 32)
+	{
+		for (size_t i = 1; i < count; i++)
+		{
+			intercept_t temp = in[i];
+			size_t j = i;
+			for (; j > 0 && in[j - 1].frac > temp.frac; j--)
+				in[j] = in[j - 1];
+			in[j] = temp;
+		}
+		return;
+	}
+
+	// LSD radix sort on the frac with the sign bit flipped, since
+	// P_SightTraverseIntercepts may have slightly negative fracs.
+	unsigned int histogram[4][256];
+	memset(histogram, 0, sizeof(histogram));
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const unsigned int key = (unsigned int)in[i].frac ^ 0x80000000u;
+		for (int pass = 0; pass < 4; pass++)
+			histogram[pass][(key >> (pass * 8)) & 0xFF]++;
+	}
+
+	intercepts_tmp.Clear();
+	intercepts_tmp.Reserve(count);
+
+	intercept_t* src = in;
+	intercept_t* dest = &intercepts_tmp[0];
+
+	for (int pass = 0; pass < 4; pass++)
+	{
+		unsigned int* counts = histogram[pass];
+		const int shift = pass * 8;
+
+		// Every key has the same digit in this position, nothing to do.
+		if (counts[(((unsigned int)src[0].frac ^ 0x80000000u) >> shift) & 0xFF] == count)
+			continue;
+
+		unsigned int offset = 0;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			const unsigned int n = counts[digit];
+			counts[digit] = offset;
+			offset += n;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const unsigned int key = (unsigned int)src[i].frac ^ 0x80000000u;
+			dest[counts[(key >> shift) & 0xFF]++] = src[i];
+		}
+
+		std::swap(src, dest);
+	}
+
+	// Make sure the result ends up in intercepts.
+	if (src != in)
+		memcpy(in, src, count * sizeof(*in));
+}
+
+
 //
 // P_TraverseIntercepts
 // Returns true if the traverser function returns true
@@ -875,31 +1135,17 @@ BOOL PIT_AddThingIntercepts (AActor* thing)
 //
 BOOL P_TraverseIntercepts (traverser_t func, fixed_t maxfrac)
 {
-	size_t 				count = intercepts.Size();
-	fixed_t 			dist;
-	size_t		scan;
-	intercept_t*		in = 0;
+	P_SortIntercepts();
 
-	while (count--)
+	for (size_t i = 0; i < intercepts.Size(); i++)
 	{
-		dist = MAXINT;
-		for (scan = 0 ; scan < intercepts.Size(); scan++)
-		{
-			if (intercepts[scan].frac < dist)
-			{
-				dist = intercepts[scan].frac;
-				in = &intercepts[scan];
-			}
-		}
+		intercept_t* in = &intercepts[i];
 
-		if (dist > maxfrac)
+		if (in->frac > maxfrac)
 			return true;		// checked everything in range
 
-
 		if ( !func (in) )
 			return false;		// don't bother going farther
-
-		in->frac = MAXINT;
 	}
 
 	return true;				// everything was traversed
@@ -1365,4 +1611,148 @@ AActor* P_RoughTargetSearch(AActor* mo, angle_t fov, int distance)
 	return NULL;
 }
 
+
+//
+// tracebench
+//
+// Fires a repeatable set of hitscan-length traces across the current map
+// and reports how long P_PathTraverse takes to collect and walk their
+// intercepts.
+//
+static size_t tracebench_intercepts;
+
+static BOOL PTR_TraceBench(intercept_t* in)
+{
+	tracebench_intercepts++;
+	return true;
+}
+
+BEGIN_COMMAND(tracebench)
+{
+	if (gamestate != GS_LEVEL || bmapwidth <= 0 || bmapheight <= 0)
+	{
+		Printf(PRINT_HIGH, "tracebench: no level loaded\n");
+		return;
+	}
+
+	int numtraces = 10000;
+	if (argc > 1)
+		numtraces = MAX(atoi(argv[1]), 1);
+
+	// Use our own generator so the game's random number index is left alone.
+	unsigned int seed = 0x1d872b41;
+	const unsigned int width = bmapwidth * MAPBLOCKUNITS;
+	const unsigned int height = bmapheight * MAPBLOCKUNITS;
+
+	size_t maxintercepts = 0;
+	tracebench_intercepts = 0;
+
+	dtime_t start = I_GetTime();
+
+	for (int i = 0; i < numtraces; i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		const fixed_t x1 = bmaporgx + ((seed >> 8) % width) * FRACUNIT;
+		seed = seed * 1664525 + 1013904223;
+		const fixed_t y1 = bmaporgy + ((seed >> 8) % height) * FRACUNIT;
+		seed = seed * 1664525 + 1013904223;
+		const unsigned int an = seed >> ANGLETOFINESHIFT;
+
+		const fixed_t x2 = x1 + (MISSILERANGE >> FRACBITS) * finecosine[an & FINEMASK];
+		const fixed_t y2 = y1 + (MISSILERANGE >> FRACBITS) * finesine[an & FINEMASK];
+
+		P_PathTraverse(x1, y1, x2, y2, PT_ADDLINES | PT_ADDTHINGS, PTR_TraceBench);
+		maxintercepts = std::max(maxintercepts, intercepts.Size());
+	}
+
+	const double elapsed = double(I_GetTime() - start) / 1000.0;
+
+	Printf(PRINT_HIGH, "tracebench: %d traces in %.2f ms (%.3f us/trace)\n",
+			numtraces, elapsed / 1000.0, elapsed / numtraces);
+	Printf(PRINT_HIGH, "tracebench: %.1f intercepts/trace on average, %u at most\n",
+			double(tracebench_intercepts) / numtraces, (unsigned int)maxintercepts);
+}
+END_COMMAND(tracebench)
+
+//
+// checkposbench
+//
+// Times P_CheckPosition for a player's actor at random spots on the map.
+// Falls back to any solid actor when there are no players (e.g. a dedicated
+// server with nobody connected).
+//
+BEGIN_COMMAND(checkposbench)
+{
+	if (gamestate != GS_LEVEL || bmapwidth <= 0 || bmapheight <= 0)
+	{
+		Printf(PRINT_HIGH, "checkposbench: no level loaded\n");
+		return;
+	}
+
+	AActor* mo = NULL;
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (it->ingame() && it->mo)
+		{
+			mo = it->mo;
+			break;
+		}
+	}
+
+	if (mo == NULL)
+	{
+		TThinkerIterator<AActor> iterator;
+		AActor* actor;
+		while ((actor = iterator.Next()))
+		{
+			if ((actor->flags & MF_SOLID) && !(actor->flags & MF_NOBLOCKMAP))
+			{
+				mo = actor;
+				break;
+			}
+		}
+	}
+
+	if (mo == NULL)
+	{
+		Printf(PRINT_HIGH, "checkposbench: no solid actor in the level\n");
+		return;
+	}
+
+	int numchecks = 100000;
+	if (argc > 1)
+		numchecks = MAX(atoi(argv[1]), 1);
+
+	// Use our own generator so the game's random number index is left alone.
+	unsigned int seed = 0x5bd1e995;
+	const unsigned int width = bmapwidth * MAPBLOCKUNITS;
+	const unsigned int height = bmapheight * MAPBLOCKUNITS;
+
+	// Don't pick up everything on the map while we're at it.
+	const int oldflags = mo->flags;
+	mo->flags &= ~MF_PICKUP;
+
+	int passed = 0;
+	dtime_t start = I_GetTime();
+
+	for (int i = 0; i < numchecks; i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		const fixed_t x = bmaporgx + ((seed >> 8) % width) * FRACUNIT;
+		seed = seed * 1664525 + 1013904223;
+		const fixed_t y = bmaporgy + ((seed >> 8) % height) * FRACUNIT;
+
+		if (P_CheckPosition(mo, x, y))
+			passed++;
+	}
+
+	const double elapsed = double(I_GetTime() - start) / 1000.0;
+
+	mo->flags = oldflags;
+
+	Printf(PRINT_HIGH, "checkposbench: %d checks in %.2f ms (%.3f us/check), %d clear\n",
+			numchecks, elapsed / 1000.0, elapsed / numchecks, passed);
+}
+END_COMMAND(checkposbench)
+
 VERSION_CONTROL (p_maputl_cpp, "$Id$")
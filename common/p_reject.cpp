@@ -0,0 +1,769 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Builds a REJECT table for maps that ship without a usable one.
+//
+//   The table is worked out from the map geometry on a worker thread while
+//   the rest of the level loads, and is installed before the first tic, so
+//   every tic of the level sees the same table.  Finished tables are cached
+//   on disk, keyed by the map fingerprint.
+//
+//   A pair of sectors is only rejected when no straight line can get from
+//   one to the other through two-sided lines.  Sector heights are ignored
+//   entirely, so doors, lifts and crushers that might open up later never
+//   cause a pair to be rejected.  The ZDoom sight check gives the same
+//   answer with or without such a table, it just gets there faster.  The
+//   vanilla one doesn't: its rounding lets it see past the corners of
+//   one-sided walls, which the table would rule out.  So no table is built
+//   unless the ZDoom sight check is in use.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "c_cvars.h"
+#include "doomstat.h"
+#include "g_level.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "m_fileio.h"
+#include "p_local.h"
+#include "p_mapformat.h"
+#include "p_reject.h"
+#include "r_state.h"
+#include "z_zone.h"
+
+EXTERN_CVAR(sv_buildreject)
+EXTERN_CVAR(co_zdoomphys)
+
+// How far a point may stray onto the wrong side of a clipping line and still
+// count as visible, in map units.  Keeps round-off from ever rejecting a
+// pair that can see each other.
+static const double REJECT_EPSILON = 2.0;
+
+// Clip operations allowed per source sector before giving up and marking
+// everything reachable from it as visible.
+static const unsigned int REJECT_MAXWORK = 1 << 18;
+
+// Keeps the recursion well inside a worker thread's stack.
+static const int REJECT_MAXDEPTH = 1024;
+
+// Larger maps would need more memory for the table than it is worth.
+static const int REJECT_MAXSECTORS = 16384;
+
+static const char REJECT_CACHE_MAGIC[4] = { 'O', 'R', 'J', '1' };
+
+//
+// RejectPortal
+//
+// One way of getting from a sector into a neighbouring one: either through a
+// two-sided line or, for sectors that only touch at a corner, through a
+// shared vertex.
+//
+struct RejectPortal
+{
+	double x1, y1, x2, y2;
+	double nx, ny, dist;	// the far side is nx * x + ny * y >= dist
+	int id;					// linedef number, or -1 - vertex number
+	int to;					// sector on the far side
+	bool point;				// vertex portal, has no plane
+};
+
+struct RejectSeg
+{
+	double x1, y1, x2, y2;
+};
+
+//
+// RejectJob
+//
+// Everything the worker thread needs, copied out of the level so the level
+// can be freed while the worker is still running.
+//
+struct RejectJob
+{
+	int numsectors;
+	int numlines;
+
+	// Portals grouped by the sector they lead out of.
+	std::vector<RejectPortal> portals;
+	std::vector<int> firstportal;
+
+	std::vector<byte> matrix;
+	int rejected;
+
+	std::string cachefile;
+	dtime_t starttime;
+
+	volatile int cancel;
+	OThread thread;
+};
+
+static RejectJob* rejectjob = NULL;
+
+//
+// P_RejectBytes
+//
+static size_t P_RejectBytes(int count)
+{
+	return ((size_t)count * count + 7) / 8;
+}
+
+//
+// P_ClipRejectSeg
+//
+// Clips seg to the side of a line where nx * x + ny * y >= dist.
+// Returns false if nothing is left.
+//
+static bool P_ClipRejectSeg(RejectSeg& seg, double nx, double ny, double dist)
+{
+	double d1 = nx * seg.x1 + ny * seg.y1 - dist;
+	double d2 = nx * seg.x2 + ny * seg.y2 - dist;
+
+	if (d1 >= 0.0 && d2 >= 0.0)
+		return true;
+	if (d1 < 0.0 && d2 < 0.0)
+		return false;
+
+	double t = d1 / (d1 - d2);
+	double x = seg.x1 + (seg.x2 - seg.x1) * t;
+	double y = seg.y1 + (seg.y2 - seg.y1) * t;
+
+	if (d1 < 0.0)
+	{
+		seg.x1 = x;
+		seg.y1 = y;
+	}
+	else
+	{
+		seg.x2 = x;
+		seg.y2 = y;
+	}
+	return true;
+}
+
+//
+// P_ClipRejectSeparators
+//
+// Any line of sight that starts in source and passes through pass ends up
+// on a known side of each line joining an endpoint of source to an endpoint
+// of pass.  Clips target against those lines.
+//
+static bool P_ClipRejectSeparators(const RejectSeg& source, const RejectSeg& pass,
+                                   RejectSeg& target)
+{
+	const double sx[2] = { source.x1, source.x2 };
+	const double sy[2] = { source.y1, source.y2 };
+	const double px[2] = { pass.x1, pass.x2 };
+	const double py[2] = { pass.y1, pass.y2 };
+	const double tiny = 1e-6;
+
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			double dx = px[j] - sx[i];
+			double dy = py[j] - sy[i];
+			double len = sqrt(dx * dx + dy * dy);
+			if (len < 0.001)
+				continue;
+
+			double nx = -dy / len;
+			double ny = dx / len;
+			double ds = nx * (sx[1 - i] - sx[i]) + ny * (sy[1 - i] - sy[i]);
+			double dp = nx * (px[1 - j] - sx[i]) + ny * (py[1 - j] - sy[i]);
+
+			// Only lines that separate source from pass say anything about
+			// where the line of sight goes next.
+			double side;
+			if (ds > tiny && dp < -tiny)
+				side = -1.0;
+			else if (ds < -tiny && dp > tiny)
+				side = 1.0;
+			else if (fabs(ds) <= tiny && fabs(dp) > tiny)
+				side = dp > 0.0 ? 1.0 : -1.0;
+			else if (fabs(dp) <= tiny && fabs(ds) > tiny)
+				side = ds > 0.0 ? -1.0 : 1.0;
+			else if (fabs(ds) <= tiny && fabs(dp) <= tiny)
+			{
+				// Source and pass lie on the same line, so the line of sight
+				// runs along it.
+				double dist = nx * sx[i] + ny * sy[i];
+				if (!P_ClipRejectSeg(target, nx, ny, dist - REJECT_EPSILON) ||
+				    !P_ClipRejectSeg(target, -nx, -ny, -dist - REJECT_EPSILON))
+					return false;
+				continue;
+			}
+			else
+				continue;
+
+			if (!P_ClipRejectSeg(target, side * nx, side * ny,
+			                     side * (nx * sx[i] + ny * sy[i]) - REJECT_EPSILON))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//
+// RejectFlood
+//
+// Where a line of sight can go after passing through a portal depends only
+// on the source portal and the part of the portal it got through, and a
+// wider opening can only see more.  So for each portal, the widest part of
+// it already explored from the current source is remembered, and anything
+// inside that is skipped.
+//
+struct RejectFlood
+{
+	const RejectJob* job;
+	const RejectPortal* source;
+	RejectSeg sourceseg;
+	byte* visible;
+	std::vector<double> explored_lo;
+	std::vector<double> explored_hi;
+	std::vector<int> touched;
+	unsigned int work;
+	int depth;
+	bool overflow;
+};
+
+//
+// P_RejectSegRange
+//
+// Returns the part of portal covered by seg as fractions along it.
+//
+static void P_RejectSegRange(const RejectPortal& portal, const RejectSeg& seg,
+                             double& lo, double& hi)
+{
+	double dx = portal.x2 - portal.x1;
+	double dy = portal.y2 - portal.y1;
+	double len2 = dx * dx + dy * dy;
+	if (len2 == 0.0)
+	{
+		lo = hi = 0.0;
+		return;
+	}
+
+	double t1 = ((seg.x1 - portal.x1) * dx + (seg.y1 - portal.y1) * dy) / len2;
+	double t2 = ((seg.x2 - portal.x1) * dx + (seg.y2 - portal.y1) * dy) / len2;
+	lo = std::min(t1, t2);
+	hi = std::max(t1, t2);
+}
+
+//
+// P_ExploreRejectPortal
+//
+// Returns false if seg is inside the part of the portal already explored
+// from the current source, otherwise marks it as explored.
+//
+static bool P_ExploreRejectPortal(RejectFlood& flood, int index, const RejectSeg& seg)
+{
+	const RejectPortal& portal = flood.job->portals[index];
+
+	double lo, hi;
+	P_RejectSegRange(portal, seg, lo, hi);
+
+	double& oldlo = flood.explored_lo[index];
+	double& oldhi = flood.explored_hi[index];
+
+	if (oldlo > oldhi)
+	{
+		flood.touched.push_back(index);
+	}
+	else
+	{
+		const double slack = 1e-4;
+		if (lo >= oldlo - slack && hi <= oldhi + slack)
+			return false;
+
+		// Only grow the remembered range when the two overlap, so that it
+		// never claims to cover a gap that hasn't been explored.
+		if (lo <= oldhi && hi >= oldlo)
+		{
+			lo = std::min(lo, oldlo);
+			hi = std::max(hi, oldhi);
+		}
+	}
+
+	oldlo = lo;
+	oldhi = hi;
+	return true;
+}
+
+//
+// P_FloodRejectPortal
+//
+// Marks every sector that a line of sight can reach after starting in the
+// source portal and passing through pass, which has been clipped to passseg.
+//
+static void P_FloodRejectPortal(RejectFlood& flood, const RejectPortal& pass,
+                                const RejectSeg& passseg)
+{
+	const RejectJob* job = flood.job;
+
+	for (int i = job->firstportal[pass.to]; i < job->firstportal[pass.to + 1]; i++)
+	{
+		const RejectPortal& target = job->portals[i];
+
+		if (++flood.work > REJECT_MAXWORK)
+		{
+			flood.overflow = true;
+			return;
+		}
+
+		// Can't go straight back out the way it came in.
+		if (target.id == pass.id)
+			continue;
+
+		RejectSeg seg = { target.x1, target.y1, target.x2, target.y2 };
+
+		const RejectPortal* source = flood.source;
+		if (!source->point &&
+		    !P_ClipRejectSeg(seg, source->nx, source->ny, source->dist - REJECT_EPSILON))
+			continue;
+		if (!pass.point && !P_ClipRejectSeg(seg, pass.nx, pass.ny, pass.dist - REJECT_EPSILON))
+			continue;
+		if (&pass != source && !P_ClipRejectSeparators(flood.sourceseg, passseg, seg))
+			continue;
+
+		flood.visible[target.to] = 1;
+
+		if (!P_ExploreRejectPortal(flood, i, seg))
+			continue;
+
+		if (++flood.depth > REJECT_MAXDEPTH)
+		{
+			flood.overflow = true;
+			return;
+		}
+
+		P_FloodRejectPortal(flood, target, seg);
+		flood.depth--;
+
+		if (flood.overflow)
+			return;
+	}
+}
+
+//
+// P_FloodRejectConnected
+//
+// Fallback for sectors with too many portals to trace: marks every sector
+// connected to start at all.
+//
+static void P_FloodRejectConnected(const RejectJob* job, int start, byte* visible)
+{
+	memset(visible, 0, job->numsectors);
+
+	std::vector<int> open;
+	open.push_back(start);
+	visible[start] = 1;
+
+	while (!open.empty())
+	{
+		int sector = open.back();
+		open.pop_back();
+
+		for (int i = job->firstportal[sector]; i < job->firstportal[sector + 1]; i++)
+		{
+			int to = job->portals[i].to;
+			if (!visible[to])
+			{
+				visible[to] = 1;
+				open.push_back(to);
+			}
+		}
+	}
+}
+
+//
+// P_WriteRejectCache
+//
+// The cache is only ever read back by the same machine, so the header is
+// written in native byte order.
+//
+static void P_WriteRejectCache(const RejectJob* job)
+{
+	if (job->cachefile.empty())
+		return;
+
+	FILE* fp = fopen(job->cachefile.c_str(), "wb");
+	if (fp == NULL)
+		return;
+
+	unsigned int header[2] = { (unsigned int)job->numsectors, (unsigned int)job->numlines };
+
+	bool ok = fwrite(REJECT_CACHE_MAGIC, sizeof(REJECT_CACHE_MAGIC), 1, fp) == 1 &&
+	          fwrite(header, sizeof(header), 1, fp) == 1 &&
+	          fwrite(&job->matrix[0], job->matrix.size(), 1, fp) == 1;
+	fclose(fp);
+
+	if (!ok)
+		remove(job->cachefile.c_str());
+}
+
+//
+// P_BuildRejectThread
+//
+static void P_BuildRejectThread(void* data)
+{
+	RejectJob* job = static_cast<RejectJob*>(data);
+	const int count = job->numsectors;
+
+	// Start with every pair rejected and clear the ones that can see.
+	job->matrix.assign(P_RejectBytes(count), 0);
+	const size_t pairs = (size_t)count * count;
+	for (size_t pnum = 0; pnum < pairs; pnum++)
+		job->matrix[pnum >> 3] |= 1 << (pnum & 7);
+
+	std::vector<byte> visible(count);
+	RejectFlood flood;
+	flood.job = job;
+	flood.visible = &visible[0];
+	flood.explored_lo.assign(job->portals.size(), 1.0);
+	flood.explored_hi.assign(job->portals.size(), 0.0);
+
+	for (int sector = 0; sector < count; sector++)
+	{
+		if (I_AtomicLoad(&job->cancel))
+			return;
+
+		memset(&visible[0], 0, count);
+		visible[sector] = 1;
+
+		flood.work = 0;
+		flood.depth = 0;
+		flood.overflow = false;
+
+		for (int i = job->firstportal[sector]; i < job->firstportal[sector + 1]; i++)
+		{
+			const RejectPortal& source = job->portals[i];
+			RejectSeg seg = { source.x1, source.y1, source.x2, source.y2 };
+
+			visible[source.to] = 1;
+
+			flood.source = &source;
+			flood.sourceseg = seg;
+			P_FloodRejectPortal(flood, source, seg);
+
+			for (size_t j = 0; j < flood.touched.size(); j++)
+			{
+				flood.explored_lo[flood.touched[j]] = 1.0;
+				flood.explored_hi[flood.touched[j]] = 0.0;
+			}
+			flood.touched.clear();
+
+			if (flood.overflow)
+				break;
+		}
+
+		if (flood.overflow)
+			P_FloodRejectConnected(job, sector, &visible[0]);
+
+		// Sight is symmetric, so clear both directions.
+		for (int other = 0; other < count; other++)
+		{
+			if (!visible[other])
+				continue;
+
+			size_t pnum = (size_t)sector * count + other;
+			job->matrix[pnum >> 3] &= ~(1 << (pnum & 7));
+			pnum = (size_t)other * count + sector;
+			job->matrix[pnum >> 3] &= ~(1 << (pnum & 7));
+		}
+	}
+
+	job->rejected = 0;
+	for (size_t pnum = 0; pnum < pairs; pnum++)
+		if (job->matrix[pnum >> 3] & (1 << (pnum & 7)))
+			job->rejected++;
+
+	P_WriteRejectCache(job);
+}
+
+//
+// P_AddRejectPortal
+//
+static void P_AddRejectPortal(std::vector<RejectPortal>& portals, const line_t* line,
+                              const sector_t* to, bool front)
+{
+	RejectPortal portal;
+	portal.x1 = FIXED2DOUBLE(line->v1->x);
+	portal.y1 = FIXED2DOUBLE(line->v1->y);
+	portal.x2 = FIXED2DOUBLE(line->v2->x);
+	portal.y2 = FIXED2DOUBLE(line->v2->y);
+
+	// Unit normal pointing out of the front of the line.
+	double dx = portal.x2 - portal.x1;
+	double dy = portal.y2 - portal.y1;
+	double len = sqrt(dx * dx + dy * dy);
+	double nx = len > 0.0 ? dy / len : 0.0;
+	double ny = len > 0.0 ? -dx / len : 0.0;
+	if (!front)
+	{
+		nx = -nx;
+		ny = -ny;
+	}
+
+	portal.nx = nx;
+	portal.ny = ny;
+	portal.dist = nx * portal.x1 + ny * portal.y1;
+	portal.id = line - lines;
+	portal.to = to - sectors;
+	portal.point = len == 0.0;
+	portals.push_back(portal);
+}
+
+//
+// P_CollectRejectPortals
+//
+static void P_CollectRejectPortals(RejectJob* job)
+{
+	std::vector<std::vector<RejectPortal> > bysector(numsectors);
+
+	// Sectors touching each vertex, and the pairs of them that already have
+	// a two-sided line between them at that vertex.
+	std::vector<std::vector<int> > vertsectors(numvertexes);
+	std::vector<std::vector<std::pair<int, int> > > vertlinked(numvertexes);
+
+	for (int i = 0; i < numlines; i++)
+	{
+		const line_t* line = &lines[i];
+		const sector_t* front = line->frontsector;
+		const sector_t* back = line->backsector;
+
+		const int verts[2] = { int(line->v1 - vertexes), int(line->v2 - vertexes) };
+		for (int v = 0; v < 2; v++)
+		{
+			std::vector<int>& list = vertsectors[verts[v]];
+			if (front && std::find(list.begin(), list.end(), front - sectors) == list.end())
+				list.push_back(front - sectors);
+			if (back && std::find(list.begin(), list.end(), back - sectors) == list.end())
+				list.push_back(back - sectors);
+		}
+
+		if (front == NULL || back == NULL || front == back)
+			continue;
+
+		// The back of the line faces into the back sector.
+		P_AddRejectPortal(bysector[front - sectors], line, back, false);
+		P_AddRejectPortal(bysector[back - sectors], line, front, true);
+
+		for (int v = 0; v < 2; v++)
+		{
+			vertlinked[verts[v]].push_back(std::make_pair(int(front - sectors), int(back - sectors)));
+			vertlinked[verts[v]].push_back(std::make_pair(int(back - sectors), int(front - sectors)));
+		}
+	}
+
+	for (int v = 0; v < numvertexes; v++)
+	{
+		const std::vector<int>& list = vertsectors[v];
+		for (size_t a = 0; a < list.size(); a++)
+		{
+			for (size_t b = 0; b < list.size(); b++)
+			{
+				std::pair<int, int> pair(list[a], list[b]);
+				if (a == b || std::find(vertlinked[v].begin(), vertlinked[v].end(), pair) !=
+				                  vertlinked[v].end())
+					continue;
+
+				RejectPortal portal;
+				portal.x1 = portal.x2 = FIXED2DOUBLE(vertexes[v].x);
+				portal.y1 = portal.y2 = FIXED2DOUBLE(vertexes[v].y);
+				portal.nx = portal.ny = portal.dist = 0.0;
+				portal.id = -1 - v;
+				portal.to = list[b];
+				portal.point = true;
+				bysector[list[a]].push_back(portal);
+			}
+		}
+	}
+
+	job->firstportal.resize(numsectors + 1);
+	for (int i = 0; i < numsectors; i++)
+	{
+		job->firstportal[i] = job->portals.size();
+		job->portals.insert(job->portals.end(), bysector[i].begin(), bysector[i].end());
+	}
+	job->firstportal[numsectors] = job->portals.size();
+}
+
+//
+// P_RejectCacheFile
+//
+static std::string P_RejectCacheFile()
+{
+	std::string name = "reject_";
+	for (size_t i = 0; i < ARRAY_LENGTH(::level.level_fingerprint); i++)
+	{
+		char hex[3];
+		sprintf(hex, "%02x", ::level.level_fingerprint[i]);
+		name += hex;
+	}
+	return M_GetWriteDir() + PATHSEP + name + ".rej";
+}
+
+//
+// P_ReadRejectCache
+//
+static bool P_ReadRejectCache(const std::string& filename)
+{
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if (fp == NULL)
+		return false;
+
+	char magic[4];
+	unsigned int header[2];
+	size_t size = P_RejectBytes(numsectors);
+
+	bool ok = fread(magic, sizeof(magic), 1, fp) == 1 &&
+	          memcmp(magic, REJECT_CACHE_MAGIC, sizeof(magic)) == 0 &&
+	          fread(header, sizeof(header), 1, fp) == 1 &&
+	          header[0] == (unsigned int)numsectors && header[1] == (unsigned int)numlines;
+
+	if (ok)
+	{
+		byte* matrix = (byte*)Z_Malloc(size, PU_LEVEL, 0);
+		if (fread(matrix, size, 1, fp) == 1)
+		{
+			rejectmatrix = matrix;
+			rejectempty = false;
+		}
+		else
+		{
+			Z_Free(matrix);
+			ok = false;
+		}
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+//
+// P_CancelReject
+//
+void P_CancelReject()
+{
+	if (rejectjob == NULL)
+		return;
+
+	I_AtomicStore(&rejectjob->cancel, 1);
+	rejectjob->thread.join();
+	delete rejectjob;
+	rejectjob = NULL;
+}
+
+//
+// P_SetupReject
+//
+void P_SetupReject()
+{
+	P_CancelReject();
+
+	if (!sv_buildreject || demoplayback || numsectors < 2)
+		return;
+
+	// The vanilla sight check can see things the table would reject.
+	if (!co_zdoomphys && !map_format.getZDoom())
+		return;
+
+	// A REJECT lump full of zeroes is what node builders write when they
+	// don't bother working one out.
+	if (!rejectempty)
+	{
+		const byte* matrix = rejectmatrix;
+		size_t size = P_RejectBytes(numsectors);
+		for (size_t i = 0; i < size; i++)
+			if (matrix[i] != 0)
+				return;
+	}
+
+	if (numsectors > REJECT_MAXSECTORS)
+	{
+		DPrintf("Not building REJECT table for %d sectors.\n", numsectors);
+		return;
+	}
+
+	std::string cachefile = P_RejectCacheFile();
+	if (P_ReadRejectCache(cachefile))
+	{
+		P_InvalidateSightCache();
+		DPrintf("Loaded REJECT table from %s.\n", cachefile.c_str());
+		return;
+	}
+
+	// Until the new table is ready, P_CheckSight does without one.
+	rejectempty = true;
+
+	rejectjob = new RejectJob;
+	rejectjob->numsectors = numsectors;
+	rejectjob->numlines = numlines;
+	rejectjob->rejected = 0;
+	rejectjob->cachefile = cachefile;
+	rejectjob->starttime = I_GetTime();
+	rejectjob->cancel = 0;
+	P_CollectRejectPortals(rejectjob);
+
+	if (!rejectjob->thread.start(P_BuildRejectThread, rejectjob))
+	{
+		delete rejectjob;
+		rejectjob = NULL;
+	}
+}
+
+//
+// P_FinishReject
+//
+void P_FinishReject()
+{
+	if (rejectjob == NULL)
+		return;
+
+	rejectjob->thread.join();
+
+	byte* matrix = (byte*)Z_Malloc(rejectjob->matrix.size(), PU_LEVEL, 0);
+	memcpy(matrix, &rejectjob->matrix[0], rejectjob->matrix.size());
+	rejectmatrix = matrix;
+	rejectempty = false;
+
+	P_InvalidateSightCache();
+
+	size_t pairs = (size_t)rejectjob->numsectors * rejectjob->numsectors;
+	DPrintf("Built REJECT table for %d sectors in %u ms, %u%% of pairs rejected.\n",
+	        rejectjob->numsectors,
+	        (unsigned int)I_ConvertTimeToMs(I_GetTime() - rejectjob->starttime),
+	        (unsigned int)((size_t)rejectjob->rejected * 100 / pairs));
+
+	delete rejectjob;
+	rejectjob = NULL;
+}
+
+VERSION_CONTROL (p_reject_cpp, "$Id$")
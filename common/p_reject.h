@@ -0,0 +1,38 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Builds a REJECT table for maps that ship without a usable one.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __P_REJECT_H__
+#define __P_REJECT_H__
+
+// Called by P_SetupLevel once the sectors and lines are loaded and grouped.
+// If the map's REJECT lump is missing, short or all zeroes, loads a cached
+// table from disk or starts building one in the background.
+void P_SetupReject();
+
+// Called at the end of P_SetupLevel.  Waits for a table being built and
+// installs it, so it's in place before the first tic.
+void P_FinishReject();
+
+// Abandons any table still being built.
+void P_CancelReject();
+
+#endif // __P_REJECT_H__
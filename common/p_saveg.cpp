@@ -61,6 +61,253 @@ void P_SerializePlayers (FArchive &arc)
 	}
 }
 
+//
+// Reset snapshots are taken and restored by the same process on the same
+// level, so the value fields of the map geometry are copied in and out as
+// flat blocks rather than one field at a time.  Anything that points at a
+// thinker or an actor still goes through the archive so it gets fixed up.
+//
+struct resetsector_t
+{
+	fixed_t floorheight, ceilingheight;
+	plane_t floorplane, ceilingplane;
+	short floorpic, ceilingpic;
+	short lightlevel, special, tag;
+	bool secretsector;
+	int soundtraversed;
+	int friction, movefactor;
+	int stairlock, prevsec, nextsec;
+	fixed_t floor_xoffs, floor_yoffs;
+	fixed_t ceiling_xoffs, ceiling_yoffs;
+	fixed_t floor_xscale, floor_yscale;
+	fixed_t ceiling_xscale, ceiling_yscale;
+	angle_t floor_angle, ceiling_angle;
+	fixed_t base_ceiling_angle, base_ceiling_yoffs;
+	fixed_t base_floor_angle, base_floor_yoffs;
+	sector_t *heightsec, *floorlightsec, *ceilinglightsec;
+	uint32_t bottommap, midmap, topmap;
+	float gravity;
+	int damageamount, damageinterval, leakrate;
+	short mod;
+	dyncolormap_t *colormap;
+	bool alwaysfake;
+	byte waterzone;
+	WORD MoreFlags;
+};
+
+struct resetline_t
+{
+	unsigned int flags;
+	short special;
+	byte lucency;
+	short id;
+	short args[5];
+};
+
+struct resetside_t
+{
+	fixed_t textureoffset, rowoffset;
+	short toptexture, bottomtexture, midtexture;
+};
+
+//
+// P_SerializeResetWorld
+//
+static void P_SerializeResetWorld (FArchive &arc)
+{
+	std::vector<resetsector_t> secstate(numsectors);
+	std::vector<resetline_t> linestate(numlines);
+	std::vector<resetside_t> sidestate(numsides);
+	int i;
+
+	if (arc.IsStoring ())
+	{
+		for (i = 0; i < numsectors; i++)
+		{
+			const sector_t *sec = &sectors[i];
+			resetsector_t *ss = &secstate[i];
+
+			ss->floorheight = sec->floorheight;
+			ss->ceilingheight = sec->ceilingheight;
+			ss->floorplane = sec->floorplane;
+			ss->ceilingplane = sec->ceilingplane;
+			ss->floorpic = sec->floorpic;
+			ss->ceilingpic = sec->ceilingpic;
+			ss->lightlevel = sec->lightlevel;
+			ss->special = sec->special;
+			ss->tag = sec->tag;
+			ss->secretsector = sec->secretsector;
+			ss->soundtraversed = sec->soundtraversed;
+			ss->friction = sec->friction;
+			ss->movefactor = sec->movefactor;
+			ss->stairlock = sec->stairlock;
+			ss->prevsec = sec->prevsec;
+			ss->nextsec = sec->nextsec;
+			ss->floor_xoffs = sec->floor_xoffs;
+			ss->floor_yoffs = sec->floor_yoffs;
+			ss->ceiling_xoffs = sec->ceiling_xoffs;
+			ss->ceiling_yoffs = sec->ceiling_yoffs;
+			ss->floor_xscale = sec->floor_xscale;
+			ss->floor_yscale = sec->floor_yscale;
+			ss->ceiling_xscale = sec->ceiling_xscale;
+			ss->ceiling_yscale = sec->ceiling_yscale;
+			ss->floor_angle = sec->floor_angle;
+			ss->ceiling_angle = sec->ceiling_angle;
+			ss->base_ceiling_angle = sec->base_ceiling_angle;
+			ss->base_ceiling_yoffs = sec->base_ceiling_yoffs;
+			ss->base_floor_angle = sec->base_floor_angle;
+			ss->base_floor_yoffs = sec->base_floor_yoffs;
+			ss->heightsec = sec->heightsec;
+			ss->floorlightsec = sec->floorlightsec;
+			ss->ceilinglightsec = sec->ceilinglightsec;
+			ss->bottommap = sec->bottommap;
+			ss->midmap = sec->midmap;
+			ss->topmap = sec->topmap;
+			ss->gravity = sec->gravity;
+			ss->damageamount = sec->damageamount;
+			ss->damageinterval = sec->damageinterval;
+			ss->leakrate = sec->leakrate;
+			ss->mod = sec->mod;
+			ss->colormap = sec->colormap;
+			ss->alwaysfake = sec->alwaysfake;
+			ss->waterzone = sec->waterzone;
+			ss->MoreFlags = sec->MoreFlags;
+		}
+
+		for (i = 0; i < numlines; i++)
+		{
+			const line_t *li = &lines[i];
+			resetline_t *ls = &linestate[i];
+
+			ls->flags = li->flags;
+			ls->special = li->special;
+			ls->lucency = li->lucency;
+			ls->id = li->id;
+			memcpy(ls->args, li->args, sizeof(ls->args));
+		}
+
+		for (i = 0; i < numsides; i++)
+		{
+			const side_t *si = &sides[i];
+			resetside_t *ss = &sidestate[i];
+
+			ss->textureoffset = si->textureoffset;
+			ss->rowoffset = si->rowoffset;
+			ss->toptexture = si->toptexture;
+			ss->bottomtexture = si->bottomtexture;
+			ss->midtexture = si->midtexture;
+		}
+
+		if (numsectors)
+			arc.Write(&secstate[0], numsectors * sizeof(resetsector_t));
+		if (numlines)
+			arc.Write(&linestate[0], numlines * sizeof(resetline_t));
+		if (numsides)
+			arc.Write(&sidestate[0], numsides * sizeof(resetside_t));
+
+		for (i = 0; i < numsectors; i++)
+		{
+			arc << sectors[i].floordata
+				<< sectors[i].ceilingdata
+				<< sectors[i].lightingdata
+				<< sectors[i].SecActTarget;
+		}
+	}
+	else
+	{
+		if (numsectors)
+			arc.Read(&secstate[0], numsectors * sizeof(resetsector_t));
+		if (numlines)
+			arc.Read(&linestate[0], numlines * sizeof(resetline_t));
+		if (numsides)
+			arc.Read(&sidestate[0], numsides * sizeof(resetside_t));
+
+		for (i = 0; i < numsectors; i++)
+		{
+			sector_t *sec = &sectors[i];
+			const resetsector_t *ss = &secstate[i];
+			AActor* SecActTarget;
+
+			sec->floorheight = ss->floorheight;
+			sec->ceilingheight = ss->ceilingheight;
+			sec->floorplane = ss->floorplane;
+			sec->ceilingplane = ss->ceilingplane;
+			sec->floorpic = ss->floorpic;
+			sec->ceilingpic = ss->ceilingpic;
+			sec->lightlevel = ss->lightlevel;
+			sec->special = ss->special;
+			sec->tag = ss->tag;
+			sec->secretsector = ss->secretsector;
+			sec->soundtraversed = ss->soundtraversed;
+			sec->friction = ss->friction;
+			sec->movefactor = ss->movefactor;
+			sec->stairlock = ss->stairlock;
+			sec->prevsec = ss->prevsec;
+			sec->nextsec = ss->nextsec;
+			sec->floor_xoffs = ss->floor_xoffs;
+			sec->floor_yoffs = ss->floor_yoffs;
+			sec->ceiling_xoffs = ss->ceiling_xoffs;
+			sec->ceiling_yoffs = ss->ceiling_yoffs;
+			sec->floor_xscale = ss->floor_xscale;
+			sec->floor_yscale = ss->floor_yscale;
+			sec->ceiling_xscale = ss->ceiling_xscale;
+			sec->ceiling_yscale = ss->ceiling_yscale;
+			sec->floor_angle = ss->floor_angle;
+			sec->ceiling_angle = ss->ceiling_angle;
+			sec->base_ceiling_angle = ss->base_ceiling_angle;
+			sec->base_ceiling_yoffs = ss->base_ceiling_yoffs;
+			sec->base_floor_angle = ss->base_floor_angle;
+			sec->base_floor_yoffs = ss->base_floor_yoffs;
+			sec->heightsec = ss->heightsec;
+			sec->floorlightsec = ss->floorlightsec;
+			sec->ceilinglightsec = ss->ceilinglightsec;
+			sec->bottommap = ss->bottommap;
+			sec->midmap = ss->midmap;
+			sec->topmap = ss->topmap;
+			sec->gravity = ss->gravity;
+			sec->damageamount = ss->damageamount;
+			sec->damageinterval = ss->damageinterval;
+			sec->leakrate = ss->leakrate;
+			sec->mod = ss->mod;
+			sec->colormap = ss->colormap;
+			sec->alwaysfake = ss->alwaysfake;
+			sec->waterzone = ss->waterzone;
+			sec->MoreFlags = ss->MoreFlags;
+
+			arc >> sec->floordata
+				>> sec->ceilingdata
+				>> sec->lightingdata
+				>> SecActTarget;
+
+			sec->SecActTarget.init(SecActTarget);
+		}
+
+		for (i = 0; i < numlines; i++)
+		{
+			line_t *li = &lines[i];
+			const resetline_t *ls = &linestate[i];
+
+			li->flags = ls->flags;
+			li->special = ls->special;
+			li->lucency = ls->lucency;
+			li->id = ls->id;
+			memcpy(li->args, ls->args, sizeof(li->args));
+		}
+
+		for (i = 0; i < numsides; i++)
+		{
+			side_t *si = &sides[i];
+			const resetside_t *ss = &sidestate[i];
+
+			si->textureoffset = ss->textureoffset;
+			si->rowoffset = ss->rowoffset;
+			si->toptexture = ss->toptexture;
+			si->bottomtexture = ss->bottomtexture;
+			si->midtexture = ss->midtexture;
+		}
+	}
+}
+
 //
 // P_ArchiveWorld
 //
@@ -70,6 +317,12 @@ void P_SerializeWorld (FArchive &arc)
 	sector_t *sec;
 	line_t *li;
 
+	if (arc.IsReset ())
+	{
+		P_SerializeResetWorld (arc);
+		return;
+	}
+
 	if (arc.IsStoring ())
 	{ // saving to archive
 
@@ -28,6 +28,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <set>
+#include <vector>
+#include <algorithm>
 
 #include "m_alloc.h"
 #include "m_vectors.h"
@@ -50,6 +52,8 @@
 #include "p_setup.h"
 #include "p_hordespawn.h"
 #include "p_mapformat.h"
+#include "p_reject.h"
+#include "i_thread.h"
 
 void SV_PreservePlayer(player_t &player);
 void P_SpawnMapThing (mapthing2_t *mthing, int position);
@@ -1128,57 +1132,212 @@ void P_LoadSideDefs2 (int lump)
                                  // jff 10/8/98 use guardband>0
                                  // jff 10/12/98 0 ok with + 1 in rows,cols
 
-typedef struct linelist_t        // type used to list lines in each block
+// Number of linedefs handed to a worker at a time.
+#define BLOCKMAP_GRAIN 2048
+
+struct blockmapbuild_t
 {
-	int		num;
-	struct	linelist_t *next;
-} linelist_t;
+	int xorg, yorg;						// blockmap origin (lower left)
+	int nrows, ncols;					// blockmap dimensions
+	std::vector<int> *chunkblocks;		// blocks touched by each chunk's lines
+	int *linecount;						// number of blocks each line touches
+};
 
 //
-// Subroutine to add a line number to a block list
-// It simply returns if the line is already in the block
+// P_AddLineBlocks
 //
-
-static void AddBlockLine
-(
-	linelist_t **lists,
-	int *count,
-	int *done,
-	int blockno,
-	DWORD lineno
-)
+// Find every blockmap block that linedef i touches and append their numbers
+// to blocks, each once.
+//
+// This finds the intersection of the linedef with the column and row lines
+// at the left and bottom of each blockmap cell. It then adds the line to all
+// block lists touching the intersection.
+//
+static void P_AddLineBlocks(const blockmapbuild_t *bm, int i, std::vector<int> &blocks)
 {
-	linelist_t *l;
+	const int xorg = bm->xorg, yorg = bm->yorg;
+	const int ncols = bm->ncols, nrows = bm->nrows;
+	const size_t first = blocks.size();
+	int j;
+
+	int x1 = lines[i].v1->x>>FRACBITS;		// lines[i] map coords
+	int y1 = lines[i].v1->y>>FRACBITS;
+	int x2 = lines[i].v2->x>>FRACBITS;
+	int y2 = lines[i].v2->y>>FRACBITS;
+	int dx = x2-x1;
+	int dy = y2-y1;
+	int vert = !dx;							// lines[i] slopetype
+	int horiz = !dy;
+	int spos = (dx^dy) > 0;
+	int sneg = (dx^dy) < 0;
+	int bx,by;								// block cell coords
+	int minx = x1>x2? x2 : x1;				// extremal lines[i] coords
+	int maxx = x1>x2? x1 : x2;
+	int miny = y1>y2? y2 : y1;
+	int maxy = y1>y2? y1 : y2;
+
+	// The line always belongs to the blocks containing its endpoints
+
+	bx = (x1-xorg) >> blkshift;
+	by = (y1-yorg) >> blkshift;
+	blocks.push_back(by*ncols+bx);
+	bx = (x2-xorg) >> blkshift;
+	by = (y2-yorg) >> blkshift;
+	blocks.push_back(by*ncols+bx);
+
+	// For each column, see where the line along its left edge, which
+	// it contains, intersects the Linedef i. Add i to each corresponding
+	// blocklist.  Columns outside [minx, maxx] can't touch the line, so
+	// they're skipped without testing them.
+
+	if (!vert)    // don't interesect vertical lines with columns
+	{
+		const int jmin = MAX((minx-xorg+blkmask)>>blkshift, 0);
+		const int jmax = MIN((maxx-xorg)>>blkshift, ncols-1);
 
-	if (done[blockno])
-		return;
+		for (j=jmin;j<=jmax;j++)
+		{
+			// intersection of Linedef with x=xorg+(j<<blkshift)
+			// (y-y1)*dx = dy*(x-x1)
+			// y = dy*(x-x1)+y1*dx;
+
+			int x = xorg+(j<<blkshift);		// (x,y) is intersection
+			int y = (dy*(x-x1))/dx+y1;
+			int yb = (y-yorg)>>blkshift;	// block row number
+			int yp = (y-yorg)&blkmask;		// y position within block
+
+			if (yb<0 || yb>nrows-1)			// outside blockmap, continue
+				continue;
+
+			if (x<minx || x>maxx)			// line doesn't touch column
+				continue;
+
+			// The cell that contains the intersection point is always added
+
+			blocks.push_back(ncols*yb+j);
+
+			// if the intersection is at a corner it depends on the slope
+			// (and whether the line extends past the intersection) which
+			// blocks are hit
+
+			if (yp==0)			// intersection at a corner
+			{
+				if (sneg)		//   \ - blocks x,y-, x-,y
+				{
+					if (yb>0 && miny<y)
+						blocks.push_back(ncols*(yb-1)+j);
+					if (j>0 && minx<x)
+						blocks.push_back(ncols*yb+j-1);
+				}
+				else if (spos)	//   / - block x-,y-
+				{
+					if (yb>0 && j>0 && minx<x)
+						blocks.push_back(ncols*(yb-1)+j-1);
+				}
+				else if (horiz)	//   - - block x-,y
+				{
+					if (j>0 && minx<x)
+						blocks.push_back(ncols*yb+j-1);
+				}
+			}
+			else if (j>0 && minx<x)	// else not at corner: x-,y
+				blocks.push_back(ncols*yb+j-1);
+		}
+	}
+
+	// For each row, see where the line along its bottom edge, which
+	// it contains, intersects the Linedef i. Add i to all the corresponding
+	// blocklists.
+
+	if (!horiz)
+	{
+		const int jmin = MAX((miny-yorg+blkmask)>>blkshift, 0);
+		const int jmax = MIN((maxy-yorg)>>blkshift, nrows-1);
 
-	l = new linelist_t;
-	l->num = lineno;
-	l->next = lists[blockno];
-	lists[blockno] = l;
-	count[blockno]++;
-	done[blockno] = 1;
+		for (j=jmin;j<=jmax;j++)
+		{
+			// intersection of Linedef with y=yorg+(j<<blkshift)
+			// (x,y) on Linedef i satisfies: (y-y1)*dx = dy*(x-x1)
+			// x = dx*(y-y1)/dy+x1;
+
+			int y = yorg+(j<<blkshift);		// (x,y) is intersection
+			int x = (dx*(y-y1))/dy+x1;
+			int xb = (x-xorg)>>blkshift;	// block column number
+			int xp = (x-xorg)&blkmask;		// x position within block
+
+			if (xb<0 || xb>ncols-1)			// outside blockmap, continue
+				continue;
+
+			if (y<miny || y>maxy)			 // line doesn't touch row
+				continue;
+
+			// The cell that contains the intersection point is always added
+
+			blocks.push_back(ncols*j+xb);
+
+			// if the intersection is at a corner it depends on the slope
+			// (and whether the line extends past the intersection) which
+			// blocks are hit
+
+			if (xp==0)			// intersection at a corner
+			{
+				if (sneg)       //   \ - blocks x,y-, x-,y
+				{
+					if (j>0 && miny<y)
+						blocks.push_back(ncols*(j-1)+xb);
+					if (xb>0 && minx<x)
+						blocks.push_back(ncols*j+xb-1);
+				}
+				else if (vert)  //   | - block x,y-
+				{
+					if (j>0 && miny<y)
+						blocks.push_back(ncols*(j-1)+xb);
+				}
+				else if (spos)  //   / - block x-,y-
+				{
+					if (xb>0 && j>0 && miny<y)
+						blocks.push_back(ncols*(j-1)+xb-1);
+				}
+			}
+			else if (j>0 && miny<y) // else not on a corner: x,y-
+				blocks.push_back(ncols*(j-1)+xb);
+		}
+	}
+
+	// A line is only listed once per block
+	std::sort(blocks.begin() + first, blocks.end());
+	blocks.erase(std::unique(blocks.begin() + first, blocks.end()), blocks.end());
+}
+
+static void P_BlockMapLinesJob(int begin, int end, void *data)
+{
+	const blockmapbuild_t *bm = static_cast<blockmapbuild_t*>(data);
+	std::vector<int> &blocks = bm->chunkblocks[begin / BLOCKMAP_GRAIN];
+
+	for (int i = begin; i < end; i++)
+	{
+		const size_t before = blocks.size();
+		P_AddLineBlocks(bm, i, blocks);
+		bm->linecount[i] = blocks.size() - before;
+	}
 }
 
 //
 // Actually construct the blockmap lump from the level data
 //
-// This finds the intersection of each linedef with the column and
-// row lines at the left and bottom of each blockmap cell. It then
-// adds the line to all block lists touching the intersection.
+// The blocks each linedef touches are found in parallel, then gathered into
+// the lump in linedef order, so the result is the same however the work was
+// split up.  Each block list starts with a 0 and ends with a -1, and lists
+// its lines from highest to lowest number, as the original linked-list
+// version of this code did.
 //
 
 void P_CreateBlockMap()
 {
-	int xorg,yorg;					// blockmap origin (lower left)
-	int nrows,ncols;				// blockmap dimensions
-	linelist_t **blocklists=NULL;	// array of pointers to lists of lines
-	int *blockcount=NULL;			// array of counters of line lists
-	int *blockdone=NULL;			// array keeping track of blocks/line
+	blockmapbuild_t bm;
 	int NBlocks;					// number of cells = nrows*ncols
 	DWORD linetotal=0;				// total length of all blocklists
-	int i,j;
+	int i;
 	int map_minx=MAXINT;			// init for map limits search
 	int map_miny=MAXINT;
 	int map_maxx=MININT;
@@ -1206,188 +1365,35 @@ void P_CreateBlockMap()
 
 	// set up blockmap area to enclose level plus margin
 
-	xorg = map_minx-blkmargin;
-	yorg = map_miny-blkmargin;
-	ncols = (map_maxx+blkmargin-xorg+1+blkmask)>>blkshift;	//jff 10/12/98
-	nrows = (map_maxy+blkmargin-yorg+1+blkmask)>>blkshift;	//+1 needed for
-	NBlocks = ncols*nrows;									//map exactly 1 cell
+	bm.xorg = map_minx-blkmargin;
+	bm.yorg = map_miny-blkmargin;
+	bm.ncols = (map_maxx+blkmargin-bm.xorg+1+blkmask)>>blkshift;	//jff 10/12/98
+	bm.nrows = (map_maxy+blkmargin-bm.yorg+1+blkmask)>>blkshift;	//+1 needed for
+	NBlocks = bm.ncols*bm.nrows;									//map exactly 1 cell
 
-	// create the array of pointers on NBlocks to blocklists
-	// also create an array of linelist counts on NBlocks
-	// finally make an array in which we can mark blocks done per line
+	// For each linedef in the wad, determine all blockmap blocks it touches
 
-	blocklists = new linelist_t *[NBlocks];
-	memset (blocklists, 0, NBlocks*sizeof(linelist_t *));
-	blockcount = new int[NBlocks];
-	memset (blockcount, 0, NBlocks*sizeof(int));
-	blockdone = new int[NBlocks];
+	const int numchunks = (numlines + BLOCKMAP_GRAIN - 1) / BLOCKMAP_GRAIN;
+	bm.chunkblocks = new std::vector<int>[numchunks];
+	bm.linecount = new int[numlines];
 
-	// initialize each blocklist, and enter the trailing -1 in all blocklists
-	// note the linked list of lines grows backwards
+	I_ParallelFor(numlines, BLOCKMAP_GRAIN, P_BlockMapLinesJob, &bm);
 
-	for (i = 0; i < NBlocks; i++)
-	{
-		blocklists[i] = new linelist_t;
-		blocklists[i]->num = -1;
-		blocklists[i]->next = NULL;
-		blockcount[i]++;
-	}
+	// count the lines in each block, plus its initial 0 and trailing -1
 
-	// For each linedef in the wad, determine all blockmap blocks it touches,
-	// and add the linedef number to the blocklists for those blocks
+	int *blockcount = new int[NBlocks];
+	for (i = 0; i < NBlocks; i++)
+		blockcount[i] = 2;
 
-	for (i = 0; i < numlines; i++)
+	for (int c = 0; c < numchunks; c++)
 	{
-		int x1 = lines[i].v1->x>>FRACBITS;		// lines[i] map coords
-		int y1 = lines[i].v1->y>>FRACBITS;
-		int x2 = lines[i].v2->x>>FRACBITS;
-		int y2 = lines[i].v2->y>>FRACBITS;
-		int dx = x2-x1;
-		int dy = y2-y1;
-		int vert = !dx;							// lines[i] slopetype
-		int horiz = !dy;
-		int spos = (dx^dy) > 0;
-		int sneg = (dx^dy) < 0;
-		int bx,by;								// block cell coords
-		int minx = x1>x2? x2 : x1;				// extremal lines[i] coords
-		int maxx = x1>x2? x1 : x2;
-		int miny = y1>y2? y2 : y1;
-		int maxy = y1>y2? y1 : y2;
-
-		// no blocks done for this linedef yet
-
-		memset (blockdone, 0, NBlocks*sizeof(int));
-
-		// The line always belongs to the blocks containing its endpoints
-
-		bx = (x1-xorg) >> blkshift;
-		by = (y1-yorg) >> blkshift;
-		AddBlockLine (blocklists, blockcount, blockdone, by*ncols+bx, i);
-		bx = (x2-xorg) >> blkshift;
-		by = (y2-yorg) >> blkshift;
-		AddBlockLine (blocklists, blockcount, blockdone, by*ncols+bx, i);
-
-		// For each column, see where the line along its left edge, which
-		// it contains, intersects the Linedef i. Add i to each corresponding
-		// blocklist.
-
-		if (!vert)    // don't interesect vertical lines with columns
-		{
-			for (j=0;j<ncols;j++)
-			{
-				// intersection of Linedef with x=xorg+(j<<blkshift)
-				// (y-y1)*dx = dy*(x-x1)
-				// y = dy*(x-x1)+y1*dx;
-
-				int x = xorg+(j<<blkshift);		// (x,y) is intersection
-				int y = (dy*(x-x1))/dx+y1;
-				int yb = (y-yorg)>>blkshift;	// block row number
-				int yp = (y-yorg)&blkmask;		// y position within block
-
-				if (yb<0 || yb>nrows-1)			// outside blockmap, continue
-					continue;
-
-				if (x<minx || x>maxx)			// line doesn't touch column
-					continue;
-
-				// The cell that contains the intersection point is always added
-
-				AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j,i);
-
-				// if the intersection is at a corner it depends on the slope
-				// (and whether the line extends past the intersection) which
-				// blocks are hit
-
-				if (yp==0)			// intersection at a corner
-				{
-					if (sneg)		//   \ - blocks x,y-, x-,y
-					{
-						if (yb>0 && miny<y)
-							AddBlockLine(blocklists, blockcount, blockdone, ncols*(yb-1)+j, i);
-						if (j>0 && minx<x)
-							AddBlockLine(blocklists, blockcount, blockdone, ncols*yb+j-1, i);
-					}
-					else if (spos)	//   / - block x-,y-
-					{
-						if (yb>0 && j>0 && minx<x)
-							AddBlockLine(blocklists,blockcount,blockdone,ncols*(yb-1)+j-1,i);
-					}
-					else if (horiz)	//   - - block x-,y
-					{
-						if (j>0 && minx<x)
-							AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
-					}
-				}
-				else if (j>0 && minx<x)	// else not at corner: x-,y
-					AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
-			}
-		}
-
-		// For each row, see where the line along its bottom edge, which
-		// it contains, intersects the Linedef i. Add i to all the corresponding
-		// blocklists.
-
-		if (!horiz)
-		{
-			for (j=0;j<nrows;j++)
-			{
-				// intersection of Linedef with y=yorg+(j<<blkshift)
-				// (x,y) on Linedef i satisfies: (y-y1)*dx = dy*(x-x1)
-				// x = dx*(y-y1)/dy+x1;
-
-				int y = yorg+(j<<blkshift);		// (x,y) is intersection
-				int x = (dx*(y-y1))/dy+x1;
-				int xb = (x-xorg)>>blkshift;	// block column number
-				int xp = (x-xorg)&blkmask;		// x position within block
-
-				if (xb<0 || xb>ncols-1)			// outside blockmap, continue
-					continue;
-
-				if (y<miny || y>maxy)			 // line doesn't touch row
-					continue;
-
-				// The cell that contains the intersection point is always added
-
-				AddBlockLine (blocklists, blockcount, blockdone, ncols*j+xb, i);
-
-				// if the intersection is at a corner it depends on the slope
-				// (and whether the line extends past the intersection) which
-				// blocks are hit
-
-				if (xp==0)			// intersection at a corner
-				{
-					if (sneg)       //   \ - blocks x,y-, x-,y
-					{
-						if (j>0 && miny<y)
-							AddBlockLine (blocklists, blockcount, blockdone, ncols*(j-1)+xb, i);
-						if (xb>0 && minx<x)
-							AddBlockLine (blocklists, blockcount, blockdone, ncols*j+xb-1, i);
-					}
-					else if (vert)  //   | - block x,y-
-					{
-						if (j>0 && miny<y)
-							AddBlockLine (blocklists, blockcount, blockdone, ncols*(j-1)+xb, i);
-					}
-					else if (spos)  //   / - block x-,y-
-					{
-						if (xb>0 && j>0 && miny<y)
-							AddBlockLine (blocklists, blockcount, blockdone, ncols*(j-1)+xb-1, i);
-					}
-				}
-				else if (j>0 && miny<y) // else not on a corner: x,y-
-					AddBlockLine (blocklists, blockcount, blockdone, ncols*(j-1)+xb, i);
-			}
-		}
+		const std::vector<int> &blocks = bm.chunkblocks[c];
+		for (size_t k = 0; k < blocks.size(); k++)
+			blockcount[blocks[k]]++;
 	}
 
-	// Add initial 0 to all blocklists
-	// count the total number of lines (and 0's and -1's)
-	memset (blockdone, 0, NBlocks*sizeof(int));
-	for (i = 0, linetotal = 0; i < NBlocks; i++)
-	{
-		AddBlockLine (blocklists, blockcount, blockdone, i, 0);
+	for (i = 0; i < NBlocks; i++)
 		linetotal += blockcount[i];
-	}
 
 	// Create the blockmap lump
 	blockmaplump = (int *)Z_Malloc(sizeof(*blockmaplump) * (4+NBlocks+linetotal), PU_LEVEL, 0);
@@ -1405,34 +1411,42 @@ void P_CreateBlockMap()
 	// clauses of the conditional in P_LoadBlockMap have the same effect, and
 	// bmap* are only initialised from blockmaplump[0..3] once in the latter.
 	//
-	blockmaplump[0] = xorg;
-	blockmaplump[1] = yorg;
-	blockmaplump[2] = ncols;
-	blockmaplump[3] = nrows;
+	blockmaplump[0] = bm.xorg;
+	blockmaplump[1] = bm.yorg;
+	blockmaplump[2] = bm.ncols;
+	blockmaplump[3] = bm.nrows;
 
-	// offsets to lists and block lists
+	// offsets to lists, and the 0 and -1 at either end of them.  The lines
+	// are filled in from the back of each list.
+
+	int *blockfill = new int[NBlocks];
 	for (i = 0; i < NBlocks; i++)
 	{
-		linelist_t *bl = blocklists[i];
 		DWORD offs = blockmaplump[4+i] =   // set offset to block's list
 			(i? blockmaplump[4+i-1] : 4+NBlocks) + (i? blockcount[i-1] : 0);
 
-		// add the lines in each block's list to the blockmaplump
-		// delete each list node as we go
+		blockmaplump[offs] = 0;
+		blockmaplump[offs + blockcount[i] - 1] = -1;
+		blockfill[i] = offs + blockcount[i] - 1;
+	}
+
+	for (int c = 0, line = 0; c < numchunks; c++)
+	{
+		const std::vector<int> &blocks = bm.chunkblocks[c];
+		size_t k = 0;
 
-		while (bl)
+		for (const int last = MIN(line + BLOCKMAP_GRAIN, numlines); line < last; line++)
 		{
-			linelist_t *tmp = bl->next;
-			blockmaplump[offs++] = bl->num;
-			delete bl;
-			bl = tmp;
+			for (int n = 0; n < bm.linecount[line]; n++, k++)
+				blockmaplump[--blockfill[blocks[k]]] = line;
 		}
 	}
 
 	// free all temporary storage
-	delete[] blocklists;
+	delete[] bm.chunkblocks;
+	delete[] bm.linecount;
 	delete[] blockcount;
-	delete[] blockdone;
+	delete[] blockfill;
 }
 
 // jff 10/6/98
@@ -1510,13 +1524,16 @@ void P_GenerateUniqueMapFingerPrint(int maplumpnum)
 	const byte* ssectorsbytes = const_cast<const byte*>((const byte*)W_CacheLumpNum(maplumpnum+ML_SSECTORS, PU_STATIC));
 	const byte* sectorsbytes = const_cast<const byte*>((const byte*)W_CacheLumpNum(maplumpnum+ML_SECTORS, PU_STATIC));
 
-	levellumps.insert(levellumps.end(), W_LumpLength(maplumpnum+ML_THINGS), *thingbytes);
-	levellumps.insert(levellumps.end(), W_LumpLength(maplumpnum+ML_LINEDEFS), *lindefbytes);
-	levellumps.insert(levellumps.end(), W_LumpLength(maplumpnum+ML_SIDEDEFS), *sidedefbytes);
-	levellumps.insert(levellumps.end(), W_LumpLength(maplumpnum+ML_VERTEXES), *vertexbytes);
-	levellumps.insert(levellumps.end(), W_LumpLength(maplumpnum+ML_SEGS), *segsbytes);
-	levellumps.insert(levellumps.end(), W_LumpLength(maplumpnum+ML_SSECTORS), *ssectorsbytes);
-	levellumps.insert(levellumps.end(), W_LumpLength(maplumpnum+ML_SECTORS), *sectorsbytes);
+	// Hash the contents of the lumps, not just their first bytes, and don't
+	// let the previous map's lumps leak into this map's fingerprint.
+	levellumps.clear();
+	levellumps.insert(levellumps.end(), thingbytes, thingbytes + W_LumpLength(maplumpnum+ML_THINGS));
+	levellumps.insert(levellumps.end(), lindefbytes, lindefbytes + W_LumpLength(maplumpnum+ML_LINEDEFS));
+	levellumps.insert(levellumps.end(), sidedefbytes, sidedefbytes + W_LumpLength(maplumpnum+ML_SIDEDEFS));
+	levellumps.insert(levellumps.end(), vertexbytes, vertexbytes + W_LumpLength(maplumpnum+ML_VERTEXES));
+	levellumps.insert(levellumps.end(), segsbytes, segsbytes + W_LumpLength(maplumpnum+ML_SEGS));
+	levellumps.insert(levellumps.end(), ssectorsbytes, ssectorsbytes + W_LumpLength(maplumpnum+ML_SSECTORS));
+	levellumps.insert(levellumps.end(), sectorsbytes, sectorsbytes + W_LumpLength(maplumpnum+ML_SECTORS));
 
 	length = W_LumpLength(maplumpnum+ML_THINGS) + W_LumpLength(maplumpnum+ML_LINEDEFS) +
 	         W_LumpLength(maplumpnum+ML_SIDEDEFS) + W_LumpLength(maplumpnum+ML_VERTEXES) +
@@ -1527,6 +1544,54 @@ void P_GenerateUniqueMapFingerPrint(int maplumpnum)
 
 	ArrayCopy(::level.level_fingerprint, fingerprint.fingerprint);
 }
+
+// Number of sectors handed to a worker at a time.
+#define GROUPLINES_GRAIN 512
+
+//
+// P_SectorBoundsJob
+//
+// Finds the bounding box of each sector's lines, and from it the sector's
+// sound origin and block bounding box.
+//
+static void P_SectorBoundsJob(int begin, int end, void *data)
+{
+	for (int i = begin; i < end; i++)
+	{
+		sector_t *sector = &sectors[i];
+		DBoundingBox bbox;
+		int block;
+
+		for (int j = 0; j < sector->linecount; j++)
+		{
+			const line_t *li = sector->lines[j];
+			bbox.AddToBox (li->v1->x, li->v1->y);
+			bbox.AddToBox (li->v2->x, li->v2->y);
+		}
+
+		// set the soundorg to the middle of the bounding box
+		sector->soundorg[0] = (bbox.Right()+bbox.Left())/2;
+		sector->soundorg[1] = (bbox.Top()+bbox.Bottom())/2;
+
+		// adjust bounding box to map blocks
+		block = (bbox.Top()-bmaporgy+MAXRADIUS)>>MAPBLOCKSHIFT;
+		block = block >= bmapheight ? bmapheight-1 : block;
+		sector->blockbox[BOXTOP]=block;
+
+		block = (bbox.Bottom()-bmaporgy-MAXRADIUS)>>MAPBLOCKSHIFT;
+		block = block < 0 ? 0 : block;
+		sector->blockbox[BOXBOTTOM]=block;
+
+		block = (bbox.Right()-bmaporgx+MAXRADIUS)>>MAPBLOCKSHIFT;
+		block = block >= bmapwidth ? bmapwidth-1 : block;
+		sector->blockbox[BOXRIGHT]=block;
+
+		block = (bbox.Left()-bmaporgx-MAXRADIUS)>>MAPBLOCKSHIFT;
+		block = block < 0 ? 0 : block;
+		sector->blockbox[BOXLEFT]=block;
+	}
+}
+
 //
 // P_GroupLines
 // Builds sector line lists and subsector sector numbers.
@@ -1536,12 +1601,9 @@ void P_GroupLines (void)
 {
 	line_t**			linebuffer;
 	int 				i;
-	int 				j;
 	int 				total;
 	line_t* 			li;
 	sector_t*			sector;
-	DBoundingBox		bbox;
-	int 				block;
 
 	// look up sector number for each subsector
 	for (i = 0; i < numsubsectors; i++)
@@ -1575,48 +1637,29 @@ void P_GroupLines (void)
 		}
 	}
 
-	// build line tables for each sector
+	// build line tables for each sector, in one pass over the lines.  The
+	// tables are laid out in sector order and each lists its lines in
+	// linedef order.
 	linebuffer = (line_t **)Z_Malloc (total*sizeof(line_t *), PU_LEVEL, 0);
 	sector = sectors;
 	for (i=0 ; i<numsectors ; i++, sector++)
 	{
-		bbox.ClearBox ();
 		sector->lines = linebuffer;
-		li = lines;
-		for (j=0 ; j<numlines ; j++, li++)
-		{
-			if (li->frontsector == sector || li->backsector == sector)
-			{
-				*linebuffer++ = li;
-				bbox.AddToBox (li->v1->x, li->v1->y);
-				bbox.AddToBox (li->v2->x, li->v2->y);
-			}
-		}
-		if (linebuffer - sector->lines != sector->linecount)
-			I_Error ("P_GroupLines: miscounted");
-
-		// set the soundorg to the middle of the bounding box
-		sector->soundorg[0] = (bbox.Right()+bbox.Left())/2;
-		sector->soundorg[1] = (bbox.Top()+bbox.Bottom())/2;
-
-		// adjust bounding box to map blocks
-		block = (bbox.Top()-bmaporgy+MAXRADIUS)>>MAPBLOCKSHIFT;
-		block = block >= bmapheight ? bmapheight-1 : block;
-		sector->blockbox[BOXTOP]=block;
-
-		block = (bbox.Bottom()-bmaporgy-MAXRADIUS)>>MAPBLOCKSHIFT;
-		block = block < 0 ? 0 : block;
-		sector->blockbox[BOXBOTTOM]=block;
+		linebuffer += sector->linecount;
+		sector->linecount = 0;
+	}
 
-		block = (bbox.Right()-bmaporgx+MAXRADIUS)>>MAPBLOCKSHIFT;
-		block = block >= bmapwidth ? bmapwidth-1 : block;
-		sector->blockbox[BOXRIGHT]=block;
+	li = lines;
+	for (i = 0; i < numlines; i++, li++)
+	{
+		if (li->frontsector)
+			li->frontsector->lines[li->frontsector->linecount++] = li;
 
-		block = (bbox.Left()-bmaporgx-MAXRADIUS)>>MAPBLOCKSHIFT;
-		block = block < 0 ? 0 : block;
-		sector->blockbox[BOXLEFT]=block;
+		if (li->backsector && li->backsector != li->frontsector)
+			li->backsector->lines[li->backsector->linecount++] = li;
 	}
 
+	I_ParallelFor(numsectors, GROUPLINES_GRAIN, P_SectorBoundsJob, NULL);
 }
 
 //
@@ -1665,11 +1708,61 @@ void P_GroupLines (void)
 // Firelines (TM) is a Rezistered Trademark of MBF Productions
 //
 
+// Number of vertexes handed to a worker at a time.
+#define SLIMETRAIL_GRAIN 4096
+
+struct slimetrails_t
+{
+	int *first;				// 2*seg+side of the first visit to each vertex
+	int *after;				// first visit of the vertex it's projected from
+	fixed_t *newx, *newy;	// projected positions
+};
+
+//
+// P_ProjectSlimeVertex
+//
+// Project the vertex back onto the parent linedef
+//
+static void P_ProjectSlimeVertex(const vertex_t *v, const line_t *l, fixed_t *x, fixed_t *y)
+{
+	int64_t dx2 = (l->dx >> FRACBITS) * (l->dx >> FRACBITS);
+	int64_t dy2 = (l->dy >> FRACBITS) * (l->dy >> FRACBITS);
+	int64_t dxy = (l->dx >> FRACBITS) * (l->dy >> FRACBITS);
+	int64_t s = dx2 + dy2;
+	fixed_t x0 = v->x, y0 = v->y, x1 = l->v1->x, y1 = l->v1->y;
+	*x = (fixed_t)((dx2 * x0 + dy2 * x1 + dxy * (y0 - y1)) / s);
+	*y = (fixed_t)((dy2 * y0 + dx2 * y1 + dxy * (x0 - x1)) / s);
+}
+
+static void P_SlimeTrailsJob(int begin, int end, void *data)
+{
+	slimetrails_t *st = static_cast<slimetrails_t*>(data);
+
+	for (int i = begin; i < end; i++)
+	{
+		if (st->first[i] >= 0 && st->after[i] < 0)
+			P_ProjectSlimeVertex(&vertexes[i], segs[st->first[i] >> 1].linedef,
+			                     &st->newx[i], &st->newy[i]);
+	}
+}
+
+static bool P_CmpSlimeVisit(const std::pair<int, int> &a, const std::pair<int, int> &b)
+{
+	return a.first < b.first;
+}
+
 static void P_RemoveSlimeTrails()
 {
-	byte* hit = (byte *)Z_Malloc(numvertexes, PU_LEVEL, 0);
-	memset(hit, 0, numvertexes * sizeof(byte));
+	slimetrails_t st;
+	st.first = new int[numvertexes];
+	st.after = new int[numvertexes];
+	st.newx = new fixed_t[numvertexes];
+	st.newy = new fixed_t[numvertexes];
+
+	for (int i = 0; i < numvertexes; i++)
+		st.first[i] = st.after[i] = -1;
 
+	// Find which seg gets to each vertex first
 	for (int i = 0; i < numsegs; i++)
 	{
 		const line_t *l = segs[i].linedef;		// The parent linedef
@@ -1677,29 +1770,63 @@ static void P_RemoveSlimeTrails()
 		// We can ignore orthogonal lines
 		if (l->slopetype != ST_VERTICAL && l->slopetype != ST_HORIZONTAL)
 		{
-			vertex_t *v = segs[i].v1;
-			do
-			{
-				if (!hit[v - vertexes])				// If we haven't processed vertex
-				{
-					hit[v - vertexes] = 1;			// Mark this vertex as processed
-					if (v != l->v1 && v != l->v2)	// Exclude endpoints of linedefs
-					{
-						// Project the vertex back onto the parent linedef
-						int64_t dx2 = (l->dx >> FRACBITS) * (l->dx >> FRACBITS);
-						int64_t dy2 = (l->dy >> FRACBITS) * (l->dy >> FRACBITS);
-						int64_t dxy = (l->dx >> FRACBITS) * (l->dy >> FRACBITS);
-						int64_t s = dx2 + dy2;
-						fixed_t x0 = v->x, y0 = v->y, x1 = l->v1->x, y1 = l->v1->y;
-						v->x = (fixed_t)((dx2 * x0 + dy2 * x1 + dxy * (y0 - y1)) / s);
-						v->y = (fixed_t)((dy2 * y0 + dx2 * y1 + dxy * (x0 - x1)) / s);
-					}
-				}  // Obsfucated C contest entry:   :)
-			} while ((v != segs[i].v2) && (v = segs[i].v2));
+			if (st.first[segs[i].v1 - vertexes] < 0)
+				st.first[segs[i].v1 - vertexes] = 2 * i;
+			if (segs[i].v2 != segs[i].v1 && st.first[segs[i].v2 - vertexes] < 0)
+				st.first[segs[i].v2 - vertexes] = 2 * i + 1;
 		}
 	}
 
-	Z_Free(hit);
+	// Endpoints of the linedef aren't moved
+	for (int i = 0; i < numvertexes; i++)
+	{
+		if (st.first[i] >= 0)
+		{
+			const line_t *l = segs[st.first[i] >> 1].linedef;
+			if (&vertexes[i] == l->v1 || &vertexes[i] == l->v2)
+				st.first[i] = -1;
+		}
+	}
+
+	// A vertex is projected using the position of its linedef's first
+	// vertex at the time.  If that vertex is moved earlier on, the result
+	// depends on it, so those are done afterwards in the original order.
+	std::vector<std::pair<int, int> > ordered;
+	for (int i = 0; i < numvertexes; i++)
+	{
+		if (st.first[i] < 0)
+			continue;
+
+		const int from = segs[st.first[i] >> 1].linedef->v1 - vertexes;
+		if (st.first[from] >= 0 && st.first[from] < st.first[i])
+		{
+			st.after[i] = st.first[from];
+			ordered.push_back(std::make_pair(st.first[i], i));
+		}
+	}
+
+	I_ParallelFor(numvertexes, SLIMETRAIL_GRAIN, P_SlimeTrailsJob, &st);
+
+	for (int i = 0; i < numvertexes; i++)
+	{
+		if (st.first[i] >= 0 && st.after[i] < 0)
+		{
+			vertexes[i].x = st.newx[i];
+			vertexes[i].y = st.newy[i];
+		}
+	}
+
+	std::sort(ordered.begin(), ordered.end(), P_CmpSlimeVisit);
+	for (size_t k = 0; k < ordered.size(); k++)
+	{
+		vertex_t *v = &vertexes[ordered[k].second];
+		P_ProjectSlimeVertex(v, segs[ordered[k].first >> 1].linedef, &v->x, &v->y);
+	}
+
+	delete[] st.first;
+	delete[] st.after;
+	delete[] st.newx;
+	delete[] st.newy;
 }
 
 //
@@ -1749,6 +1876,45 @@ static void P_InitTagLists(void)
 	}
 }
 
+//
+// MapLoadTimer
+//
+// With -maploadbench, prints how long each stage of P_SetupLevel took.
+//
+class MapLoadTimer
+{
+  public:
+	MapLoadTimer() : m_enabled(Args.CheckParm("-maploadbench") != 0)
+	{
+		m_start = m_last = I_GetTime();
+	}
+
+	void stage(const char *name)
+	{
+		if (!m_enabled)
+			return;
+
+		const dtime_t now = I_GetTime();
+		Printf(PRINT_HIGH, "  %-24s %9.2f ms\n", name, double(now - m_last) / 1000000.0);
+		m_last = now;
+	}
+
+	void finish(const char *lumpname)
+	{
+		if (!m_enabled)
+			return;
+
+		Printf(PRINT_HIGH, "%s: %d lines, %d sectors, %d segs loaded in %.2f ms\n",
+		       lumpname, numlines, numsectors, numsegs,
+		       double(I_GetTime() - m_start) / 1000000.0);
+	}
+
+  private:
+	bool m_enabled;
+	dtime_t m_start;
+	dtime_t m_last;
+};
+
 // [RH] position indicates the start spot to spawn at
 void P_SetupLevel (const char *lumpname, int position)
 {
@@ -1787,12 +1953,17 @@ void P_SetupLevel (const char *lumpname, int position)
 	// [AM] So shootthing isn't a wild pointer on map swtich.
 	shootthing = NULL;
 
+	MapLoadTimer timer;
+
 	DThinker::DestroyAllThinkers ();
+	P_CancelReject();
 	Z_FreeTags (PU_LEVEL, PU_LEVELMAX);
 	NormalLight.next = NULL;	// [RH] Z_FreeTags frees all the custom colormaps
+	P_InvalidateSightCache();
 
 	// [AM] Every new level starts with fresh netids.
 	P_ClearAllNetIds();
+	timer.stage("free previous level");
 
 	// UNUSED W_Profile ();
 
@@ -1828,16 +1999,22 @@ void P_SetupLevel (const char *lumpname, int position)
 	P_LoadVertexes (lumpnum+ML_VERTEXES);
 	P_LoadSectors (lumpnum+ML_SECTORS);
 	P_LoadSideDefs (lumpnum+ML_SIDEDEFS);
+	timer.stage("vertexes and sectors");
 	if (!HasBehavior)
 		P_LoadLineDefs (lumpnum+ML_LINEDEFS);
 	else
 		P_LoadLineDefs2 (lumpnum+ML_LINEDEFS);	// [RH] Load Hexen-style linedefs
 	P_LoadSideDefs2 (lumpnum+ML_SIDEDEFS);
 	P_FinishLoadingLineDefs ();
+	timer.stage("linedefs and sidedefs");
 	P_LoadBlockMap (lumpnum+ML_BLOCKMAP);
+	timer.stage("blockmap");
+	P_InitBlockLines ();
+	timer.stage("blockmap line records");
 
 	// [Blair] Create map fingerprint
 	P_GenerateUniqueMapFingerPrint(lumpnum);
+	timer.stage("fingerprint");
 
 	if (!P_LoadXNOD(lumpnum+ML_NODES))
 	{
@@ -1845,8 +2022,10 @@ void P_SetupLevel (const char *lumpname, int position)
 		P_LoadNodes (lumpnum+ML_NODES);
 		P_LoadSegs (lumpnum+ML_SEGS);
 	}
+	timer.stage("nodes");
 
 	rejectmatrix = (byte *)W_CacheLumpNum (lumpnum+ML_REJECT, PU_LEVEL);
+	rejectempty = false;
 	{
 		// [SL] 2011-07-01 - Check to see if the reject table is of the proper size
 		// If it's too short, the reject table should be ignored when
@@ -1858,16 +2037,24 @@ void P_SetupLevel (const char *lumpname, int position)
 		}
 	}
 	P_GroupLines ();
+	timer.stage("group lines");
+
+	// Build a REJECT table in the background if the map doesn't have one.
+	P_SetupReject();
+	timer.stage("reject");
 
 	// [SL] don't move seg vertices if compatibility is cruical
 	if (!demoplayback)
 		P_RemoveSlimeTrails();
+	timer.stage("slime trails");
 
 	P_SetupSlopes();
+	timer.stage("slopes");
 
     po_NumPolyobjs = 0;
 
 	P_InitTagLists();   // killough 1/30/98: Create xref tables for tags
+	timer.stage("tag lists");
 
 	if (!HasBehavior)
 		P_LoadThings (lumpnum+ML_THINGS);
@@ -1876,8 +2063,11 @@ void P_SetupLevel (const char *lumpname, int position)
 
 	if (!HasBehavior)
 		P_TranslateTeleportThings(); // [RH] Assign teleport destination TIDs
+	timer.stage("things");
 
     PO_Init ();
+	P_FlagPolyobjBlockLines ();
+	timer.stage("polyobjects");
 
     if (serverside)
     {
@@ -1902,6 +2092,7 @@ void P_SetupLevel (const char *lumpname, int position)
 
 	// set up world state
 	P_SetupWorldState();
+	timer.stage("players and world state");
 
 	// build subsector connect matrix
 	//	UNUSED P_ConnectSubsectors ();
@@ -1910,7 +2101,13 @@ void P_SetupLevel (const char *lumpname, int position)
 	// preload graphics
 	if (precache)
 		R_PrecacheLevel ();
+	timer.stage("precache");
 #endif
+
+	P_FinishReject();
+	timer.stage("reject wait");
+
+	timer.finish(lumpname);
 }
 
 //
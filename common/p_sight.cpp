@@ -32,6 +32,10 @@
 #include "m_random.h"
 #include "m_vectors.h"
 #include "p_mapformat.h"
+#include "c_dispatch.h"
+#include "i_thread.h"
+
+#include <vector>
 
 // State.
 #include "r_state.h"
@@ -43,10 +47,6 @@ fixed_t		sightzstart;		// eye z of looker
 fixed_t		topslope;
 fixed_t		bottomslope;		// slopes to top and bottom of target
 
-divline_t	strace;			// from t1 to t2
-fixed_t		t2x;
-fixed_t		t2y;
-
 int		sightcounts[2];
 int		sightcounts2[3];
 
@@ -214,10 +214,7 @@ bool P_SightBlockLinesIterator (int x, int y)
 
 bool P_SightTraverseIntercepts ( void )
 {
-	size_t  count = intercepts.Size();
-	fixed_t dist;
 	size_t	scan;
-	intercept_t *in = 0;
 	divline_t dl;
 //
 // calculate intercept distance
@@ -234,20 +231,12 @@ bool P_SightTraverseIntercepts ( void )
 //
 // go through in order
 //
-	while (count--)
-	{
-		dist = MAXINT;
-		for (scan = 0 ; scan < intercepts.Size(); scan++)
-			if (intercepts[scan].frac < dist)
-			{
-				dist = intercepts[scan].frac;
-				in = &intercepts[scan];
-			}
+	P_SortIntercepts();
 
-		if ( !PTR_SightTraverse (in) )
+	for (scan = 0 ; scan < intercepts.Size(); scan++)
+	{
+		if ( !PTR_SightTraverse (&intercepts[scan]) )
 			return false;					// don't bother going farther
-			
-		in->frac = MAXINT;
 	}
 
 	return true;			// everything was traversed
@@ -605,12 +594,50 @@ P_InterceptVector2
     return frac;
 }
 
+//
+// Everything a vanilla sight trace keeps track of while it walks the BSP.
+// The main thread has its own, and sight checks traced on worker threads
+// borrow one each from a pool.
+//
+typedef struct
+{
+	fixed_t				sightzstart;	// eye z of looker
+	fixed_t				topslope;
+	fixed_t				bottomslope;	// slopes to top and bottom of target
+	divline_t			strace;			// from t1 to t2
+	fixed_t				t2x;
+	fixed_t				t2y;
+	std::vector<int>	linestamps;		// lines checked, in place of validcount
+	int					stamp;
+} sighttrace_t;
+
+static sighttrace_t mainsighttrace;
+
+static std::vector<sighttrace_t*> sparesighttraces;
+static OMutex sparesighttracelock;
+
+//
+// P_BeginSightTrace
+//
+// Gets a trace ready to be used for a new sight check.
+//
+static void P_BeginSightTrace(sighttrace_t* st)
+{
+	if (st->linestamps.size() != (size_t)numlines || st->stamp == MAXINT)
+	{
+		st->linestamps.assign(numlines, 0);
+		st->stamp = 0;
+	}
+
+	st->stamp++;
+}
+
 //
 // P_CrossSubsector
 // Returns true
 //  if strace crosses the given subsector successfully.
 //
-bool P_CrossSubsector (int num)
+static bool P_CrossSubsector (sighttrace_t* st, int num)
 {
     seg_t*		seg;
     line_t*		line;
@@ -646,15 +673,15 @@ bool P_CrossSubsector (int num)
 		line = seg->linedef;
 		
 		// allready checked other side?
-		if (line->validcount == validcount)
+		if (st->linestamps[line - lines] == st->stamp)
 			continue;
 		
-		line->validcount = validcount;
+		st->linestamps[line - lines] = st->stamp;
 		
 		v1 = line->v1;
 		v2 = line->v2;
-		s1 = P_DivlineSide (v1->x,v1->y, &strace);
-		s2 = P_DivlineSide (v2->x, v2->y, &strace);
+		s1 = P_DivlineSide (v1->x,v1->y, &st->strace);
+		s2 = P_DivlineSide (v2->x, v2->y, &st->strace);
 		
 		// line isn't crossed?
 		if (s1 == s2)
@@ -664,8 +691,8 @@ bool P_CrossSubsector (int num)
 		divl.y = v1->y;
 		divl.dx = v2->x - v1->x;
 		divl.dy = v2->y - v1->y;
-		s1 = P_DivlineSide (strace.x, strace.y, &divl);
-		s2 = P_DivlineSide (t2x, t2y, &divl);
+		s1 = P_DivlineSide (st->strace.x, st->strace.y, &divl);
+		s2 = P_DivlineSide (st->t2x, st->t2y, &divl);
 		
 		// line isn't crossed?
 		if (s1 == s2)
@@ -680,7 +707,7 @@ bool P_CrossSubsector (int num)
 		front = seg->frontsector;
 		back = seg->backsector;
 
-		frac = P_InterceptVector2 (&strace, &divl);
+		frac = P_InterceptVector2 (&st->strace, &divl);
 		
 		// no wall to block sight with?
 		fixed_t crossx = divl.x + FixedMul(frac, divl.dx);
@@ -713,19 +740,19 @@ bool P_CrossSubsector (int num)
 		
 		if (ff != bf)
 		{
-			slope = FixedDiv (openbottom - sightzstart , frac);
-			if (slope > bottomslope)
-				bottomslope = slope;
+			slope = FixedDiv (openbottom - st->sightzstart , frac);
+			if (slope > st->bottomslope)
+				st->bottomslope = slope;
 		}
 		
 		if (fc != bc)
 		{
-			slope = FixedDiv (opentop - sightzstart , frac);
-			if (slope < topslope)
-				topslope = slope;
+			slope = FixedDiv (opentop - st->sightzstart , frac);
+			if (slope < st->topslope)
+				st->topslope = slope;
 		}
 		
-		if (topslope <= bottomslope)
+		if (st->topslope <= st->bottomslope)
 			return false;		// stop				
     }
     // passed the subsector ok
@@ -739,7 +766,7 @@ bool P_CrossSubsector (int num)
 // Returns true
 //  if strace crosses the given node successfully.
 //
-bool P_CrossBSPNode (int bspnum)
+static bool P_CrossBSPNode (sighttrace_t* st, int bspnum)
 {
     node_t*	bsp;
     int		side;
@@ -747,33 +774,60 @@ bool P_CrossBSPNode (int bspnum)
     if (bspnum & NF_SUBSECTOR)
     {
 		if (bspnum == -1)
-			return P_CrossSubsector (0);
+			return P_CrossSubsector (st, 0);
 		else
-			return P_CrossSubsector (bspnum&(~NF_SUBSECTOR));
+			return P_CrossSubsector (st, bspnum&(~NF_SUBSECTOR));
     }
 	
     bsp = &nodes[bspnum];
     
     // decide which side the start point is on
-    side = P_DivlineSide (strace.x, strace.y, (divline_t *)bsp);
+    side = P_DivlineSide (st->strace.x, st->strace.y, (divline_t *)bsp);
     if (side == 2)
 		side = 0;	// an "on" should cross both sides
 	
     // cross the starting side
-    if (!P_CrossBSPNode (bsp->children[side]) )
+    if (!P_CrossBSPNode (st, bsp->children[side]) )
 		return false;
 	
     // the partition plane is crossed here
-    if (side == P_DivlineSide (t2x, t2y,(divline_t *)bsp))
+    if (side == P_DivlineSide (st->t2x, st->t2y,(divline_t *)bsp))
     {
 		// the line doesn't touch the other side
 		return true;
     }
     
     // cross the ending side		
-    return P_CrossBSPNode (bsp->children[side^1]);
+    return P_CrossBSPNode (st, bsp->children[side^1]);
 }
 
+//
+// P_TraceSightDoom
+//
+// Looks from the eyes of the first thing to any part of the second once
+// REJECT has said it's possible.
+//
+static bool P_TraceSightDoom
+( sighttrace_t* st,
+  fixed_t x1, fixed_t y1, fixed_t z1, fixed_t h1,
+  fixed_t x2, fixed_t y2, fixed_t z2, fixed_t h2 )
+{
+	P_BeginSightTrace(st);
+
+	st->sightzstart = z1 + h1 - (h1>>2);
+	st->topslope = (z2+h2) - st->sightzstart;
+	st->bottomslope = (z2) - st->sightzstart;
+
+	st->strace.x = x1;
+	st->strace.y = y1;
+	st->t2x = x2;
+	st->t2y = y2;
+	st->strace.dx = x2 - x1;
+	st->strace.dy = y2 - y1;
+
+	// the head node is the last node output
+	return P_CrossBSPNode (st, numnodes-1);
+}
 
 //
 // P_CheckSight
@@ -813,22 +867,9 @@ bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
     sightcounts[1]++;
-	
-    validcount++;
-	
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
-	
-    strace.x = t1->x;
-    strace.y = t1->y;
-    t2x = t2->x;
-    t2y = t2->y;
-    strace.dx = t2->x - t1->x;
-    strace.dy = t2->y - t1->y;
-	
-    // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+
+	return P_TraceSightDoom(&mainsighttrace, t1->x, t1->y, t1->z, t1->height,
+	                        t2->x, t2->y, t2->z, t2->height);
 }
 
 //
@@ -868,31 +909,233 @@ static bool P_CheckSightDoom
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
     sightcounts[1]++;
-	
-    validcount++;
-	
-    sightzstart = z1 + h1 - (h1>>2);
-    topslope = (z2+h2) - sightzstart;
-    bottomslope = (z2) - sightzstart;
-	
-    strace.x = x1;
-    strace.y = y1;
-    t2x = x2;
-    t2y = y2;
-    strace.dx = x2 - x1;
-    strace.dy = y2 - y1;
-	
-    // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+
+	return P_TraceSightDoom(&mainsighttrace, x1, y1, z1, h1, x2, y2, z2, h2);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//  Sight Check Cache
+/////////////////////////////////////////////////////////////////////////////
+
+//
+// Monsters repeat the same sight checks several times in a tic (A_Chase,
+// P_CheckMissileRange, A_FaceTarget code pointers...) and idle monsters
+// keep looking at players that have not moved. Results are cached keyed on
+// both actors and everything about them a sight check reads. The cache is
+// flushed at the start of every tic and whenever a floor, ceiling or
+// polyobject moves, so it never returns a result the full check would not.
+//
+
+#define SIGHTCACHE_SIZE		4096	// must be a power of two
+
+typedef struct
+{
+	unsigned int		generation;
+	const AActor*		t1;
+	const AActor*		t2;
+	const subsector_t*	ss1;
+	const subsector_t*	ss2;
+	fixed_t				x1, y1, z1, h1;
+	fixed_t				x2, y2, z2, h2;
+	bool				zdoom;
+	bool				result;
+} sightcache_t;
+
+static sightcache_t sightcache[SIGHTCACHE_SIZE];
+static unsigned int sightcache_generation = 1;
+
+static unsigned int sightcache_hits;
+static unsigned int sightcache_misses;
+static unsigned int sightcache_prefetched;
+
+//
+// P_InvalidateSightCache
+//
+// Forgets every cached sight check result.
+//
+void P_InvalidateSightCache()
+{
+	// Generation 0 is never valid, so wrapping around clears the table.
+	if (++sightcache_generation == 0)
+	{
+		memset(sightcache, 0, sizeof(sightcache));
+		sightcache_generation = 1;
+	}
+}
+
+static inline bool P_SightCacheMatches(const sightcache_t* entry, const AActor* t1,
+                                       const AActor* t2, bool zdoom)
+{
+	return entry->generation == sightcache_generation &&
+	       entry->t1 == t1 && entry->t2 == t2 && entry->zdoom == zdoom &&
+	       entry->ss1 == t1->subsector && entry->ss2 == t2->subsector &&
+	       entry->x1 == t1->x && entry->y1 == t1->y &&
+	       entry->z1 == t1->z && entry->h1 == t1->height &&
+	       entry->x2 == t2->x && entry->y2 == t2->y &&
+	       entry->z2 == t2->z && entry->h2 == t2->height;
+}
+
+static sightcache_t* P_SightCacheEntry(const AActor* t1, const AActor* t2)
+{
+	size_t hash = (size_t(t1) >> 3) * 2654435761u ^ (size_t(t2) >> 3);
+	return &sightcache[(hash ^ (hash >> 16)) & (SIGHTCACHE_SIZE - 1)];
+}
+
+static void P_StoreSightCache(sightcache_t* entry, const AActor* t1, const AActor* t2,
+                              bool zdoom, bool result)
+{
+	entry->generation = sightcache_generation;
+	entry->t1 = t1;
+	entry->t2 = t2;
+	entry->ss1 = t1->subsector;
+	entry->ss2 = t2->subsector;
+	entry->x1 = t1->x;
+	entry->y1 = t1->y;
+	entry->z1 = t1->z;
+	entry->h1 = t1->height;
+	entry->x2 = t2->x;
+	entry->y2 = t2->y;
+	entry->z2 = t2->z;
+	entry->h2 = t2->height;
+	entry->zdoom = zdoom;
+	entry->result = result;
 }
 
 bool P_CheckSight(const AActor* t1, const AActor* t2)
+{
+	if (!t1 || !t2 || !t1->subsector || !t2->subsector)
+		return false;
+
+	const bool zdoom = co_zdoomphys || map_format.getZDoom();
+
+	sightcache_t* entry = P_SightCacheEntry(t1, t2);
+
+	if (P_SightCacheMatches(entry, t1, t2, zdoom))
+	{
+		sightcache_hits++;
+		return entry->result;
+	}
+
+	sightcache_misses++;
+
+	const bool result = zdoom ? P_CheckSightZDoom(t1, t2) : P_CheckSightDoom(t1, t2);
+
+	P_StoreSightCache(entry, t1, t2, zdoom, result);
+
+	return result;
+}
+
+struct sightprefetch_t
+{
+	std::vector<const AActor*> t1;
+	std::vector<const AActor*> t2;
+	std::vector<char> results;
+};
+
+static void P_PrefetchSightJob(int begin, int end, void* data)
+{
+	sightprefetch_t* pf = static_cast<sightprefetch_t*>(data);
+
+	sighttrace_t* st;
+	{
+		OMutexLock lock(sparesighttracelock);
+		if (sparesighttraces.empty())
+		{
+			st = new sighttrace_t;
+			st->stamp = 0;
+		}
+		else
+		{
+			st = sparesighttraces.back();
+			sparesighttraces.pop_back();
+		}
+	}
+
+	for (int i = begin; i < end; i++)
+	{
+		const AActor* t1 = pf->t1[i];
+		const AActor* t2 = pf->t2[i];
+
+		const int pnum = (t1->subsector->sector - sectors) * numsectors +
+		                 (t2->subsector->sector - sectors);
+
+		if (!rejectempty && rejectmatrix[pnum >> 3] & (1 << (pnum & 7)))
+			pf->results[i] = false;
+		else
+			pf->results[i] = P_TraceSightDoom(st, t1->x, t1->y, t1->z, t1->height,
+			                                  t2->x, t2->y, t2->z, t2->height);
+	}
+
+	OMutexLock lock(sparesighttracelock);
+	sparesighttraces.push_back(st);
+}
+
+//
+// P_PrefetchSight
+//
+// Traces the line of sight for each pair of actors on the worker pool and
+// puts the results in the cache, so the same checks made later in the tic
+// don't have to trace anything.  Nothing else may run while this does, so
+// every trace sees the same world the main thread would.
+//
+// Only the vanilla checks can be traced off the main thread.  With ZDoom
+// physics this does nothing.
+//
+void P_PrefetchSight(const AActor* const* observers, const AActor* const* targets,
+                     size_t count)
 {
 	if (co_zdoomphys || map_format.getZDoom())
-		return P_CheckSightZDoom(t1, t2);
-	else
-		return P_CheckSightDoom(t1, t2);
+		return;
+
+	sightprefetch_t pf;
+	pf.t1.reserve(count);
+	pf.t2.reserve(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const AActor* t1 = observers[i];
+		const AActor* t2 = targets[i];
+
+		if (!t1 || !t2 || !t1->subsector || !t2->subsector)
+			continue;
+
+		if (P_SightCacheMatches(P_SightCacheEntry(t1, t2), t1, t2, false))
+			continue;
+
+		pf.t1.push_back(t1);
+		pf.t2.push_back(t2);
+	}
+
+	pf.results.resize(pf.t1.size());
+
+	I_ParallelFor(pf.t1.size(), 16, P_PrefetchSightJob, &pf);
+
+	for (size_t i = 0; i < pf.t1.size(); i++)
+	{
+		P_StoreSightCache(P_SightCacheEntry(pf.t1[i], pf.t2[i]), pf.t1[i], pf.t2[i],
+		                  false, pf.results[i] != 0);
+	}
+
+	sightcache_prefetched += pf.t1.size();
+}
+
+BEGIN_COMMAND(sightcounts)
+{
+	Printf(PRINT_HIGH, "Doom sight checks: %d rejected, %d traced\n",
+		sightcounts[0], sightcounts[1]);
+	Printf(PRINT_HIGH, "ZDoom sight checks: %d rejected, %d blocked early, %d traversed\n",
+		sightcounts2[0], sightcounts2[1], sightcounts2[2]);
+	Printf(PRINT_HIGH, "Sight cache: %u hits, %u misses, %u prefetched\n",
+		sightcache_hits, sightcache_misses, sightcache_prefetched);
+
+	if (argc > 1 && stricmp(argv[1], "reset") == 0)
+	{
+		sightcounts[0] = sightcounts[1] = 0;
+		sightcounts2[0] = sightcounts2[1] = sightcounts2[2] = 0;
+		sightcache_hits = sightcache_misses = sightcache_prefetched = 0;
+	}
 }
+END_COMMAND(sightcounts)
 
 //
 // denis - P_CheckSightEdgesDoom
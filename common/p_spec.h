@@ -1276,6 +1276,7 @@ void P_SuspendScript (int script, const char *map);
 void P_TerminateScript (int script, const char *map);
 void P_StartOpenScripts (void);
 void P_DoDeferedScripts (void);
+void P_WakeWaitingScripts (void);
 
 
 //
@@ -61,6 +61,9 @@ void P_Ticker (void)
 		return;
 #endif
 
+	// Sight check results are only good for the tic they were made in.
+	P_InvalidateSightCache();
+
 	if (serverside)
 		P_RunHordeTics();
 
@@ -83,6 +86,9 @@ void P_Ticker (void)
 		P_AnimationTick(it->mo);
 	}
 
+	// Work out what monsters can see before any of them move.
+	P_SenseMonsters ();
+
 	DThinker::RunThinkers ();
 	
 	P_UpdateSpecials ();
@@ -106,6 +106,12 @@ DPolyAction::DPolyAction (int polyNum)
 	m_Dist = 0;
 }
 
+void DPolyAction::Destroy ()
+{
+	P_WakeWaitingScripts ();
+	Super::Destroy ();
+}
+
 DRotatePoly::DRotatePoly ()
 {
 }
@@ -913,6 +919,9 @@ static void UnLinkPolyobj (polyobj_t *po)
 	int i, j;
 	int index;
 
+	// the polyobj is about to move, so cached sight checks may be stale
+	P_InvalidateSightCache();
+
 	// remove the polyobj from each blockmap section
 	for(j = po->bbox[BOXBOTTOM]; j <= po->bbox[BOXTOP]; j++)
 	{
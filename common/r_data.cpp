@@ -37,6 +37,7 @@
 #include "r_sky.h"
 
 #include "cmdlib.h"
+#include "c_dispatch.h"
 
 #include "r_data.h"
 
@@ -1077,11 +1078,66 @@ int R_TextureNumForName (const char *name)
 
 
 
+//
+// R_MarkStateSprites
+//
+// Marks the sprites used by a state and every state that follows it, so
+// that death, pain and attack frames of an actor get precached along with
+// the frame it was spawned in.
+//
+static void R_MarkStateSprites(int statenum, byte* spritehit, byte* statehit)
+{
+	while (statenum > S_NULL && statenum < NUMSTATES && !statehit[statenum])
+	{
+		statehit[statenum] = 1;
+
+		const state_t* state = &states[statenum];
+		if (state->sprite >= 0 && state->sprite < numsprites)
+			spritehit[state->sprite] = 1;
+
+		statenum = state->nextstate;
+	}
+}
+
+//
+// R_MarkActorSprites
+//
+static void R_MarkActorSprites(const mobjinfo_t* info, byte* spritehit, byte* statehit)
+{
+	R_MarkStateSprites(info->spawnstate, spritehit, statehit);
+	R_MarkStateSprites(info->seestate, spritehit, statehit);
+	R_MarkStateSprites(info->painstate, spritehit, statehit);
+	R_MarkStateSprites(info->meleestate, spritehit, statehit);
+	R_MarkStateSprites(info->missilestate, spritehit, statehit);
+	R_MarkStateSprites(info->deathstate, spritehit, statehit);
+	R_MarkStateSprites(info->xdeathstate, spritehit, statehit);
+	R_MarkStateSprites(info->raisestate, spritehit, statehit);
+}
+
+// Statistics for the last call to R_PrecacheLevel
+static struct
+{
+	dtime_t time;
+	size_t bytes;
+	int flats;
+	int textures;
+	int composites;
+	int sprites;
+} precachestats;
+
 //
 // R_PrecacheLevel
 // Preloads all relevant graphics for the level.
 //
 // [RH] Rewrote this using Lee Killough's code in BOOM as an example.
+//
+// Wall textures that need a composite are composited here as well, rather
+// than on the first R_GetTextureColumn call, and sprites are precached for
+// every frame an actor on the map can reach instead of only its current
+// frame.  Everything here goes through the zone allocator and WAD cache,
+// neither of which is thread safe, so the work is done up front during
+// level setup instead of in the background.
+//
 
 void R_PrecacheLevel (void)
 {
@@ -1091,6 +1147,9 @@ void R_PrecacheLevel (void)
 	if (demoplayback)
 		return;
 
+	const dtime_t starttime = I_GetTime();
+	memset(&precachestats, 0, sizeof(precachestats));
+
 	{
 		int size = (numflats > numsprites) ? numflats : numsprites;
 
@@ -1104,8 +1163,14 @@ void R_PrecacheLevel (void)
 		hitlist[sectors[i].floorpic] = hitlist[sectors[i].ceilingpic] = 1;
 
 	for (i = numflats - 1; i >= 0; i--)
+	{
 		if (hitlist[i])
+		{
 			W_CacheLumpNum (firstflat + i, PU_CACHE);
+			precachestats.bytes += W_LumpLength(firstflat + i);
+			precachestats.flats++;
+		}
+	}
 
 	// Precache textures.
 	memset (hitlist, 0, numtextures);
@@ -1137,8 +1202,21 @@ void R_PrecacheLevel (void)
 			int j;
 			texture_t *texture = textures[i];
 
-			for (j = texture->patchcount - 1; j > 0; j--)
+			for (j = texture->patchcount - 1; j >= 0; j--)
+			{
 				W_CachePatch(texture->patches[j].patch, PU_CACHE);
+				precachestats.bytes += W_LumpLength(texture->patches[j].patch);
+			}
+
+			// Build the composite now instead of while rendering.
+			if (texturecompositesize[i] > 0 && !texturecomposite[i])
+			{
+				R_GenerateComposite(i);
+				precachestats.bytes += texturecompositesize[i];
+				precachestats.composites++;
+			}
+
+			precachestats.textures++;
 		}
 	}
 
@@ -1146,22 +1224,59 @@ void R_PrecacheLevel (void)
 	memset (hitlist, 0, numsprites);
 
 	{
+		byte* statehit = new byte[NUMSTATES];
+		memset(statehit, 0, NUMSTATES);
+
 		AActor *actor;
 		TThinkerIterator<AActor> iterator;
 
 		while ( (actor = iterator.Next ()) )
+		{
 			hitlist[actor->sprite] = 1;
+			R_MarkActorSprites(&mobjinfo[actor->type], hitlist, statehit);
+		}
+
+		delete[] statehit;
 	}
 
 	for (i = numsprites - 1; i >= 0; i--)
 	{
 		if (hitlist[i])
+		{
 			R_CacheSprite (sprites + i);
+			precachestats.sprites++;
+
+			for (int f = 0; f < sprites[i].numframes; f++)
+			{
+				for (int r = 0; r < 16; r++)
+				{
+					const int lump = sprites[i].spriteframes[f].lump[r];
+					if (lump != -1 && (r == 0 || lump != sprites[i].spriteframes[f].lump[r - 1]))
+						precachestats.bytes += W_LumpLength(lump);
+				}
+			}
+		}
 	}
 
 	delete[] hitlist;
+
+	precachestats.time = I_GetTime() - starttime;
 }
 
+#ifdef CLIENT_APP
+BEGIN_COMMAND(precachestats)
+{
+	Printf(PRINT_HIGH, "Level precache took %d ms\n",
+	       (int)I_ConvertTimeToMs(precachestats.time));
+	Printf(PRINT_HIGH, "%d flats, %d textures (%d composited), %d sprites\n",
+	       precachestats.flats, precachestats.textures, precachestats.composites,
+	       precachestats.sprites);
+	Printf(PRINT_HIGH, "%.1f KiB of graphics cached\n",
+	       precachestats.bytes / 1024.0);
+}
+END_COMMAND(precachestats)
+#endif
+
 // Utility function,
 //	called by R_PointToAngle.
 unsigned int SlopeDiv (unsigned int num, unsigned int den)
@@ -30,10 +30,30 @@
 #include "stats.h"
 #include "i_system.h"
 
+// How many of the latest times each stat keeps for its percentiles.  At one
+// time per tic, this is a little under two minutes.
+static const size_t STAT_WINDOW = 4096;
+
+// A trace is cut off at this many events so it can't eat all our memory.
+static const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+struct StatTraceEvent
+{
+	FStat* stat;
+	dtime_t start;
+	dtime_t elapsed;
+};
+
+static std::vector<StatTraceEvent> traceevents;
+static std::string tracefile;
+static dtime_t tracestart = 0;
+static int tracetics = 0;
+
 std::vector<FStat*> FStat::stats;
+bool FStat::profiling = false;
 
 FStat::FStat (const char *cname)
-: name(cname)
+: last_clock(0), last_elapsed(0), name(cname), next_sample(0)
 {
 	stats.push_back(this);
 }
@@ -46,19 +66,56 @@ FStat::~FStat ()
 		stats.erase(i);
 }
 
-void FStat::clock()
+void FStat::start()
 {
-	last_clock = I_MSTime();
+	last_clock = I_GetTime();
 }
 
-void FStat::unclock()
+void FStat::stop()
 {
-	last_elapsed = I_MSTime() - last_clock;
+	// Reset while we were running.
+	if (last_clock == 0)
+		return;
+
+	const dtime_t now = I_GetTime();
+
+	if (!profiling)
+	{
+		last_elapsed = now - last_clock;
+		last_clock = 0;
+		return;
+	}
+
+	addSample(now - last_clock);
+
+	if (!tracefile.empty() && traceevents.size() < MAX_TRACE_EVENTS)
+	{
+		StatTraceEvent evt = {this, last_clock, now - last_clock};
+		traceevents.push_back(evt);
+	}
+
+	last_clock = 0;
+}
+
+void FStat::addSample(dtime_t elapsed)
+{
+	last_elapsed = elapsed;
+
+	if (samples.size() < STAT_WINDOW)
+	{
+		samples.push_back(elapsed);
+		return;
+	}
+
+	samples[next_sample] = elapsed;
+	next_sample = (next_sample + 1) % STAT_WINDOW;
 }
 
 void FStat::reset()
 {
 	last_elapsed = last_clock = 0;
+	samples.clear();
+	next_sample = 0;
 }
 
 const char *FStat::getname()
@@ -72,8 +129,16 @@ void FStat::dumpstat()
 		Printf(PRINT_HIGH, "%s\n", stats[i]->getname());
 }
 
+static void PrintStatHeader()
+{
+	Printf(PRINT_HIGH, "%-32s %6s %9s %9s %9s %9s\n", "stat", "count", "last", "p50",
+	       "p99", "max");
+}
+
 void FStat::dumpstat(std::string which)
 {
+	PrintStatHeader();
+
 	for(size_t i = 0; i < stats.size(); i++)
 		if(which == stats[i]->name)
 			stats[i]->dump();
@@ -81,7 +146,143 @@ void FStat::dumpstat(std::string which)
 
 void FStat::dump()
 {
-	Printf(PRINT_HIGH, "%s: %dms\n", name.c_str(), last_elapsed);
+	// Only the last time is kept while profiling is off.
+	if (samples.empty())
+	{
+		Printf(PRINT_HIGH, "%-32s %6u %9.3f\n", name.c_str(), 0u,
+		       last_elapsed / 1000000.0);
+		return;
+	}
+
+	std::vector<dtime_t> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+
+	const size_t n = sorted.size();
+	Printf(PRINT_HIGH, "%-32s %6u %9.3f %9.3f %9.3f %9.3f\n", name.c_str(),
+	       (unsigned int)n, last_elapsed / 1000000.0, sorted[(n - 1) / 2] / 1000000.0,
+	       sorted[(n - 1) * 99 / 100] / 1000000.0, sorted[n - 1] / 1000000.0);
+}
+
+//
+// FStat::startProfiling
+//
+void FStat::startProfiling()
+{
+	profiling = true;
+}
+
+//
+// FStat::stopProfiling
+//
+// Also cuts short any trace being recorded.
+//
+void FStat::stopProfiling()
+{
+	if (!tracefile.empty())
+	{
+		tracetics = 1;
+		endTic();
+	}
+
+	profiling = false;
+}
+
+//
+// FStat::resetAll
+//
+void FStat::resetAll()
+{
+	for (size_t i = 0; i < stats.size(); i++)
+		stats[i]->reset();
+}
+
+static bool CompareStatNames(FStat* a, FStat* b)
+{
+	return strcmp(a->getname(), b->getname()) < 0;
+}
+
+//
+// FStat::dumpProfile
+//
+// Prints every stat that has been timed, in milliseconds.
+//
+void FStat::dumpProfile()
+{
+	std::vector<FStat*> sorted(stats);
+	std::sort(sorted.begin(), sorted.end(), CompareStatNames);
+
+	PrintStatHeader();
+
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		if (!sorted[i]->samples.empty())
+			sorted[i]->dump();
+	}
+}
+
+//
+// FStat::startTrace
+//
+// Records every clocked stat for the next few tics, then writes them out
+// in the Chrome trace event format, which chrome://tracing and Perfetto
+// can both load.
+//
+bool FStat::startTrace(const std::string& filename, int tics)
+{
+	if (!tracefile.empty() || tics <= 0)
+		return false;
+
+	tracefile = filename;
+	tracetics = tics;
+	tracestart = I_GetTime();
+	traceevents.clear();
+
+	startProfiling();
+	return true;
+}
+
+static void WriteTraceEvents(FILE* fh)
+{
+	fputs("{\"traceEvents\":[\n", fh);
+
+	for (size_t i = 0; i < traceevents.size(); i++)
+	{
+		const StatTraceEvent& evt = traceevents[i];
+		fprintf(fh, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+		        "\"ts\":%.3f,\"dur\":%.3f}",
+		        i > 0 ? ",\n" : "", evt.stat->getname(),
+		        (evt.start - tracestart) / 1000.0, evt.elapsed / 1000.0);
+	}
+
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", fh);
+}
+
+//
+// FStat::endTic
+//
+// Called at the end of every tic, to write out the trace once it's done.
+//
+void FStat::endTic()
+{
+	if (tracefile.empty() || --tracetics > 0)
+		return;
+
+	FILE* fh = fopen(tracefile.c_str(), "w");
+	if (fh == NULL)
+	{
+		Printf(PRINT_HIGH, "Could not open \"%s\" for writing.\n", tracefile.c_str());
+	}
+	else
+	{
+		WriteTraceEvents(fh);
+		fclose(fh);
+
+		Printf(PRINT_HIGH, "Wrote %u trace events to \"%s\".\n",
+		       (unsigned int)traceevents.size(), tracefile.c_str());
+	}
+
+	tracefile.clear();
+	traceevents.clear();
 }
 
 BEGIN_COMMAND (stat)
@@ -27,6 +27,14 @@
 
 #include <algorithm>
 
+//
+// FStat
+//
+// Times a piece of code.  The last time is always kept for the stat
+// command.  While profiling is switched on, every time is also kept in a
+// rolling window so that its percentiles can be shown, and can be recorded
+// to a Chrome trace file.
+//
 class FStat
 {
 public:
@@ -34,23 +42,72 @@ public:
 
 	virtual ~FStat ();
 
-	void clock();
-	void unclock();
+	void clock()
+	{
+		start();
+	}
+
+	void unclock()
+	{
+		stop();
+	}
+
 	void reset();
 
+	// Add a time that was measured some other way.
+	void addSample(dtime_t elapsed);
+
 	const char *getname();
 
 	static void dumpstat();
 	static void dumpstat(std::string which);
 	void dump();
 
+	static bool profiling;
+
+	static void startProfiling();
+	static void stopProfiling();
+	static void resetAll();
+	static void dumpProfile();
+
+	static bool startTrace(const std::string& filename, int tics);
+	static void endTic();
+
 private:
+	void start();
+	void stop();
 
-	QWORD last_clock, last_elapsed;
+	dtime_t last_clock, last_elapsed;
 	std::string name;
+
+	std::vector<dtime_t> samples;
+	size_t next_sample;
+
 	static std::vector<FStat*> stats;
 };
 
+//
+// FStatScope
+//
+// Clocks a stat until the end of the enclosing scope.
+//
+class FStatScope
+{
+public:
+	FStatScope(FStat& stat) : m_stat(stat)
+	{
+		m_stat.clock();
+	}
+
+	~FStatScope()
+	{
+		m_stat.unclock();
+	}
+
+private:
+	FStat& m_stat;
+};
+
 #define BEGIN_STAT(n) \
 	static class Stat_##n : public FStat { \
 		public: \
@@ -59,4 +116,7 @@ private:
 
 #define END_STAT(n) Stat_var_##n.unclock();
 
+#define SCOPED_STAT(n) \
+	static FStat Stat_var_##n(#n); FStatScope Stat_scope_##n(Stat_var_##n);
+
 #endif //__STATS_H__
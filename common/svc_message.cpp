@@ -437,6 +437,7 @@ odaproto::svc::ConsolePlayer SVC_ConsolePlayer(player_t& player,
 
 	msg.set_pid(player.id);
 	msg.set_digest(digest);
+	msg.set_netfeatures(player.client.netfeatures);
 
 	return msg;
 }
@@ -109,8 +109,13 @@ class OZone
 	typedef std::map<void*, MemoryBlockInfo> MemoryBlockTable;
 	MemoryBlockTable m_heap;
 
+	// Running total of m_heap sizes, so it can be read without a walk.
+	size_t m_bytes;
+
 	MemoryBlockTable::iterator dealloc(MemoryBlockTable::iterator& block)
 	{
+		m_bytes -= block->second.size;
+
 		if (block->second.user)
 		{
 			*block->second.user = NULL;
@@ -127,7 +132,7 @@ class OZone
 	}
 
   public:
-	OZone()
+	OZone() : m_bytes(0)
 	{
 	}
 
@@ -176,6 +181,7 @@ class OZone
 		block.fileLine.line = fileline.line;
 
 		m_heap.insert(std::make_pair(ptr, block));
+		m_bytes += block.size;
 		if (block.user != NULL)
 		{
 			*block.user = ptr;
@@ -248,6 +254,12 @@ class OZone
 		}
 	}
 
+	void usage(size_t& blocks, size_t& bytes) const
+	{
+		blocks = m_heap.size();
+		bytes = m_bytes;
+	}
+
 	void dump()
 	{
 		size_t total = 0;
@@ -333,6 +345,16 @@ void Z_ChangeOwner2(void* ptr, void* user, const char* file, int line)
 	return ::g_zone.changeOwner(ptr, user, OFileLine::create(file, line));
 }
 
+//
+// Z_GetUsage
+//
+// Number of blocks the zone is tracking and their total size.
+//
+void Z_GetUsage(size_t& blocks, size_t& bytes)
+{
+	g_zone.usage(blocks, bytes);
+}
+
 //
 // Z_DumpHeap
 // Note: TFileDumpHeap( stdout ) ?
@@ -50,6 +50,7 @@ void Z_Init();
 void Z_Close();
 void Z_FreeTags(const zoneTag_e lowtag, const zoneTag_e hightag);
 void Z_DumpHeap(const zoneTag_e lowtag, const zoneTag_e hightag);
+void Z_GetUsage(size_t& blocks, size_t& bytes);
 
 // Don't use these, use the macros instead!
 void* Z_Malloc2(size_t size, const zoneTag_e tag, void* user, const char* file,
@@ -0,0 +1,351 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Console and log file output, written out on a background thread.
+//
+//   Printf only ever runs on the main thread, so the ring has a single
+//   producer.  The writer thread and I_FlushLog both drain it, but only
+//   while holding loglock, and the main thread takes the same lock whenever
+//   it needs to touch the log file itself.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include "c_dispatch.h"
+#include "d_main.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "m_fileio.h"
+
+// How long the writer waits between batches.  Everything written in a batch
+// is flushed to disk at the end of it.
+static const unsigned int LOG_BATCH_MS = 50;
+
+static const int LOG_RING_SIZE = 1 << 20;	// must be a power of two
+
+static char logring[LOG_RING_SIZE];
+static volatile int loghead = 0;	// next byte the main thread fills
+static volatile int logtail = 0;	// next byte the writer takes
+
+static OMutex loglock;
+static OSemaphore logwake;
+static OThread* logthread = NULL;
+static volatile int logquit = 0;
+
+// Written by whoever holds loglock, read by the main thread.
+static volatile int logbytes = 0;
+static volatile int logdropped = 0;
+static int logdroppednoted = 0;
+
+// Main thread only.  The size and age of the current log file, for rotation.
+static std::string logname;
+static int logbytesbase = 0;
+static time_t logopened = 0;
+
+static volatile int logrotatesize = 0;	// in megabytes
+static volatile int logrotatetime = 0;	// in hours
+
+CVAR_FUNC_IMPL(log_rotatesize)
+{
+	I_AtomicStore(&logrotatesize, var.asInt());
+}
+
+CVAR_FUNC_IMPL(log_rotatetime)
+{
+	I_AtomicStore(&logrotatetime, var.asInt());
+}
+
+static void I_WriteLogChunk(const char* str, size_t len)
+{
+	fwrite(str, 1, len, stdout);
+
+	if (LOG.is_open())
+		LOG.write(str, len);
+
+	I_AtomicStore(&logbytes, I_AtomicLoad(&logbytes) + (int)len);
+}
+
+//
+// I_DrainLog
+//
+// Writes out everything in the ring.  loglock must be held.
+//
+static void I_DrainLog()
+{
+	const int head = I_AtomicLoad(&loghead);
+	const int tail = logtail;
+	bool wrote = false;
+
+	if (head != tail)
+	{
+		if (head > tail)
+		{
+			I_WriteLogChunk(logring + tail, head - tail);
+		}
+		else
+		{
+			I_WriteLogChunk(logring + tail, LOG_RING_SIZE - tail);
+			I_WriteLogChunk(logring, head);
+		}
+
+		I_AtomicStore(&logtail, head);
+		wrote = true;
+	}
+
+	const int dropped = I_AtomicLoad(&logdropped);
+	if (dropped != logdroppednoted)
+	{
+		char note[64];
+		int len = snprintf(note, sizeof(note), "*** %d log lines dropped ***\n",
+		                   dropped - logdroppednoted);
+		I_WriteLogChunk(note, len);
+		logdroppednoted = dropped;
+		wrote = true;
+	}
+
+	if (wrote)
+	{
+		fflush(stdout);
+
+		if (LOG.is_open())
+			LOG.flush();
+	}
+}
+
+static void I_LogThread(void* data)
+{
+	while (!I_AtomicLoad(&logquit))
+	{
+		logwake.wait(LOG_BATCH_MS);
+
+		OMutexLock lock(loglock);
+		I_DrainLog();
+	}
+}
+
+//
+// I_RotateLog
+//
+// Moves the current log file aside and starts a new one with the same name
+// if it has grown too big or too old.
+//
+static void I_RotateLog()
+{
+	if (!LOG.is_open())
+	{
+		logopened = 0;
+		return;
+	}
+
+	const time_t now = time(NULL);
+
+	if (logname != LOG_FILE || logopened == 0)
+	{
+		// A different file from the last time we looked.
+		logname = LOG_FILE;
+		logbytesbase = I_AtomicLoad(&logbytes);
+		logopened = now;
+		return;
+	}
+
+	const int maxmb = I_AtomicLoad(&logrotatesize);
+	const int maxhours = I_AtomicLoad(&logrotatetime);
+
+	const unsigned int size = (unsigned int)(I_AtomicLoad(&logbytes) - logbytesbase);
+	const bool toobig = maxmb > 0 && size >= (unsigned int)maxmb * 1024 * 1024;
+	const bool tooold = maxhours > 0 && now - logopened >= (time_t)maxhours * 60 * 60;
+
+	if (!toobig && !tooold)
+		return;
+
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+	const std::string oldname = LOG_FILE + "." + stamp;
+
+	OMutexLock lock(loglock);
+	I_DrainLog();
+
+	LOG.close();
+	rename(LOG_FILE.c_str(), oldname.c_str());
+	LOG.open(LOG_FILE.c_str(), std::ios::app);
+
+	if (LOG.is_open())
+		LOG << "Log continued from " << oldname << "\n";
+
+	logbytesbase = I_AtomicLoad(&logbytes);
+	logopened = now;
+}
+
+//
+// I_WriteLog
+//
+// Queues a string for the console and log file.  If the writer is too far
+// behind to take the whole string, it's dropped and counted.
+//
+void I_WriteLog(const char* str, size_t len)
+{
+	I_RotateLog();
+
+	if (logthread == NULL || !logthread->joinable())
+	{
+		fwrite(str, 1, len, stdout);
+		fflush(stdout);
+
+		if (LOG.is_open())
+		{
+			LOG.write(str, len);
+			LOG.flush();
+		}
+
+		I_AtomicStore(&logbytes, I_AtomicLoad(&logbytes) + (int)len);
+		return;
+	}
+
+	const int head = loghead;
+	const int used = (head - I_AtomicLoad(&logtail)) & (LOG_RING_SIZE - 1);
+	const size_t space = LOG_RING_SIZE - 1 - used;
+
+	if (len > space)
+	{
+		I_AtomicIncrement(&logdropped);
+		return;
+	}
+
+	const size_t first = MIN(len, (size_t)(LOG_RING_SIZE - head));
+	memcpy(logring + head, str, first);
+	memcpy(logring, str + first, len - first);
+
+	I_AtomicStore(&loghead, (head + (int)len) & (LOG_RING_SIZE - 1));
+}
+
+//
+// I_FlushLog
+//
+// Writes out everything queued so far before returning.  A crash handler
+// passes crashing, so that if the writer was in the middle of a batch when
+// the crash happened we give up instead of waiting on it forever.
+//
+void I_FlushLog(bool crashing)
+{
+	if (crashing)
+	{
+		if (!loglock.trylock())
+			return;
+	}
+	else
+	{
+		loglock.lock();
+	}
+
+	I_DrainLog();
+
+	fflush(stdout);
+	if (LOG.is_open())
+		LOG.flush();
+
+	loglock.unlock();
+}
+
+//
+// I_ReopenLog
+//
+// Writes out everything queued for the current log file, if any, and
+// starts logging to path instead.  Returns false if it can't be opened.
+//
+bool I_ReopenLog(const std::string& path)
+{
+	OMutexLock lock(loglock);
+	I_DrainLog();
+
+	if (LOG.is_open())
+		LOG.close();
+
+	LOG_FILE = path;
+	LOG.open(LOG_FILE.c_str(), std::ios::app);
+
+	if (!LOG.is_open())
+		return false;
+
+	LOG << std::endl;
+	return true;
+}
+
+//
+// I_CloseLog
+//
+// Writes out everything queued and stops logging to a file.
+//
+void I_CloseLog()
+{
+	OMutexLock lock(loglock);
+	I_DrainLog();
+
+	if (LOG.is_open())
+		LOG.close();
+}
+
+//
+// I_StartLog
+//
+// The thread object is never deleted, so an exit that skips I_ShutdownLog
+// doesn't wait forever on it.
+//
+void I_StartLog()
+{
+	if (logthread == NULL)
+		logthread = new OThread;
+
+	if (logthread->joinable())
+		return;
+
+	I_AtomicStore(&logquit, 0);
+	logthread->start(I_LogThread, NULL);
+}
+
+//
+// I_ShutdownLog
+//
+// Writes out anything left and stops the writer.  Anything printed after
+// this is written out straight away.
+//
+void I_ShutdownLog()
+{
+	if (logthread == NULL || !logthread->joinable())
+		return;
+
+	I_AtomicStore(&logquit, 1);
+	logwake.post();
+	logthread->join();
+
+	I_FlushLog();
+}
+
+BEGIN_COMMAND(logstats)
+{
+	Printf(PRINT_HIGH, "Log writer %s, %d bytes written, %d lines dropped\n",
+	       logthread && logthread->joinable() ? "running" : "stopped", I_AtomicLoad(&logbytes),
+	       I_AtomicLoad(&logdropped));
+}
+END_COMMAND(logstats)
+
+VERSION_CONTROL(i_log_cpp, "$Id$")
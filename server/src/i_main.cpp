@@ -79,14 +79,7 @@ int PrintString(int printlevel, char const* str)
 	std::string sanitized_str(str);
 	StripColorCodes(sanitized_str);
 
-	printf("%s", sanitized_str.c_str());
-	fflush(stdout);
-
-	if (LOG.is_open())
-	{
-		LOG << sanitized_str;
-		LOG.flush();
-	}
+	I_WriteLog(sanitized_str.c_str(), sanitized_str.length());
 
 	return sanitized_str.length();
 }
@@ -174,10 +167,14 @@ int __cdecl main(int argc, char *argv[])
 		atterm (I_Quit);
 		atterm (DObject::StaticShutdown);
 
+		I_StartLog();
+
 		D_DoomMain();
 	}
 	catch (CDoomError& error)
 	{
+		I_FlushLog();
+
 		if (LOG.is_open())
 		{
 			LOG << "=== ERROR: " << error.GetMsg() << " ===\n\n";
@@ -208,12 +205,17 @@ void daemon_init(void)
 
     Printf(PRINT_HIGH, "Launched into the background\n");
 
+    // The writer thread doesn't survive the fork.
+    I_ShutdownLog();
+
     if ((pid = fork()) != 0)
     {
     	call_terms();
     	exit(EXIT_SUCCESS);
     }
 
+    I_StartLog();
+
 	const char *forkargs = Args.CheckValue("-fork");
 	if (forkargs)
 		pidfile = string(forkargs);
@@ -290,6 +292,8 @@ int main (int argc, char **argv)
 		atterm (I_Quit);
 		atterm (DObject::StaticShutdown);
 
+		I_StartLog();
+
 		// [AM] There used to be a signal handler here that attempted to
 		//      shut the server off gracefully.  I'm not sure masking the
 		//      signal is a good idea, and it stomped over the crashlog handler
@@ -299,6 +303,8 @@ int main (int argc, char **argv)
 	}
 	catch (CDoomError& error)
 	{
+		I_FlushLog();
+
 		if (LOG.is_open())
 		{
 			LOG << "=== ERROR: " << error.GetMsg() << " ===\n\n";
@@ -348,6 +348,8 @@ void STACK_ARGS I_Quit (void)
     CloseNetwork ();
 
 	DConsoleAlias::DestroyAll();
+
+	I_ShutdownLog();
 }
 
 
@@ -88,6 +88,20 @@ void addterm (void (STACK_ARGS *func)(void), const char *name);
 // Print a console string
 void I_PrintStr (int x, const char *str, int count, BOOL scroll);
 
+// Console and log file output.  Once I_StartLog has been called, strings
+// are queued and written out by a background thread.
+void I_StartLog();
+void I_ShutdownLog();
+void I_WriteLog(const char* str, size_t len);
+
+// Writes out everything queued so far.  Crash handlers pass crashing, so they
+// never wait on a writer that may not let go.
+void I_FlushLog(bool crashing = false);
+
+// Switch log files or stop logging without losing anything still queued.
+bool I_ReopenLog(const std::string& path);
+void I_CloseLog();
+
 // Set the title string of the startup window
 void I_SetTitleString (const char *title);
 
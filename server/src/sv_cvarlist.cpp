@@ -38,6 +38,12 @@ CVAR(			log_fulltimestamps, "0", "Extended timestamp info (dd/mm/yyyy hh:mm:ss)"
 CVAR(			log_packetdebug, "0", "Print debugging messages for each packet sent",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
 
+CVAR_RANGE_FUNC_DECL(log_rotatesize, "0", "Start a new log file once the current one reaches this many megabytes (0 to disable)",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 1024.0f)
+
+CVAR_RANGE_FUNC_DECL(log_rotatetime, "0", "Start a new log file once the current one is this many hours old (0 to disable)",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 8760.0f)
+
 // Server administrative settings
 // ------------------------------
 
@@ -116,6 +122,24 @@ CVAR_RANGE_FUNC_DECL(sv_maxrate, "200", "Forces clients to be on or below this r
 CVAR_RANGE_FUNC_DECL(sv_waddownloadcap, "200", "Cap wad file downloading to a specific rate",
 				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 7.0f, 100000.0f)
 
+CVAR_FUNC_DECL(	sv_netthread, "1", "Read packets on a separate thread as soon as they arrive",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR(			sv_cullupdates, "1", "Update actors that players can't see or hear less often",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR(			sv_parallelsend, "0", "Compress and send each client's packets on several threads",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR_RANGE_FUNC_DECL(sv_metricsport, "0", "Serve Prometheus metrics over HTTP on this TCP port (0 to disable)",
+				CVARTYPE_WORD, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 65535.0f)
+
+CVAR_FUNC_DECL(	sv_metricsaddress, "127.0.0.1", "Address the metrics port listens on",
+				CVARTYPE_STRING, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE)
+
+CVAR_FUNC_DECL(	sv_metricssocket, "", "Serve Prometheus metrics over HTTP on this UNIX socket (empty to disable)",
+				CVARTYPE_STRING, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE)
+
 #ifdef ODA_HAVE_MINIUPNP
 CVAR(			sv_upnp, "1", "Enable UPnP support",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
@@ -153,6 +177,9 @@ CVAR(			sv_ticbuffer, "1", "Buffer controller input from players experiencing su
 				"latency spikes for smoother movement",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE | CVAR_SERVERINFO)
 
+CVAR(			sv_buildreject, "0", "Build a REJECT table for maps that lack one",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
 
 // Ban settings
 // ============
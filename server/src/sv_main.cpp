@@ -46,6 +46,8 @@
 #include "sv_sqp.h"
 #include "sv_sqpold.h"
 #include "sv_master.h"
+#include "sv_metrics.h"
+#include "sv_relevance.h"
 #include "i_system.h"
 #include "c_console.h"
 #include "c_dispatch.h"
@@ -69,6 +71,7 @@
 #include "m_wdlstats.h"
 #include "svc_message.h"
 #include "m_cheat.h"
+#include "stats.h"
 
 #include <algorithm>
 #include <sstream>
@@ -266,6 +269,8 @@ CVAR_FUNC_IMPL (rcon_password) // Remote console password.
 
 
 EXTERN_CVAR(sv_waddownloadcap)
+EXTERN_CVAR(sv_netthread)
+EXTERN_CVAR(sv_parallelsend)
 CVAR_FUNC_IMPL(sv_maxrate)
 {
 	// sv_waddownloadcap can not be larger than sv_maxrate
@@ -470,6 +475,40 @@ static void SendLevelState(SerializedLevelState sls)
 	}
 }
 
+CVAR_FUNC_IMPL (sv_netthread)
+{
+	if (!network_game)
+		return;
+
+	if (var)
+		NET_StartReceiveThread();
+	else
+		NET_StopReceiveThread();
+}
+
+BEGIN_COMMAND (netqueue)
+{
+	netrecvstats_t stats;
+	NET_GetReceiveStats(stats, argc > 1 && stricmp(argv[1], "reset") == 0);
+
+	if (!stats.running)
+	{
+		Printf(PRINT_HIGH, "The network receive thread is not running.\n");
+		return;
+	}
+
+	const double droprate =
+	    stats.received + stats.dropped > 0
+	        ? 100.0 * stats.dropped / (stats.received + stats.dropped)
+	        : 0.0;
+
+	Printf(PRINT_HIGH, "%d packets received, %d dropped (%.2f%%)\n",
+	       stats.received, stats.dropped, droprate);
+	Printf(PRINT_HIGH, "queue depth %d, peak %d of %d\n",
+	       stats.depth, stats.peakdepth, stats.capacity);
+}
+END_COMMAND (netqueue)
+
 //
 // SV_InitNetwork
 //
@@ -489,6 +528,12 @@ void SV_InitNetwork (void)
 	// set up a socket and net_message buffer
 	InitNetCommon();
 
+	if (sv_netthread)
+		NET_StartReceiveThread();
+
+	SV_InitMetrics();
+	atterm(SV_ShutdownMetrics);
+
 	// determine my name & address
 	// NET_GetLocalAddress ();
 
@@ -623,6 +668,8 @@ Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it)
 //
 void SV_GetPackets()
 {
+	SCOPED_STAT(GetPackets);
+
 	while (NET_GetPacket())
 	{
 		player_t &player = SV_FindPlayerByAddr();
@@ -640,6 +687,8 @@ void SV_GetPackets()
 			if(player.playerstate != PST_DISCONNECT)
 			{
 				player.client.last_received = gametic;
+
+				SCOPED_STAT(ParseCommands);
 				SV_ParseCommands(player);
 			}
 		}
@@ -1544,10 +1593,22 @@ void SV_UpdateSecret(sector_t& sector, player_t &player)
 
 void SV_SendPackets(void);
 
-static void SendServerSettings(player_t& pl)
+static void SendServerSetting(player_t& pl, cvar_t& var)
 {
 	client_t* cl = &pl.client;
 
+	odaproto::svc::ServerSettings settings = SVC_ServerSettings(var);
+
+	if (settings.ByteSizeLong() > MAX_UDP_SIZE - cl->reliablebuf.size())
+	{
+		SV_SendPacket(pl);
+	}
+
+	MSG_WriteSVC(&cl->reliablebuf, settings);
+}
+
+static void SendServerSettings(player_t& pl)
+{
 	// GhostlyDeath <June 19, 2008> -- Loop through all CVARs and send the CVAR_SERVERINFO
 	// stuff only
 	cvar_t* var = GetFirstCvar();
@@ -1555,16 +1616,7 @@ static void SendServerSettings(player_t& pl)
 	while (var)
 	{
 		if (var->flags() & CVAR_SERVERINFO)
-		{
-			odaproto::svc::ServerSettings settings = SVC_ServerSettings(*var);
-
-			if (settings.ByteSizeLong() > MAX_UDP_SIZE - cl->reliablebuf.size())
-			{
-				SV_SendPacket(pl);
-			}
-
-			MSG_WriteSVC(&cl->reliablebuf, settings);
-		}
+			SendServerSetting(pl, *var);
 
 		var = var->GetNext();
 	}
@@ -1573,7 +1625,8 @@ static void SendServerSettings(player_t& pl)
 //
 //	SV_ServerSettingChange
 //
-//	Sends server settings to clients when changed
+//	Sends the server settings that have changed since the last call to
+//	clients.  Anything changed outside of a level is held until the next one.
 //
 void SV_ServerSettingChange()
 {
@@ -1582,9 +1635,16 @@ void SV_ServerSettingChange()
 		return;
 	}
 
+	std::vector<cvar_t*> changed;
+	cvar_t::GetChangedServerInfo(changed);
+
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
-		SendServerSettings(*it);
+		for (size_t i = 0; i < changed.size(); i++)
+		{
+			if (changed[i]->flags() & CVAR_SERVERINFO)
+				SendServerSetting(*it, *changed[i]);
+		}
 	}
 }
 
@@ -1784,18 +1844,20 @@ void SV_ConnectClient()
 	cl->allow_rcon = false;
 	cl->displaydisconnect = false;
 
+	cl->sendrate = client_t::sendrate_t();
+
 	SZ_Clear(&cl->netbuf);
+	SZ_Clear(&cl->nearbuf);
+	SZ_Clear(&cl->farbuf);
 	SZ_Clear(&cl->reliablebuf);
-	
-	for (size_t i = 0; i < ARRAY_LENGTH(cl->oldpackets); i++)
-	{
-		cl->oldpackets[i].sequence = -1;
-		SZ_Clear(&cl->oldpackets[i].data);
-	}
+
+	cl->oldpackets.clear();
+	cl->srtt = cl->rttvar = 0;
 
 	cl->sequence = 0;
 	cl->last_sequence = -1;
 	cl->packetnum = 0;
+	cl->netfeatures = 0;
 	
 	// generate a random string
 	std::stringstream ss;
@@ -1858,6 +1920,11 @@ void SV_ConnectClient()
 		return;
 	}
 
+	// Older clients stop after the password and don't know about any of the
+	// network features.
+	if (MSG_BytesLeft() >= 4)
+		cl->netfeatures = MSG_ReadLong() & NETF_ALL;
+
 	// send consoleplayer number
 	MSG_WriteSVC(&cl->reliablebuf, SVC_ConsolePlayer(*player, cl->digest));
 	SV_SendPacket(*player);
@@ -2752,19 +2819,19 @@ void SV_UpdateMissiles(player_t &pl)
 			continue;
 
 		// update missile position every 30 tics
-		if (((gametic+mo->netid) % 30) && (mo->type != MT_TRACER) && (mo->type != MT_FATSHOT) && !(mo->flags2 & MF2_SEEKERMISSILE))
-			continue;
 		// Revenant tracers and Mancubus fireballs need to be updated more often (and custom tracers)
-		else if (((gametic+mo->netid) % 5) && (mo->type == MT_TRACER || mo->type == MT_FATSHOT || mo->flags2 & MF2_SEEKERMISSILE))
+		const bool seeker = mo->type == MT_TRACER || mo->type == MT_FATSHOT ||
+		                    mo->flags2 & MF2_SEEKERMISSILE;
+		if (!SV_IsUpdateDue(pl, mo, seeker ? 5 : 30))
 			continue;
 
 		if(SV_IsPlayerAllowedToSee(pl, mo))
 		{
-			client_t *cl = &pl.client;
+			buf_t* buf = SV_ActorBuf(pl, mo);
 
-			MSG_WriteSVC(&cl->netbuf, SVC_UpdateMobj(*mo));
+			MSG_WriteSVC(buf, SVC_UpdateMobj(*mo));
 
-            if (cl->netbuf.cursize >= 1024)
+            if (buf->cursize >= 1024)
                 if(!SV_SendPacket(pl))
                     return;
 		}
@@ -2824,16 +2891,16 @@ void SV_UpdateMonsters(player_t &pl)
 			continue;
 
 		// update monster position every 7 tics
-		if ((gametic+mo->netid) % 7)
+		if (!SV_IsUpdateDue(pl, mo, 7))
 			continue;
 
 		if (SV_IsPlayerAllowedToSee(pl, mo) && mo->target)
 		{
-			client_t *cl = &pl.client;
+			buf_t* buf = SV_ActorBuf(pl, mo);
 
-			MSG_WriteSVC(&cl->netbuf, SVC_UpdateMobj(*mo));
+			MSG_WriteSVC(buf, SVC_UpdateMobj(*mo));
 
-			if (cl->netbuf.cursize >= 1024)
+			if (buf->cursize >= 1024)
 			{
 				if (!SV_SendPacket(pl))
 					return;
@@ -2968,11 +3035,11 @@ void SV_UpdateMonsterRespawnCount()
 	}
 }
 
-// calculates ping using gametic which was sent by SV_SendGametic and
-// current gametic
+// calculates ping using the time which was sent by SV_SendPingRequest and
+// the time the reply came off the socket
 void SV_CalcPing(player_t &player)
 {
-	unsigned int ping = I_MSTime() - MSG_ReadLong();
+	unsigned int ping = I_ConvertTimeToMs(net_arrival) - MSG_ReadLong();
 
 	if(ping > 999)
 		ping = 999;
@@ -3041,6 +3108,8 @@ void SV_ClearClientsBPS(void)
 	{
 		client_t *cl = &(it->client);
 
+		SV_MetricsClientBPS(*it);
+
 		cl->reliable_bps = 0;
 		cl->unreliable_bps = 0;
 	}
@@ -3054,6 +3123,12 @@ void SV_SendPackets()
 	if (players.empty())
 		return;
 
+	if (sv_parallelsend)
+	{
+		SV_SendPacketsParallel();
+		return;
+	}
+
 	static size_t fair_send = 0;
 	size_t num_players = players.size();
 
@@ -3070,6 +3145,8 @@ void SV_SendPackets()
 	Players::iterator it = begin;
 	do
 	{
+		SV_ResendPackets(*it);
+
 		// [AM] Don't send packets to players who haven't acked packet 0
 		if (it->playerstate != PST_CONTACT)
 			SV_SendPacket(*it);
@@ -3140,7 +3217,10 @@ void SV_WriteCommands(void)
 			if(!SV_IsPlayerAllowedToSee(*it, pit->mo))
 				continue;
 
-			MSG_WriteSVC(&cl->netbuf, SVC_MovePlayer(*pit, it->tic));
+			if (!SV_IsUpdateDue(*it, pit->mo, 1))
+				continue;
+
+			MSG_WriteSVC(SV_ActorBuf(*it, pit->mo), SVC_MovePlayer(*pit, it->tic));
 		}
 
 		// [SL] Send client info about player he is spying on
@@ -3957,7 +4037,11 @@ void SV_ParseCommands(player_t &player)
 			break;
 
 		case clc_ack:
-			SV_AcknowledgePacket(player);
+			SV_AcknowledgePacket(player, false);
+			break;
+
+		case clc_ackbits:
+			SV_AcknowledgePacket(player, true);
 			break;
 
 		case clc_rcon:
@@ -4157,15 +4241,36 @@ void SV_StepTics(QWORD count)
 	// run the newtime tics
 	while (count--)
 	{
+		const dtime_t ticstart = I_GetTime();
+		BEGIN_STAT(Tic);
+
+		BEGIN_STAT(GameTics);
 		SV_GameTics();
+		END_STAT(GameTics);
 
+		BEGIN_STAT(Ticker);
 		G_Ticker();
+		END_STAT(Ticker);
 
+		BEGIN_STAT(WriteCommands);
 		SV_WriteCommands();
+		END_STAT(WriteCommands);
+
+		BEGIN_STAT(SendPackets);
 		SV_SendPackets();
+		END_STAT(SendPackets);
+
+		BEGIN_STAT(ClearClientsBPS);
 		SV_ClearClientsBPS();
+		END_STAT(ClearClientsBPS);
+
+		BEGIN_STAT(CheckTimeouts);
 		SV_CheckTimeouts();
+		END_STAT(CheckTimeouts);
+
+		BEGIN_STAT(DestroyMovingSectors);
 		SV_DestroyFinishedMovingSectors();
+		END_STAT(DestroyMovingSectors);
 
 		// increment player_t::GameTime for all players once a second
 		static int TicCount = 0;
@@ -4177,11 +4282,75 @@ void SV_StepTics(QWORD count)
 		}
 
 		gametic++;
+
+		END_STAT(Tic);
+		FStat::endTic();
+		SV_MetricsTic(I_GetTime() - ticstart);
 	}
 
 	DObject::EndFrame();
 }
 
+static void ProfileHelp()
+{
+	Printf(PRINT_HIGH,
+	       "sv_profile - Times each part of a tic, to find out where the time goes\n\n"
+	       "Usage:\n"
+	       "  ] sv_profile on|off\n"
+	       "  Start or stop timing.\n\n"
+	       "  ] sv_profile dump\n"
+	       "  Print the last, median, 99th percentile and worst times in ms.\n\n"
+	       "  ] sv_profile reset\n"
+	       "  Forget every time taken so far.\n\n"
+	       "  ] sv_profile trace <FILENAME> [TICS]\n"
+	       "  Record the next TICS tics (default 350) as a Chrome trace.\n");
+}
+
+BEGIN_COMMAND (sv_profile)
+{
+	if (argc < 2)
+	{
+		ProfileHelp();
+		Printf(PRINT_HIGH, "Profiling is currently %s.\n", FStat::profiling ? "on" : "off");
+		return;
+	}
+
+	if (stricmp(argv[1], "on") == 0)
+	{
+		FStat::startProfiling();
+		Printf(PRINT_HIGH, "Profiling started.\n");
+	}
+	else if (stricmp(argv[1], "off") == 0)
+	{
+		FStat::stopProfiling();
+		Printf(PRINT_HIGH, "Profiling stopped.\n");
+	}
+	else if (stricmp(argv[1], "dump") == 0)
+	{
+		FStat::dumpProfile();
+	}
+	else if (stricmp(argv[1], "reset") == 0)
+	{
+		FStat::resetAll();
+	}
+	else if (stricmp(argv[1], "trace") == 0 && argc >= 3)
+	{
+		const int tics = argc >= 4 ? atoi(argv[3]) : TICRATE * 10;
+		if (!FStat::startTrace(argv[2], tics))
+		{
+			Printf(PRINT_HIGH, "A trace is already being recorded.\n");
+			return;
+		}
+
+		Printf(PRINT_HIGH, "Recording the next %d tics to \"%s\".\n", tics, argv[2]);
+	}
+	else
+	{
+		ProfileHelp();
+	}
+}
+END_COMMAND (sv_profile)
+
 //
 // SV_DisplayTics
 //
@@ -4216,6 +4385,7 @@ void SV_RunTics()
 
 	SV_BanlistTics();
 	SV_UpdateMaster();
+	SV_PollMetrics();
 
 	// only run game-related tickers if the server isn't frozen
 	// (sv_emptyfreeze enabled and no clients)
@@ -4508,7 +4678,7 @@ void SV_SendDamageMobj(AActor *target, int pain)
 
 		MSG_WriteSVC(&cl->reliablebuf, SVC_DamageMobj(target, pain));
 		if (!target->player)
-			MSG_WriteSVC(&cl->netbuf, SVC_UpdateMobj(*target));
+			MSG_WriteSVC(SV_ActorBuf(*it, target), SVC_UpdateMobj(*target));
 	}
 }
 
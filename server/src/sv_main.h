@@ -53,6 +53,7 @@ void SV_DrawScores();
 
 void SV_ServerSettingChange();
 bool SV_IsPlayerAllowedToSee(player_t &pl, AActor *mobj);
+bool SV_IsTeammate(player_t &a, player_t &b);
 
 void STACK_ARGS SV_ClientPrintf (client_t *cl, int level, const char *fmt, ...);
 void STACK_ARGS SV_SpectatorPrintf (int level, const char *fmt, ...);
@@ -63,7 +64,10 @@ void SV_ConnectClient2(player_t& player);
 void SV_WriteCommands(void);
 void SV_ClearClientsBPS(void);
 bool SV_SendPacket(player_t &pl);
-void SV_AcknowledgePacket(player_t &player);
+void SV_ResendPackets(player_t& pl);
+void SV_SendPacketsParallel();
+buf_t* SV_ActorBuf(player_t& pl, AActor* mo);
+void SV_AcknowledgePacket(player_t &player, bool hasbits);
 void SV_DisplayTics();
 void SV_RunTics();
 void SV_ParseCommands(player_t &player);
@@ -0,0 +1,569 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Server metrics, served in the Prometheus text format.
+//
+//   Counters are plain integers that are only touched on the main thread,
+//   and the listeners are polled from the main loop, so nothing here needs a
+//   lock.  A scrape is answered with a minimal HTTP/1.0 response on either a
+//   TCP port or a UNIX socket.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include <map>
+
+#include "win32inc.h"
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <sys/ioctl.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <errno.h>
+	#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+typedef int SOCKET;
+#define SOCKET_ERROR -1
+#define INVALID_SOCKET -1
+#define closesocket close
+#define ioctlsocket ioctl
+#endif
+
+// Don't let a scraper that hangs up early kill the server with SIGPIPE.
+#ifdef MSG_NOSIGNAL
+#define METRICS_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define METRICS_SEND_FLAGS 0
+#endif
+
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "doomstat.h"
+#include "dthinker.h"
+#include "i_system.h"
+#include "sv_main.h"
+#include "sv_metrics.h"
+#include "z_zone.h"
+
+EXTERN_CVAR(sv_metricsport)
+EXTERN_CVAR(sv_metricsaddress)
+EXTERN_CVAR(sv_metricssocket)
+
+uint64_t sv_metrics[NUM_METRICS];
+
+// Upper bounds of the tic duration histogram buckets, in seconds.  The
+// 0.0286 bucket is one whole tic at 35Hz.
+static const double ticbuckets[] = {
+    0.001, 0.002, 0.005, 0.01, 0.02, 0.0286, 0.05, 0.1, 0.25,
+};
+static const size_t NUM_TIC_BUCKETS = ARRAY_LENGTH(ticbuckets);
+
+static uint64_t tichistogram[NUM_TIC_BUCKETS + 1];
+static uint64_t ticcount = 0;
+static dtime_t ticsum = 0;
+
+// Bytes sent to each client over the last whole second.
+static int clientreliablebps[MAXPLAYERS];
+static int clientunreliablebps[MAXPLAYERS];
+
+// Scrapes that are slower than this are hung up on.
+static const dtime_t METRICS_TIMEOUT_MS = 5000;
+static const size_t MAX_METRICS_CONNECTIONS = 8;
+static const size_t MAX_METRICS_REQUEST = 4096;
+
+struct MetricsConnection
+{
+	SOCKET sock;
+	dtime_t opened;
+	std::string request;
+	std::string response;
+	size_t sent;
+};
+
+static SOCKET tcplistener = INVALID_SOCKET;
+static SOCKET unixlistener = INVALID_SOCKET;
+static std::string unixpath;
+static std::vector<MetricsConnection> connections;
+
+//
+// SV_MetricsTic
+//
+// Adds the time taken by a single tic to the tic histogram.
+//
+void SV_MetricsTic(dtime_t elapsed)
+{
+	const double seconds = elapsed / 1000000000.0;
+
+	size_t bucket = 0;
+	while (bucket < NUM_TIC_BUCKETS && seconds > ticbuckets[bucket])
+		bucket++;
+
+	tichistogram[bucket]++;
+	ticcount++;
+	ticsum += elapsed;
+}
+
+//
+// SV_MetricsClientBPS
+//
+// Called just before a client's bytes per second are reset.
+//
+void SV_MetricsClientBPS(const player_t& player)
+{
+	if (player.id >= MAXPLAYERS)
+		return;
+
+	clientreliablebps[player.id] = player.client.reliable_bps;
+	clientunreliablebps[player.id] = player.client.unreliable_bps;
+}
+
+static void STACK_ARGS AddMetricLine(std::string& out, const char* fmt, ...)
+{
+	std::string line;
+	va_list va;
+	va_start(va, fmt);
+	VStrFormat(line, fmt, va);
+	va_end(va);
+
+	out += line;
+}
+
+static void AddMetricHeader(std::string& out, const char* name, const char* type,
+                            const char* help)
+{
+	AddMetricLine(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// Escape a label value as the text format wants it.
+static std::string MetricLabel(const std::string& value)
+{
+	std::string out;
+	out.reserve(value.size());
+
+	for (size_t i = 0; i < value.size(); i++)
+	{
+		if (value[i] == '\\' || value[i] == '"')
+		{
+			out += '\\';
+			out += value[i];
+		}
+		else if (value[i] == '\n')
+		{
+			out += "\\n";
+		}
+		else
+		{
+			out += value[i];
+		}
+	}
+
+	return out;
+}
+
+static void AddCounter(std::string& out, const char* name, const char* help,
+                       uint64_t value)
+{
+	AddMetricHeader(out, name, "counter", help);
+	AddMetricLine(out, "%s %llu\n", name, (unsigned long long)value);
+}
+
+//
+// BuildMetrics
+//
+// Writes out everything we know in the Prometheus text format.
+//
+static void BuildMetrics(std::string& out)
+{
+	out.clear();
+
+	AddMetricHeader(out, "odamex_tic_duration_seconds", "histogram",
+	                "Time taken to run each game tic.");
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < NUM_TIC_BUCKETS; i++)
+	{
+		cumulative += tichistogram[i];
+		AddMetricLine(out, "odamex_tic_duration_seconds_bucket{le=\"%g\"} %llu\n",
+		              ticbuckets[i], (unsigned long long)cumulative);
+	}
+	AddMetricLine(out, "odamex_tic_duration_seconds_bucket{le=\"+Inf\"} %llu\n",
+	              (unsigned long long)ticcount);
+	AddMetricLine(out, "odamex_tic_duration_seconds_sum %.9f\n", ticsum / 1000000000.0);
+	AddMetricLine(out, "odamex_tic_duration_seconds_count %llu\n",
+	              (unsigned long long)ticcount);
+
+	AddMetricHeader(out, "odamex_gametic", "gauge", "Current game tic.");
+	AddMetricLine(out, "odamex_gametic %d\n", ::gametic);
+
+	AddCounter(out, "odamex_packets_sent_total", "Packets sent to clients.",
+	           sv_metrics[METRIC_PACKETS_SENT]);
+
+	AddMetricHeader(out, "odamex_packets_compressed_total", "counter",
+	                "Packets that were or were not made smaller by compression.");
+	AddMetricLine(out, "odamex_packets_compressed_total{compressed=\"true\"} %llu\n",
+	              (unsigned long long)sv_metrics[METRIC_PACKETS_COMPRESSED]);
+	AddMetricLine(out, "odamex_packets_compressed_total{compressed=\"false\"} %llu\n",
+	              (unsigned long long)sv_metrics[METRIC_PACKETS_UNCOMPRESSED]);
+
+	AddMetricHeader(out, "odamex_sent_bytes_total", "counter",
+	                "Bytes of messages sent to clients, before compression.");
+	AddMetricLine(out, "odamex_sent_bytes_total{channel=\"reliable\"} %llu\n",
+	              (unsigned long long)sv_metrics[METRIC_RELIABLE_BYTES]);
+	AddMetricLine(out, "odamex_sent_bytes_total{channel=\"unreliable\"} %llu\n",
+	              (unsigned long long)sv_metrics[METRIC_UNRELIABLE_BYTES]);
+
+	AddCounter(out, "odamex_retransmits_total", "Reliable packets sent again.",
+	           sv_metrics[METRIC_RETRANSMITS]);
+	AddCounter(out, "odamex_retransmit_bytes_total",
+	           "Bytes of reliable messages sent again.",
+	           sv_metrics[METRIC_RETRANSMIT_BYTES]);
+	AddCounter(out, "odamex_updates_culled_total",
+	           "Actor updates held back because the player couldn't see or hear them.",
+	           sv_metrics[METRIC_UPDATES_CULLED]);
+
+	// Players
+	AddMetricHeader(out, "odamex_players", "gauge", "Connected clients.");
+	AddMetricLine(out, "odamex_players %" PRIuSIZE "\n", ::players.size());
+
+	AddMetricHeader(out, "odamex_client_rtt_milliseconds", "gauge",
+	                "Round trip time to each client.");
+	for (Players::const_iterator it = ::players.begin(); it != ::players.end(); ++it)
+	{
+		AddMetricLine(out, "odamex_client_rtt_milliseconds{id=\"%d\",name=\"%s\"} %d\n",
+		              it->id, MetricLabel(it->userinfo.netname).c_str(), it->ping);
+	}
+
+	AddMetricHeader(out, "odamex_client_sent_bytes_per_second", "gauge",
+	                "Bytes sent to each client over the last whole second.");
+	for (Players::const_iterator it = ::players.begin(); it != ::players.end(); ++it)
+	{
+		if (it->id >= MAXPLAYERS)
+			continue;
+
+		const std::string name = MetricLabel(it->userinfo.netname);
+		AddMetricLine(out,
+		              "odamex_client_sent_bytes_per_second{id=\"%d\",name=\"%s\","
+		              "channel=\"reliable\"} %d\n",
+		              it->id, name.c_str(), clientreliablebps[it->id]);
+		AddMetricLine(out,
+		              "odamex_client_sent_bytes_per_second{id=\"%d\",name=\"%s\","
+		              "channel=\"unreliable\"} %d\n",
+		              it->id, name.c_str(), clientunreliablebps[it->id]);
+	}
+
+	AddMetricHeader(out, "odamex_client_send_rate_bytes_per_second", "gauge",
+	                "Rate each client's congestion control currently allows.");
+	for (Players::const_iterator it = ::players.begin(); it != ::players.end(); ++it)
+	{
+		AddMetricLine(out,
+		              "odamex_client_send_rate_bytes_per_second{id=\"%d\",name=\"%s\"} %d\n",
+		              it->id, MetricLabel(it->userinfo.netname).c_str(),
+		              it->client.sendrate.rate);
+	}
+
+	// Thinkers
+	typedef std::map<std::string, int> ThinkerCounts;
+	ThinkerCounts thinkers;
+	{
+		TThinkerIterator<DThinker> iterator;
+		DThinker* thinker;
+		while ((thinker = iterator.Next()))
+			thinkers[RUNTIME_TYPE(thinker)->Name]++;
+	}
+
+	AddMetricHeader(out, "odamex_thinkers", "gauge", "Thinkers of each type.");
+	for (ThinkerCounts::const_iterator it = thinkers.begin(); it != thinkers.end(); ++it)
+	{
+		AddMetricLine(out, "odamex_thinkers{type=\"%s\"} %d\n",
+		              MetricLabel(it->first).c_str(), it->second);
+	}
+
+	// Zone memory
+	size_t blocks, bytes;
+	Z_GetUsage(blocks, bytes);
+
+	AddMetricHeader(out, "odamex_zone_blocks", "gauge", "Blocks allocated by the zone.");
+	AddMetricLine(out, "odamex_zone_blocks %" PRIuSIZE "\n", blocks);
+	AddMetricHeader(out, "odamex_zone_bytes", "gauge", "Bytes allocated by the zone.");
+	AddMetricLine(out, "odamex_zone_bytes %" PRIuSIZE "\n", bytes);
+}
+
+static void SetNonBlocking(SOCKET sock)
+{
+	u_long nonblocking = 1;
+	ioctlsocket(sock, FIONBIO, &nonblocking);
+}
+
+static SOCKET OpenTCPListener(const char* address, int port)
+{
+	SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	int reuse = 1;
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = inet_addr(address);
+
+	if (addr.sin_addr.s_addr == INADDR_NONE ||
+	    bind(sock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+	    listen(sock, 4) == SOCKET_ERROR)
+	{
+		closesocket(sock);
+		return INVALID_SOCKET;
+	}
+
+	SetNonBlocking(sock);
+	return sock;
+}
+
+#ifndef _WIN32
+static SOCKET OpenUnixListener(const std::string& path)
+{
+	sockaddr_un addr;
+	if (path.size() >= sizeof(addr.sun_path))
+		return INVALID_SOCKET;
+
+	SOCKET sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+
+	// Get rid of the socket left over from the last run.
+	unlink(path.c_str());
+
+	if (bind(sock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+	    listen(sock, 4) == SOCKET_ERROR)
+	{
+		closesocket(sock);
+		return INVALID_SOCKET;
+	}
+
+	SetNonBlocking(sock);
+	return sock;
+}
+#endif
+
+//
+// SV_ShutdownMetrics
+//
+// Stops listening and hangs up on anybody still connected.
+//
+void STACK_ARGS SV_ShutdownMetrics()
+{
+	for (size_t i = 0; i < connections.size(); i++)
+		closesocket(connections[i].sock);
+	connections.clear();
+
+	if (tcplistener != INVALID_SOCKET)
+	{
+		closesocket(tcplistener);
+		tcplistener = INVALID_SOCKET;
+	}
+
+	if (unixlistener != INVALID_SOCKET)
+	{
+		closesocket(unixlistener);
+		unixlistener = INVALID_SOCKET;
+#ifndef _WIN32
+		unlink(unixpath.c_str());
+#endif
+	}
+}
+
+//
+// SV_InitMetrics
+//
+// Starts listening for scrapes on whatever the metrics cvars ask for.
+//
+void SV_InitMetrics()
+{
+	SV_ShutdownMetrics();
+
+	const int port = sv_metricsport.asInt();
+	if (port > 0)
+	{
+		tcplistener = OpenTCPListener(sv_metricsaddress.cstring(), port);
+		if (tcplistener == INVALID_SOCKET)
+			Printf(PRINT_HIGH, "Could not serve metrics on %s:%d.\n",
+			       sv_metricsaddress.cstring(), port);
+		else
+			Printf(PRINT_HIGH, "Serving metrics on %s:%d.\n", sv_metricsaddress.cstring(),
+			       port);
+	}
+
+	unixpath = sv_metricssocket.str();
+	if (!unixpath.empty())
+	{
+#ifdef _WIN32
+		Printf(PRINT_HIGH, "Metrics can't be served on a UNIX socket on Windows.\n");
+#else
+		unixlistener = OpenUnixListener(unixpath);
+		if (unixlistener == INVALID_SOCKET)
+			Printf(PRINT_HIGH, "Could not serve metrics on \"%s\".\n", unixpath.c_str());
+		else
+			Printf(PRINT_HIGH, "Serving metrics on \"%s\".\n", unixpath.c_str());
+#endif
+	}
+}
+
+static void AcceptConnections(SOCKET listener)
+{
+	if (listener == INVALID_SOCKET)
+		return;
+
+	while (connections.size() < MAX_METRICS_CONNECTIONS)
+	{
+		SOCKET sock = accept(listener, NULL, NULL);
+		if (sock == INVALID_SOCKET)
+			return;
+
+		SetNonBlocking(sock);
+
+		MetricsConnection conn;
+		conn.sock = sock;
+		conn.opened = I_MSTime();
+		conn.sent = 0;
+		connections.push_back(conn);
+	}
+}
+
+//
+// ServiceConnection
+//
+// Returns false once we're done with the connection.
+//
+static bool ServiceConnection(MetricsConnection& conn)
+{
+	if (I_MSTime() - conn.opened > METRICS_TIMEOUT_MS)
+		return false;
+
+	if (conn.response.empty())
+	{
+		char buf[1024];
+		const int len = recv(conn.sock, buf, sizeof(buf), 0);
+		if (len == 0)
+			return false;
+		if (len < 0)
+			return true; // Nothing new yet.
+
+		conn.request.append(buf, len);
+		if (conn.request.size() > MAX_METRICS_REQUEST)
+			return false;
+
+		// Wait for the whole request header.
+		if (conn.request.find("\r\n\r\n") == std::string::npos &&
+		    conn.request.find("\n\n") == std::string::npos)
+			return true;
+
+		if (conn.request.compare(0, 4, "GET ") != 0)
+		{
+			conn.response = "HTTP/1.0 405 Method Not Allowed\r\n"
+			                "Content-Length: 0\r\n\r\n";
+		}
+		else
+		{
+			std::string body;
+			BuildMetrics(body);
+
+			std::string header;
+			StrFormat(header,
+			          "HTTP/1.0 200 OK\r\n"
+			          "Content-Type: text/plain; version=0.0.4\r\n"
+			          "Content-Length: %" PRIuSIZE "\r\n\r\n",
+			          body.size());
+			conn.response = header + body;
+		}
+	}
+
+	const int len = send(conn.sock, conn.response.data() + conn.sent,
+	                     conn.response.size() - conn.sent, METRICS_SEND_FLAGS);
+	if (len < 0)
+	{
+#ifdef _WIN32
+		return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+	}
+
+	conn.sent += len;
+	return conn.sent < conn.response.size();
+}
+
+//
+// SV_PollMetrics
+//
+// Called from the main loop to answer any scrapes.
+//
+void SV_PollMetrics()
+{
+	if (tcplistener == INVALID_SOCKET && unixlistener == INVALID_SOCKET &&
+	    connections.empty())
+		return;
+
+	AcceptConnections(tcplistener);
+	AcceptConnections(unixlistener);
+
+	for (size_t i = 0; i < connections.size();)
+	{
+		if (ServiceConnection(connections[i]))
+		{
+			i++;
+			continue;
+		}
+
+		closesocket(connections[i].sock);
+		connections.erase(connections.begin() + i);
+	}
+}
+
+CVAR_FUNC_IMPL(sv_metricsport)
+{
+	if (network_game)
+		SV_InitMetrics();
+}
+
+CVAR_FUNC_IMPL(sv_metricsaddress)
+{
+	if (network_game)
+		SV_InitMetrics();
+}
+
+CVAR_FUNC_IMPL(sv_metricssocket)
+{
+	if (network_game)
+		SV_InitMetrics();
+}
+
+VERSION_CONTROL(sv_metrics_cpp, "$Id$")
@@ -0,0 +1,58 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Server metrics, served in the Prometheus text format.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __SV_METRICS_H__
+#define __SV_METRICS_H__
+
+#include "d_player.h"
+
+enum svmetric_t
+{
+	METRIC_PACKETS_SENT,
+	METRIC_PACKETS_COMPRESSED,
+	METRIC_PACKETS_UNCOMPRESSED,
+	METRIC_RELIABLE_BYTES,
+	METRIC_UNRELIABLE_BYTES,
+	METRIC_RETRANSMITS,
+	METRIC_RETRANSMIT_BYTES,
+	METRIC_UPDATES_CULLED,
+
+	NUM_METRICS
+};
+
+// Only ever touched on the main thread, so counting is just an add.
+extern uint64_t sv_metrics[NUM_METRICS];
+
+inline void SV_CountMetric(svmetric_t metric, uint64_t amount = 1)
+{
+	sv_metrics[metric] += amount;
+}
+
+void SV_MetricsTic(dtime_t elapsed);
+void SV_MetricsClientBPS(const player_t& player);
+
+void SV_InitMetrics();
+void STACK_ARGS SV_ShutdownMetrics();
+void SV_PollMetrics();
+
+#endif
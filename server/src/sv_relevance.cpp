@@ -0,0 +1,198 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Works out which actors each client can see or hear, so that updates
+//   about the rest can be sent less often.
+//
+//   Once a tic, the first time it's asked about a client, it floods out
+//   from the sector the client is looking from through every two-sided line
+//   that isn't shut, the same way monsters hear sounds, stopping at lines
+//   too far away to matter.  A sector that was reached is visible if the
+//   REJECT lump doesn't rule it out, and audible if the actor in it is close
+//   enough to be heard.  Every actor is still spawned on every client, only
+//   the rate of updates about it changes.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "odamex.h"
+
+#include "c_cvars.h"
+#include "m_fixed.h"
+#include "p_local.h"
+#include "sv_main.h"
+#include "sv_metrics.h"
+#include "sv_relevance.h"
+
+EXTERN_CVAR(sv_cullupdates)
+
+// Lines further away than this from the viewer aren't flooded through.
+static const fixed_t RELEVANCE_RANGE = 4096 * FRACUNIT;
+
+// Actors that can be reached and are closer than this can be heard even if
+// REJECT says they can't be seen.  Same as the client's sound clipping.
+static const fixed_t RELEVANCE_AUDIBLE_DIST = 1200 * FRACUNIT;
+
+// Updates about irrelevant actors are this many times less frequent.
+static const int RELEVANCE_KEEPALIVE_SCALE = 5;
+
+struct relevance_t
+{
+	int tic;                   // gametic the sectors were worked out
+	std::vector<byte> sectors; // nonzero if reachable from the viewer
+	int viewsector;            // sector the viewer is in, or -1
+
+	relevance_t() : tic(-1), viewsector(-1)
+	{
+	}
+};
+
+static relevance_t relevance[MAXPLAYERS];
+static std::vector<int> floodqueue;
+
+//
+// SV_ViewerMobj
+//
+// Whatever the player is looking through, which is someone else if they're
+// spying.
+//
+AActor* SV_ViewerMobj(player_t& player)
+{
+	player_t& spied = idplayer(player.spying);
+	if (validplayer(spied) && spied.mo)
+		return spied.mo;
+
+	return player.mo;
+}
+
+//
+// FloodSectors
+//
+// Marks every sector reachable from the viewer through open lines.
+//
+static void FloodSectors(relevance_t& rel, AActor* viewer)
+{
+	rel.sectors.assign(numsectors, 0);
+	rel.viewsector = -1;
+
+	if (!viewer || !viewer->subsector)
+		return;
+
+	rel.viewsector = viewer->subsector->sector - sectors;
+	rel.sectors[rel.viewsector] = 1;
+
+	floodqueue.clear();
+	floodqueue.push_back(rel.viewsector);
+
+	for (size_t i = 0; i < floodqueue.size(); i++)
+	{
+		const sector_t* sec = &sectors[floodqueue[i]];
+
+		for (int j = 0; j < sec->linecount; j++)
+		{
+			const line_t* line = sec->lines[j];
+			if (!(line->flags & ML_TWOSIDED))
+				continue;
+
+			const sector_t* other = line->frontsector == sec ? line->backsector
+			                                                 : line->frontsector;
+			if (!other)
+				continue;
+
+			const int othernum = other - sectors;
+			if (rel.sectors[othernum])
+				continue;
+
+			const fixed_t x = (line->v1->x >> 1) + (line->v2->x >> 1);
+			const fixed_t y = (line->v1->y >> 1) + (line->v2->y >> 1);
+
+			if (P_AproxDistance(x - viewer->x, y - viewer->y) > RELEVANCE_RANGE)
+				continue;
+
+			P_LineOpening(line, x, y);
+			if (openrange <= 0)
+				continue; // closed door
+
+			rel.sectors[othernum] = 1;
+			floodqueue.push_back(othernum);
+		}
+	}
+}
+
+//
+// SV_IsRelevant
+//
+// Returns true if the player can see or hear mo, or needs to know about it
+// regardless.
+//
+bool SV_IsRelevant(player_t& player, AActor* mo)
+{
+	AActor* viewer = SV_ViewerMobj(player);
+	if (!viewer || !mo || !mo->subsector || player.id >= MAXPLAYERS)
+		return true;
+
+	// Anything to do with the viewer themselves.
+	if (mo == viewer || mo->target == viewer || mo->tracer == viewer)
+		return true;
+
+	if (mo->player && SV_IsTeammate(player, *mo->player))
+		return true;
+
+	relevance_t& rel = relevance[player.id];
+	if (rel.tic != gametic || rel.sectors.size() != (size_t)numsectors)
+	{
+		FloodSectors(rel, viewer);
+		rel.tic = gametic;
+	}
+
+	if (rel.viewsector < 0)
+		return true;
+
+	const int secnum = mo->subsector->sector - sectors;
+	if (!rel.sectors[secnum])
+		return false;
+
+	const int pnum = rel.viewsector * numsectors + secnum;
+	if (rejectempty || !(rejectmatrix[pnum >> 3] & (1 << (pnum & 7))))
+		return true;
+
+	return P_AproxDistance(mo->x - viewer->x, mo->y - viewer->y) < RELEVANCE_AUDIBLE_DIST;
+}
+
+//
+// SV_IsUpdateDue
+//
+// Returns true if an update about mo that's normally sent every period tics
+// should go out this tic.  Irrelevant actors are updated less often.
+//
+bool SV_IsUpdateDue(player_t& player, AActor* mo, int period)
+{
+	if ((gametic + mo->netid) % period)
+		return false;
+
+	if (!sv_cullupdates || (gametic + mo->netid) % (period * RELEVANCE_KEEPALIVE_SCALE) == 0)
+		return true;
+
+	if (SV_IsRelevant(player, mo))
+		return true;
+
+	SV_CountMetric(METRIC_UPDATES_CULLED);
+	return false;
+}
+
+VERSION_CONTROL(sv_relevance_cpp, "$Id$")
@@ -0,0 +1,35 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Works out which actors each client can see or hear, so that updates
+//   about the rest can be sent less often.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __SV_RELEVANCE_H__
+#define __SV_RELEVANCE_H__
+
+#include "actor.h"
+#include "d_player.h"
+
+AActor* SV_ViewerMobj(player_t& player);
+bool SV_IsRelevant(player_t& player, AActor* mo);
+bool SV_IsUpdateDue(player_t& player, AActor* mo, int period);
+
+#endif
@@ -26,8 +26,11 @@
 
 #include "p_local.h"
 #include "sv_main.h"
+#include "sv_metrics.h"
+#include "sv_relevance.h"
 #include "huffman.h"
 #include "i_net.h"
+#include "i_thread.h"
 
 #ifdef SIMULATE_LATENCY
 #include <thread>
@@ -41,13 +44,142 @@ EXTERN_CVAR (log_packetdebug)
 EXTERN_CVAR (sv_latency)
 #endif
 
-buf_t plain(MAX_UDP_PACKET); // denis - todo - call_terms destroys these statics on quit
-buf_t sendd(MAX_UDP_PACKET);
-
 const static size_t PACKET_FLAG_INDEX = sizeof(uint32_t);
 const static size_t PACKET_MESSAGE_INDEX = PACKET_FLAG_INDEX + 1;
 const static size_t PACKET_HEADER_SIZE = PACKET_MESSAGE_INDEX;
-const static size_t PACKET_OLD_MASK = 0xFF;
+
+// Bytes of reliable data in each piece when it has to be split up.
+const static size_t FRAGMENT_HEADER_SIZE = sizeof(uint32_t) + 2;
+const static size_t MAX_FRAGMENT_SIZE =
+    MAX_UDP_SIZE - PACKET_HEADER_SIZE - FRAGMENT_HEADER_SIZE;
+
+// Limits on how long to wait for an ack before sending a packet again, in ms.
+const static int RTO_INITIAL = 500;
+const static int RTO_MIN = 60;
+const static int RTO_MAX = 2000;
+
+// An unacked packet is sent again straight away once an ack for a packet
+// this many sequences later arrives.
+const static int FAST_RETRANSMIT_DISTANCE = 3;
+
+// Slowest the unreliable stream is throttled to, in bytes per second.  The
+// fastest is the client's rate.
+const static int SENDRATE_MIN = 2000;
+
+// How much the send rate grows every round trip without loss.  A loss takes
+// a quarter off.
+const static int SENDRATE_STEP = 1400;
+
+// Pings are never taken to be lower than this, in ms.
+const static int SENDRATE_MIN_RTT = 20;
+
+// Tics of tokens the bucket can save up, so a quiet moment can't turn into a
+// burst.
+const static int SENDRATE_BURST_TICS = 4;
+
+// Actors closer than this to the viewer are sent before those further away.
+const static fixed_t NEARBY_ACTOR_DIST = 1024 * FRACUNIT;
+
+// Clients each worker takes at a time when sending in parallel.
+const static int SEND_GRAIN = 4;
+
+//
+// sendcontext_t
+//
+// Buffers for putting together and sending packets for one client at a
+// time.  Each worker takes its own from the spare list, and anything that
+// has to happen on the main thread waits in here until FlushSendContext.
+//
+struct sendcontext_t
+{
+	buf_t packet;				// being put together
+	buf_t resend;				// an old packet going out again
+	buf_t scratch;				// for compression
+	uint64_t* workmem;
+
+	// Read on the main thread before sending, since I_MSTime isn't safe to
+	// call from the workers.
+	dtime_t now;
+
+	uint64_t metrics[NUM_METRICS];
+	std::vector<std::string> log;
+	std::vector<player_t*> drops;
+
+	// Room for a full reliable buffer after the header.
+	sendcontext_t()
+	    : packet(MAX_UDP_PACKET + PACKET_HEADER_SIZE + 1),
+	      resend(MAX_UDP_PACKET + PACKET_HEADER_SIZE + 1),
+	      workmem(new uint64_t[(MSG_MinilzoWorkSize() + 7) / 8]), now(0)
+	{
+		memset(metrics, 0, sizeof(metrics));
+	}
+};
+
+static sendcontext_t* mainsendcontext = NULL;
+static std::vector<sendcontext_t*> sparesendcontexts;
+static OMutex sparesendcontextlock;
+
+//
+// MainSendContext
+//
+// The context used by everything that sends from the main thread.  The
+// contexts are never freed, like the buffers they replace.
+//
+static sendcontext_t& MainSendContext()
+{
+	if (mainsendcontext == NULL)
+		mainsendcontext = new sendcontext_t;
+
+	return *mainsendcontext;
+}
+
+static sendcontext_t* TakeSendContext()
+{
+	OMutexLock lock(sparesendcontextlock);
+
+	if (sparesendcontexts.empty())
+		return new sendcontext_t;
+
+	sendcontext_t* ctx = sparesendcontexts.back();
+	sparesendcontexts.pop_back();
+	return ctx;
+}
+
+static void ReturnSendContext(sendcontext_t* ctx)
+{
+	OMutexLock lock(sparesendcontextlock);
+	sparesendcontexts.push_back(ctx);
+}
+
+//
+// FlushSendContext
+//
+// Counts, prints and drops whatever was put off while sending.  Main thread
+// only.
+//
+static void FlushSendContext(sendcontext_t& ctx)
+{
+	for (size_t i = 0; i < NUM_METRICS; i++)
+	{
+		if (ctx.metrics[i])
+		{
+			SV_CountMetric(static_cast<svmetric_t>(i), ctx.metrics[i]);
+			ctx.metrics[i] = 0;
+		}
+	}
+
+	for (size_t i = 0; i < ctx.log.size(); i++)
+		Printf(PRINT_HIGH, "%s", ctx.log[i].c_str());
+	ctx.log.clear();
+
+	// Dropping a client sends them one last packet, so the list is moved
+	// out of the way first.
+	std::vector<player_t*> drops;
+	drops.swap(ctx.drops);
+
+	for (size_t i = 0; i < drops.size(); i++)
+		SV_DropClient(*drops[i]);
+}
 
 //
 // CompressPacket
@@ -58,25 +190,21 @@ const static size_t PACKET_OLD_MASK = 0xFF;
 //
 // [AM] Cleaned the old huffman calls for code clarity sake.
 //
-static void CompressPacket(buf_t& send, const size_t reserved, client_t* cl)
+static void CompressPacket(sendcontext_t& ctx, buf_t& send, const size_t reserved)
 {
-	if (plain.maxsize() < send.maxsize())
-	{
-		plain.resize(send.maxsize());
-	}
-
-	plain.setcursize(send.size());
-	memcpy(plain.ptr(), send.ptr(), send.size());
-
 	byte method = 0;
-	if (MSG_CompressMinilzo(send, reserved, 0))
+	if (MSG_CompressMinilzo(send, reserved, 0, ctx.scratch, ctx.workmem))
 	{
 		// Successful compression, set the compression flag bit.
 		method |= SVF_COMPRESSED;
+		ctx.metrics[METRIC_PACKETS_COMPRESSED]++;
+	}
+	else
+	{
+		ctx.metrics[METRIC_PACKETS_UNCOMPRESSED]++;
 	}
 
 	send.ptr()[PACKET_FLAG_INDEX] |= method;
-	DPrintf("CompressPacket %x " PRIuSIZE "\n", method, send.size());
 }
 
 #ifdef SIMULATE_LATENCY
@@ -129,171 +257,590 @@ void SV_SendPacketDelayed(buf_t& packet, player_t& pl)
 #endif
 
 //
-// SV_SendPacket
+// SV_ActorBuf
 //
-bool SV_SendPacket(player_t &pl)
+// The unreliable buffer an update about mo belongs in for pl.  Actors close
+// to whoever pl is looking through are sent before ones further away.
+//
+buf_t* SV_ActorBuf(player_t& pl, AActor* mo)
 {
-	int				bps = 0; // bytes per second, not bits per second
+	client_t* cl = &pl.client;
+	AActor* viewer = SV_ViewerMobj(pl);
 
+	if (viewer && mo &&
+	    P_AproxDistance(mo->x - viewer->x, mo->y - viewer->y) < NEARBY_ACTOR_DIST)
+		return &cl->nearbuf;
+
+	return &cl->farbuf;
+}
+
+//
+// RefillSendTokens
+//
+// Tops up the token bucket with however many tics have passed since the
+// last packet.
+//
+static void RefillSendTokens(client_t* cl)
+{
+	client_t::sendrate_t& sr = cl->sendrate;
+	const int ceiling = MAX(cl->rate * 1000, SENDRATE_MIN);
+
+	if (sr.rate == 0)
+	{
+		// Start at half the client's rate and find the rest from there.
+		sr.rate = MAX(ceiling / 2, SENDRATE_MIN);
+		sr.tokens = 0;
+		sr.tokentic = gametic - 1;
+	}
+
+	// sv_maxrate could have gone down since the last packet.
+	sr.rate = MIN(sr.rate, ceiling);
+
+	if (sr.tokentic != gametic)
+	{
+		const int tics = clamp(gametic - sr.tokentic, 1, SENDRATE_BURST_TICS);
+		sr.tokens += sr.rate * tics / TICRATE;
+		sr.tokentic = gametic;
+	}
+
+	sr.tokens = clamp(sr.tokens, -sr.rate, sr.rate * SENDRATE_BURST_TICS / TICRATE);
+}
+
+//
+// TransmitPacket
+//
+// Compresses a finished packet and puts it on the wire.
+//
+static void TransmitPacket(sendcontext_t& ctx, player_t& pl, buf_t& packet, int sequence)
+{
+	client_t* cl = &pl.client;
+
+	// compress the packet, but not the sequence id
+	if (packet.size() > PACKET_HEADER_SIZE)
+	{
+		CompressPacket(ctx, packet, PACKET_HEADER_SIZE);
+	}
+
+	if (log_packetdebug)
+	{
+		std::string line;
+		StrFormat(line, "ply %03u, pkt %06u, size %04u, tic %07u, time %011u\n", pl.id,
+		          sequence, (unsigned int)packet.cursize, gametic,
+		          (unsigned int)ctx.now);
+		ctx.log.push_back(line);
+	}
+
+	ctx.metrics[METRIC_PACKETS_SENT]++;
+
+#ifdef SIMULATE_LATENCY
+	SV_SendPacketDelayed(packet, pl);
+#else
+	std::string error;
+	NET_SendPacket(packet, cl->address, &error);
+
+	if (!error.empty())
+		ctx.log.push_back(error);
+#endif
+}
+
+//
+// StartPacket
+//
+// Begins a new packet.  The sequence is filled in by FinishPacket,
+// so a packet that ends up empty never uses one up.
+//
+static void StartPacket(sendcontext_t& ctx, byte flags)
+{
+	ctx.packet.clear();
+	MSG_WriteLong(&ctx.packet, 0);
+	MSG_WriteByte(&ctx.packet, flags); // Compression flag is added later.
+}
+
+//
+// FinishPacket
+//
+// Numbers and sends the packet being put together.  The first reliablesize bytes after
+// the header are saved so they can be sent again until the client acks them.
+//
+static void FinishPacket(sendcontext_t& ctx, player_t& pl, size_t reliablesize)
+{
+	client_t* cl = &pl.client;
+	const int sequence = cl->sequence++;
+
+	cl->packetnum++; // packetnum will never be more than 255
+	                 // because sizeof(packetnum) == 1. Don't need
+	                 // to use &0xff. Cool, eh? ;-)
+
+	byte* header = ctx.packet.ptr();
+	header[0] = sequence & 0xFF;
+	header[1] = (sequence >> 8) & 0xFF;
+	header[2] = (sequence >> 16) & 0xFF;
+	header[3] = (sequence >> 24) & 0xFF;
+
+	if (reliablesize)
+	{
+		cl->oldpackets.push_back(client_t::oldPacket_t());
+
+		client_t::oldPacket_t& old = cl->oldpackets.back();
+		old.sequence = sequence;
+		old.flags = header[PACKET_FLAG_INDEX];
+		old.data.resize(reliablesize + 1);
+		SZ_Write(&old.data, ctx.packet.ptr(), PACKET_HEADER_SIZE, reliablesize);
+		old.sent = ctx.now;
+	}
+
+	TransmitPacket(ctx, pl, ctx.packet, sequence);
+}
+
+//
+// WriteReliable
+//
+// Adds reliable data to the packet being put together.  It always goes out, but it
+// still counts against the rate.
+//
+static void WriteReliable(sendcontext_t& ctx, client_t* cl, const byte* data, size_t len)
+{
+	SZ_Write(&ctx.packet, data, len);
+	cl->reliable_bps += len;
+	cl->sendrate.tokens -= len;
+	ctx.metrics[METRIC_RELIABLE_BYTES] += len;
+}
+
+//
+// SendFragments
+//
+// Splits reliable data that won't fit in one packet over as many as it
+// takes.  Each piece is a reliable packet in its own right, and the client
+// puts them back together once it has all of them.
+//
+static void SendFragments(sendcontext_t& ctx, player_t& pl)
+{
+	client_t* cl = &pl.client;
+	const buf_t& reliable = cl->reliablebuf;
+
+	const size_t count = (reliable.cursize + MAX_FRAGMENT_SIZE - 1) / MAX_FRAGMENT_SIZE;
+	const int first = cl->sequence;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const size_t offset = i * MAX_FRAGMENT_SIZE;
+		const size_t len = MIN(MAX_FRAGMENT_SIZE, reliable.cursize - offset);
+
+		StartPacket(ctx, SVF_FRAGMENT);
+		MSG_WriteLong(&ctx.packet, first);
+		MSG_WriteByte(&ctx.packet, (byte)i);
+		MSG_WriteByte(&ctx.packet, (byte)count);
+		WriteReliable(ctx, cl, reliable.data + offset, len);
+
+		FinishPacket(ctx, pl, ctx.packet.cursize - PACKET_HEADER_SIZE);
+	}
+}
+
+//
+// SendPacket
+//
+// Sends everything waiting in the client's buffers.  Returns false if the
+// client is to be dropped.
+//
+static bool SendPacket(sendcontext_t& ctx, player_t& pl)
+{
 	client_t *cl = &pl.client;
 
 	if (cl->reliablebuf.overflowed)
 	{ 
 		SZ_Clear(&cl->netbuf);
+		SZ_Clear(&cl->nearbuf);
+		SZ_Clear(&cl->farbuf);
 		SZ_Clear(&cl->reliablebuf);
-	    SV_DropClient(pl);
+		ctx.drops.push_back(&pl);
 		return false;
 	}
-	else
-		if (cl->netbuf.overflowed)
-			SZ_Clear(&cl->netbuf);
+
+	if (cl->netbuf.overflowed)
+		SZ_Clear(&cl->netbuf);
+	if (cl->nearbuf.overflowed)
+		SZ_Clear(&cl->nearbuf);
+	if (cl->farbuf.overflowed)
+		SZ_Clear(&cl->farbuf);
 
 	// [SL] 2012-05-04 - Don't send empty packets - they still have overhead
-	if (cl->reliablebuf.cursize + cl->netbuf.cursize == 0)
+	if (cl->reliablebuf.cursize + cl->netbuf.cursize + cl->nearbuf.cursize +
+	        cl->farbuf.cursize ==
+	    0)
 		return true;
 
-	sendd.clear();
-
-	// save the reliable message 
-	// it will be retransmited, if it's missed
-	client_t::oldPacket_t& old = cl->oldpackets[cl->sequence & PACKET_OLD_MASK];
+	RefillSendTokens(cl);
 
-	old.data.clear();
-	if (cl->reliablebuf.cursize)
+	// Reliable data too big for one packet is split up, but only once the
+	// client has acked the first packet and so is known to be listening, and
+	// only if it asked for fragments.  Otherwise it goes as one big packet.
+	if (cl->reliablebuf.cursize > MAX_FRAGMENT_SIZE && cl->last_sequence >= 0 &&
+	    (cl->netfeatures & NETF_FRAGMENT))
 	{
-		// copy the reliable data into the buffer.
-		old.sequence = cl->sequence;
-		SZ_Write(&old.data, cl->reliablebuf.data, cl->reliablebuf.cursize);
-	}
-	else
-	{
-		old.sequence = -1;
+		SendFragments(ctx, pl);
+		SZ_Clear(&cl->reliablebuf);
 	}
 
-	cl->packetnum++; // packetnum will never be more than 255
-	                 // because sizeof(packetnum) == 1. Don't need
-	                 // to use &0xff. Cool, eh? ;-)
+	// copy the reliable message to the packet first
+	StartPacket(ctx, 0);
 
-	// copy sequence
-	MSG_WriteLong(&sendd, cl->sequence++);
-	MSG_WriteByte(&sendd, 0); // Flags, filled out later.
+	const size_t reliablesize = cl->reliablebuf.cursize;
+	if (reliablesize)
+		WriteReliable(ctx, cl, cl->reliablebuf.data, reliablesize);
 
-	// copy the reliable message to the packet first
-    if (cl->reliablebuf.cursize)
-    {
-		SZ_Write (&sendd, cl->reliablebuf.data, cl->reliablebuf.cursize);
-		cl->reliable_bps += cl->reliablebuf.cursize;
-    }
-
-	// add the unreliable part if space is available and rate value
-	// allows it
-	if (gametic % 35)
-	    bps = (int)((double)( (cl->unreliable_bps + cl->reliable_bps) * TICRATE)/(double)(gametic%35));
-
-    if (bps < cl->rate*1000)
-
-	  if (cl->netbuf.cursize && (sendd.maxsize() - sendd.cursize > cl->netbuf.cursize) )
-	  {
-         SZ_Write (&sendd, cl->netbuf.data, cl->netbuf.cursize);
-	     cl->unreliable_bps += cl->netbuf.cursize;
-	  }
-    
-	SZ_Clear(&cl->netbuf);
 	SZ_Clear(&cl->reliablebuf);
-	
-	// compress the packet, but not the sequence id
-	if (sendd.size() > PACKET_HEADER_SIZE)
-	{
-		CompressPacket(sendd, PACKET_HEADER_SIZE, cl);
-	}
 
-	if (log_packetdebug)
+	// then the unreliable classes, most important first.  The player's own
+	// view is small and keeps their prediction honest, so it goes even when
+	// the bucket is empty.
+	buf_t* unreliable[] = {&cl->netbuf, &cl->nearbuf, &cl->farbuf};
+	size_t saved = reliablesize;
+
+	for (size_t i = 0; i < ARRAY_LENGTH(unreliable); i++)
 	{
-		Printf(PRINT_HIGH, "ply %03u, pkt %06u, size %04u, tic %07u, time %011u\n",
-			   pl.id, cl->sequence - 1, sendd.cursize, gametic, I_MSTime());
+		buf_t& buf = *unreliable[i];
+		if (!buf.cursize)
+			continue;
+
+		if (i > 0 && cl->sendrate.tokens <= 0)
+		{
+			// Whatever isn't sent is thrown away, there will be a fresher
+			// update along soon enough.
+			cl->sendrate.limited = true;
+			SZ_Clear(&buf);
+			continue;
+		}
+
+		// Start another packet rather than go over the safe size.
+		if (ctx.packet.cursize > PACKET_HEADER_SIZE &&
+		    ctx.packet.cursize + buf.cursize > MAX_UDP_SIZE)
+		{
+			FinishPacket(ctx, pl, saved);
+			StartPacket(ctx, 0);
+			saved = 0;
+		}
+
+		if (ctx.packet.maxsize() - ctx.packet.cursize > buf.cursize)
+		{
+			SZ_Write(&ctx.packet, buf.data, buf.cursize);
+			cl->unreliable_bps += buf.cursize;
+			cl->sendrate.tokens -= buf.cursize;
+			ctx.metrics[METRIC_UNRELIABLE_BYTES] += buf.cursize;
+		}
+
+		SZ_Clear(&buf);
 	}
 
-#ifdef SIMULATE_LATENCY
-	SV_SendPacketDelayed(sendd, pl);
-#else
+	if (ctx.packet.cursize > PACKET_HEADER_SIZE)
+		FinishPacket(ctx, pl, saved);
 
-	NET_SendPacket(sendd, cl->address);
-#endif
 	return true;
 }
 
-/**
- * @brief Send an old reliable packet with old data on the wire.
- * 
- * @param pl Player to send to.
- * @param sequence Sequence number to send.  This assumss
-*/
-static void SendOldPacket(player_t& pl, const int sequence)
+//
+// SV_SendPacket
+//
+bool SV_SendPacket(player_t &pl)
 {
-	// Send buffer.
-	static buf_t send(MAX_UDP_PACKET);
+	sendcontext_t& ctx = MainSendContext();
+	ctx.now = I_MSTime();
+
+	const bool sent = SendPacket(ctx, pl);
+	FlushSendContext(ctx);
+
+	return sent;
+}
+
+//
+// ResendPacket
+//
+// Puts a reliable packet back on the wire with its original sequence, so
+// the client can tell if it's a duplicate.
+//
+static void ResendPacket(sendcontext_t& ctx, player_t& pl, client_t::oldPacket_t& old)
+{
+	buf_t& send = ctx.resend;
 	send.clear();
 
 	client_t& cl = pl.client;
-	client_t::oldPacket_t& old = cl.oldpackets[sequence & PACKET_OLD_MASK];
-
-	// This is a lot simpler than a fresh send.  Just send the data we have
-	// have saved out.
 
 	MSG_WriteLong(&send, old.sequence);
-	MSG_WriteByte(&send, 0); // Flags, filled out later.
+	MSG_WriteByte(&send, old.flags);
+
+	SZ_Write(&send, old.data.data, old.data.cursize);
+	cl.reliable_bps += old.data.cursize;
+	cl.sendrate.tokens -= old.data.cursize;
+
+	ctx.metrics[METRIC_RETRANSMITS]++;
+	ctx.metrics[METRIC_RETRANSMIT_BYTES] += old.data.cursize;
+
+	old.sent = ctx.now;
+	old.retries++;
+
+	TransmitPacket(ctx, pl, send, old.sequence);
+}
 
-	// copy the reliable message to the packet
-	if (old.data.cursize)
+//
+// RetransmitTimeout
+//
+// How long to wait for an ack before sending a packet again, worked out
+// from the round trips measured so far the same way TCP does it.
+//
+static dtime_t RetransmitTimeout(const client_t* cl, int retries)
+{
+	int rto = RTO_INITIAL;
+	if (cl->srtt > 0)
+		rto = clamp(cl->srtt + 4 * cl->rttvar, RTO_MIN, RTO_MAX);
+
+	// Back off for every time it's been sent already.
+	return MIN(rto << MIN(retries, 5), RTO_MAX);
+}
+
+//
+// ResendPackets
+//
+// Sends reliable packets that have gone too long without an ack.  Returns
+// false if the client is to be dropped.
+//
+static bool ResendPackets(sendcontext_t& ctx, player_t& pl)
+{
+	client_t* cl = &pl.client;
+	if (cl->oldpackets.empty())
+		return true;
+
+	// The client can only weed out duplicates within its window.
+	const int window = (cl->netfeatures & NETF_SELECTIVEACK) ? PACKET_SEQ_WINDOW
+	                                                         : LEGACY_PACKET_SEQ_WINDOW;
+	if (cl->sequence - cl->oldpackets.front().sequence >= window)
 	{
-		SZ_Write(&send, old.data.data, old.data.cursize);
-		cl.reliable_bps += old.data.cursize;
+		std::string line;
+		StrFormat(line, "%s stopped acknowledging packets.\n",
+		          pl.userinfo.netname.c_str());
+		ctx.log.push_back(line);
+
+		cl->oldpackets.clear();
+		ctx.drops.push_back(&pl);
+		return false;
 	}
 
-	// compress the packet, but not the sequence id
-	if (send.size() > PACKET_HEADER_SIZE)
+	typedef std::list<client_t::oldPacket_t> OldPackets;
+	for (OldPackets::iterator it = cl->oldpackets.begin(); it != cl->oldpackets.end(); ++it)
 	{
-		CompressPacket(send, PACKET_HEADER_SIZE, &cl);
+		if (ctx.now - it->sent >= RetransmitTimeout(cl, it->retries))
+			ResendPacket(ctx, pl, *it);
 	}
 
-	NET_SendPacket(send, cl.address);
+	return true;
+}
+
+//
+// SV_ResendPackets
+//
+// Called once a tic for each client.
+//
+void SV_ResendPackets(player_t& pl)
+{
+	sendcontext_t& ctx = MainSendContext();
+	ctx.now = I_MSTime();
+
+	ResendPackets(ctx, pl);
+	FlushSendContext(ctx);
+}
+
+struct sendpacketsjob_t
+{
+	std::vector<player_t*> clients;
+	dtime_t now;
+};
+
+static void SendPacketsJob(int begin, int end, void* data)
+{
+	const sendpacketsjob_t* job = static_cast<const sendpacketsjob_t*>(data);
+	sendcontext_t* ctx = TakeSendContext();
+	ctx->now = job->now;
+
+	for (int i = begin; i < end; i++)
+	{
+		player_t& pl = *job->clients[i];
+
+		if (!ResendPackets(*ctx, pl))
+			continue;
+
+		// [AM] Don't send packets to players who haven't acked packet 0
+		if (pl.playerstate != PST_CONTACT)
+			SendPacket(*ctx, pl);
+	}
+
+	ReturnSendContext(ctx);
+}
+
+//
+// SV_SendPacketsParallel
+//
+// Does the same as calling SV_ResendPackets and SV_SendPacket for every
+// client, but spread over the worker pool.  Each client's packets only
+// touch that client's state, so the only thing the workers share is the
+// socket.  Anything with a wider effect waits for FlushSendContext.
+//
+void SV_SendPacketsParallel()
+{
+	sendpacketsjob_t job;
+	job.clients.reserve(players.size());
+
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+		job.clients.push_back(&*it);
+
+	if (job.clients.empty())
+		return;
+
+	job.now = I_MSTime();
+
+#ifdef SIMULATE_LATENCY
+	// The delay queue can't be shared between threads.
+	const int grain = job.clients.size();
+#else
+	const int grain = SEND_GRAIN;
+#endif
+
+	I_ParallelFor(job.clients.size(), grain, SendPacketsJob, &job);
+
+	// Dropping a client can send packets, which takes contexts from the
+	// spare list again, so go through a copy.
+	std::vector<sendcontext_t*> contexts;
+	{
+		OMutexLock lock(sparesendcontextlock);
+		contexts = sparesendcontexts;
+	}
+
+	for (size_t i = 0; i < contexts.size(); i++)
+		FlushSendContext(*contexts[i]);
+}
+
+//
+// UpdateRoundTrip
+//
+static void UpdateRoundTrip(client_t* cl, int rtt)
+{
+	rtt = MAX(rtt, 1);
+
+	if (cl->srtt == 0)
+	{
+		cl->srtt = rtt;
+		cl->rttvar = rtt / 2;
+	}
+	else
+	{
+		cl->rttvar = (cl->rttvar * 3 + abs(cl->srtt - rtt)) / 4;
+		cl->srtt = (cl->srtt * 7 + rtt) / 8;
+	}
+}
+
+//
+// UpdateSendRate
+//
+// Called for every ack.  Packets that went missing cut the rate, at most
+// once a round trip so that a run of losses only counts once.  Otherwise the
+// rate grows a step each round trip, but only while it's holding something
+// back and the ping isn't climbing.
+//
+static void UpdateSendRate(player_t& player, int missed)
+{
+	client_t::sendrate_t& sr = player.client.sendrate;
+	if (sr.rate == 0)
+		return;
+
+	const int rtt = MAX(player.ping, SENDRATE_MIN_RTT);
+	if (sr.minrtt == 0 || rtt < sr.minrtt)
+		sr.minrtt = rtt;
+
+	const dtime_t now = I_MSTime();
+	if (now - sr.lastchange < (dtime_t)rtt)
+		return;
+
+	if (missed > 0)
+	{
+		sr.rate = MAX(sr.rate - sr.rate / 4, SENDRATE_MIN);
+		sr.lastchange = now;
+	}
+	else if (sr.limited && rtt <= sr.minrtt * 2 + SENDRATE_MIN_RTT)
+	{
+		sr.rate = MIN(sr.rate + SENDRATE_STEP, MAX(player.client.rate * 1000, SENDRATE_MIN));
+		sr.limited = false;
+		sr.lastchange = now;
+	}
 }
 
 //
 // SV_AcknowledgePacket
 //
-void SV_AcknowledgePacket(player_t &player)
+// Every packet the client gets is acked with its sequence.  With hasbits
+// (clc_ackbits) a bitfield of which of the 32 sequences before it have
+// arrived follows, so a lost ack is made up for by the next one.
+//
+void SV_AcknowledgePacket(player_t &player, bool hasbits)
 {
 	client_t *cl = &player.client;
 
-	int sequence = MSG_ReadLong();
+	const int sequence = MSG_ReadLong();
+	const unsigned int ackbits = hasbits ? MSG_ReadLong() : 0;
 
 	cl->compressor.packet_acked(sequence);
 
-	// packet is missed
-	if (sequence - cl->last_sequence > 1)
+	// Count the packets since the last ack that the client says it never got.
+	// Without the bitfield, anything skipped over is taken as lost.
+	int missed = 0;
+	if (hasbits)
 	{
-		// resend
-		for (int seq = cl->last_sequence+1; seq < sequence; seq++)
+		for (int seq = MAX(cl->last_sequence + 1, sequence - 32); seq < sequence; seq++)
 		{
-			int  n;
-			bool needfullupdate = true;
-
-			if (cl->oldpackets[seq & PACKET_OLD_MASK].sequence != seq)
-			{
-				// do full update
-				DPrintf("need full update\n");
-				cl->last_sequence = sequence;
-				return;
-			}
-
-			SendOldPacket(player, seq);
+			if (!(ackbits & (1u << (sequence - 1 - seq))))
+				missed++;
 		}
 	}
+	else
+	{
+		missed = MAX(0, sequence - cl->last_sequence - 1);
+	}
+
+	UpdateSendRate(player, missed);
+
+	const dtime_t now = I_MSTime();
+
+	typedef std::list<client_t::oldPacket_t> OldPackets;
+	for (OldPackets::iterator it = cl->oldpackets.begin(); it != cl->oldpackets.end();)
+	{
+		const int behind = sequence - it->sequence;
+
+		if (behind == 0 || (behind > 0 && behind <= 32 && (ackbits & (1u << (behind - 1)))))
+		{
+			// Only time packets that were sent once, otherwise there's no
+			// telling which send the ack is for.
+			if (behind == 0 && it->retries == 0)
+				UpdateRoundTrip(cl, (int)(now - it->sent));
+
+			it = cl->oldpackets.erase(it);
+			continue;
+		}
+
+		// Packets after this one made it and it didn't, so it's probably
+		// lost rather than late.  Don't wait for the timeout.
+		if (hasbits && behind >= FAST_RETRANSMIT_DISTANCE && behind <= 32 &&
+		    now - it->sent >= (dtime_t)MAX(cl->srtt, RTO_MIN))
+		{
+			sendcontext_t& ctx = MainSendContext();
+			ctx.now = now;
+			ResendPacket(ctx, player, *it);
+		}
+
+		++it;
+	}
+
+	FlushSendContext(MainSendContext());
 
-	cl->last_sequence = sequence;
+	const int previous = cl->last_sequence;
+	cl->last_sequence = MAX(cl->last_sequence, sequence);
 
-	if (cl->last_sequence == 0)
+	if (previous < 0 && cl->last_sequence == 0)
 	{
 		// [AM] Finish our connection sequence.
 		SV_ConnectClient2(player);
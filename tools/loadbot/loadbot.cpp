@@ -0,0 +1,837 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Headless load generator.  Connects a number of fake players to a
+//   server, sends them wandering around at 35 tics a second and reports
+//   the bandwidth, round trip and tic jitter each of them saw.
+//
+//   Only as much of the protocol as a player needs to stay connected is
+//   spoken here.  Messages from the server are framed by a header byte and
+//   a size, so everything the bots don't care about is skipped without
+//   being decoded.
+//
+//-----------------------------------------------------------------------------
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "i_net.h"
+#include "minilzo.h"
+
+// NetCommand fields, from common/d_netcmd.h, which keeps them private.
+#define CMD_BUTTONS 0x01
+#define CMD_ANGLE 0x02
+#define CMD_FORWARD 0x08
+#define CMD_SIDE 0x10
+
+// How many tics back a ping reply can be matched to the tic it was sent on.
+#define MAXSAVETICS 64
+
+// How often to ask again while connecting, in ms.
+#define CONNECT_RETRY_MS 1000
+
+static long long MSTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//
+// Writer
+//
+// Little-endian, the same as MSG_Write*.
+//
+struct Writer
+{
+	std::string data;
+
+	void byte(int b) { data += (char)(b & 0xFF); }
+	void shortint(int s) { byte(s); byte(s >> 8); }
+	void longint(int l) { shortint(l); shortint(l >> 16); }
+	void string(const char* s) { data.append(s, strlen(s) + 1); }
+};
+
+//
+// Reader
+//
+// Sets bad instead of running off the end.
+//
+struct Reader
+{
+	const unsigned char* data;
+	size_t size, pos;
+	bool bad;
+
+	Reader(const unsigned char* d, size_t s) : data(d), size(s), pos(0), bad(false) { }
+
+	size_t left() const { return size - pos; }
+
+	int byte()
+	{
+		if (pos + 1 > size)
+		{
+			bad = true;
+			return 0;
+		}
+		return data[pos++];
+	}
+
+	int longint()
+	{
+		int l = byte();
+		l |= byte() << 8;
+		l |= byte() << 16;
+		l |= byte() << 24;
+		return l;
+	}
+
+	unsigned long long varint()
+	{
+		unsigned long long v = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			const int b = byte();
+			v |= (unsigned long long)(b & 0x7F) << shift;
+			if (bad || !(b & 0x80))
+				return v;
+		}
+
+		bad = true;
+		return 0;
+	}
+
+	const unsigned char* chunk(size_t len)
+	{
+		if (pos + len > size)
+		{
+			bad = true;
+			return NULL;
+		}
+		pos += len;
+		return data + pos - len;
+	}
+};
+
+//
+// ProtoField
+//
+// Finds a varint field in an encoded protobuf message.  Nothing the bots
+// need is nested, so this is as far as decoding goes.
+//
+static bool ProtoField(const unsigned char* data, size_t size, int field,
+                       unsigned long long& out)
+{
+	Reader r(data, size);
+	while (r.left() && !r.bad)
+	{
+		const unsigned long long key = r.varint();
+		const int wiretype = key & 7;
+
+		if (wiretype == 0)
+		{
+			const unsigned long long v = r.varint();
+			if ((int)(key >> 3) == field && !r.bad)
+			{
+				out = v;
+				return true;
+			}
+		}
+		else if (wiretype == 1)
+			r.chunk(8);
+		else if (wiretype == 2)
+			r.chunk(r.varint());
+		else if (wiretype == 5)
+			r.chunk(4);
+		else
+			return false;
+	}
+
+	return false;
+}
+
+enum botstate_t
+{
+	BOT_IDLE,		// not started yet
+	BOT_QUERYING,	// waiting for the launcher reply with our token
+	BOT_JOINING,	// waiting for the first packet
+	BOT_CONNECTED,
+	BOT_GONE
+};
+
+struct Fragments
+{
+	std::vector<std::string> pieces;
+	size_t received;
+};
+
+struct Bot
+{
+	int id;
+	int sock;
+	botstate_t state;
+	long long lastsend;
+	int token;
+	int pid;
+	int netfeatures;	// what the server agreed to
+	bool joined;
+	std::string reason;
+
+	int packetseq[PACKET_SEQ_WINDOW];
+	std::map<int, Fragments> fragments;
+	std::string pending;	// acks and replies waiting for the next tic
+
+	int tic;
+	long long ticsent[MAXSAVETICS];
+	int angle;
+	int forward, side;
+	int turnleft;
+
+	// Stats.
+	long long connected;
+	long long bytesin, bytesout;
+	int packetsin, duplicates, dropped;
+	long long rttsum;
+	int rttcount, rttmax;
+	int ping;
+	long long lastgametic;
+	double gapsum, gapsqsum;
+	int gapcount, gapmax;
+
+	Bot(int id)
+	    : id(id), sock(-1), state(BOT_IDLE), lastsend(0), token(0), pid(-1), netfeatures(0), joined(false),
+	      tic(0), angle(0), forward(0), side(0), turnleft(0), connected(0), bytesin(0),
+	      bytesout(0), packetsin(0), duplicates(0), dropped(0), rttsum(0), rttcount(0),
+	      rttmax(0), ping(0), lastgametic(0), gapsum(0), gapsqsum(0), gapcount(0), gapmax(0)
+	{
+		memset(packetseq, -1, sizeof(packetseq));
+		memset(ticsent, 0, sizeof(ticsent));
+	}
+};
+
+static sockaddr_in serveraddr;
+static int losspercent = 0;
+static bool spectate = false;
+static bool legacy = false;
+static int rampms = 50;
+
+static void SendRaw(Bot& bot, const std::string& data)
+{
+	if (sendto(bot.sock, data.data(), data.size(), 0, (const sockaddr*)&serveraddr,
+	           sizeof(serveraddr)) > 0)
+	{
+		bot.bytesout += data.size();
+	}
+	bot.lastsend = MSTime();
+}
+
+static void SendQuery(Bot& bot)
+{
+	Writer w;
+	w.longint(LAUNCHER_CHALLENGE);
+	SendRaw(bot, w.data);
+}
+
+//
+// SendJoin
+//
+// The same as CL_TryToConnect and CL_SendUserInfo.
+//
+static void SendJoin(Bot& bot)
+{
+	Writer w;
+	w.longint(PROTO_CHALLENGE);
+	w.longint(bot.token);
+	w.shortint(VERSION);
+	w.byte(0);			// play rather than spectate, rcon or download
+	w.longint(GAMEVER);
+
+	char name[16];
+	snprintf(name, sizeof(name), "loadbot%d", bot.id);
+
+	w.byte(clc_userinfo);
+	w.string(name);
+	w.byte(0);			// team
+	w.longint(0);		// gender
+	w.byte(0);			// color
+	w.byte(0x40 + bot.id * 37 % 0xC0);
+	w.byte(0x40 + bot.id * 71 % 0xC0);
+	w.byte(0x40 + bot.id * 13 % 0xC0);
+	w.string("");		// skin
+	w.longint(16384);	// aimdist
+	w.byte(1);			// unlag
+	w.byte(0);			// predict weapons
+	w.byte(0);			// switch weapon
+	for (int i = 0; i < NUMWEAPONS; i++)
+		w.byte(i);
+
+	w.longint(0xFFFF);	// rate, ignored
+	w.string("");		// password hash
+	if (!legacy)
+		w.longint(NETF_ALL);
+
+	SendRaw(bot, w.data);
+}
+
+static void Disconnect(Bot& bot, const std::string& reason)
+{
+	if (bot.state == BOT_CONNECTED)
+	{
+		Writer w;
+		w.byte(clc_disconnect);
+		SendRaw(bot, w.data);
+	}
+
+	bot.state = BOT_GONE;
+	if (bot.reason.empty())
+		bot.reason = reason;
+}
+
+//
+// QueueAck
+//
+// The same as CL_SendAck.
+//
+static void QueueAck(Bot& bot, int sequence)
+{
+	if (!(bot.netfeatures & NETF_SELECTIVEACK))
+	{
+		Writer w;
+		w.byte(clc_ack);
+		w.longint(sequence);
+		bot.pending += w.data;
+		return;
+	}
+
+	unsigned int bits = 0;
+	for (int i = 0; i < 32; i++)
+	{
+		const int seq = sequence - 1 - i;
+		if (seq >= 0 && bot.packetseq[seq & (PACKET_SEQ_WINDOW - 1)] == seq)
+			bits |= 1u << i;
+	}
+
+	Writer w;
+	w.byte(clc_ackbits);
+	w.longint(sequence);
+	w.longint(bits);
+	bot.pending += w.data;
+}
+
+static void ParseMessages(Bot& bot, const unsigned char* data, size_t size)
+{
+	Reader r(data, size);
+	while (r.left() && !r.bad && bot.state == BOT_CONNECTED)
+	{
+		const int header = r.byte();
+		const size_t len = r.varint();
+		const unsigned char* msg = r.chunk(len);
+		if (r.bad)
+		{
+			Disconnect(bot, "bad message framing");
+			return;
+		}
+
+		unsigned long long v = 0;
+		const long long now = MSTime();
+
+		switch (header)
+		{
+		case svc_disconnect:
+			Disconnect(bot, "disconnected by server");
+			break;
+
+		case svc_reconnect:
+			// The map changed, so start over.
+			bot.state = BOT_QUERYING;
+			bot.joined = false;
+			SendQuery(bot);
+			return;
+
+		case svc_consoleplayer:
+			if (ProtoField(msg, len, 1, v))
+				bot.pid = (int)v;
+			bot.netfeatures = ProtoField(msg, len, 3, v) ? (int)v & NETF_ALL : 0;
+			break;
+
+		case svc_pingrequest:
+			if (ProtoField(msg, len, 1, v))
+			{
+				Writer w;
+				w.byte(clc_pingreply);
+				w.longint((int)v);
+				bot.pending += w.data;
+			}
+			break;
+
+		case svc_updateping:
+		{
+			unsigned long long pid = 0;
+			if (ProtoField(msg, len, 1, pid) && (int)pid == bot.pid &&
+			    ProtoField(msg, len, 2, v))
+				bot.ping = (int)v;
+			break;
+		}
+
+		case svc_updatelocalplayer:
+			// The server echoes the newest tic of ours it has run.
+			if (ProtoField(msg, len, 1, v) && (int)v > bot.tic - MAXSAVETICS &&
+			    (int)v <= bot.tic)
+			{
+				const int rtt = (int)(now - bot.ticsent[(int)v % MAXSAVETICS]);
+				bot.rttsum += rtt;
+				bot.rttcount++;
+				if (rtt > bot.rttmax)
+					bot.rttmax = rtt;
+			}
+			break;
+
+		case svc_servergametic:
+			if (bot.lastgametic)
+			{
+				const int gap = (int)(now - bot.lastgametic);
+				bot.gapsum += gap;
+				bot.gapsqsum += (double)gap * gap;
+				bot.gapcount++;
+				if (gap > bot.gapmax)
+					bot.gapmax = gap;
+			}
+			bot.lastgametic = now;
+			break;
+		}
+	}
+}
+
+//
+// ReadFragment
+//
+// The same as CL_ReadFragment.  Returns true with out filled in once every
+// piece has arrived.
+//
+static bool ReadFragment(Bot& bot, int sequence, Reader& r, std::string& out)
+{
+	const int first = r.longint();
+	const int index = r.byte();
+	const int count = r.byte();
+
+	if (r.bad || count <= 0 || index >= count || first > sequence)
+		return false;
+
+	while (!bot.fragments.empty() &&
+	       bot.fragments.begin()->first <= sequence - PACKET_SEQ_WINDOW)
+		bot.fragments.erase(bot.fragments.begin());
+
+	Fragments& frag = bot.fragments[first];
+	if (frag.pieces.empty())
+	{
+		frag.pieces.resize(count);
+		frag.received = 0;
+	}
+
+	const size_t len = r.left();
+	if (frag.pieces.size() != (size_t)count || !frag.pieces[index].empty() || len == 0)
+		return false;
+
+	frag.pieces[index].assign((const char*)r.chunk(len), len);
+	if (++frag.received < frag.pieces.size())
+		return false;
+
+	out.clear();
+	for (size_t i = 0; i < frag.pieces.size(); i++)
+		out += frag.pieces[i];
+
+	bot.fragments.erase(first);
+	return true;
+}
+
+//
+// ReadPacket
+//
+// The same as CL_ReadPacketHeader followed by CL_ParseCommands.
+//
+static void ReadPacket(Bot& bot, const unsigned char* data, size_t size)
+{
+	Reader r(data, size);
+	const int sequence = r.longint();
+	if (r.bad)
+		return;
+
+	if (bot.state == BOT_QUERYING)
+	{
+		if (sequence == MSG_CHALLENGE)
+		{
+			bot.token = r.longint();
+			bot.state = BOT_JOINING;
+			SendJoin(bot);
+		}
+		return;
+	}
+
+	if (bot.state == BOT_JOINING)
+	{
+		if (sequence != 0)
+			return;
+
+		bot.state = BOT_CONNECTED;
+		bot.connected = MSTime();
+		memset(bot.packetseq, -1, sizeof(bot.packetseq));
+		bot.fragments.clear();
+		bot.netfeatures = 0;
+	}
+
+	bot.packetsin++;
+	bot.bytesin += size;
+
+	int& slot = bot.packetseq[sequence & (PACKET_SEQ_WINDOW - 1)];
+	if (slot == sequence)
+	{
+		bot.duplicates++;
+		QueueAck(bot, sequence);
+		return;
+	}
+
+	slot = sequence;
+	QueueAck(bot, sequence);
+
+	const int flags = r.byte();
+	if (r.bad || (flags & ~(SVF_COMPRESSED | SVF_FRAGMENT)))
+	{
+		Disconnect(bot, "unknown packet flags");
+		return;
+	}
+
+	static unsigned char decompressed[MAX_UDP_PACKET * 4];
+	if (flags & SVF_COMPRESSED)
+	{
+		lzo_uint newlen = sizeof(decompressed);
+		if (lzo1x_decompress_safe(data + r.pos, r.left(), decompressed, &newlen, NULL) !=
+		    LZO_E_OK)
+		{
+			Disconnect(bot, "decompression failed");
+			return;
+		}
+		r = Reader(decompressed, newlen);
+	}
+
+	if (flags & SVF_FRAGMENT)
+	{
+		std::string whole;
+		if (ReadFragment(bot, sequence, r, whole))
+			ParseMessages(bot, (const unsigned char*)whole.data(), whole.size());
+		return;
+	}
+
+	ParseMessages(bot, r.data + r.pos, r.left());
+}
+
+//
+// RunTic
+//
+// Wanders around, the same way for every run, and sends the tic's command
+// along with the last nine so a lost packet doesn't lose any movement.
+//
+static void RunTic(Bot& bot)
+{
+	const long long now = MSTime();
+
+	if (bot.state == BOT_QUERYING || bot.state == BOT_JOINING)
+	{
+		if (now - bot.lastsend >= CONNECT_RETRY_MS)
+		{
+			if (bot.state == BOT_QUERYING)
+				SendQuery(bot);
+			else
+				SendJoin(bot);
+		}
+		return;
+	}
+
+	if (bot.state != BOT_CONNECTED)
+		return;
+
+	Writer w;
+	w.data.swap(bot.pending);
+
+	if (!bot.joined && !spectate && now - bot.connected >= 1000)
+	{
+		w.byte(clc_spectate);
+		w.byte(0);
+		bot.joined = true;
+	}
+
+	bot.tic++;
+	bot.ticsent[bot.tic % MAXSAVETICS] = now;
+
+	if (bot.turnleft-- <= 0)
+	{
+		bot.turnleft = 10 + rand() % 70;
+		bot.forward = (rand() % 3 - 1) * 50;
+		bot.side = (rand() % 3 - 1) * 40;
+		if (bot.forward == 0 && bot.side == 0)
+			bot.forward = 25;
+	}
+	bot.angle += (rand() % 3 - 1) * 256;
+
+	w.byte(clc_move);
+	w.longint(bot.tic);
+	for (int i = 9; i >= 0; i--)
+	{
+		w.byte(CMD_BUTTONS | CMD_ANGLE | CMD_FORWARD | CMD_SIDE);
+		w.longint(0);	// world index
+		w.byte((rand() % 8 == 0) ? 1 : 0);
+		w.shortint(bot.angle);
+		w.shortint(bot.forward);
+		w.shortint(bot.side);
+	}
+
+	SendRaw(bot, w.data);
+}
+
+static void Usage()
+{
+	fprintf(stderr,
+	        "Usage: loadbot [-n CLIENTS] [-s HOST:PORT] [-t SECONDS] [-l LOSS] [-r RAMP] [-spec]\n"
+	        "               [-legacy]\n\n"
+	        "Connects CLIENTS (default 16) fake players to a server (default\n"
+	        "127.0.0.1:10666) for SECONDS (default 60) and reports what each of\n"
+	        "them saw.  LOSS is the percentage of packets from the server to\n"
+	        "throw away, to try out the reliable channel.  RAMP is the time in ms\n"
+	        "between bots connecting (default 50).  With -spec the bots stay\n"
+	        "spectators instead of joining the game.  With -legacy they don't ask\n"
+	        "for any network features, like clients from before they existed.\n\n"
+	        "The server has to allow enough clients, for example with\n"
+	        "+sv_maxclients 128 +sv_maxplayers 128.\n");
+}
+
+int main(int argc, char** argv)
+{
+	int numbots = 16;
+	int seconds = 60;
+	std::string server = "127.0.0.1:10666";
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const bool hasvalue = i + 1 < argc;
+
+		if (arg == "-n" && hasvalue)
+			numbots = atoi(argv[++i]);
+		else if (arg == "-s" && hasvalue)
+			server = argv[++i];
+		else if (arg == "-t" && hasvalue)
+			seconds = atoi(argv[++i]);
+		else if (arg == "-l" && hasvalue)
+			losspercent = atoi(argv[++i]);
+		else if (arg == "-r" && hasvalue)
+			rampms = atoi(argv[++i]);
+		else if (arg == "-spec")
+			spectate = true;
+		else if (arg == "-legacy")
+			legacy = true;
+		else
+		{
+			Usage();
+			return 1;
+		}
+	}
+
+	if (numbots < 1 || numbots > 255 || seconds < 1)
+	{
+		Usage();
+		return 1;
+	}
+
+	std::string host = server, port = "10666";
+	const size_t colon = server.rfind(':');
+	if (colon != std::string::npos)
+	{
+		host = server.substr(0, colon);
+		port = server.substr(colon + 1);
+	}
+
+	addrinfo hints, *res = NULL;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || res == NULL)
+	{
+		fprintf(stderr, "Could not resolve \"%s\".\n", server.c_str());
+		return 1;
+	}
+	memcpy(&serveraddr, res->ai_addr, sizeof(serveraddr));
+	freeaddrinfo(res);
+
+	if (lzo_init() != LZO_E_OK)
+	{
+		fprintf(stderr, "Could not initialize minilzo.\n");
+		return 1;
+	}
+
+	srand(1);
+
+	std::vector<Bot*> bots;
+	std::vector<pollfd> fds;
+	for (int i = 0; i < numbots; i++)
+	{
+		Bot* bot = new Bot(i + 1);
+		bot->sock = socket(AF_INET, SOCK_DGRAM, 0);
+		if (bot->sock < 0)
+		{
+			fprintf(stderr, "Could not create a socket: %s\n", strerror(errno));
+			return 1;
+		}
+
+		pollfd pfd = {bot->sock, POLLIN, 0};
+		fds.push_back(pfd);
+		bots.push_back(bot);
+	}
+
+	printf("Connecting %d bots to %s for %d seconds...\n", numbots, server.c_str(), seconds);
+
+	const long long start = MSTime();
+	const long long end = start + seconds * 1000LL;
+	long long nexttic = start;
+	long long nextreport = start + 1000;
+	long long lastbytes = 0;
+	unsigned char packet[MAX_UDP_PACKET];
+
+	while (MSTime() < end)
+	{
+		const long long now = MSTime();
+
+		if (now >= nexttic)
+		{
+			for (size_t i = 0; i < bots.size(); i++)
+			{
+				Bot& bot = *bots[i];
+				if (bot.state == BOT_IDLE && now - start >= (long long)i * rampms)
+				{
+					bot.state = BOT_QUERYING;
+					SendQuery(bot);
+				}
+
+				RunTic(bot);
+			}
+
+			// Keep to the schedule rather than drift.
+			nexttic += 1000 / TICRATE;
+			if (nexttic < now)
+				nexttic = now + 1000 / TICRATE;
+		}
+
+		if (now >= nextreport)
+		{
+			int connected = 0;
+			long long bytes = 0;
+			for (size_t i = 0; i < bots.size(); i++)
+			{
+				connected += bots[i]->state == BOT_CONNECTED;
+				bytes += bots[i]->bytesin;
+			}
+
+			printf("%3llds: %d connected, %lld KB/s in\n", (now - start) / 1000, connected,
+			       (bytes - lastbytes) / 1024);
+			fflush(stdout);
+
+			lastbytes = bytes;
+			nextreport += 1000;
+		}
+
+		const int wait = (int)(nexttic - MSTime());
+		if (poll(&fds[0], fds.size(), wait > 0 ? wait : 0) <= 0)
+			continue;
+
+		for (size_t i = 0; i < fds.size(); i++)
+		{
+			if (!(fds[i].revents & POLLIN))
+				continue;
+
+			ssize_t len;
+			while ((len = recv(fds[i].fd, packet, sizeof(packet), MSG_DONTWAIT)) > 0)
+			{
+				if (losspercent > 0 && rand() % 100 < losspercent)
+				{
+					bots[i]->dropped++;
+					continue;
+				}
+
+				ReadPacket(*bots[i], packet, len);
+			}
+		}
+	}
+
+	const double elapsed = (MSTime() - start) / 1000.0;
+
+	printf("\n bot  state      KB/s in  KB/s out  pkts/s  dups  lost  rtt avg/max    ping  "
+	       "tic gap avg/sd/max\n");
+
+	long long totalin = 0, totalout = 0;
+	int numconnected = 0;
+	for (size_t i = 0; i < bots.size(); i++)
+	{
+		Bot& bot = *bots[i];
+		const char* state = bot.state == BOT_CONNECTED ? "connected" :
+		                    bot.state == BOT_GONE      ? "gone" :
+		                                                 "connecting";
+
+		const double secs = bot.connected ? (MSTime() - bot.connected) / 1000.0 : elapsed;
+		const double gapavg = bot.gapcount ? bot.gapsum / bot.gapcount : 0;
+		const double gapsd =
+		    bot.gapcount ? sqrt(std::max(0.0, bot.gapsqsum / bot.gapcount - gapavg * gapavg)) : 0;
+
+		printf("%4d  %-10s %7.1f  %8.1f  %6.1f  %4d  %4d  %4d / %-5d  %4d  %5.1f / %4.1f / %d\n",
+		       bot.id, state, bot.bytesin / 1024.0 / secs, bot.bytesout / 1024.0 / secs,
+		       bot.packetsin / secs, bot.duplicates, bot.dropped,
+		       bot.rttcount ? (int)(bot.rttsum / bot.rttcount) : 0, bot.rttmax, bot.ping,
+		       gapavg, gapsd, bot.gapmax);
+
+		if (!bot.reason.empty())
+			printf("      %s\n", bot.reason.c_str());
+
+		totalin += bot.bytesin;
+		totalout += bot.bytesout;
+		numconnected += bot.state == BOT_CONNECTED;
+
+		Disconnect(bot, "");
+		close(bot.sock);
+	}
+
+	printf("\n%d of %d bots connected at the end, %.1f KB/s in, %.1f KB/s out in total.\n",
+	       numconnected, numbots, totalin / 1024.0 / elapsed, totalout / 1024.0 / elapsed);
+
+	return 0;
+}
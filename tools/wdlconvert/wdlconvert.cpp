@@ -0,0 +1,236 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Converts WDL stats logs between the text and binary formats.  The
+//   format of the input is detected, and the output is the other one.
+//
+//   The binary format is described next to FinishStream in
+//   common/m_wdlstats.cpp.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define WDLSTATS_BINARY_VERSION 1
+
+#define NUM_EVENT_FIELDS 14
+#define GAMETIC_FIELD 3
+
+static bool ReadFile(const char* filename, std::string& out)
+{
+	FILE* fh = fopen(filename, "rb");
+	if (fh == NULL)
+		return false;
+
+	char buf[8192];
+	size_t len;
+	while ((len = fread(buf, 1, sizeof(buf), fh)) > 0)
+		out.append(buf, len);
+
+	bool ok = !ferror(fh);
+	fclose(fh);
+	return ok;
+}
+
+static void WriteVarint(std::string& out, int v)
+{
+	unsigned int uv = ((unsigned int)v << 1) ^ (unsigned int)(v >> 31);
+	while (uv >= 0x80)
+	{
+		out += (char)((uv & 0x7F) | 0x80);
+		uv >>= 7;
+	}
+	out += (char)uv;
+}
+
+//
+// ReadVarint
+//
+// Returns false if the varint runs off the end of the data or is too big.
+//
+static bool ReadVarint(const std::string& in, size_t& pos, int& v)
+{
+	unsigned int uv = 0;
+	for (unsigned int shift = 0; shift < 35; shift += 7)
+	{
+		if (pos >= in.size())
+			return false;
+
+		const unsigned char b = in[pos++];
+		uv |= (unsigned int)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+		{
+			v = (int)((uv >> 1) ^ (0U - (uv & 1)));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool TextToBinary(const std::string& in, std::string& out)
+{
+	// The header is everything up to the events line.
+	size_t events;
+	if (in.compare(0, 7, "events\n") == 0)
+		events = 0;
+	else if ((events = in.find("\nevents\n")) != std::string::npos)
+		events++;
+	else
+	{
+		fprintf(stderr, "No events section found.\n");
+		return false;
+	}
+
+	out = "WDLB";
+	WriteVarint(out, WDLSTATS_BINARY_VERSION);
+	WriteVarint(out, (int)events);
+	out.append(in, 0, events);
+
+	int lasttic = 0;
+	size_t pos = events + 7;
+	while (pos < in.size())
+	{
+		size_t end = in.find('\n', pos);
+		if (end == std::string::npos)
+			end = in.size();
+
+		const std::string line = in.substr(pos, end - pos);
+		pos = end + 1;
+
+		if (line.empty() || line == "\r")
+			continue;
+
+		int f[NUM_EVENT_FIELDS];
+		if (sscanf(line.c_str(), "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d", &f[0],
+		           &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8], &f[9], &f[10],
+		           &f[11], &f[12], &f[13]) != NUM_EVENT_FIELDS)
+		{
+			fprintf(stderr, "Bad event line \"%s\".\n", line.c_str());
+			return false;
+		}
+
+		for (int i = 0; i < NUM_EVENT_FIELDS; i++)
+		{
+			if (i == GAMETIC_FIELD)
+			{
+				WriteVarint(out, f[i] - lasttic);
+				lasttic = f[i];
+			}
+			else
+			{
+				WriteVarint(out, f[i]);
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool BinaryToText(const std::string& in, std::string& out)
+{
+	size_t pos = 4;
+	int version, headersize;
+	if (!ReadVarint(in, pos, version) || !ReadVarint(in, pos, headersize) ||
+	    headersize < 0 || pos + headersize > in.size())
+	{
+		fprintf(stderr, "Truncated header.\n");
+		return false;
+	}
+
+	if (version != WDLSTATS_BINARY_VERSION)
+	{
+		fprintf(stderr, "Unknown binary version %d.\n", version);
+		return false;
+	}
+
+	out.assign(in, pos, headersize);
+	out += "events\n";
+	pos += headersize;
+
+	int lasttic = 0;
+	while (pos < in.size())
+	{
+		int f[NUM_EVENT_FIELDS];
+		for (int i = 0; i < NUM_EVENT_FIELDS; i++)
+		{
+			if (!ReadVarint(in, pos, f[i]))
+			{
+				fprintf(stderr, "Truncated event at offset %lu.\n", (unsigned long)pos);
+				return false;
+			}
+		}
+
+		f[GAMETIC_FIELD] += lasttic;
+		lasttic = f[GAMETIC_FIELD];
+
+		char buf[256];
+		int len = snprintf(buf, sizeof(buf), "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n",
+		                   f[0], f[1], f[2], f[3], f[4], f[5], f[6], f[7], f[8], f[9],
+		                   f[10], f[11], f[12], f[13]);
+		out.append(buf, len);
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		fprintf(stderr,
+		        "Usage: wdlconvert <INPUT> <OUTPUT>\n\n"
+		        "Converts a WDL stats log from the text format to the binary format,\n"
+		        "or from the binary format back to text.\n");
+		return 1;
+	}
+
+	std::string in;
+	if (!ReadFile(argv[1], in))
+	{
+		fprintf(stderr, "Could not read \"%s\".\n", argv[1]);
+		return 1;
+	}
+
+	const bool binary = in.compare(0, 4, "WDLB") == 0;
+
+	std::string out;
+	if (!(binary ? BinaryToText(in, out) : TextToBinary(in, out)))
+		return 1;
+
+	FILE* fh = fopen(argv[2], binary ? "w" : "wb");
+	if (fh == NULL)
+	{
+		fprintf(stderr, "Could not open \"%s\" for writing.\n", argv[2]);
+		return 1;
+	}
+
+	fwrite(out.data(), 1, out.size(), fh);
+	if (fclose(fh) != 0)
+	{
+		fprintf(stderr, "Could not write \"%s\".\n", argv[2]);
+		return 1;
+	}
+
+	printf("Converted %s log \"%s\" to %s log \"%s\".\n", binary ? "binary" : "text",
+	       argv[1], binary ? "text" : "binary", argv[2]);
+	return 0;
+}